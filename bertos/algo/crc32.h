@@ -0,0 +1,72 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Cyclic Redundancy Check 32 (CRC-32).
+ *
+ * This is the CRC-32 of IEEE 802.3, zlib and PNG: reflected polynomial
+ * 0xEDB88320, register preset to ~0 and complemented at the end.
+ *
+ * $WIZ$ module_name = "crc32"
+ */
+
+#ifndef ALGO_CRC32_H
+#define ALGO_CRC32_H
+
+#include "cfg/cfg_arch.h"
+
+#include <cfg/compiler.h>
+#include <cpu/pgm.h>
+
+EXTERN_C_BEGIN
+
+/* CRC table */
+extern const uint32_t crc32tab[256];
+
+/** CRC-32 init value */
+#define CRC32_INIT_VAL ((uint32_t)0)
+
+/**
+ * Compute the CRC-32 of a buffer.
+ * The result of a call can be passed as \a crc to the next one, to compute
+ * the CRC of data coming in chunks.
+ *
+ * \param crc  Current CRC-32 value, CRC32_INIT_VAL at start.
+ * \param buf  The buffer to perform CRC calculation on.
+ * \param len  The length of the buffer.
+ *
+ * \return The updated CRC-32 value.
+ */
+uint32_t crc32(uint32_t crc, const void *buf, size_t len);
+
+EXTERN_C_END
+
+#endif /* ALGO_CRC32_H */
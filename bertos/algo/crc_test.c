@@ -38,6 +38,7 @@
 
 #include "crc_ccitt.h"
 #include "crc.h"
+#include "crc32.h"
 
 #include <cfg/debug.h>
 #include <cfg/test.h>
@@ -69,6 +70,14 @@ int crc_testRun(void)
 	kprintf("crc16 [%04X]\n", crc);
 	ASSERT(crc == 0x31C3);
 
+	uint32_t crc_32 = crc32(CRC32_INIT_VAL, vector, sizeof(vector));
+	kprintf("crc32 [%08lX]\n", (unsigned long)crc_32);
+	ASSERT(crc_32 == 0xCBF43926);
+
+	/* Chained on two chunks */
+	crc_32 = crc32(crc32(CRC32_INIT_VAL, vector, 4), vector + 4, sizeof(vector) - 4);
+	ASSERT(crc_32 == 0xCBF43926);
+
 	return  0;
 }
 
@@ -0,0 +1,405 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Fixed point FIR, biquad and CIC filters (implementation).
+ */
+
+#include "filter.h"
+
+#include <cpu/detect.h>
+
+#include <cfg/debug.h>
+#include <cfg/macros.h>
+
+#include <string.h>
+
+#if CPU_X86 && defined(__SSE2__)
+	#include <emmintrin.h>
+#endif
+
+/*
+ * Arithmetic primitives: 32x32 -> 64 bit multiply-accumulate, high word
+ * of a 32x32 bit product and saturation.
+ */
+#if CPU_CM3
+
+INLINE int64_t filter_mac(int64_t acc, int32_t a, int32_t b)
+{
+	uint32_t lo = (uint32_t)acc;
+	int32_t hi = (int32_t)(acc >> 32);
+
+	asm ("smlal %0, %1, %2, %3" : "+r" (lo), "+r" (hi) : "r" (a), "r" (b));
+	return ((int64_t)hi << 32) | lo;
+}
+
+INLINE int32_t filter_mulHigh(int32_t a, int32_t b)
+{
+	uint32_t lo;
+	int32_t hi;
+
+	asm ("smull %0, %1, %2, %3" : "=&r" (lo), "=&r" (hi) : "r" (a), "r" (b));
+	return hi;
+}
+
+INLINE q15_t filter_sat16(int32_t x)
+{
+	asm ("ssat %0, #16, %1" : "=r" (x) : "r" (x));
+	return x;
+}
+
+#else
+
+INLINE int64_t filter_mac(int64_t acc, int32_t a, int32_t b)
+{
+	return acc + (int64_t)a * b;
+}
+
+INLINE int32_t filter_mulHigh(int32_t a, int32_t b)
+{
+	return ((int64_t)a * b) >> 32;
+}
+
+INLINE q15_t filter_sat16(int32_t x)
+{
+	return MINMAX(INT16_MIN, x, INT16_MAX);
+}
+
+#endif
+
+INLINE q31_t filter_sat32(int64_t x)
+{
+	return MINMAX((int64_t)INT32_MIN, x, (int64_t)INT32_MAX);
+}
+
+
+/*
+ * Q15 dot product, exact in 64 bits.
+ */
+#if CPU_X86 && defined(__SSE2__)
+
+static int64_t fir_dotQ15(const q15_t *c, const q15_t *x, uint16_t n)
+{
+	__m128i acc = _mm_setzero_si128();
+	int64_t lanes[2];
+	uint16_t k;
+
+	/*
+	 * pmaddwd sums pairs of 32 bit products: it overflows only for two
+	 * -32768 coefficients in a row, which are not allowed.
+	 */
+	for (k = 0; k + 8 <= n; k += 8)
+	{
+		__m128i p = _mm_madd_epi16(
+			_mm_loadu_si128((const __m128i *)(c + k)),
+			_mm_loadu_si128((const __m128i *)(x + k)));
+		__m128i sign = _mm_srai_epi32(p, 31);
+
+		acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(p, sign));
+		acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(p, sign));
+	}
+	_mm_storeu_si128((__m128i *)lanes, acc);
+
+	int64_t sum = lanes[0] + lanes[1];
+	for (; k < n; k++)
+		sum += (int32_t)c[k] * x[k];
+	return sum;
+}
+
+#else
+
+static int64_t fir_dotQ15(const q15_t *c, const q15_t *x, uint16_t n)
+{
+	int64_t acc = 0;
+	uint16_t k;
+
+	for (k = 0; k + 4 <= n; k += 4)
+	{
+		acc = filter_mac(acc, c[k], x[k]);
+		acc = filter_mac(acc, c[k + 1], x[k + 1]);
+		acc = filter_mac(acc, c[k + 2], x[k + 2]);
+		acc = filter_mac(acc, c[k + 3], x[k + 3]);
+	}
+	for (; k < n; k++)
+		acc = filter_mac(acc, c[k], x[k]);
+	return acc;
+}
+
+#endif
+
+/*
+ * Q31 dot product, summing the high words of the products.
+ */
+static int64_t fir_dotQ31(const q31_t *c, const q31_t *x, uint16_t n)
+{
+	int64_t acc = 0;
+	uint16_t k;
+
+	for (k = 0; k + 4 <= n; k += 4)
+	{
+		acc += filter_mulHigh(c[k], x[k]);
+		acc += filter_mulHigh(c[k + 1], x[k + 1]);
+		acc += filter_mulHigh(c[k + 2], x[k + 2]);
+		acc += filter_mulHigh(c[k + 3], x[k + 3]);
+	}
+	for (; k < n; k++)
+		acc += filter_mulHigh(c[k], x[k]);
+	return acc;
+}
+
+
+void fir_q15_init(FirQ15 *f, const q15_t *coeffs, uint16_t ntaps, uint8_t decim,
+	q15_t *state, size_t state_len)
+{
+	ASSERT(ntaps);
+	ASSERT(decim);
+	ASSERT(state_len >= (size_t)ntaps - 1 + decim);
+	DB(for (uint16_t i = 0; i < ntaps; i++)
+		ASSERT(coeffs[i] != INT16_MIN));
+
+	f->coeffs = coeffs;
+	f->state = state;
+	f->state_len = state_len;
+	f->ntaps = ntaps;
+	f->decim = decim;
+	f->phase = 0;
+	memset(state, 0, state_len * sizeof(*state));
+}
+
+/*
+ * The input is copied after the past samples in the state buffer, one
+ * block at a time, so that every output sample is a dot product over
+ * contiguous memory. The output can overwrite the input: a block is
+ * copied before its output is written, and there are never more output
+ * than input samples.
+ */
+size_t fir_q15(FirQ15 *f, const q15_t *in, q15_t *out, size_t n)
+{
+	size_t hist = f->ntaps - 1;
+	size_t block = f->state_len - hist;
+	size_t n_out = 0;
+
+	while (n)
+	{
+		size_t len = MIN(n, block);
+
+		memcpy(f->state + hist, in, len * sizeof(*in));
+		for (size_t i = f->decim - 1 - f->phase; i < len; i += f->decim)
+		{
+			int64_t acc = fir_dotQ15(f->coeffs, f->state + i, f->ntaps);
+			out[n_out++] = filter_sat16((acc + (1 << 14)) >> 15);
+		}
+		f->phase = (f->phase + len) % f->decim;
+		memmove(f->state, f->state + len, hist * sizeof(*in));
+		in += len;
+		n -= len;
+	}
+	return n_out;
+}
+
+void fir_q31_init(FirQ31 *f, const q31_t *coeffs, uint16_t ntaps, uint8_t decim,
+	q31_t *state, size_t state_len)
+{
+	ASSERT(ntaps);
+	ASSERT(decim);
+	ASSERT(state_len >= (size_t)ntaps - 1 + decim);
+
+	f->coeffs = coeffs;
+	f->state = state;
+	f->state_len = state_len;
+	f->ntaps = ntaps;
+	f->decim = decim;
+	f->phase = 0;
+	memset(state, 0, state_len * sizeof(*state));
+}
+
+size_t fir_q31(FirQ31 *f, const q31_t *in, q31_t *out, size_t n)
+{
+	size_t hist = f->ntaps - 1;
+	size_t block = f->state_len - hist;
+	size_t n_out = 0;
+
+	while (n)
+	{
+		size_t len = MIN(n, block);
+
+		memcpy(f->state + hist, in, len * sizeof(*in));
+		for (size_t i = f->decim - 1 - f->phase; i < len; i += f->decim)
+			out[n_out++] = filter_sat32(fir_dotQ31(f->coeffs, f->state + i, f->ntaps) * 2);
+		f->phase = (f->phase + len) % f->decim;
+		memmove(f->state, f->state + len, hist * sizeof(*in));
+		in += len;
+		n -= len;
+	}
+	return n_out;
+}
+
+
+void biquad_q15_init(BiquadQ15 *b, const q15_t *coeffs, uint8_t sections, uint8_t shift, q15_t *state)
+{
+	ASSERT(sections);
+	ASSERT(shift < 15);
+
+	b->coeffs = coeffs;
+	b->state = state;
+	b->sections = sections;
+	b->shift = shift;
+	memset(state, 0, 4 * sections * sizeof(*state));
+}
+
+void biquad_q15(BiquadQ15 *b, const q15_t *in, q15_t *out, size_t n)
+{
+	const q15_t *c = b->coeffs;
+	q15_t *st = b->state;
+	int out_shift = 15 - b->shift;
+	int32_t round = 1L << (out_shift - 1);
+
+	for (uint8_t s = 0; s < b->sections; s++, c += 5, st += 4)
+	{
+		q15_t b0 = c[0], b1 = c[1], b2 = c[2], a1 = c[3], a2 = c[4];
+		q15_t x1 = st[0], x2 = st[1], y1 = st[2], y2 = st[3];
+
+		for (size_t i = 0; i < n; i++)
+		{
+			q15_t x0 = in[i];
+			int64_t acc = round;
+
+			acc = filter_mac(acc, b0, x0);
+			acc = filter_mac(acc, b1, x1);
+			acc = filter_mac(acc, b2, x2);
+			acc = filter_mac(acc, a1, y1);
+			acc = filter_mac(acc, a2, y2);
+
+			x2 = x1;
+			x1 = x0;
+			y2 = y1;
+			y1 = filter_sat16(acc >> out_shift);
+			out[i] = y1;
+		}
+		st[0] = x1;
+		st[1] = x2;
+		st[2] = y1;
+		st[3] = y2;
+		/* The next sections filter the output of this one */
+		in = out;
+	}
+}
+
+void biquad_q31_init(BiquadQ31 *b, const q31_t *coeffs, uint8_t sections, uint8_t shift, q31_t *state)
+{
+	ASSERT(sections);
+	ASSERT(shift < 31);
+
+	b->coeffs = coeffs;
+	b->state = state;
+	b->sections = sections;
+	b->shift = shift;
+	memset(state, 0, 4 * sections * sizeof(*state));
+}
+
+void biquad_q31(BiquadQ31 *b, const q31_t *in, q31_t *out, size_t n)
+{
+	const q31_t *c = b->coeffs;
+	q31_t *st = b->state;
+	int out_shift = 1 + b->shift;
+
+	for (uint8_t s = 0; s < b->sections; s++, c += 5, st += 4)
+	{
+		q31_t b0 = c[0], b1 = c[1], b2 = c[2], a1 = c[3], a2 = c[4];
+		q31_t x1 = st[0], x2 = st[1], y1 = st[2], y2 = st[3];
+
+		for (size_t i = 0; i < n; i++)
+		{
+			q31_t x0 = in[i];
+			int64_t acc = (int64_t)filter_mulHigh(b0, x0)
+				+ filter_mulHigh(b1, x1)
+				+ filter_mulHigh(b2, x2)
+				+ filter_mulHigh(a1, y1)
+				+ filter_mulHigh(a2, y2);
+
+			x2 = x1;
+			x1 = x0;
+			y2 = y1;
+			y1 = filter_sat32(acc << out_shift);
+			out[i] = y1;
+		}
+		st[0] = x1;
+		st[1] = x2;
+		st[2] = y1;
+		st[3] = y2;
+		in = out;
+	}
+}
+
+
+void cic_init(CicDecim *c, uint8_t stages, uint8_t decim)
+{
+	ASSERT(stages && stages <= CIC_MAX_STAGES);
+	ASSERT(decim && IS_POW2(decim));
+
+	memset(c, 0, sizeof(*c));
+	c->stages = stages;
+	c->decim = decim;
+	c->shift = stages * UINT8_LOG2(decim);
+	ASSERT(c->shift <= 16);
+}
+
+/*
+ * The integrators overflow on a steady input, but in two's complement
+ * the combs take the differences right anyway, as long as the output
+ * fits in 32 bits.
+ */
+size_t cic_decimate(CicDecim *c, const q15_t *in, q15_t *out, size_t n)
+{
+	size_t n_out = 0;
+	uint8_t stages = c->stages;
+
+	for (size_t i = 0; i < n; i++)
+	{
+		uint32_t acc = (uint32_t)(int32_t)in[i];
+
+		for (uint8_t s = 0; s < stages; s++)
+			acc = c->integ[s] += acc;
+
+		if (++c->phase == c->decim)
+		{
+			c->phase = 0;
+			for (uint8_t s = 0; s < stages; s++)
+			{
+				uint32_t prev = c->comb[s];
+				c->comb[s] = acc;
+				acc -= prev;
+			}
+			out[n_out++] = filter_sat16((int32_t)acc >> c->shift);
+		}
+	}
+	return n_out;
+}
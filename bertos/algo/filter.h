@@ -0,0 +1,243 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Fixed point FIR, biquad and CIC filters on sample blocks.
+ *
+ * All the filters work on blocks of samples and keep their state between
+ * calls, so a stream can be processed in buffers of any length. Samples
+ * and coefficients are signed fractional numbers: Q15 in int16_t, Q31 in
+ * int32_t.
+ *
+ * \li FIR filters, optionally decimating: only the output samples that
+ *     are kept are computed, which is the polyphase decimator without the
+ *     reordering of the coefficients.
+ * \li Cascades of second order IIR sections (biquads), in direct form I.
+ * \li CIC decimators, to bring down a high sample rate before a FIR.
+ *
+ * The arithmetic is exactly specified, so that every implementation gives
+ * the same bits:
+ *
+ * \li fir_q15(): 64 bit sum of the Q30 products, rounded to Q15 and
+ *     saturated.
+ * \li fir_q31(): sum of the high 32 bits of each Q62 product, in Q30,
+ *     shifted to Q31 and saturated. This drops 32 bits of precision of
+ *     each product, but the sum can not overflow.
+ * \li biquad_q15() and biquad_q31(): as the FIR of the same width, with
+ *     the result shifted left by the \a shift of the coefficients.
+ * \li cic_decimate(): integrators and combs in 32 bit two's complement,
+ *     wrapping around; the output is divided by the gain of the filter.
+ *
+ * The kernels are portable C. On Cortex-M3 the multiply-accumulate and
+ * the saturation use the SMLAL, SMULL and SSAT instructions; on x86 the
+ * Q15 FIR uses the SSE2 multiply-add of 16 bit pairs.
+ *
+ * Example, a 4x decimating low pass on ADC samples:
+ * \code
+ * static const q15_t coeffs[FIR_TAPS] = { ... };
+ * static q15_t history[FIR_TAPS - 1 + 64];
+ * FirQ15 fir;
+ *
+ * fir_q15_init(&fir, coeffs, FIR_TAPS, 4, history, countof(history));
+ * n_out = fir_q15(&fir, samples, samples, n);
+ * \endcode
+ *
+ * $WIZ$ module_name = "filter"
+ */
+
+#ifndef ALGO_FILTER_H
+#define ALGO_FILTER_H
+
+#include <cfg/compiler.h>
+
+/** Q15 fractional value, in [-1, 1) */
+typedef int16_t q15_t;
+
+/** Q31 fractional value, in [-1, 1) */
+typedef int32_t q31_t;
+
+/**
+ * Q15 FIR filter.
+ */
+typedef struct FirQ15
+{
+	const q15_t *coeffs;  ///< Coefficients, oldest sample first
+	q15_t *state;         ///< Past samples and input block
+	size_t state_len;     ///< Length of \a state, in samples
+	uint16_t ntaps;       ///< Number of coefficients
+	uint8_t decim;        ///< Decimation factor
+	uint8_t phase;        ///< Input samples since the last output
+} FirQ15;
+
+/**
+ * Q31 FIR filter.
+ */
+typedef struct FirQ31
+{
+	const q31_t *coeffs;  ///< Coefficients, oldest sample first
+	q31_t *state;         ///< Past samples and input block
+	size_t state_len;     ///< Length of \a state, in samples
+	uint16_t ntaps;       ///< Number of coefficients
+	uint8_t decim;        ///< Decimation factor
+	uint8_t phase;        ///< Input samples since the last output
+} FirQ31;
+
+/**
+ * Initialize a Q15 FIR filter.
+ *
+ * The output sample \c n is <code>sum(coeffs[k] * x[n - ntaps + 1 + k])</code>,
+ * that is the coefficients are in reverse order, \a coeffs[0] multiplying
+ * the oldest sample. For the usual symmetric filters it makes no
+ * difference.
+ *
+ * \param coeffs \a ntaps coefficients, none equal to -32768.
+ * \param decim Decimation factor: one output sample every \a decim input
+ *              samples, 1 for no decimation.
+ * \param state Buffer for the past samples: the filter works on blocks
+ *              of <code>state_len - ntaps + 1</code> input samples, at
+ *              least \a decim.
+ */
+void fir_q15_init(FirQ15 *f, const q15_t *coeffs, uint16_t ntaps, uint8_t decim,
+	q15_t *state, size_t state_len);
+
+/**
+ * Filter \a n samples from \a in into \a out, which can be the same buffer.
+ *
+ * \return The number of output samples.
+ */
+size_t fir_q15(FirQ15 *f, const q15_t *in, q15_t *out, size_t n);
+
+/**
+ * Initialize a Q31 FIR filter, see fir_q15_init().
+ */
+void fir_q31_init(FirQ31 *f, const q31_t *coeffs, uint16_t ntaps, uint8_t decim,
+	q31_t *state, size_t state_len);
+
+/**
+ * Filter \a n samples from \a in into \a out, which can be the same buffer.
+ *
+ * \return The number of output samples.
+ */
+size_t fir_q31(FirQ31 *f, const q31_t *in, q31_t *out, size_t n);
+
+/**
+ * Cascade of Q15 biquad sections.
+ *
+ * Each section computes:
+ * <pre>
+ * y[n] = (b0 * x[n] + b1 * x[n-1] + b2 * x[n-2] + a1 * y[n-1] + a2 * y[n-2]) << shift
+ * </pre>
+ * with the coefficients stored as <code>{ b0, b1, b2, a1, a2 }</code>:
+ * note that \c a1 and \c a2 are the feedback coefficients with their
+ * sign changed, in respect to the usual transfer function notation.
+ * All the coefficients are scaled down by 2^shift, so that they fit
+ * in [-2^shift, 2^shift).
+ */
+typedef struct BiquadQ15
+{
+	const q15_t *coeffs;  ///< 5 coefficients per section
+	q15_t *state;         ///< x[n-1], x[n-2], y[n-1], y[n-2] per section
+	uint8_t sections;
+	uint8_t shift;
+} BiquadQ15;
+
+/**
+ * Cascade of Q31 biquad sections, see BiquadQ15.
+ */
+typedef struct BiquadQ31
+{
+	const q31_t *coeffs;  ///< 5 coefficients per section
+	q31_t *state;         ///< x[n-1], x[n-2], y[n-1], y[n-2] per section
+	uint8_t sections;
+	uint8_t shift;
+} BiquadQ31;
+
+/**
+ * Initialize a cascade of \a sections biquads.
+ *
+ * \param state Buffer of 4 * \a sections samples.
+ */
+void biquad_q15_init(BiquadQ15 *b, const q15_t *coeffs, uint8_t sections, uint8_t shift, q15_t *state);
+
+/**
+ * Filter \a n samples from \a in into \a out, which can be the same buffer.
+ */
+void biquad_q15(BiquadQ15 *b, const q15_t *in, q15_t *out, size_t n);
+
+/**
+ * Initialize a cascade of \a sections Q31 biquads.
+ *
+ * \param state Buffer of 4 * \a sections samples.
+ */
+void biquad_q31_init(BiquadQ31 *b, const q31_t *coeffs, uint8_t sections, uint8_t shift, q31_t *state);
+
+/**
+ * Filter \a n samples from \a in into \a out, which can be the same buffer.
+ */
+void biquad_q31(BiquadQ31 *b, const q31_t *in, q31_t *out, size_t n);
+
+/** Maximum number of stages of a CIC filter */
+#define CIC_MAX_STAGES 5
+
+/**
+ * CIC decimator, with a differential delay of 1, on Q15 samples.
+ */
+typedef struct CicDecim
+{
+	uint32_t integ[CIC_MAX_STAGES];
+	uint32_t comb[CIC_MAX_STAGES];
+	uint8_t stages;
+	uint8_t decim;
+	uint8_t phase;
+	uint8_t shift;
+} CicDecim;
+
+/**
+ * Initialize a CIC decimator of \a stages stages, by \a decim.
+ *
+ * \a decim must be a power of 2, and the gain of the filter,
+ * <code>decim ^ stages</code>, must fit in 16 bits.
+ */
+void cic_init(CicDecim *c, uint8_t stages, uint8_t decim);
+
+/**
+ * Decimate \a n samples from \a in into \a out, which can be the same buffer.
+ *
+ * \return The number of output samples.
+ */
+size_t cic_decimate(CicDecim *c, const q15_t *in, q15_t *out, size_t n);
+
+/* Self test */
+int filter_testSetup(void);
+int filter_testRun(void);
+int filter_testTearDown(void);
+
+#endif /* ALGO_FILTER_H */
@@ -0,0 +1,380 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Fixed point filters test.
+ *
+ * Filters the vectors generated by test/gen_filter_vectors.py in blocks
+ * of varying size, both in place and out of place, checking the outputs
+ * bit by bit against the integer model and within a few LSBs against the
+ * floating point one, then measures the throughput of the kernels.
+ *
+ * notest:avr
+ * $test$: python test/gen_filter_vectors.py -o $testdir/filter_vectors.h
+ */
+
+#include "filter.h"
+
+#include <cpu/detect.h>
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+#include <cfg/macros.h>
+
+#include <os/hptime.h>
+
+#include <string.h>
+
+#include "filter_vectors.h"
+
+/* Block sizes used to split the input vector */
+static const uint8_t blocks[] = { 1, 97, 2, 31, 64, 3, 17, 8 };
+
+#define STATE_LEN   (FIR_TAPS - 1 + 64)
+#define BENCH_TAPS  64
+#define BENCH_LEN   256
+#define BENCH_LOOPS 200
+
+/*
+ * The truncated products of the Q31 biquad are recirculated by the
+ * poles: a few hundred LSBs, that is about 2^-22 of full scale.
+ */
+#define BIQUAD_Q31_TOL 1024
+
+static q15_t buf15[VEC_LEN];
+static q31_t buf31[VEC_LEN];
+static q15_t state15[STATE_LEN];
+static q31_t state31[STATE_LEN];
+static q15_t bq_state15[4 * BIQUAD_SECTIONS];
+static q31_t bq_state31[4 * BIQUAD_SECTIONS];
+
+/*
+ * Time base of the benchmark: the cycle counter on x86, nanoseconds
+ * elsewhere.
+ */
+#if CPU_X86
+	#define BENCH_UNIT "cycles"
+
+	INLINE uint64_t bench_time(void)
+	{
+		uint32_t lo, hi;
+
+		asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+		return ((uint64_t)hi << 32) | lo;
+	}
+#else
+	#define BENCH_UNIT "ns"
+
+	INLINE uint64_t bench_time(void)
+	{
+		return (uint64_t)hptime_get() * 1000;
+	}
+#endif
+
+/*
+ * Filter \a len samples from \a in to \a out, a block at a time; \a out
+ * may be the same as \a in.
+ */
+#define FILTER_BLOCKS(func, f, in, out, len, n_out) \
+	do { \
+		size_t __i = 0, __b = 0; \
+		(n_out) = 0; \
+		while (__i < (len)) \
+		{ \
+			size_t __n = MIN((size_t)blocks[__b++ % countof(blocks)], (len) - __i); \
+			(n_out) += func((f), (in) + __i, (out) + (n_out), __n); \
+			__i += __n; \
+		} \
+	} while (0)
+
+#define BIQUAD_BLOCKS(func, f, in, out, len) \
+	do { \
+		size_t __i = 0, __b = 0; \
+		while (__i < (len)) \
+		{ \
+			size_t __n = MIN((size_t)blocks[__b++ % countof(blocks)], (len) - __i); \
+			func((f), (in) + __i, (out) + __i, __n); \
+			__i += __n; \
+		} \
+	} while (0)
+
+static int check15(const char *name, const q15_t *out, const q15_t *exact, const q15_t *ideal, size_t n, int tol)
+{
+	int max_err = 0;
+
+	for (size_t i = 0; i < n; i++)
+	{
+		if (out[i] != exact[i])
+		{
+			kprintf("%s: sample %d is %d, expected %d\n", name, (int)i, out[i], exact[i]);
+			return -1;
+		}
+		if (ideal)
+			max_err = MAX(max_err, ABS(out[i] - ideal[i]));
+	}
+	if (max_err > tol)
+	{
+		kprintf("%s: error %d LSB, more than %d\n", name, max_err, tol);
+		return -1;
+	}
+	return 0;
+}
+
+static int check31(const char *name, const q31_t *out, const q31_t *exact, const q31_t *ideal, size_t n, int32_t tol)
+{
+	int64_t max_err = 0;
+
+	for (size_t i = 0; i < n; i++)
+	{
+		if (out[i] != exact[i])
+		{
+			kprintf("%s: sample %d is %ld, expected %ld\n", name, (int)i, (long)out[i], (long)exact[i]);
+			return -1;
+		}
+		max_err = MAX(max_err, ABS((int64_t)out[i] - ideal[i]));
+	}
+	if (max_err > tol)
+	{
+		kprintf("%s: error %ld LSB, more than %ld\n", name, (long)max_err, (long)tol);
+		return -1;
+	}
+	return 0;
+}
+
+static int filter_testFir(void)
+{
+	FirQ15 f15;
+	FirQ31 f31;
+	size_t n;
+
+	/* Out of place */
+	fir_q15_init(&f15, fir_q15_coeffs, FIR_TAPS, 1, state15, STATE_LEN);
+	FILTER_BLOCKS(fir_q15, &f15, in_q15, buf15, VEC_LEN, n);
+	ASSERT(n == VEC_LEN);
+	if (check15("fir_q15", buf15, fir_q15_exact, fir_q15_ideal, n, 1))
+		return -1;
+
+	/* In place */
+	memcpy(buf15, in_q15, sizeof(buf15));
+	fir_q15_init(&f15, fir_q15_coeffs, FIR_TAPS, 1, state15, STATE_LEN);
+	FILTER_BLOCKS(fir_q15, &f15, buf15, buf15, VEC_LEN, n);
+	if (check15("fir_q15 in place", buf15, fir_q15_exact, fir_q15_ideal, n, 1))
+		return -1;
+
+	/* Decimating, the state buffer as small as possible */
+	memcpy(buf15, in_q15, sizeof(buf15));
+	fir_q15_init(&f15, fir_q15_coeffs, FIR_TAPS, FIR_DECIM, state15, FIR_TAPS - 1 + FIR_DECIM);
+	FILTER_BLOCKS(fir_q15, &f15, buf15, buf15, VEC_LEN, n);
+	ASSERT(n == VEC_LEN / FIR_DECIM);
+	if (check15("fir_q15 decim", buf15, fir_q15_decim_exact, NULL, n, 0))
+		return -1;
+
+	fir_q31_init(&f31, fir_q31_coeffs, FIR_TAPS, 1, state31, STATE_LEN);
+	FILTER_BLOCKS(fir_q31, &f31, in_q31, buf31, VEC_LEN, n);
+	ASSERT(n == VEC_LEN);
+	if (check31("fir_q31", buf31, fir_q31_exact, fir_q31_ideal, n, 2 * FIR_TAPS))
+		return -1;
+
+	memcpy(buf31, in_q31, sizeof(buf31));
+	fir_q31_init(&f31, fir_q31_coeffs, FIR_TAPS, 1, state31, STATE_LEN);
+	FILTER_BLOCKS(fir_q31, &f31, buf31, buf31, VEC_LEN, n);
+	if (check31("fir_q31 in place", buf31, fir_q31_exact, fir_q31_ideal, n, 2 * FIR_TAPS))
+		return -1;
+
+	return 0;
+}
+
+static int filter_testBiquad(void)
+{
+	BiquadQ15 b15;
+	BiquadQ31 b31;
+
+	biquad_q15_init(&b15, biquad_q15_coeffs, BIQUAD_SECTIONS, BIQUAD_SHIFT, bq_state15);
+	BIQUAD_BLOCKS(biquad_q15, &b15, in_q15, buf15, VEC_LEN);
+	if (check15("biquad_q15", buf15, biquad_q15_exact, biquad_q15_ideal, VEC_LEN, 8))
+		return -1;
+
+	memcpy(buf15, in_q15, sizeof(buf15));
+	biquad_q15_init(&b15, biquad_q15_coeffs, BIQUAD_SECTIONS, BIQUAD_SHIFT, bq_state15);
+	BIQUAD_BLOCKS(biquad_q15, &b15, buf15, buf15, VEC_LEN);
+	if (check15("biquad_q15 in place", buf15, biquad_q15_exact, biquad_q15_ideal, VEC_LEN, 8))
+		return -1;
+
+	biquad_q31_init(&b31, biquad_q31_coeffs, BIQUAD_SECTIONS, BIQUAD_SHIFT, bq_state31);
+	BIQUAD_BLOCKS(biquad_q31, &b31, in_q31, buf31, VEC_LEN);
+	if (check31("biquad_q31", buf31, biquad_q31_exact, biquad_q31_ideal, VEC_LEN, BIQUAD_Q31_TOL))
+		return -1;
+
+	memcpy(buf31, in_q31, sizeof(buf31));
+	biquad_q31_init(&b31, biquad_q31_coeffs, BIQUAD_SECTIONS, BIQUAD_SHIFT, bq_state31);
+	BIQUAD_BLOCKS(biquad_q31, &b31, buf31, buf31, VEC_LEN);
+	if (check31("biquad_q31 in place", buf31, biquad_q31_exact, biquad_q31_ideal, VEC_LEN, BIQUAD_Q31_TOL))
+		return -1;
+
+	return 0;
+}
+
+static int filter_testCic(void)
+{
+	CicDecim c;
+	size_t n;
+
+	cic_init(&c, CIC_STAGES, CIC_DECIM);
+	FILTER_BLOCKS(cic_decimate, &c, in_q15, buf15, VEC_LEN, n);
+	ASSERT(n == VEC_LEN / CIC_DECIM);
+	return check15("cic", buf15, cic_exact, NULL, n, 0);
+}
+
+/*
+ * Plain C FIR, the baseline of the benchmark.
+ */
+static void ref_fir_q15(const q15_t *c, const q15_t *x, q15_t *out, size_t n, uint16_t ntaps)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		int64_t acc = 0;
+
+		for (uint16_t k = 0; k < ntaps; k++)
+			acc += (int32_t)c[k] * x[i + k];
+		out[i] = MINMAX((int64_t)INT16_MIN, (acc + (1 << 14)) >> 15, (int64_t)INT16_MAX);
+	}
+}
+
+static void ref_fir_q31(const q31_t *c, const q31_t *x, q31_t *out, size_t n, uint16_t ntaps)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		int64_t acc = 0;
+
+		for (uint16_t k = 0; k < ntaps; k++)
+			acc += ((int64_t)c[k] * x[i + k]) >> 32;
+		out[i] = MINMAX((int64_t)INT32_MIN, acc * 2, (int64_t)INT32_MAX);
+	}
+}
+
+static void filter_benchmark(void)
+{
+	static q15_t c15[BENCH_TAPS], s15[BENCH_TAPS - 1 + BENCH_LEN];
+	static q31_t c31[BENCH_TAPS], s31[BENCH_TAPS - 1 + BENCH_LEN];
+	FirQ15 f15;
+	FirQ31 f31;
+	BiquadQ15 b15;
+	BiquadQ31 b31;
+	CicDecim cic;
+	uint64_t start, t_ref, t_fir;
+
+	for (int i = 0; i < BENCH_TAPS; i++)
+	{
+		c15[i] = fir_q15_coeffs[i % FIR_TAPS] / 2;
+		c31[i] = fir_q31_coeffs[i % FIR_TAPS] / 2;
+	}
+
+	for (uint16_t taps = 32; taps <= BENCH_TAPS; taps *= 2)
+	{
+		unsigned long samples = (unsigned long)BENCH_LOOPS * BENCH_LEN;
+
+		fir_q15_init(&f15, c15, taps, 1, s15, taps - 1 + BENCH_LEN);
+		start = bench_time();
+		for (int j = 0; j < BENCH_LOOPS; j++)
+			fir_q15(&f15, in_q15, buf15, BENCH_LEN);
+		t_fir = bench_time() - start;
+
+		start = bench_time();
+		for (int j = 0; j < BENCH_LOOPS; j++)
+			ref_fir_q15(c15, in_q15, buf15, BENCH_LEN, taps);
+		t_ref = bench_time() - start;
+
+		kprintf("fir_q15 %d taps: %ld.%02ld %s/sample/tap, plain C %ld.%02ld\n", taps,
+			(long)(t_fir / (samples * taps)), (long)(t_fir * 100 / (samples * taps) % 100), BENCH_UNIT,
+			(long)(t_ref / (samples * taps)), (long)(t_ref * 100 / (samples * taps) % 100));
+
+		fir_q31_init(&f31, c31, taps, 1, s31, taps - 1 + BENCH_LEN);
+		start = bench_time();
+		for (int j = 0; j < BENCH_LOOPS; j++)
+			fir_q31(&f31, in_q31, buf31, BENCH_LEN);
+		t_fir = bench_time() - start;
+
+		start = bench_time();
+		for (int j = 0; j < BENCH_LOOPS; j++)
+			ref_fir_q31(c31, in_q31, buf31, BENCH_LEN, taps);
+		t_ref = bench_time() - start;
+
+		kprintf("fir_q31 %d taps: %ld.%02ld %s/sample/tap, plain C %ld.%02ld\n", taps,
+			(long)(t_fir / (samples * taps)), (long)(t_fir * 100 / (samples * taps) % 100), BENCH_UNIT,
+			(long)(t_ref / (samples * taps)), (long)(t_ref * 100 / (samples * taps) % 100));
+	}
+
+	biquad_q15_init(&b15, biquad_q15_coeffs, BIQUAD_SECTIONS, BIQUAD_SHIFT, bq_state15);
+	start = bench_time();
+	for (int j = 0; j < BENCH_LOOPS; j++)
+		biquad_q15(&b15, in_q15, buf15, VEC_LEN);
+	t_fir = bench_time() - start;
+	kprintf("biquad_q15: %ld %s/sample/section\n",
+		(long)(t_fir / ((uint64_t)BENCH_LOOPS * VEC_LEN * BIQUAD_SECTIONS)), BENCH_UNIT);
+
+	biquad_q31_init(&b31, biquad_q31_coeffs, BIQUAD_SECTIONS, BIQUAD_SHIFT, bq_state31);
+	start = bench_time();
+	for (int j = 0; j < BENCH_LOOPS; j++)
+		biquad_q31(&b31, in_q31, buf31, VEC_LEN);
+	t_fir = bench_time() - start;
+	kprintf("biquad_q31: %ld %s/sample/section\n",
+		(long)(t_fir / ((uint64_t)BENCH_LOOPS * VEC_LEN * BIQUAD_SECTIONS)), BENCH_UNIT);
+
+	cic_init(&cic, CIC_STAGES, CIC_DECIM);
+	start = bench_time();
+	for (int j = 0; j < BENCH_LOOPS; j++)
+		cic_decimate(&cic, in_q15, buf15, VEC_LEN);
+	t_fir = bench_time() - start;
+	kprintf("cic %d stages: %ld %s/sample\n", CIC_STAGES,
+		(long)(t_fir / ((uint64_t)BENCH_LOOPS * VEC_LEN)), BENCH_UNIT);
+}
+
+int filter_testSetup(void)
+{
+	kdbg_init();
+	return 0;
+}
+
+int filter_testRun(void)
+{
+	if (filter_testFir() || filter_testBiquad() || filter_testCic())
+		return -1;
+
+	filter_benchmark();
+	return 0;
+}
+
+int filter_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(filter);
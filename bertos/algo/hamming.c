@@ -0,0 +1,152 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Hamming code ECC for 256 bytes data chunks (implementation).
+ *
+ * Parity layout: for each bit k of the byte index (0..7) there is a pair
+ * of line parity bits, the parity of the bytes with bit k set and the
+ * parity of the bytes with bit k clear.  In the same way three pairs of
+ * column parity bits are computed on the bit position inside the bytes.
+ * A single flipped bit toggles exactly one bit of each pair: the toggled
+ * bits give the position of the error.
+ */
+
+#include "hamming.h"
+
+#include <cfg/macros.h>
+
+/* All the 11 pairs of parity bits */
+#define HAMMING_PAIRS_MASK   0x3FFFFFUL
+#define HAMMING_ODD_MASK     0x155555UL
+
+INLINE bool parity8(uint8_t b)
+{
+	b ^= b >> 4;
+	b ^= b >> 2;
+	b ^= b >> 1;
+	return b & 1;
+}
+
+/*
+ * Pack index bits in the pair layout: bit 2k is set if bit k
+ * of the index is set, bit 2k+1 if it is clear.
+ */
+INLINE uint32_t spreadPairs(unsigned idx, unsigned nbits, bool parity)
+{
+	uint32_t res = 0;
+
+	if (!parity)
+		return 0;
+
+	for (unsigned k = 0; k < nbits; k++)
+		res |= (idx & BV(k)) ? BV32(2 * k) : BV32(2 * k + 1);
+	return res;
+}
+
+static uint32_t computeParity(const uint8_t *data)
+{
+	uint8_t col = 0;
+	uint8_t line_odd = 0;
+	bool total = false;
+
+	for (unsigned i = 0; i < HAMMING_DATA_SIZE; i++)
+	{
+		col ^= data[i];
+		if (parity8(data[i]))
+		{
+			line_odd ^= i;
+			total = !total;
+		}
+	}
+
+	/*
+	 * The parity of the bytes with bit k of the index clear is
+	 * the total parity minus the parity of bytes with that bit set.
+	 */
+	uint32_t line = 0;
+	for (unsigned k = 0; k < 8; k++)
+	{
+		bool odd = line_odd & BV(k);
+		if (odd)
+			line |= BV32(2 * k);
+		if (odd != total)
+			line |= BV32(2 * k + 1);
+	}
+
+	uint32_t column = 0;
+	for (unsigned bit = 0; bit < 8; bit++)
+		column ^= spreadPairs(bit, 3, col & BV(bit));
+
+	return line | (column << 16);
+}
+
+void hamming_compute(const void *data, uint8_t *ecc)
+{
+	uint32_t p = ~computeParity((const uint8_t *)data);
+
+	ecc[0] = p;
+	ecc[1] = p >> 8;
+	ecc[2] = p >> 16;
+}
+
+int hamming_correct(void *data, const uint8_t *read_ecc, const uint8_t *calc_ecc)
+{
+	uint32_t syndrome = (uint32_t)(read_ecc[0] ^ calc_ecc[0])
+		| (uint32_t)(read_ecc[1] ^ calc_ecc[1]) << 8
+		| (uint32_t)(read_ecc[2] ^ calc_ecc[2]) << 16;
+
+	syndrome &= HAMMING_PAIRS_MASK;
+	if (!syndrome)
+		return HAMMING_OK;
+
+	/* Exactly one bit of each pair toggled: single bit error in data */
+	if (((syndrome ^ (syndrome >> 1)) & HAMMING_ODD_MASK) == HAMMING_ODD_MASK)
+	{
+		unsigned byte = 0, bit = 0;
+
+		for (unsigned k = 0; k < 8; k++)
+			if (syndrome & BV32(2 * k))
+				byte |= BV(k);
+		for (unsigned k = 0; k < 3; k++)
+			if (syndrome & BV32(16 + 2 * k))
+				bit |= BV(k);
+
+		((uint8_t *)data)[byte] ^= BV(bit);
+		return HAMMING_CORRECTED;
+	}
+
+	/* Only one bit toggled: the error is in the ECC itself */
+	if (!(syndrome & (syndrome - 1)))
+		return HAMMING_CORRECTED;
+
+	return HAMMING_ERROR;
+}
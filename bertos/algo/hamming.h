@@ -0,0 +1,83 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Hamming code ECC for 256 bytes data chunks.
+ *
+ * This is the classic ECC scheme used for NAND flash memories: 22 bits of
+ * parity are computed on each 256 bytes chunk of data, allowing to correct
+ * any single bit error and to detect double bit errors.
+ *
+ * The parity bits are stored inverted, so the ECC of an erased
+ * (all 0xFF) chunk is all 0xFF too.
+ *
+ * $WIZ$ module_name = "hamming"
+ */
+
+#ifndef ALGO_HAMMING_H
+#define ALGO_HAMMING_H
+
+#include <cfg/compiler.h>
+
+#define HAMMING_DATA_SIZE  256  ///< Size of the data chunk covered by one ECC.
+#define HAMMING_ECC_SIZE   3    ///< Size of the ECC of one data chunk.
+
+/**
+ * \name Values returned by hamming_correct().
+ * \{
+ */
+#define HAMMING_OK          0   ///< No errors found.
+#define HAMMING_CORRECTED   1   ///< A single bit error was found and corrected.
+#define HAMMING_ERROR      -1   ///< Uncorrectable error.
+/** \} */
+
+/**
+ * Compute the ECC of \a data.
+ *
+ * \param data Data chunk, HAMMING_DATA_SIZE bytes long.
+ * \param ecc Buffer where the ECC is stored, HAMMING_ECC_SIZE bytes long.
+ */
+void hamming_compute(const void *data, uint8_t *ecc);
+
+/**
+ * Check \a data against the ECC \a read_ecc, fixing it if possible.
+ *
+ * \param data Data chunk to check, HAMMING_DATA_SIZE bytes long.
+ * \param read_ecc ECC stored together with the data.
+ * \param calc_ecc ECC computed by hamming_compute() on \a data.
+ *
+ * \return HAMMING_OK if data is correct, HAMMING_CORRECTED if a single
+ *         bit error has been found and fixed in \a data (or in the ECC
+ *         itself), HAMMING_ERROR if data cannot be recovered.
+ */
+int hamming_correct(void *data, const uint8_t *read_ecc, const uint8_t *calc_ecc);
+
+#endif /* ALGO_HAMMING_H */
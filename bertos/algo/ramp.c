@@ -103,8 +103,9 @@
 
 #include "ramp.h"
 #include <cfg/debug.h>
+#include <cfg/macros.h>
 
-#include <string.h> // memcpy()
+#include <string.h> // memset()
 
 void ramp_compute(struct Ramp *ramp, uint32_t clocksRamp, uint16_t clocksMinWL, uint16_t clocksMaxWL)
 {
@@ -132,6 +133,7 @@ void ramp_compute(struct Ramp *ramp, uint32_t clocksRamp, uint16_t clocksMinWL,
     ramp->precalc.inv_total_time = 0xFFFFFFFFUL / (ramp->clocksRamp >> RAMP_CLOCK_SHIFT_PRECISION);
     ASSERT(ramp->precalc.inv_total_time < 0x1000000UL);
 
+	memset(&ramp->table, 0, sizeof(ramp->table));
 #endif
 }
 
@@ -195,6 +197,62 @@ uint16_t FAST_FUNC ramp_evaluate(const struct Ramp* ramp, uint32_t curClock)
 	return cur_delta;
 }
 
+uint16_t ramp_computeTable(struct Ramp *ramp, void *buf, size_t size)
+{
+	uint32_t clock = ramp->clocksMaxWL;
+	uint16_t prev = ramp->clocksMaxWL;
+	uint16_t head_len = 1;
+	uint16_t n;
+
+	ASSERT(((uintptr_t)buf & (sizeof(uint16_t) - 1)) == 0);
+	memset(&ramp->table, 0, sizeof(ramp->table));
+
+	/*
+	 * First pass: find the steps whose interval can not be stored as a
+	 * byte difference from the previous one.  The ramp is monotonic, but
+	 * a wrong difference is caught as a big unsigned one anyway.
+	 */
+	for (n = 0; clock < ramp->clocksRamp && n < UINT16_MAX; n++)
+	{
+		uint16_t cur = ramp_evaluate(ramp, clock);
+
+		if (n > 0 && (uint16_t)(prev - cur) > UINT8_MAX)
+			head_len = n + 1;
+		clock += cur;
+		prev = cur;
+	}
+
+	if (head_len * sizeof(uint16_t) > size)
+		return 0;
+	n = MIN((size_t)n, head_len + (size - head_len * sizeof(uint16_t)));
+
+	uint16_t *head = (uint16_t *)buf;
+	uint8_t *delta = (uint8_t *)(head + head_len);
+
+	/* Second pass: fill the table */
+	clock = ramp->clocksMaxWL;
+	for (uint16_t i = 0; i < n; i++)
+	{
+		uint16_t cur = ramp_evaluate(ramp, clock);
+
+		if (i < head_len)
+			head[i] = cur;
+		else
+			delta[i - head_len] = prev - cur;
+		clock += cur;
+		prev = cur;
+	}
+
+	ramp->table.head = head;
+	ramp->table.delta = delta;
+	ramp->table.end_clock = clock;
+	ramp->table.head_len = MIN(head_len, n);
+	ramp->table.len = n;
+	ramp->table.last = prev;
+
+	return n;
+}
+
 #endif
 
 
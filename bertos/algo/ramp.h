@@ -37,6 +37,14 @@
  * for DSP56000 (but a portable C version of it can be easily written, see the
  * comments in the code).
  *
+ * With the fixed point version, the whole sequence of steps can also be
+ * precomputed with ramp_computeTable(): the intervals are then walked with
+ * ramp_tableNext() and ramp_tablePrev(), which cost an addition per step
+ * instead of the division of ramp_evaluate(). Since the intervals
+ * shrink very slowly after the first steps, the table stores the first
+ * ones as 16 bit values and then just the 8 bit difference between two
+ * consecutive steps.
+ *
  *
  * \author Simone Zinanni <s.zinanni@develer.com>
  * \author Giovanni Bajo <rasky@develer.com>
@@ -102,6 +110,25 @@ struct RampPrecalc
 };
 
 
+#if !RAMP_USE_FLOATING_POINT
+/**
+ * Precomputed intervals of a ramp, see ramp_computeTable().
+ *
+ * Step \c n of the ramp starts at clock <code>clock(n)</code>, with
+ * <code>clock(0) = clocksMaxWL</code>, and lasts <code>interval(n) =
+ * ramp_evaluate(clock(n))</code> clocks.
+ */
+struct RampTable
+{
+	const uint16_t *head;   ///< interval(n), for n < head_len
+	const uint8_t *delta;   ///< interval(n - 1) - interval(n), for head_len <= n < len
+	uint32_t end_clock;     ///< clock(len)
+	uint16_t head_len;      ///< Number of 16 bit intervals, at least 1
+	uint16_t len;           ///< Number of precomputed steps, 0 if there is no table
+	uint16_t last;          ///< interval(len - 1)
+};
+#endif
+
 /**
  * Ramp structure
  */
@@ -112,6 +139,9 @@ struct Ramp
 	uint16_t clocksMaxWL;
 
 	struct RampPrecalc precalc; ///< pre-calculated values for speed
+#if !RAMP_USE_FLOATING_POINT
+	struct RampTable table;     ///< precomputed intervals, if any
+#endif
 };
 
 
@@ -156,6 +186,59 @@ void ramp_default(struct Ramp *ramp);
 	uint16_t ramp_evaluate(const struct Ramp* ramp, uint32_t curClock);
 #endif
 
+#if !RAMP_USE_FLOATING_POINT
+
+/**
+ * Precompute the intervals of the steps of \a ramp into \a buf.
+ *
+ * The table covers as many steps of the ramp as fit in \a size bytes:
+ * the first ones take 2 bytes, until the difference between two
+ * consecutive intervals fits in a byte, and the following ones take
+ * a single byte. A table for a whole ramp takes little more than one byte
+ * per step.
+ *
+ * The table is attached to \a ramp, and it is dropped by ramp_compute():
+ * \a buf must stay valid until then.
+ *
+ * \param ramp Ramp to precompute, already set up.
+ * \param buf Buffer for the table, aligned for uint16_t.
+ * \param size Size of \a buf, in bytes.
+ * \return The number of precomputed steps, 0 if not even the 16 bit
+ *         intervals fit in \a buf.
+ */
+uint16_t ramp_computeTable(struct Ramp *ramp, void *buf, size_t size);
+
+/**
+ * Interval of step \a step of the ramp, given the interval \a prev of
+ * the previous one (clocksMaxWL for step 0).
+ *
+ * \note \a step must be below table.len.
+ */
+INLINE uint16_t ramp_tableNext(const struct Ramp *ramp, uint16_t step, uint16_t prev)
+{
+	if (step < ramp->table.head_len)
+		return ramp->table.head[step];
+	return prev - ramp->table.delta[step - ramp->table.head_len];
+}
+
+/**
+ * Inverse of ramp_tableNext(): interval of step <code>step - 2</code> of the
+ * ramp, given the interval \a cur of step <code>step - 1</code>.
+ * Step -1 has interval clocksMaxWL.
+ *
+ * \note \a step must be between 1 and table.len.
+ */
+INLINE uint16_t ramp_tablePrev(const struct Ramp *ramp, uint16_t step, uint16_t cur)
+{
+	if (step == 1)
+		return ramp->clocksMaxWL;
+	if (step - 1 <= ramp->table.head_len)
+		return ramp->table.head[step - 2];
+	return cur + ramp->table.delta[step - 1 - ramp->table.head_len];
+}
+
+#endif /* !RAMP_USE_FLOATING_POINT */
+
 
 /** Self test */
 int ramp_testSetup(void);
@@ -105,6 +105,15 @@
 #include <cfg/debug.h>
 #include <cfg/test.h>
 
+#include <os/hptime.h>
+
+#define TABLE_SIZE 9000
+#define BENCH_LOOPS 200
+
+/* Enough for a whole ramp of the tests */
+static uint16_t table_buf[TABLE_SIZE / sizeof(uint16_t)];
+static uint16_t ref_steps[TABLE_SIZE];
+
 
 static bool ramp_test_single(uint32_t minFreq, uint32_t maxFreq, uint32_t length)
 {
@@ -159,6 +168,125 @@ static bool ramp_test_single(uint32_t minFreq, uint32_t maxFreq, uint32_t length
 	return true;
 }
 
+/*
+ * Check that walking the table of \a r, forward and back, gives the same
+ * steps as ramp_evaluate(), which are in \a ref.
+ */
+static bool ramp_test_walk(const struct Ramp *r, const uint16_t *ref, int numsteps)
+{
+	uint16_t cur = r->clocksMaxWL;
+	int i;
+
+	for (i = 0; i < r->table.len; i++)
+	{
+		cur = ramp_tableNext(r, i, cur);
+		if (cur != ref[i])
+		{
+			kprintf("    Failed: table step %d: %04x instead of %04x\n", i, cur, ref[i]);
+			return false;
+		}
+	}
+
+	for (; i > 0; i--)
+	{
+		cur = ramp_tablePrev(r, i, cur);
+		if (cur != (i > 1 ? ref[i - 2] : r->clocksMaxWL))
+		{
+			kprintf("    Failed: table step %d back: %04x\n", i - 2, cur);
+			return false;
+		}
+	}
+
+	return r->table.len <= numsteps;
+}
+
+static bool ramp_test_table(uint32_t minFreq, uint32_t maxFreq, uint32_t length)
+{
+	struct Ramp r;
+	uint32_t clock;
+	uint16_t cur = 0;
+	int numsteps = 0;
+
+	ramp_setup(&r, length, minFreq, maxFreq);
+
+	for (clock = r.clocksMaxWL; clock < r.clocksRamp; clock += cur)
+	{
+		ASSERT(numsteps < TABLE_SIZE);
+		cur = ref_steps[numsteps++] = ramp_evaluate(&r, clock);
+	}
+
+	/* Whole ramp */
+	if (ramp_computeTable(&r, table_buf, sizeof(table_buf)) != numsteps
+		|| r.table.end_clock != clock || r.table.last != cur
+		|| !ramp_test_walk(&r, ref_steps, numsteps))
+		return false;
+	kprintf("Table: %d steps in %u bytes (%u of 16 bit)\n", numsteps,
+		r.table.head_len + r.table.len, r.table.head_len);
+
+	/* Partial table */
+	size_t size = r.table.head_len * sizeof(uint16_t) + numsteps / 2;
+	if (ramp_computeTable(&r, table_buf, size) != r.table.head_len + numsteps / 2
+		|| !ramp_test_walk(&r, ref_steps, numsteps))
+		return false;
+
+	/* Not even the head fits */
+	if (ramp_computeTable(&r, table_buf, (r.table.head_len - 1) * sizeof(uint16_t)) != 0
+		|| r.table.len != 0)
+		return false;
+
+	/* Dropped by a new ramp */
+	ramp_computeTable(&r, table_buf, sizeof(table_buf));
+	ramp_setup(&r, length, minFreq, maxFreq);
+	return r.table.len == 0;
+}
+
+/*
+ * Time needed by the stepper interrupt to find the next step, that is the
+ * maximum step rate it could sustain if it did nothing else.
+ */
+static void ramp_benchmark(uint32_t minFreq, uint32_t maxFreq, uint32_t length)
+{
+	struct Ramp r;
+	volatile uint16_t sink = 0;
+	hptime_t start, t_eval, t_table;
+	uint16_t n;
+
+	ramp_setup(&r, length, minFreq, maxFreq);
+	n = ramp_computeTable(&r, table_buf, sizeof(table_buf));
+
+	start = hptime_get();
+	for (int j = 0; j < BENCH_LOOPS; j++)
+	{
+		uint32_t clock = r.clocksMaxWL;
+		for (uint16_t i = 0; i < n; i++)
+		{
+			uint16_t cur = ramp_evaluate(&r, clock);
+			clock += cur;
+			sink += cur;
+		}
+	}
+	t_eval = hptime_get() - start;
+
+	start = hptime_get();
+	for (int j = 0; j < BENCH_LOOPS; j++)
+	{
+		uint32_t clock = r.clocksMaxWL;
+		uint16_t cur = r.clocksMaxWL;
+		for (uint16_t i = 0; i < n; i++)
+		{
+			cur = ramp_tableNext(&r, i, cur);
+			clock += cur;
+			sink += cur;
+		}
+	}
+	t_table = hptime_get() - start;
+
+	t_eval = MAX(t_eval * 1000 / (BENCH_LOOPS * n), (hptime_t)1);
+	t_table = MAX(t_table * 1000 / (BENCH_LOOPS * n), (hptime_t)1);
+	kprintf("Step time: evaluate %ldns (%ld kHz), table %ldns (%ld kHz)\n",
+		(long)t_eval, 1000000L / (long)t_eval, (long)t_table, 1000000L / (long)t_table);
+}
+
 int ramp_testSetup(void)
 {
 	kdbg_init();
@@ -180,6 +308,12 @@ int ramp_testRun(void)
 	TEST_RAMP(200,  5000, 3000000);
 	TEST_RAMP(1000, 2000, 1000000);
 
+	if (!ramp_test_table(200, 5000, 3000000)
+		|| !ramp_test_table(1000, 2000, 1000000))
+		return -1;
+
+	ramp_benchmark(200, 5000, 3000000);
+
 	return 0;
 }
 
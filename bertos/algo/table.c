@@ -90,6 +90,38 @@ int table_linearInterpolation(const Table *table, size_t size, int x)
 	return ((long)(x - table[i - 1].x) * dy) / dx + table[i - 1].y;
 }
 
+/**
+ * Linear interpolation of an evenly spaced table.
+ *
+ * Same as table_linearInterpolation(), but the distance of \a x from the
+ * lower point is a fraction of the step in Q(table->shift) format, so the
+ * interpolation is a multiply and a shift.
+ *
+ * \param table the table of y values.
+ * \param x the x value we want to find the interpolation to.
+ *
+ * \return if x is lesser than the first x coordinate in the table, the first y.
+ * \return if x is greater than the last, the last y.
+ * \return if x is between them, the linear interpolation for y.
+ */
+int table_evenInterpolation(const TableEven *table, int x)
+{
+	if (x <= table->x0)
+		return table->y[0];
+
+	unsigned long dx = (unsigned long)(x - table->x0);
+	size_t i = dx >> table->shift;
+
+	if (i >= table->size - 1)
+		return table->y[table->size - 1];
+
+	const int *y = &table->y[i];
+	long frac = dx & ((1UL << table->shift) - 1);
+
+	/* The shift rounds down, where the division of table_linearInterpolation() truncates */
+	return y[0] + (((long)(y[1] - y[0]) * frac) >> table->shift);
+}
+
 #if 0
 #include <stdio.h>
 
@@ -48,6 +48,23 @@ typedef struct Table
 	int y;
 } Table;
 
+/**
+ * Table of y values at evenly spaced x coordinates.
+ *
+ * The i-th value is at x = x0 + (i << shift): being the step a power of
+ * two, table_evenInterpolation() finds the interval with a shift and
+ * interpolates with one multiply and one shift, without any search or
+ * division.
+ */
+typedef struct TableEven
+{
+	const int *y;   ///< y values
+	size_t size;    ///< Number of values
+	int x0;         ///< x coordinate of the first value
+	uint8_t shift;  ///< log2 of the distance between two x coordinates
+} TableEven;
+
 int table_linearInterpolation(const Table *table, size_t size, int x);
+int table_evenInterpolation(const TableEven *table, int x);
 
 #endif /* ALGO_TABLE_H */
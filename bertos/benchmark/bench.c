@@ -0,0 +1,125 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Micro-benchmark harness (implementation).
+ */
+#include "bench.h"
+
+#include <cfg/debug.h>
+#include <cfg/macros.h>
+
+#include <drv/timer.h>
+
+#include <io/kfile.h>
+
+static List bench_list = { { &bench_list.tail, NULL }, { NULL, &bench_list.head } };
+
+void bench_register(Benchmark *b)
+{
+	ADDTAIL(&bench_list, &b->link);
+}
+
+void bench_run(Benchmark *b)
+{
+	static uint32_t samples[CONFIG_BENCH_REPS];
+	uint32_t start, elapsed;
+	uint64_t total = 0;
+	int i, j;
+
+	if (b->setup)
+		b->setup();
+
+	for (i = 0; i < CONFIG_BENCH_WARMUP; i++)
+		b->run(CONFIG_BENCH_ITERS);
+
+	for (i = 0; i < CONFIG_BENCH_REPS; i++)
+	{
+		ATOMIC(start = timer_hpclock_unlocked());
+		b->run(CONFIG_BENCH_ITERS);
+		ATOMIC(elapsed = timer_hpclock_unlocked());
+		elapsed -= start;
+		total += elapsed;
+
+		uint32_t ns = (uint32_t)((uint64_t)elapsed * 1000000000UL
+			/ TIMER_HW_HPTICKS_PER_SEC / CONFIG_BENCH_ITERS);
+
+		/* Insertion sort, the sample set is small */
+		for (j = i; j > 0 && samples[j - 1] > ns; j--)
+			samples[j] = samples[j - 1];
+		samples[j] = ns;
+	}
+
+	if (b->teardown)
+		b->teardown();
+
+	b->res.min = samples[0];
+	b->res.median = samples[CONFIG_BENCH_REPS / 2];
+	b->res.p99 = samples[DIV_ROUNDUP(CONFIG_BENCH_REPS * 99, 100) - 1];
+	b->res.mean = (uint32_t)(total * 1000000000UL / TIMER_HW_HPTICKS_PER_SEC
+		/ ((uint32_t)CONFIG_BENCH_REPS * CONFIG_BENCH_ITERS));
+}
+
+void bench_runAll(void)
+{
+	Benchmark *b;
+
+	FOREACH_NODE(b, &bench_list)
+		bench_run(b);
+}
+
+void bench_forEach(void (*func)(Benchmark *b))
+{
+	Benchmark *b;
+
+	FOREACH_NODE(b, &bench_list)
+		func(b);
+}
+
+void bench_report(struct KFile *fd, int format)
+{
+	Benchmark *b;
+
+	if (format == BENCH_FMT_TEXT)
+		kfile_printf(fd, "%-20s%12s%12s%12s\n", "Benchmark [ns/op]", "min", "median", "p99");
+
+	FOREACH_NODE(b, &bench_list)
+	{
+		if (format == BENCH_FMT_CSV)
+			kfile_printf(fd, "BENCH,%s,%lu,%lu,%lu,%d,%d\n", b->name,
+				(unsigned long)b->res.min, (unsigned long)b->res.median,
+				(unsigned long)b->res.p99, CONFIG_BENCH_REPS, CONFIG_BENCH_ITERS);
+		else
+			kfile_printf(fd, "%-20s%12lu%12lu%12lu\n", b->name,
+				(unsigned long)b->res.min, (unsigned long)b->res.median,
+				(unsigned long)b->res.p99);
+	}
+}
@@ -0,0 +1,121 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Micro-benchmark harness.
+ *
+ * A benchmark is a function that performs an operation a given number of
+ * times. The harness runs it in batches: CONFIG_BENCH_WARMUP batches are
+ * discarded, then CONFIG_BENCH_REPS batches of CONFIG_BENCH_ITERS
+ * operations are timed with the high precision timer. The cost of one
+ * operation is reported as minimum, median and 99th percentile over the
+ * batches, in nanoseconds.
+ *
+ * Example:
+ * \code
+ * static void bench_nopRun(unsigned long iters)
+ * {
+ * 	while (iters--)
+ * 		MEMORY_BARRIER;
+ * }
+ * BENCH_DEFINE(nop, NULL, bench_nopRun, NULL);
+ *
+ * bench_register(&bench_nop);
+ * bench_runAll();
+ * bench_report(&out.fd, BENCH_FMT_TEXT);
+ * \endcode
+ *
+ * Results can be printed as a table or as CSV lines ("BENCH,name,...")
+ * that are easy to pick out of a log and compare between builds.
+ *
+ * $WIZ$ module_name = "bench"
+ * $WIZ$ module_depends = "kfile", "timer"
+ * $WIZ$ module_configuration = "bertos/cfg/cfg_bench.h"
+ */
+#ifndef BENCHMARK_BENCH_H
+#define BENCHMARK_BENCH_H
+
+#include "cfg/cfg_bench.h"
+
+#include <cfg/compiler.h>
+
+#include <struct/list.h>
+
+struct KFile;
+
+/** Result of a benchmark run, times per operation in ns */
+typedef struct BenchResult
+{
+	uint32_t min;
+	uint32_t median;
+	uint32_t p99;
+	uint32_t mean;   ///< Over all the batches, also for operations faster than the timer resolution
+} BenchResult;
+
+/** A registered benchmark */
+typedef struct Benchmark
+{
+	Node link;
+	const char *name;
+	void (*setup)(void);               ///< Optional, called before the warmup
+	void (*run)(unsigned long iters);  ///< Perform the operation \a iters times
+	void (*teardown)(void);            ///< Optional, called after the last batch
+	BenchResult res;                   ///< Last result
+} Benchmark;
+
+/**
+ * Define a benchmark called bench_<name>.
+ *
+ * \a setup and \a teardown may be NULL.
+ */
+#define BENCH_DEFINE(name, setup, run, teardown) \
+	Benchmark bench_##name = { { NULL, NULL }, #name, (setup), (run), (teardown), { 0, 0, 0, 0 } }
+
+/** Output formats for bench_report() */
+#define BENCH_FMT_TEXT  0  ///< Human readable table
+#define BENCH_FMT_CSV   1  ///< One "BENCH,name,min,median,p99,reps,iters" line each
+
+/** Add \a b to the list of benchmarks run by bench_runAll() */
+void bench_register(Benchmark *b);
+
+/** Run a single benchmark, storing the result in b->res */
+void bench_run(Benchmark *b);
+
+/** Run all the registered benchmarks, in registration order */
+void bench_runAll(void);
+
+/** Call \a func on each registered benchmark, in registration order */
+void bench_forEach(void (*func)(Benchmark *b));
+
+/** Print the results of the registered benchmarks on \a fd */
+void bench_report(struct KFile *fd, int format);
+
+#endif /* BENCHMARK_BENCH_H */
@@ -0,0 +1,399 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Kernel micro-benchmark suite.
+ */
+#include "kernel_bench.h"
+#include "bench.h"
+
+#include "cfg/cfg_proc.h"
+#include "cfg/cfg_signal.h"
+#include "cfg/cfg_sem.h"
+#include "cfg/cfg_heap.h"
+#include <cfg/debug.h>
+
+#include <cpu/power.h>   /* cpu_relax() */
+
+#include <drv/timer.h>
+
+#include <kern/proc.h>
+#include <kern/sem.h>
+#include <kern/signal.h>
+#include <kern/msg.h>
+
+#include <struct/heap.h>
+#include <struct/pool.h>
+#include <struct/fifobuf.h>
+#include <struct/kfile_mem.h>
+
+#include <io/kblock_ram.h>
+#include <io/kfile.h>
+
+#include <string.h>
+
+/* Partner process for the benchmarks that need two of them */
+#if CONFIG_KERN && (CONFIG_KERN_SIGNALS || CONFIG_KERN_SEMAPHORES)
+static PROC_DEFINE_STACK(partner_stack, KERN_MINSTACKSIZE * 2);
+static Process *bench_main;
+static volatile bool partner_stop, partner_done;
+
+static Process *bench_partnerStart(void (*entry)(void))
+{
+	bench_main = proc_current();
+	partner_stop = partner_done = false;
+	return proc_new(entry, NULL, sizeof(partner_stack), partner_stack);
+}
+
+/* Wait for the partner to terminate, so its stack can be reused */
+static void bench_partnerJoin(void)
+{
+	while (!partner_done)
+		cpu_relax();
+}
+#endif
+
+/*
+ * Signal round trip between two processes.
+ */
+#if CONFIG_KERN && CONFIG_KERN_SIGNALS
+static Process *sig_partner;
+
+static void bench_sigPartner(void)
+{
+	for (;;)
+	{
+		sigmask_t sigs = sig_wait(SIG_USER0 | SIG_USER1);
+		if (sigs & SIG_USER1)
+			break;
+		sig_send(bench_main, SIG_USER0);
+	}
+	partner_done = true;
+}
+
+static void bench_sigSetup(void)
+{
+	sig_partner = bench_partnerStart(bench_sigPartner);
+}
+
+static void bench_sigRun(unsigned long iters)
+{
+	while (iters--)
+	{
+		sig_send(sig_partner, SIG_USER0);
+		sig_wait(SIG_USER0);
+	}
+}
+
+static void bench_sigTeardown(void)
+{
+	sig_send(sig_partner, SIG_USER1);
+	bench_partnerJoin();
+}
+
+static BENCH_DEFINE(sig_pingpong, bench_sigSetup, bench_sigRun, bench_sigTeardown);
+#endif
+
+/*
+ * Semaphore obtain/release while another process contends for it.
+ *
+ * Both processes yield while holding the semaphore, so that each
+ * obtain finds it taken and each release hands it over.
+ */
+#if CONFIG_KERN && CONFIG_KERN_SEMAPHORES
+static Semaphore bench_sem;
+
+static void bench_semPartner(void)
+{
+	while (!partner_stop)
+	{
+		sem_obtain(&bench_sem);
+		cpu_relax();
+		sem_release(&bench_sem);
+	}
+	partner_done = true;
+}
+
+static void bench_semSetup(void)
+{
+	sem_init(&bench_sem);
+	bench_partnerStart(bench_semPartner);
+}
+
+static void bench_semRun(unsigned long iters)
+{
+	while (iters--)
+	{
+		sem_obtain(&bench_sem);
+		cpu_relax();
+		sem_release(&bench_sem);
+	}
+}
+
+static void bench_semTeardown(void)
+{
+	partner_stop = true;
+	bench_partnerJoin();
+}
+
+static BENCH_DEFINE(sem_contended, bench_semSetup, bench_semRun, bench_semTeardown);
+#endif
+
+/*
+ * Message put/get on a port.
+ */
+#if CONFIG_KERN
+static MsgPort bench_port;
+static Msg bench_msg;
+
+static void bench_msgSetup(void)
+{
+	msg_initPort(&bench_port, event_createNone());
+}
+
+static void bench_msgRun(unsigned long iters)
+{
+	while (iters--)
+	{
+		msg_put(&bench_port, &bench_msg);
+		msg_get(&bench_port);
+	}
+}
+
+static BENCH_DEFINE(msg_putget, bench_msgSetup, bench_msgRun, NULL);
+
+/*
+ * Process creation and termination.
+ */
+static PROC_DEFINE_STACK(child_stack, KERN_MINSTACKSIZE * 2);
+static volatile bool child_done;
+
+static void bench_child(void)
+{
+	child_done = true;
+}
+
+static void bench_procRun(unsigned long iters)
+{
+	while (iters--)
+	{
+		child_done = false;
+		proc_new(bench_child, NULL, sizeof(child_stack), child_stack);
+		while (!child_done)
+			proc_yield();
+		/*
+		 * Let the child go through proc_exit() before reusing its
+		 * stack: it gets a fresh quantum, so it cannot be preempted
+		 * again before the end.
+		 */
+		proc_yield();
+	}
+}
+
+static BENCH_DEFINE(proc_newexit, NULL, bench_procRun, NULL);
+#endif
+
+/*
+ * Timer add/abort.
+ */
+static Timer bench_timer;
+
+static void bench_timerNop(UNUSED_ARG(void *, data))
+{
+}
+
+static void bench_timerSetup(void)
+{
+	timer_setSoftint(&bench_timer, bench_timerNop, 0);
+}
+
+static void bench_timerRun(unsigned long iters)
+{
+	while (iters--)
+	{
+		timer_setDelay(&bench_timer, ms_to_ticks(1000));
+		timer_add(&bench_timer);
+		timer_abort(&bench_timer);
+	}
+}
+
+static BENCH_DEFINE(timer_addabort, bench_timerSetup, bench_timerRun, NULL);
+
+/*
+ * Heap allocation.
+ */
+#if CONFIG_HEAP_MALLOC
+static HEAP_DEFINE_BUF(bench_heap_buf, 1024);
+static Heap bench_heap;
+
+static void bench_heapSetup(void)
+{
+	heap_init(&bench_heap, bench_heap_buf, sizeof(bench_heap_buf));
+}
+
+static void bench_heapRun(unsigned long iters)
+{
+	while (iters--)
+		heap_free(&bench_heap, heap_malloc(&bench_heap, 32));
+}
+
+static BENCH_DEFINE(heap_mallocfree, bench_heapSetup, bench_heapRun, NULL);
+#endif
+
+/*
+ * Pool allocation.
+ */
+typedef struct PoolElem
+{
+	Node link;
+	uint8_t data[16];
+} PoolElem;
+
+DEFINE_POOL_STATIC(bench_pool, PoolElem, 8);
+
+static void bench_poolSetup(void)
+{
+	pool_init(bench_pool, NULL);
+}
+
+static void bench_poolRun(unsigned long iters)
+{
+	while (iters--)
+	{
+		PoolElem *e = (PoolElem *)pool_alloc(&bench_pool);
+		pool_free(&bench_pool, e);
+	}
+}
+
+static BENCH_DEFINE(pool_allocfree, bench_poolSetup, bench_poolRun, NULL);
+
+/*
+ * FIFO buffer push/pop.
+ */
+static FIFOBuffer bench_fifo;
+static unsigned char bench_fifo_buf[32];
+
+static void bench_fifoSetup(void)
+{
+	fifo_init(&bench_fifo, bench_fifo_buf, sizeof(bench_fifo_buf));
+}
+
+static void bench_fifoRun(unsigned long iters)
+{
+	while (iters--)
+	{
+		fifo_push(&bench_fifo, (unsigned char)iters);
+		fifo_pop(&bench_fifo);
+	}
+}
+
+static BENCH_DEFINE(fifo_pushpop, bench_fifoSetup, bench_fifoRun, NULL);
+
+/*
+ * Block write and read back on a RAM block device.
+ */
+#define BENCH_BLK_SIZE 64
+#define BENCH_BLK_NUM  8
+
+static KBlockRam bench_ram;
+static uint8_t bench_ram_buf[BENCH_BLK_SIZE * BENCH_BLK_NUM];
+static uint8_t bench_io_buf[BENCH_BLK_SIZE];
+
+static void bench_kblockSetup(void)
+{
+	kblockram_init(&bench_ram, bench_ram_buf, sizeof(bench_ram_buf),
+		BENCH_BLK_SIZE, false, false);
+}
+
+static void bench_kblockRun(unsigned long iters)
+{
+	while (iters--)
+	{
+		block_idx_t idx = iters % BENCH_BLK_NUM;
+
+		kblock_write(&bench_ram.b, idx, bench_io_buf, 0, BENCH_BLK_SIZE);
+		kblock_read(&bench_ram.b, idx, bench_io_buf, 0, BENCH_BLK_SIZE);
+	}
+}
+
+static BENCH_DEFINE(kblock_rw, bench_kblockSetup, bench_kblockRun, NULL);
+
+/*
+ * KFile write and read back on a memory file.
+ */
+static KFileMem bench_mem;
+
+static void bench_kfileSetup(void)
+{
+	kfilemem_init(&bench_mem, bench_ram_buf, sizeof(bench_ram_buf));
+}
+
+static void bench_kfileRun(unsigned long iters)
+{
+	while (iters--)
+	{
+		kfile_seek(&bench_mem.fd, 0, KSM_SEEK_SET);
+		kfile_write(&bench_mem.fd, bench_io_buf, sizeof(bench_io_buf));
+		kfile_seek(&bench_mem.fd, 0, KSM_SEEK_SET);
+		kfile_read(&bench_mem.fd, bench_io_buf, sizeof(bench_io_buf));
+	}
+}
+
+static BENCH_DEFINE(kfile_rw, bench_kfileSetup, bench_kfileRun, NULL);
+
+void kernel_benchInit(void)
+{
+#if CONFIG_KERN && CONFIG_KERN_SIGNALS
+	bench_register(&bench_sig_pingpong);
+#endif
+#if CONFIG_KERN && CONFIG_KERN_SEMAPHORES
+	bench_register(&bench_sem_contended);
+#endif
+#if CONFIG_KERN
+	bench_register(&bench_msg_putget);
+	bench_register(&bench_proc_newexit);
+#endif
+	bench_register(&bench_timer_addabort);
+#if CONFIG_HEAP_MALLOC
+	bench_register(&bench_heap_mallocfree);
+#endif
+	bench_register(&bench_pool_allocfree);
+	bench_register(&bench_fifo_pushpop);
+	bench_register(&bench_kblock_rw);
+	bench_register(&bench_kfile_rw);
+}
+
+void kernel_bench(struct KFile *fd)
+{
+	bench_runAll();
+	bench_report(fd, BENCH_FMT_TEXT);
+	bench_report(fd, BENCH_FMT_CSV);
+}
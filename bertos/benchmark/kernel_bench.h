@@ -0,0 +1,66 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Kernel micro-benchmark suite.
+ *
+ * Times the basic kernel and library primitives with the bench harness:
+ * signal ping-pong, semaphores under contention, message ports, timer
+ * add/abort, heap and pool allocation, process creation/exit, FIFO
+ * buffers and KBlock/KFile I/O on memory devices. Primitives disabled
+ * in the configuration are skipped.
+ *
+ * The suite runs on the emulator too (kernel_bench_test.c), so results
+ * can be compared between builds; on a board call kernel_bench() with
+ * the console KFile.
+ *
+ * $WIZ$ module_name = "kernel_bench"
+ * $WIZ$ module_depends = "bench", "kern", "heap", "kfile", "kblock", "timer"
+ */
+#ifndef BENCHMARK_KERNEL_BENCH_H
+#define BENCHMARK_KERNEL_BENCH_H
+
+struct KFile;
+
+/** Register the kernel benchmarks with the harness */
+void kernel_benchInit(void);
+
+/**
+ * Run the kernel benchmarks and print the results on \a fd, both as a
+ * table and as CSV lines.
+ */
+void kernel_bench(struct KFile *fd);
+
+int kernel_bench_testSetup(void);
+int kernel_bench_testRun(void);
+int kernel_bench_testTearDown(void);
+
+#endif /* BENCHMARK_KERNEL_BENCH_H */
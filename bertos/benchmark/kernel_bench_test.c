@@ -0,0 +1,105 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Run the kernel micro-benchmark suite on the emulator.
+ *
+ * The CSV lines ("BENCH,...") in the output can be collected per build
+ * to track regressions.
+ *
+ * $test$: cp bertos/cfg/cfg_proc.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN" >> $cfgdir/cfg_proc.h
+ * $test$: echo "#define CONFIG_KERN 1" >> $cfgdir/cfg_proc.h
+ * $test$: echo  "#undef CONFIG_KERN_PREEMPT" >> $cfgdir/cfg_proc.h
+ * $test$: echo "#define CONFIG_KERN_PREEMPT 1" >> $cfgdir/cfg_proc.h
+ * $test$: cp bertos/cfg/cfg_signal.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN_SIGNALS" >> $cfgdir/cfg_signal.h
+ * $test$: echo "#define CONFIG_KERN_SIGNALS 1" >> $cfgdir/cfg_signal.h
+ * $test$: cp bertos/cfg/cfg_sem.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN_SEMAPHORES" >> $cfgdir/cfg_sem.h
+ * $test$: echo "#define CONFIG_KERN_SEMAPHORES 1" >> $cfgdir/cfg_sem.h
+ * $test$: cp bertos/cfg/cfg_bench.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_BENCH_REPS" >> $cfgdir/cfg_bench.h
+ * $test$: echo "#define CONFIG_BENCH_REPS 16" >> $cfgdir/cfg_bench.h
+ * $test$: echo  "#undef CONFIG_BENCH_ITERS" >> $cfgdir/cfg_bench.h
+ * $test$: echo "#define CONFIG_BENCH_ITERS 200" >> $cfgdir/cfg_bench.h
+ */
+#include "kernel_bench.h"
+#include "bench.h"
+
+#include <cfg/kfile_debug.h>
+#include <cfg/test.h>
+#include <cfg/debug.h>
+
+#include <drv/timer.h>
+
+#include <kern/proc.h>
+
+/* All the kernel benchmarks are enabled in this configuration */
+#define NUM_BENCH  10
+
+static KFileDebug dbg;
+static int checked;
+
+static void checkResult(Benchmark *b)
+{
+	ASSERT(b->res.mean > 0);
+	ASSERT(b->res.min <= b->res.median && b->res.median <= b->res.p99);
+	/* A clock going backwards would give huge times, an operation surely takes less than 1s */
+	ASSERT(b->res.p99 < 1000000000UL);
+	checked++;
+}
+
+int kernel_bench_testSetup(void)
+{
+	kdbg_init();
+	timer_init();
+	proc_init();
+	kfiledebug_init(&dbg);
+	kernel_benchInit();
+	return 0;
+}
+
+int kernel_bench_testRun(void)
+{
+	kernel_bench(&dbg.fd);
+
+	bench_forEach(checkResult);
+	ASSERT(checked == NUM_BENCH);
+	return 0;
+}
+
+int kernel_bench_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(kernel_bench);
@@ -71,6 +71,15 @@
  */
 #define CONFIG_AFSK_RX_BUFLEN 32
 
+/**
+ * Max frame length of the frame oriented interface, FCS included.
+ * Only used by the frames passed to afsk_framesInit().
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 18
+ */
+#define CONFIG_AFSK_FRAME_LEN 330
+
 /**
  * AFSK transimtter buffer length.
  *
@@ -110,4 +119,20 @@
  */
 #define CONFIG_AFSK_TRAILER_LEN 50UL
 
+/**
+ * Number of parallel bit slicers of the correlator demodulator.
+ * Every slicer compensates a different amount of mark/space twist.
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 1
+ * $WIZ$ max = 8
+ */
+#define CONFIG_AFSK_CORR_SLICERS 3
+
+/**
+ * Max frame length received by each slicer of the correlator demodulator.
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 18
+ */
+#define CONFIG_AFSK_CORR_FRAME_LEN 330
+
 #endif /* CFG_AFSK_H */
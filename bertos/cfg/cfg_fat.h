@@ -107,6 +107,22 @@
 #define CONFIG_FAT_USE_FORWARD 0
 #define	_USE_FORWARD (CONFIG_FAT_USE_FORWARD && CONFIG_FAT_FS_TINY)
 
+/**
+ * Enable fast seek: a per-file cluster link map avoids following the
+ * cluster chain from the start of the file on each seek.
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_FAT_USE_FASTSEEK 1
+#define	_USE_FASTSEEK CONFIG_FAT_USE_FASTSEEK
+
+/**
+ * Enable f_expand function, to pre-allocate a contiguous area to a file.
+ * Requires CONFIG_FAT_FS_READONLY = 0.
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_FAT_USE_EXPAND 1
+#define	_USE_EXPAND (CONFIG_FAT_USE_EXPAND && !CONFIG_FAT_FS_READONLY)
+
 /**
  * Number of volumes (logical drives) to be used.
  * $WIZ$ type = "int"; min = 1; max = 255
@@ -45,6 +45,14 @@
  */
 #define CONFIG_HT_OPTIONAL_INTERNAL_KEY      1
 
+/**
+ * Enable/disable the growable hash tables, allocated on a heap (requires
+ * the heap module).
+ *
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_HT_GROW                       0
+
 #endif /* CFG_HASHTABLE_H */
 
 
@@ -44,4 +44,47 @@
  */
 #define CONFIG_KERN_MONITOR 0
 
+/**
+ * Stack words scanned per process at each monitor wakeup.
+ *
+ * The stack high-water mark of each process is refined incrementally:
+ * every wakeup the monitor examines at most this many words of the
+ * free area of a process, with preemption disabled only while it
+ * works on that process.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 1
+ */
+#define CONFIG_KERN_MONITOR_SCAN 64
+
+/**
+ * Check the last word of the stack of a process each time it leaves
+ * the CPU, to catch overflows as soon as they happen.
+ *
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_KERN_MONITOR_GUARD 0
+
+/**
+ * Per-process CPU time accounting.
+ *
+ * Track run time, context switches (voluntary and preempted) and the
+ * maximum latency from wakeup to run of each process, using the high
+ * precision timer.
+ *
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_KERN_MONITOR_ACCT 0
+
+/**
+ * Number of events in the scheduler trace ring, 0 disables tracing.
+ *
+ * Must be a power of 2. The trace can be dumped with monitor_traceDump()
+ * and decoded on the host with test/monitor_trace.py.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 0
+ */
+#define CONFIG_KERN_MONITOR_TRACE 0
+
 #endif /*  CFG_MONITOR_H */
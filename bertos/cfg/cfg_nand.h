@@ -82,6 +82,17 @@
  */
 #define CONFIG_NAND_NUM_REMAP_BLOCKS  128
 
+/**
+ * Software ECC
+ *
+ * Compute ECC in software with a Hamming code, correcting single
+ * bit errors on read.  Otherwise the hardware ECC is used, that
+ * only detects errors.
+ *
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_NAND_ECC_SW            0
+
 /**
  * NAND operations timeout
  *
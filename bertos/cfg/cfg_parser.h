@@ -46,9 +46,12 @@
 #define CONFIG_PARSER_MAX_ARGS       4
 
 /**
- * Max number of commands
+ * Max number of commands registered at runtime.
+ *
+ * Set to 0 if all the commands come from a static table
+ * (see parser_register_table()), to save the hashtable RAM.
  * $WIZ$ type = "int"
- * $WIZ$ min = 8
+ * $WIZ$ min = 0
  */
 #define CONFIG_MAX_COMMANDS_NUMBER  16
 
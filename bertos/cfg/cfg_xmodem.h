@@ -75,5 +75,23 @@
  */
 #define CONFIG_XMODEM_MAXCRCRETRIES   7
 
+/// Enable the streaming transfer mode. $WIZ$ type = "boolean"
+#define CONFIG_XMODEM_STREAM  1
+
+/**
+ * Block size of the streaming mode.
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 16
+ * $WIZ$ max = 65535
+ */
+#define CONFIG_XMODEM_STREAM_BLOCK   1024
+
+/**
+ * Blocks sent by the streaming mode before waiting for an acknowledge.
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 1
+ */
+#define CONFIG_XMODEM_STREAM_WINDOW  8
+
 #endif /* CFG_XMODEM_H */
 
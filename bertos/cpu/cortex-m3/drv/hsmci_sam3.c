@@ -148,6 +148,34 @@ void hsmci_read(uint32_t *buf, size_t word_num, size_t blk_size)
 }
 
 
+/*
+ * Multi block transfers: the block count is programmed in BCNT so that
+ * the controller moves the whole run with a single DMA setup.
+ */
+void hsmci_writeBlocks(const uint32_t *buf, size_t blk_size, size_t blk_cnt)
+{
+	ASSERT(blk_cnt <= HSMCI_BLKR_BCNT_MASK);
+
+	HSMCI_DMA |= BV(HSMCI_DMA_DMAEN);
+	HSMCI_BLKR = ((blk_size << HSMCI_BLKR_BLKLEN_SHIFT) & ~0x30000) | blk_cnt;
+
+	dmac_setSources(HSMCI_DMAC_CH, (uint32_t)buf, (uint32_t)&HSMCI_TDR);
+	dmac_configureDmac(HSMCI_DMAC_CH, blk_size * blk_cnt / 4, HSMCI_WRITE_DMAC_CFG, HSMCI_WRITE_DMAC_CTRLA, HSMCI_WRITE_DMAC_CTRLB);
+	dmac_start(HSMCI_DMAC_CH);
+}
+
+void hsmci_readBlocks(uint32_t *buf, size_t blk_size, size_t blk_cnt)
+{
+	ASSERT(blk_cnt <= HSMCI_BLKR_BCNT_MASK);
+
+	HSMCI_DMA |= BV(HSMCI_DMA_DMAEN);
+	HSMCI_BLKR = (blk_size << HSMCI_BLKR_BLKLEN_SHIFT) | blk_cnt;
+
+	dmac_setSources(HSMCI_DMAC_CH, (uint32_t)&HSMCI_RDR, (uint32_t)buf);
+	dmac_configureDmac(HSMCI_DMAC_CH, blk_size * blk_cnt / 4, HSMCI_READ_DMAC_CFG, HSMCI_READ_DMAC_CTRLA, HSMCI_READ_DMAC_CTRLB);
+	dmac_start(HSMCI_DMAC_CH);
+}
+
 void hsmci_waitTransfer(void)
 {
 	while (!(HSMCI_SR & BV(HSMCI_SR_XFRDONE)))
@@ -84,6 +84,8 @@ bool hsmci_sendCmd(uint8_t index, uint32_t argument, uint32_t reply_type);
 
 void hsmci_read(uint32_t *buf, size_t word_num, size_t blk_size);
 void hsmci_write(const uint32_t *buf, size_t word_num, size_t blk_size);
+void hsmci_readBlocks(uint32_t *buf, size_t blk_size, size_t blk_cnt);
+void hsmci_writeBlocks(const uint32_t *buf, size_t blk_size, size_t blk_cnt);
 void hsmci_waitTransfer(void);
 
 void hsmci_setSpeed(uint32_t data_rate, int flag);
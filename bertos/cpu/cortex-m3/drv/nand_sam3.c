@@ -36,6 +36,9 @@
  */
 
 #include <drv/nand.h>
+
+#define LOG_LEVEL    CONFIG_NAND_LOG_LEVEL
+#define LOG_FORMAT   CONFIG_NAND_LOG_FORMAT
 #include <cfg/log.h>
 #include <io/sam3.h>
 #include <drv/timer.h>
@@ -693,6 +693,76 @@ static size_t sd_SdWriteDirect(KBlock *b, block_idx_t idx, const void *buf, size
 	return -1;
 }
 
+static bool sd_stopTransmission(Sd *sd)
+{
+	if (hsmci_sendCmd(12, 0, HSMCI_CMDR_RSPTYP_R1B | HSMCI_CMDR_TRCMD_STOP_DATA))
+	{
+		LOG_ERR("STOP_TRANSMISSION: %lx\n", HSMCI_SR);
+		return false;
+	}
+	hsmci_readResp(&(sd->status), 1);
+	return true;
+}
+
+static block_idx_t sd_SdReadRange(struct KBlock *b, block_idx_t idx, void *buf, block_idx_t count)
+{
+	ASSERT(buf);
+	ASSERT(!((uint32_t)buf & 0x3));
+
+	Sd *sd = SD_CAST(b);
+	LOG_INFO("reading %ld blocks from %ld\n", count, idx);
+
+	hsmci_waitTransfer();
+	hsmci_readBlocks(buf, sd->b.blk_size, count);
+
+	if (hsmci_sendCmd(18, idx * sd->b.blk_size, HSMCI_CMDR_RSPTYP_48_BIT |
+			BV(HSMCI_CMDR_TRDIR) | HSMCI_CMDR_TRCMD_START_DATA | HSMCI_CMDR_TRTYP_MULTIPLE))
+	{
+		LOG_ERR("MULTI_BLK_READ: %lx\n", HSMCI_SR);
+		return 0;
+	}
+
+	hsmci_readResp(&(sd->status), 1);
+
+	LOG_INFOB(dump("MULTI_BLK_READ", &(sd->status), 1););
+	LOG_INFO("State[%d]\n", SD_GET_STATE(sd->status));
+
+	if (!(sd->status & SD_STATUS_READY))
+		return 0;
+
+	hsmci_waitTransfer();
+	return sd_stopTransmission(sd) ? count : 0;
+}
+
+static block_idx_t sd_SdWriteRange(KBlock *b, block_idx_t idx, const void *buf, block_idx_t count)
+{
+	ASSERT(buf);
+	ASSERT(!((uint32_t)buf & 0x3));
+
+	Sd *sd = SD_CAST(b);
+	LOG_INFO("writing %ld blocks from %ld\n", count, idx);
+
+	hsmci_waitTransfer();
+	hsmci_writeBlocks((const uint32_t *)buf, sd->b.blk_size, count);
+
+	if (hsmci_sendCmd(25, idx * sd->b.blk_size, HSMCI_CMDR_RSPTYP_48_BIT |
+						HSMCI_CMDR_TRCMD_START_DATA | HSMCI_CMDR_TRTYP_MULTIPLE))
+	{
+		LOG_ERR("MULTI_BLK_WRITE: %lx\n", HSMCI_SR);
+		return 0;
+	}
+
+	hsmci_readResp(&(sd->status), 1);
+
+	LOG_INFOB(dump("MULTI_BLK_WR", &(sd->status), 1););
+	LOG_INFO("State[%d]\n", SD_GET_STATE(sd->status));
+
+	if (!(sd->status & SD_STATUS_READY))
+		return 0;
+
+	hsmci_waitTransfer();
+	return sd_stopTransmission(sd) ? count : 0;
+}
 
 static int sd_SdError(KBlock *b)
 {
@@ -796,6 +866,8 @@ static const KBlockVTable sd_unbuffered_vt =
 {
 	.readDirect = sd_SdReadDirect,
 	.writeDirect = sd_SdWriteDirect,
+	.readRange = sd_SdReadRange,
+	.writeRange = sd_SdWriteRange,
 
 	.error = sd_SdError,
 	.clearerr = sd_SdClearerr,
@@ -805,6 +877,8 @@ static const KBlockVTable sd_buffered_vt =
 {
 	.readDirect = sd_SdReadDirect,
 	.writeDirect = sd_SdWriteDirect,
+	.readRange = sd_SdReadRange,
+	.writeRange = sd_SdWriteRange,
 
 	.readBuf = kblock_swReadBuf,
 	.writeBuf = kblock_swWriteBuf,
@@ -33,10 +33,12 @@
 *
 * Defective blocks are remapped in a reserved area of configurable size
 * at the bottom of the NAND.
-* At the moment there is no wear-leveling block translation: kblock's blocks
+* There is no wear-leveling block translation in this driver: kblock's blocks
 * are mapped directly on NAND erase blocks: when a (k)block is written the
 * corresponding erase block is erased and all pages within are rewritten.
 * Partial write is not possible: it's recommended to use buffered mode.
+* For wear-leveling and out of place writes use the translation layer
+* in drv/nand_ftl.h on top of this driver.
 *
 * The driver needs to format the NAND before use. If the initialization code
 * detects a fresh memory it does a bad block scan and a formatting.
@@ -46,6 +48,10 @@
 * RemapInfo).
 *
 * The ECC for each page is written in the spare area too.
+* If CONFIG_NAND_ECC_SW is enabled, ECC is computed in software with
+* a Hamming code and single bit errors are corrected on read.
+* Spare area layout is: ECC data, user tag (\see nand_pageProgram()),
+* remap info.
 *
 * Works only in 8 bit data mode and NAND parameters are not
 * detected at run-time, but hand-configured in cfg_nand.h.
@@ -59,8 +65,15 @@
 */
 
 #include "nand.h"
+
+// Define log settings for cfg/log.h
+#define LOG_LEVEL    CONFIG_NAND_LOG_LEVEL
+#define LOG_FORMAT   CONFIG_NAND_LOG_FORMAT
 #include <cfg/log.h>
 #include <struct/heap.h>
+#if CONFIG_NAND_ECC_SW
+	#include <algo/hamming.h>
+#endif
 #include <string.h> // memset
 
 
@@ -84,22 +97,14 @@ struct RemapInfo
 // Fixed tag to detect RemapInfo
 #define NAND_REMAP_TAG         0x3e10c8ed
 
-/*
- * Number of ECC words computed for a page.
- *
- * For 2048 bytes pages and 1 ECC word each 256 bytes,
- * 24 bytes of ECC data are stored.
- */
-#define NAND_ECC_NWORDS        (CONFIG_NAND_DATA_SIZE / 256)
-
-// Total page size (user data + spare) in bytes
-#define NAND_PAGE_SIZE         (CONFIG_NAND_DATA_SIZE + CONFIG_NAND_SPARE_SIZE)
-
-// Erase block size in bytes
-#define NAND_BLOCK_SIZE        (CONFIG_NAND_DATA_SIZE * CONFIG_NAND_PAGES_PER_BLOCK)
+// Where the user tag is stored in the spare area
+#define NAND_TAG_OFFSET        NAND_ECC_SIZE
 
-// Number of usable blocks, and index of first remapping block
-#define NAND_NUM_USER_BLOCKS   (CONFIG_NAND_NUM_BLOCK - CONFIG_NAND_NUM_REMAP_BLOCKS)
+STATIC_ASSERT(sizeof(struct RemapInfo) <= NAND_REMAP_INFO_SIZE);
+#if CONFIG_NAND_ECC_SW
+	STATIC_ASSERT(NAND_ECC_NWORDS * HAMMING_ECC_SIZE <= NAND_ECC_SIZE);
+	STATIC_ASSERT(CONFIG_NAND_DATA_SIZE % HAMMING_DATA_SIZE == 0);
+#endif
 
 // ONFI NAND status codes
 #define NAND_STATUS_READY  BV(6)
@@ -203,7 +208,7 @@ bool nand_getDevId(Nand *chip, uint8_t dev_id[5])
 		return false;
 	}
 
-	memcpy(dev_id, nand_dataBuffer(chip), sizeof(dev_id));
+	memcpy(dev_id, nand_dataBuffer(chip), 5);
 	return true;
 }
 
@@ -231,9 +236,43 @@ static bool nand_readPage(Nand *chip, uint32_t page, uint16_t offset)
 }
 
 
+#if CONFIG_NAND_ECC_SW
+
+/*
+ * Check page data in the NAND buffer against the ECC stored in
+ * the spare area, fixing single bit errors.
+ */
+static bool correctEcc(Nand *chip, uint32_t page)
+{
+	uint8_t *data = (uint8_t *)nand_dataBuffer(chip);
+	const uint8_t *ecc = data + CONFIG_NAND_DATA_SIZE;
+	uint8_t calc_ecc[HAMMING_ECC_SIZE];
+
+	for (int i = 0; i < CONFIG_NAND_DATA_SIZE / HAMMING_DATA_SIZE; i++)
+	{
+		hamming_compute(data, calc_ecc);
+		switch (hamming_correct(data, ecc, calc_ecc))
+		{
+		case HAMMING_CORRECTED:
+			LOG_INFO("nand: ECC fixed bit error in page %ld\n", (long)page);
+			chip->ecc_fixed++;
+			break;
+		case HAMMING_ERROR:
+			LOG_ERR("nand: uncorrectable ECC error in page %ld\n", (long)page);
+			return false;
+		}
+		data += HAMMING_DATA_SIZE;
+		ecc += HAMMING_ECC_SIZE;
+	}
+	(void)page;
+	return true;
+}
+
+#endif /* CONFIG_NAND_ECC_SW */
+
 /*
  * Read page data and ECC, checking for errors.
- * TODO: fix errors with ECC when possible.
+ * With software ECC, single bit errors are also fixed.
  */
 static bool nand_read(Nand *chip, uint32_t page, void *buf, uint16_t offset, uint16_t size)
 {
@@ -252,20 +291,27 @@ static bool nand_read(Nand *chip, uint32_t page, void *buf, uint16_t offset, uin
 	if (!nand_readPage(chip, page, 0))
 		return false;
 
-	memcpy(buf, (char *)nand_dataBuffer(chip) + offset, size);
-
 	/*
-	 * Check for ECC hardware status only if a valid RemapInfo structure is found.
+	 * Check for ECC only if a valid RemapInfo structure is found.
 	 * That guarantees the page is written by us and a valid ECC is present.
 	 */
-	memcpy(&remap_info, (char *)buf + NAND_REMAP_TAG_OFFSET, sizeof(remap_info));
-	if (remap_info.tag == NAND_REMAP_TAG && !nand_checkEcc(chip))
+	memcpy(&remap_info, (char *)nand_dataBuffer(chip) + CONFIG_NAND_DATA_SIZE + NAND_REMAP_TAG_OFFSET,
+		sizeof(remap_info));
+	if (remap_info.tag == NAND_REMAP_TAG)
 	{
-		chip->status |= NAND_ERR_ECC;
-		return false;
+	#if CONFIG_NAND_ECC_SW
+		if (!correctEcc(chip, page))
+	#else
+		if (!nand_checkEcc(chip))
+	#endif
+		{
+			chip->status |= NAND_ERR_ECC;
+			return false;
+		}
 	}
-	else
-		return true;
+
+	memcpy(buf, (char *)nand_dataBuffer(chip) + offset, size);
+	return true;
 }
 
 
@@ -320,13 +366,17 @@ static bool nand_writePage(Nand *chip, uint32_t page, uint16_t offset)
  * spare data in one write, at this point the last ECC_PR is correct and
  * ECC data can be written in the spare area with a second program operation.
  */
-static bool nand_write(Nand *chip, uint32_t page, const void *buf, size_t size)
+static bool nand_write(Nand *chip, uint32_t page, const void *buf, size_t size, const void *tag, size_t tag_size)
 {
 	struct RemapInfo remap_info;
 	uint32_t *nand_buf = (uint32_t *)nand_dataBuffer(chip);
 	uint32_t remapped_page = PAGE(chip->block_map[BLOCK(page)]) + PAGE_IN_BLOCK(page);
+#if CONFIG_NAND_ECC_SW
+	uint8_t ecc[NAND_ECC_SIZE];
+#endif
 
 	ASSERT(size <= CONFIG_NAND_DATA_SIZE);
+	ASSERT(tag_size <= NAND_TAG_SIZE);
 
 	if (page != remapped_page)
 		LOG_INFO("nand_write: remapped block: blk %d->%d, pg %ld->%ld\n",
@@ -335,12 +385,25 @@ static bool nand_write(Nand *chip, uint32_t page, const void *buf, size_t size)
 	// Data
 	memset(nand_buf, 0xff, NAND_PAGE_SIZE);
 	memcpy(nand_buf, buf, size);
+#if CONFIG_NAND_ECC_SW
+	memset(ecc, 0xff, sizeof(ecc));
+	for (int i = 0; i < CONFIG_NAND_DATA_SIZE / HAMMING_DATA_SIZE; i++)
+		hamming_compute((uint8_t *)nand_buf + i * HAMMING_DATA_SIZE, ecc + i * HAMMING_ECC_SIZE);
+#endif
 	if (!nand_writePage(chip, remapped_page, 0))
 		return false;
 
 	// ECC
 	memset(nand_buf, 0xff, CONFIG_NAND_SPARE_SIZE);
+#if CONFIG_NAND_ECC_SW
+	memcpy(nand_buf, ecc, sizeof(ecc));
+#else
 	nand_computeEcc(chip, buf, size, nand_buf, NAND_ECC_NWORDS);
+#endif
+
+	// User tag
+	if (tag)
+		memcpy((char *)nand_buf + NAND_TAG_OFFSET, tag, tag_size);
 
 	// Remap info
 	remap_info.tag = NAND_REMAP_TAG;
@@ -351,6 +414,78 @@ static bool nand_write(Nand *chip, uint32_t page, const void *buf, size_t size)
 }
 
 
+/**
+ * Program a single page of the user partition, with an optional \a tag
+ * stored in its spare area.
+ *
+ * \param chip      nand context
+ * \param page      page to be programmed, bad blocks remapping is applied
+ * \param buf       page data, CONFIG_NAND_DATA_SIZE bytes long
+ * \param tag       data to store in the spare area (may be NULL)
+ * \param tag_size  size of \a tag, max NAND_TAG_SIZE bytes
+ *
+ * \note The block containing \a page must have been erased before.
+ * \return true if ok, false on errors.
+ */
+bool nand_pageProgram(Nand *chip, uint32_t page, const void *buf, const void *tag, size_t tag_size)
+{
+	return nand_write(chip, page, buf, CONFIG_NAND_DATA_SIZE, tag, tag_size);
+}
+
+
+/**
+ * Read \a size bytes from \a page of the user partition, starting at \a offset.
+ *
+ * Data is checked against ECC (and fixed, if CONFIG_NAND_ECC_SW is enabled).
+ * \return true if ok, false on errors.
+ */
+bool nand_pageRead(Nand *chip, uint32_t page, void *buf, uint16_t offset, uint16_t size)
+{
+	ASSERT(offset + size <= CONFIG_NAND_DATA_SIZE);
+	return nand_read(chip, page, buf, offset, size);
+}
+
+
+/**
+ * Read the user tag stored in the spare area of \a page.
+ *
+ * No ECC check is done on the tag: users should protect it with
+ * their own checksum.
+ * \return true if ok, false on errors.
+ */
+bool nand_pageReadTag(Nand *chip, uint32_t page, void *tag, size_t tag_size)
+{
+	uint32_t remapped_page = PAGE(chip->block_map[BLOCK(page)]) + PAGE_IN_BLOCK(page);
+
+	ASSERT(tag_size <= NAND_TAG_SIZE);
+	if (!nand_readPage(chip, remapped_page, CONFIG_NAND_DATA_SIZE + NAND_TAG_OFFSET))
+		return false;
+
+	memcpy(tag, nand_dataBuffer(chip), tag_size);
+	return true;
+}
+
+
+/**
+ * Check if \a page of the user partition, data and spare area, is erased.
+ *
+ * \return true if all bytes read as 0xFF, false otherwise or on errors.
+ */
+bool nand_pageIsErased(Nand *chip, uint32_t page)
+{
+	uint32_t remapped_page = PAGE(chip->block_map[BLOCK(page)]) + PAGE_IN_BLOCK(page);
+	const uint8_t *buf = (const uint8_t *)nand_dataBuffer(chip);
+
+	if (!nand_readPage(chip, remapped_page, 0))
+		return false;
+
+	for (size_t i = 0; i < NAND_PAGE_SIZE; i++)
+		if (buf[i] != 0xff)
+			return false;
+	return true;
+}
+
+
 /*
  * Check if the given block is marked bad: ONFI standard mandates
  * that bad block are marked with "00" bytes on the spare area of the
@@ -589,7 +724,7 @@ static size_t nand_writeDirect(struct KBlock *kblk, block_idx_t idx, const void
 	{
 		uint32_t page = PAGE(idx) + (offset / CONFIG_NAND_DATA_SIZE);
 
-		if (!nand_write(NAND_CAST(kblk), page, buf, CONFIG_NAND_DATA_SIZE))
+		if (!nand_write(NAND_CAST(kblk), page, buf, CONFIG_NAND_DATA_SIZE, NULL, 0))
 			break;
 
 		offset += CONFIG_NAND_DATA_SIZE;
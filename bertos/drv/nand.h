@@ -34,7 +34,7 @@
 * \author Stefano Fedrigo <aleph@develer.com>
 *
 * $WIZ$ module_name = "nand"
-* $WIZ$ module_depends = "timer", "kblock", "heap"
+* $WIZ$ module_depends = "timer", "kblock", "heap", "hamming"
 * $WIZ$ module_configuration = "bertos/cfg/cfg_nand.h"
 *
 */
@@ -45,11 +45,6 @@
 #include "cfg/cfg_nand.h"
 #include <io/kblock.h>
 
-
-// Define log settings for cfg/log.h
-#define LOG_LEVEL    CONFIG_NAND_LOG_LEVEL
-#define LOG_FORMAT   CONFIG_NAND_LOG_FORMAT
-
 /**
  * \name Error codes.
  * \{
@@ -81,6 +76,33 @@
 #define NAND_CMD_RESET                0xFF
 
 
+/*
+ * Number of ECC words computed for a page.
+ *
+ * For 2048 bytes pages and 1 ECC word each 256 bytes,
+ * 24 bytes of ECC data are stored.
+ */
+#define NAND_ECC_NWORDS        (CONFIG_NAND_DATA_SIZE / 256)
+
+// Room reserved for ECC data at the beginning of the spare area
+#define NAND_ECC_SIZE          (NAND_ECC_NWORDS * sizeof(uint32_t))
+
+// Room reserved for bad block remapping info at the end of the spare area
+#define NAND_REMAP_INFO_SIZE   8
+
+// Room available for a user tag in the spare area, \see nand_pageProgram()
+#define NAND_TAG_SIZE          (CONFIG_NAND_SPARE_SIZE - NAND_ECC_SIZE - NAND_REMAP_INFO_SIZE)
+
+// Total page size (user data + spare) in bytes
+#define NAND_PAGE_SIZE         (CONFIG_NAND_DATA_SIZE + CONFIG_NAND_SPARE_SIZE)
+
+// Erase block size in bytes
+#define NAND_BLOCK_SIZE        (CONFIG_NAND_DATA_SIZE * CONFIG_NAND_PAGES_PER_BLOCK)
+
+// Number of usable blocks, and index of first remapping block
+#define NAND_NUM_USER_BLOCKS   (CONFIG_NAND_NUM_BLOCK - CONFIG_NAND_NUM_REMAP_BLOCKS)
+
+
 /**
  * NAND context.
  */
@@ -93,6 +115,8 @@ typedef struct Nand
 
 	uint16_t *block_map;    // For bad blocks remapping
 	uint16_t  remap_start;  // First unused remap block
+
+	uint32_t  ecc_fixed;    // Number of bit errors fixed by software ECC
 } Nand;
 
 /*
@@ -120,6 +144,12 @@ bool nand_getDevId(Nand *chip, uint8_t dev_id[5]);
 int nand_blockErase(Nand *chip, uint16_t block);
 void nand_format(Nand *chip);
 
+// Page level access, used by the translation layer
+bool nand_pageProgram(Nand *chip, uint32_t page, const void *buf, const void *tag, size_t tag_size);
+bool nand_pageRead(Nand *chip, uint32_t page, void *buf, uint16_t offset, uint16_t size);
+bool nand_pageReadTag(Nand *chip, uint32_t page, void *tag, size_t tag_size);
+bool nand_pageIsErased(Nand *chip, uint32_t page);
+
 #ifdef _DEBUG
 void nand_ruinSomeBlocks(Nand *chip);
 #endif
@@ -0,0 +1,607 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Wear leveling flash translation layer over the NAND driver.
+ *
+ * The translation layer exports a KBlock with erase block sized blocks,
+ * like drv/nand.h, but logical blocks are never written in place: each
+ * write goes to a free physical block, and the block previously holding
+ * the data is released for garbage collection.
+ *
+ * Dynamic wear leveling: new data is always written to the available block
+ * with the lowest erase count.  Static wear leveling: when the erase count
+ * spread grows over CONFIG_NAND_FTL_WL_THRESHOLD, nandftl_gc() moves the
+ * data of the least erased block to the most erased free one, so blocks
+ * holding cold data take part in the rotation too.
+ *
+ * The mapping table is not stored in a dedicated area: each written block
+ * carries a tag (struct FtlTag) in the spare area of its first and last
+ * page, with the logical block number, a sequence number and the erase count.
+ * At init all tags are scanned and, when several physical blocks claim the
+ * same logical block, the one with the highest sequence number wins.
+ * The tag of the last page acts as a commit record: a block whose write
+ * was interrupted is discarded at next init, and the previous copy of its
+ * data is used instead.  The first page tag is only used when the last one
+ * is programmed but corrupted.
+ * Erase counts of blocks without a valid tag are unknown after a reboot
+ * and are estimated with the average of the known ones.
+ *
+ * Blocks that fail erase or program operations are retired at run-time.
+ * Factory bad blocks are handled by the underlying NAND driver.
+ * Bit errors are corrected by the NAND driver if CONFIG_NAND_ECC_SW is set.
+ *
+ * notest: avr
+ */
+
+#include "nand_ftl.h"
+
+#include "cfg/cfg_nand_ftl.h"
+
+// Define log settings for cfg/log.h
+#define LOG_LEVEL    CONFIG_NAND_FTL_LOG_LEVEL
+#define LOG_FORMAT   CONFIG_NAND_FTL_LOG_FORMAT
+#include <cfg/log.h>
+
+#include <algo/rotating_hash.h>
+#include <struct/heap.h>
+
+#include <string.h> // memset
+
+
+/*
+ * Tag stored in the spare area of first and last page of each written block.
+ */
+struct FtlTag
+{
+	uint16_t lblk;       // Logical block stored in this block
+	uint16_t check;      // Rotating hash of the other fields
+	uint32_t seq;        // Write sequence number
+	uint32_t erase_cnt;  // Erase count of this block
+};
+
+STATIC_ASSERT(sizeof(struct FtlTag) <= NAND_TAG_SIZE);
+STATIC_ASSERT(CONFIG_NAND_FTL_RESERVED_BLOCKS >= 2);
+STATIC_ASSERT(NAND_FTL_NUM_BLOCKS > 0);
+
+// Physical block states
+#define FTL_FREE   0   // Erased, ready to be written
+#define FTL_DIRTY  1   // Holds stale data, must be erased before use
+#define FTL_USED   2   // Holds the current copy of a logical block
+#define FTL_BAD    3   // Retired
+
+#define FTL_UNMAPPED   0xffff
+
+#define PAGE(blk)       ((uint32_t)(blk) * CONFIG_NAND_PAGES_PER_BLOCK)
+#define LAST_PAGE(blk)  (PAGE(blk) + CONFIG_NAND_PAGES_PER_BLOCK - 1)
+
+
+static uint16_t tagCheck(const struct FtlTag *tag)
+{
+	rotating_t rot;
+
+	rotating_init(&rot);
+	rotating_update(&tag->lblk, sizeof(tag->lblk), &rot);
+	rotating_update(&tag->seq, sizeof(tag->seq), &rot);
+	rotating_update(&tag->erase_cnt, sizeof(tag->erase_cnt), &rot);
+	return rot;
+}
+
+static bool tagIsValid(const struct FtlTag *tag)
+{
+	return tag->lblk < NAND_FTL_NUM_BLOCKS && tag->check == tagCheck(tag);
+}
+
+static bool tagIsErased(const struct FtlTag *tag)
+{
+	const uint8_t *p = (const uint8_t *)tag;
+
+	for (size_t i = 0; i < sizeof(*tag); i++)
+		if (p[i] != 0xff)
+			return false;
+	return true;
+}
+
+/*
+ * Read the tag of a physical block.
+ */
+static bool readTag(NandFtl *ftl, uint16_t pblk, struct FtlTag *tag)
+{
+	bool ok = nand_pageReadTag(ftl->chip, LAST_PAGE(pblk), tag, sizeof(*tag));
+
+	if (ok && tagIsValid(tag))
+		return true;
+
+	/*
+	 * Last page unreadable, or programmed but with a corrupted tag:
+	 * use the copy in the first page. On read errors *tag is untouched.
+	 */
+	if ((!ok || !tagIsErased(tag))
+			&& nand_pageReadTag(ftl->chip, PAGE(pblk), tag, sizeof(*tag))
+			&& tagIsValid(tag))
+		return true;
+
+	return false;
+}
+
+
+static void retireBlock(NandFtl *ftl, uint16_t pblk)
+{
+	LOG_WARN("nand_ftl: retiring bad block %d\n", pblk);
+	ftl->state[pblk] = FTL_BAD;
+	ftl->stats.bad++;
+	// The error has been handled here
+	ftl->chip->status &= ~(NAND_ERR_ERASE | NAND_ERR_WRITE);
+}
+
+static bool eraseBlock(NandFtl *ftl, uint16_t pblk)
+{
+	ASSERT(ftl->state[pblk] == FTL_DIRTY);
+
+	if (nand_blockErase(ftl->chip, pblk) != 0)
+	{
+		retireBlock(ftl, pblk);
+		return false;
+	}
+
+	ftl->erase_cnt[pblk]++;
+	ftl->stats.erases++;
+	ftl->state[pblk] = FTL_FREE;
+	return true;
+}
+
+/*
+ * Find the available (free or dirty) block with the lowest (or highest)
+ * erase count.  Free blocks are preferred on equal counts.
+ */
+static int findAvailable(NandFtl *ftl, bool most_worn)
+{
+	int found = -1;
+
+	for (uint16_t b = 0; b < NAND_NUM_USER_BLOCKS; b++)
+	{
+		if (ftl->state[b] != FTL_FREE && ftl->state[b] != FTL_DIRTY)
+			continue;
+
+		if (found < 0)
+		{
+			found = b;
+			continue;
+		}
+
+		uint32_t cnt = ftl->erase_cnt[b];
+		uint32_t found_cnt = ftl->erase_cnt[found];
+		if ((most_worn ? cnt > found_cnt : cnt < found_cnt)
+				|| (cnt == found_cnt && ftl->state[b] == FTL_FREE && ftl->state[found] == FTL_DIRTY))
+			found = b;
+	}
+	return found;
+}
+
+/*
+ * Get an erased block, ready to be written.
+ */
+static int allocBlock(NandFtl *ftl, bool most_worn)
+{
+	int pblk;
+
+	while ((pblk = findAvailable(ftl, most_worn)) >= 0)
+	{
+		if (ftl->state[pblk] == FTL_FREE || eraseBlock(ftl, pblk))
+			return pblk;
+	}
+
+	LOG_ERR("nand_ftl: no space left\n");
+	ftl->status |= NAND_FTL_ERR_NOSPACE;
+	return -1;
+}
+
+static bool programPage(NandFtl *ftl, uint16_t pblk, int page, const void *buf, const struct FtlTag *tag)
+{
+	bool tagged = page == 0 || page == CONFIG_NAND_PAGES_PER_BLOCK - 1;
+
+	return nand_pageProgram(ftl->chip, PAGE(pblk) + page, buf,
+			tagged ? tag : NULL, tagged ? sizeof(*tag) : 0);
+}
+
+static void prepareTag(NandFtl *ftl, struct FtlTag *tag, block_idx_t lblk, uint16_t pblk)
+{
+	tag->lblk = lblk;
+	tag->seq = ++ftl->seq;
+	tag->erase_cnt = ftl->erase_cnt[pblk];
+	tag->check = tagCheck(tag);
+}
+
+/*
+ * Update the map after logical block lblk has been written in pblk.
+ */
+static void commitBlock(NandFtl *ftl, block_idx_t lblk, uint16_t pblk)
+{
+	uint16_t old = ftl->map[lblk];
+
+	if (old != FTL_UNMAPPED)
+		ftl->state[old] = FTL_DIRTY;
+
+	ftl->map[lblk] = pblk;
+	ftl->state[pblk] = FTL_USED;
+}
+
+static bool writeBlock(NandFtl *ftl, block_idx_t lblk, const void *buf)
+{
+	struct FtlTag tag;
+	int pblk;
+
+	while ((pblk = allocBlock(ftl, false)) >= 0)
+	{
+		const uint8_t *data = (const uint8_t *)buf;
+		int page;
+
+		prepareTag(ftl, &tag, lblk, pblk);
+		for (page = 0; page < CONFIG_NAND_PAGES_PER_BLOCK; page++)
+		{
+			if (!programPage(ftl, pblk, page, data, &tag))
+				break;
+			data += CONFIG_NAND_DATA_SIZE;
+		}
+
+		if (page == CONFIG_NAND_PAGES_PER_BLOCK)
+		{
+			commitBlock(ftl, lblk, pblk);
+			return true;
+		}
+		retireBlock(ftl, pblk);
+	}
+	return false;
+}
+
+/*
+ * Move the data of a cold block to the most worn available block.
+ */
+static bool moveBlock(NandFtl *ftl, uint16_t src)
+{
+	struct FtlTag tag;
+	block_idx_t lblk;
+	int dst;
+
+	// Find the logical block stored in src
+	for (lblk = 0; lblk < NAND_FTL_NUM_BLOCKS; lblk++)
+		if (ftl->map[lblk] == src)
+			break;
+	ASSERT(lblk < NAND_FTL_NUM_BLOCKS);
+
+	while ((dst = allocBlock(ftl, true)) >= 0)
+	{
+		int page;
+
+		LOG_INFO("nand_ftl: moving block %ld, %d->%d\n", (long)lblk, src, dst);
+		prepareTag(ftl, &tag, lblk, dst);
+		for (page = 0; page < CONFIG_NAND_PAGES_PER_BLOCK; page++)
+		{
+			if (!nand_pageRead(ftl->chip, PAGE(src) + page, ftl->page_buf, 0, CONFIG_NAND_DATA_SIZE))
+			{
+				// dst is partly programmed: erase it before reuse
+				ftl->state[dst] = FTL_DIRTY;
+				return false;
+			}
+			if (!programPage(ftl, dst, page, ftl->page_buf, &tag))
+				break;
+		}
+
+		if (page == CONFIG_NAND_PAGES_PER_BLOCK)
+		{
+			commitBlock(ftl, lblk, dst);
+			ftl->stats.moves++;
+			return true;
+		}
+		retireBlock(ftl, dst);
+	}
+	return false;
+}
+
+
+/**
+ * Get the lowest and the highest erase count of good blocks.
+ */
+void nandftl_eraseCountRange(NandFtl *ftl, uint32_t *min, uint32_t *max)
+{
+	*min = UINT32_MAX;
+	*max = 0;
+
+	for (uint16_t b = 0; b < NAND_NUM_USER_BLOCKS; b++)
+	{
+		if (ftl->state[b] == FTL_BAD)
+			continue;
+		*min = MIN(*min, ftl->erase_cnt[b]);
+		*max = MAX(*max, ftl->erase_cnt[b]);
+	}
+}
+
+/**
+ * Garbage collection: erase up to \a max_erases blocks holding stale data,
+ * so that following writes don't have to wait for erase operations.
+ * If the erase count spread exceeds CONFIG_NAND_FTL_WL_THRESHOLD,
+ * one cold block is moved too (static wear leveling).
+ *
+ * Call it periodically from a low priority process, when the NAND is idle.
+ *
+ * \return the number of erased blocks.
+ */
+int nandftl_gc(NandFtl *ftl, int max_erases)
+{
+	int erased = 0;
+
+#if CONFIG_NAND_FTL_WL_THRESHOLD > 0
+	uint32_t min_used = UINT32_MAX;
+	uint32_t max_cnt = 0;
+	int cold = -1;
+
+	for (uint16_t b = 0; b < NAND_NUM_USER_BLOCKS; b++)
+	{
+		if (ftl->state[b] == FTL_BAD)
+			continue;
+		max_cnt = MAX(max_cnt, ftl->erase_cnt[b]);
+		if (ftl->state[b] == FTL_USED && ftl->erase_cnt[b] < min_used)
+		{
+			min_used = ftl->erase_cnt[b];
+			cold = b;
+		}
+	}
+
+	if (cold >= 0 && max_cnt - min_used > CONFIG_NAND_FTL_WL_THRESHOLD)
+		moveBlock(ftl, cold);
+#endif
+
+	for (uint16_t b = 0; b < NAND_NUM_USER_BLOCKS && erased < max_erases; b++)
+	{
+		if (ftl->state[b] == FTL_DIRTY && eraseBlock(ftl, b))
+			erased++;
+	}
+
+	return erased;
+}
+
+
+/*
+ * Rebuild the mapping table from the block tags.
+ */
+static void mount(NandFtl *ftl)
+{
+	struct FtlTag tag, other;
+	uint32_t known = 0;
+	uint64_t total = 0;
+	uint16_t b;
+
+	for (b = 0; b < NAND_FTL_NUM_BLOCKS; b++)
+		ftl->map[b] = FTL_UNMAPPED;
+
+	for (b = 0; b < NAND_NUM_USER_BLOCKS; b++)
+	{
+		ftl->state[b] = FTL_DIRTY;
+		ftl->erase_cnt[b] = UINT32_MAX;
+
+		if (!readTag(ftl, b, &tag))
+		{
+			// Blocks are programmed from the first page
+			if (nand_pageIsErased(ftl->chip, PAGE(b)))
+				ftl->state[b] = FTL_FREE;
+			continue;
+		}
+
+		ftl->erase_cnt[b] = tag.erase_cnt;
+		total += tag.erase_cnt;
+		known++;
+		ftl->seq = MAX(ftl->seq, tag.seq);
+
+		uint16_t prev = ftl->map[tag.lblk];
+		if (prev != FTL_UNMAPPED)
+		{
+			// Two copies of the same logical block: keep the newest one
+			if (readTag(ftl, prev, &other) && other.seq > tag.seq)
+				continue;
+			ftl->state[prev] = FTL_DIRTY;
+		}
+		ftl->map[tag.lblk] = b;
+		ftl->state[b] = FTL_USED;
+	}
+
+	for (b = 0; b < NAND_NUM_USER_BLOCKS; b++)
+		if (ftl->erase_cnt[b] == UINT32_MAX)
+			ftl->erase_cnt[b] = known ? total / known : 0;
+
+	LOG_INFO("nand_ftl: mounted, %ld blocks with valid tag, seq %ld\n", (long)known, (long)ftl->seq);
+}
+
+
+/**************** Kblock interface ****************/
+
+
+static size_t nandftl_readDirect(struct KBlock *kblk, block_idx_t idx, void *buf, size_t offset, size_t size)
+{
+	NandFtl *ftl = NAND_FTL_CAST(kblk);
+	uint16_t pblk = ftl->map[idx];
+	size_t nread = 0;
+
+	ASSERT(offset + size <= NAND_BLOCK_SIZE);
+
+	// Never written blocks read as erased flash
+	if (pblk == FTL_UNMAPPED)
+	{
+		memset(buf, 0xff, size);
+		return size;
+	}
+
+	while (nread < size)
+	{
+		uint32_t page = PAGE(pblk) + offset / CONFIG_NAND_DATA_SIZE;
+		uint16_t page_offset = offset % CONFIG_NAND_DATA_SIZE;
+		uint16_t read_size = MIN(size - nread, (size_t)(CONFIG_NAND_DATA_SIZE - page_offset));
+
+		if (!nand_pageRead(ftl->chip, page, (uint8_t *)buf + nread, page_offset, read_size))
+			break;
+
+		offset += read_size;
+		nread += read_size;
+	}
+
+	return nread;
+}
+
+static size_t nandftl_writeDirect(struct KBlock *kblk, block_idx_t idx, const void *buf, size_t offset, size_t size)
+{
+	NandFtl *ftl = NAND_FTL_CAST(kblk);
+
+	// Blocks are always written as a whole
+	ASSERT(offset == 0);
+	ASSERT(size == NAND_BLOCK_SIZE);
+	(void)offset;
+
+	if (!writeBlock(ftl, idx, buf))
+		return 0;
+
+	ftl->stats.writes++;
+	return size;
+}
+
+static int nandftl_error(struct KBlock *kblk)
+{
+	NandFtl *ftl = NAND_FTL_CAST(kblk);
+	return ftl->status | ftl->chip->status;
+}
+
+static void nandftl_clearError(struct KBlock *kblk)
+{
+	NandFtl *ftl = NAND_FTL_CAST(kblk);
+
+	ftl->status = 0;
+	ftl->chip->status = 0;
+}
+
+static int nandftl_close(UNUSED_ARG(struct KBlock *, kblk))
+{
+	return 0;
+}
+
+
+static const KBlockVTable nandftl_buffered_vt =
+{
+	.readDirect = nandftl_readDirect,
+	.writeDirect = nandftl_writeDirect,
+
+	.readBuf = kblock_swReadBuf,
+	.writeBuf = kblock_swWriteBuf,
+	.load = kblock_swLoad,
+	.store = kblock_swStore,
+
+	.error = nandftl_error,
+	.clearerr = nandftl_clearError,
+	.close = nandftl_close,
+};
+
+static const KBlockVTable nandftl_unbuffered_vt =
+{
+	.readDirect = nandftl_readDirect,
+	.writeDirect = nandftl_writeDirect,
+
+	.error = nandftl_error,
+	.clearerr = nandftl_clearError,
+	.close = nandftl_close,
+};
+
+
+static bool commonInit(NandFtl *ftl, Nand *chip, struct Heap *heap)
+{
+	memset(ftl, 0, sizeof(NandFtl));
+
+	DB(ftl->fd.priv.type = KBT_NAND_FTL);
+	ftl->fd.blk_size = NAND_BLOCK_SIZE;
+	ftl->fd.blk_cnt  = NAND_FTL_NUM_BLOCKS;
+	ftl->chip = chip;
+
+	ftl->map = heap_allocmem(heap, NAND_FTL_NUM_BLOCKS * sizeof(*ftl->map));
+	ftl->erase_cnt = heap_allocmem(heap, NAND_NUM_USER_BLOCKS * sizeof(*ftl->erase_cnt));
+	ftl->state = heap_allocmem(heap, NAND_NUM_USER_BLOCKS * sizeof(*ftl->state));
+#if CONFIG_NAND_FTL_WL_THRESHOLD > 0
+	ftl->page_buf = heap_allocmem(heap, CONFIG_NAND_DATA_SIZE);
+#endif
+	if (!ftl->map || !ftl->erase_cnt || !ftl->state
+		#if CONFIG_NAND_FTL_WL_THRESHOLD > 0
+			|| !ftl->page_buf
+		#endif
+		)
+	{
+		LOG_ERR("nand_ftl: error allocating tables\n");
+		ftl->status |= NAND_FTL_ERR_NOMEM;
+		return false;
+	}
+
+	mount(ftl);
+	return true;
+}
+
+/**
+ * Initialize the translation layer in buffered mode.
+ *
+ * \param ftl   translation layer context
+ * \param chip  an initialized NAND driver context
+ * \param heap  heap used to allocate the mapping tables and the block buffer
+ */
+bool nandftl_init(NandFtl *ftl, Nand *chip, struct Heap *heap)
+{
+	if (!commonInit(ftl, chip, heap))
+		return false;
+
+	ftl->fd.priv.vt = &nandftl_buffered_vt;
+	ftl->fd.priv.flags |= KB_BUFFERED;
+
+	ftl->fd.priv.buf = heap_allocmem(heap, NAND_BLOCK_SIZE);
+	if (!ftl->fd.priv.buf)
+	{
+		LOG_ERR("nand_ftl: error allocating block buffer\n");
+		ftl->status |= NAND_FTL_ERR_NOMEM;
+		return false;
+	}
+
+	// Load the first block in the cache
+	return nandftl_readDirect(&ftl->fd, 0, ftl->fd.priv.buf, 0, ftl->fd.blk_size);
+}
+
+/**
+ * Initialize the translation layer in unbuffered mode.
+ * Only whole blocks can be written.
+ */
+bool nandftl_initUnbuffered(NandFtl *ftl, Nand *chip, struct Heap *heap)
+{
+	if (!commonInit(ftl, chip, heap))
+		return false;
+
+	ftl->fd.priv.vt = &nandftl_unbuffered_vt;
+	return true;
+}
@@ -0,0 +1,116 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Wear leveling flash translation layer over the NAND driver.
+ *
+ * \see nand_ftl.c for the design notes.
+ *
+ * $WIZ$ module_name = "nand_ftl"
+ * $WIZ$ module_depends = "nand", "kblock", "heap", "rotating_hash"
+ * $WIZ$ module_configuration = "bertos/cfg/cfg_nand_ftl.h"
+ */
+
+#ifndef DRV_NAND_FTL_H
+#define DRV_NAND_FTL_H
+
+#include "cfg/cfg_nand_ftl.h"
+
+#include <drv/nand.h>
+#include <io/kblock.h>
+
+/**
+ * \name Error codes.
+ * Driver errors are or'ed with the ones of the underlying Nand.
+ * \{
+ */
+#define NAND_FTL_ERR_NOSPACE   BV(8)   ///< No good block left for writing
+#define NAND_FTL_ERR_NOMEM     BV(9)   ///< Error allocating tables
+/** \} */
+
+/**
+ * Number of logical blocks exported by the translation layer.
+ */
+#define NAND_FTL_NUM_BLOCKS   (NAND_NUM_USER_BLOCKS - CONFIG_NAND_FTL_RESERVED_BLOCKS)
+
+/**
+ * Translation layer statistics.
+ */
+typedef struct NandFtlStats
+{
+	uint32_t writes;   ///< Logical blocks written by the user.
+	uint32_t erases;   ///< Physical blocks erased.
+	uint32_t moves;    ///< Blocks relocated by static wear leveling.
+	uint16_t bad;      ///< Blocks gone bad at run-time.
+} NandFtlStats;
+
+/**
+ * NAND translation layer context.
+ */
+typedef struct NandFtl
+{
+	KBlock    fd;           ///< KBlock descriptor.
+
+	Nand     *chip;         ///< Underlying NAND.
+	int       status;       ///< Error bitmap.
+
+	uint16_t *map;          ///< Logical to physical block map.
+	uint32_t *erase_cnt;    ///< Erase count of each physical block.
+	uint8_t  *state;        ///< State of each physical block.
+	uint32_t  seq;          ///< Sequence number of the last write.
+	uint8_t  *page_buf;     ///< Buffer for moving blocks.
+
+	NandFtlStats stats;
+} NandFtl;
+
+/*
+ * Kblock id.
+ */
+#define KBT_NAND_FTL  MAKE_ID('N', 'F', 'T', 'L')
+
+/**
+ * Convert + ASSERT from generic KBlock to NAND FTL context.
+ */
+INLINE NandFtl *NAND_FTL_CAST(KBlock *kb)
+{
+	ASSERT(kb->priv.type == KBT_NAND_FTL);
+	return (NandFtl *)kb;
+}
+
+struct Heap;
+
+bool nandftl_init(NandFtl *ftl, Nand *chip, struct Heap *heap);
+bool nandftl_initUnbuffered(NandFtl *ftl, Nand *chip, struct Heap *heap);
+
+int nandftl_gc(NandFtl *ftl, int max_erases);
+void nandftl_eraseCountRange(NandFtl *ftl, uint32_t *min, uint32_t *max);
+
+#endif /* DRV_NAND_FTL_H */
@@ -0,0 +1,308 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief NAND flash translation layer test.
+ *
+ * Runs the translation layer on the RAM NAND simulator: checks
+ * persistence of the mapping, ECC correction and bad block handling,
+ * then compares the erase count distribution and the write amplification
+ * of an hot/cold workload against the plain NAND driver.
+ *
+ * $test$: cp bertos/cfg/cfg_nand.h $cfgdir/
+ * $test$: echo "#undef CONFIG_NAND_PAGES_PER_BLOCK" >> $cfgdir/cfg_nand.h
+ * $test$: echo "#define CONFIG_NAND_PAGES_PER_BLOCK 8" >> $cfgdir/cfg_nand.h
+ * $test$: echo "#undef CONFIG_NAND_NUM_BLOCK" >> $cfgdir/cfg_nand.h
+ * $test$: echo "#define CONFIG_NAND_NUM_BLOCK 64" >> $cfgdir/cfg_nand.h
+ * $test$: echo "#undef CONFIG_NAND_NUM_REMAP_BLOCKS" >> $cfgdir/cfg_nand.h
+ * $test$: echo "#define CONFIG_NAND_NUM_REMAP_BLOCKS 4" >> $cfgdir/cfg_nand.h
+ * $test$: echo "#undef CONFIG_NAND_ECC_SW" >> $cfgdir/cfg_nand.h
+ * $test$: echo "#define CONFIG_NAND_ECC_SW 1" >> $cfgdir/cfg_nand.h
+ * $test$: cp bertos/cfg/cfg_nand_ftl.h $cfgdir/
+ * $test$: echo "#undef CONFIG_NAND_FTL_RESERVED_BLOCKS" >> $cfgdir/cfg_nand_ftl.h
+ * $test$: echo "#define CONFIG_NAND_FTL_RESERVED_BLOCKS 8" >> $cfgdir/cfg_nand_ftl.h
+ * $test$: echo "#undef CONFIG_NAND_FTL_WL_THRESHOLD" >> $cfgdir/cfg_nand_ftl.h
+ * $test$: echo "#define CONFIG_NAND_FTL_WL_THRESHOLD 8" >> $cfgdir/cfg_nand_ftl.h
+ */
+
+#include <drv/nand_ftl.h>
+#include <emul/nand_emul.h>
+
+#include <struct/heap.h>
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+
+#include <string.h>
+
+#define HEAP_SIZE      (64 * 1024)
+#define HOT_BLOCKS     4
+#define HOT_WRITES     1000
+#define FACTORY_BAD    5
+
+HEAP_DEFINE_BUF(heap_buf, HEAP_SIZE);
+static Heap heap;
+
+static Nand chip;
+static NandFtl ftl;
+
+static uint8_t wbuf[NAND_BLOCK_SIZE];
+static uint8_t rbuf[NAND_BLOCK_SIZE];
+
+static void fillPattern(uint8_t *buf, block_idx_t blk, uint32_t gen)
+{
+	for (size_t i = 0; i < NAND_BLOCK_SIZE; i++)
+		buf[i] = (uint8_t)(i * 7 + blk * 31 + gen * 13);
+}
+
+static void mount(void)
+{
+	heap_init(&heap, heap_buf, sizeof(heap_buf));
+	ASSERT(nand_initUnbuffered(&chip, &heap, 0));
+	ASSERT(nandftl_init(&ftl, &chip, &heap));
+}
+
+static void writeBlock(block_idx_t blk, uint32_t gen)
+{
+	fillPattern(wbuf, blk, gen);
+	ASSERT(kblock_write(&ftl.fd, blk, wbuf, 0, NAND_BLOCK_SIZE) == NAND_BLOCK_SIZE);
+	ASSERT(kblock_flush(&ftl.fd) == 0);
+}
+
+static void checkBlock(block_idx_t blk, uint32_t gen)
+{
+	fillPattern(wbuf, blk, gen);
+	ASSERT(kblock_read(&ftl.fd, blk, rbuf, 0, NAND_BLOCK_SIZE) == NAND_BLOCK_SIZE);
+	ASSERT(memcmp(wbuf, rbuf, NAND_BLOCK_SIZE) == 0);
+}
+
+/* Physical NAND block holding a logical block */
+static uint16_t physBlock(block_idx_t blk)
+{
+	return chip.block_map[ftl.map[blk]];
+}
+
+static void maxEraseCount(uint32_t *min, uint32_t *max)
+{
+	*min = UINT32_MAX;
+	*max = 0;
+	for (uint16_t b = 0; b < NAND_NUM_USER_BLOCKS; b++)
+	{
+		if (b == FACTORY_BAD)
+			continue;
+		*min = MIN(*min, nand_emulEraseCount(b));
+		*max = MAX(*max, nand_emulEraseCount(b));
+	}
+}
+
+static void test_persistence(void)
+{
+	block_idx_t b;
+
+	kputs("Write all blocks\n");
+	for (b = 0; b < NAND_FTL_NUM_BLOCKS; b++)
+		writeBlock(b, 0);
+	// Rewrite some to leave stale copies around
+	for (b = 0; b < NAND_FTL_NUM_BLOCKS; b += 3)
+		writeBlock(b, 1);
+
+	kputs("Remount\n");
+	mount();
+	ASSERT(kblock_error(&ftl.fd) == 0);
+	for (b = 0; b < NAND_FTL_NUM_BLOCKS; b++)
+		checkBlock(b, b % 3 == 0 ? 1 : 0);
+
+	// Erased blocks are found free at mount, and not erased again
+	ASSERT(nandftl_gc(&ftl, NAND_NUM_USER_BLOCKS) > 0);
+	mount();
+	ASSERT(nandftl_gc(&ftl, NAND_NUM_USER_BLOCKS) == 0);
+	for (b = 0; b < NAND_FTL_NUM_BLOCKS; b++)
+		checkBlock(b, b % 3 == 0 ? 1 : 0);
+}
+
+static void test_ecc(void)
+{
+	NandEmulStats stats;
+	uint32_t fixed = chip.ecc_fixed;
+
+	kputs("ECC correction\n");
+	nand_emulFlipBit((physBlock(4) * CONFIG_NAND_PAGES_PER_BLOCK) + 2, 100, 3);
+	nand_emulFlipBit((physBlock(4) * CONFIG_NAND_PAGES_PER_BLOCK) + 5, CONFIG_NAND_DATA_SIZE - 1, 7);
+	checkBlock(4, 0);
+	ASSERT(chip.ecc_fixed == fixed + 2);
+
+	// Random transient bit flips
+	nand_emulSetReadDisturb(3);
+	for (block_idx_t b = 0; b < NAND_FTL_NUM_BLOCKS; b++)
+		checkBlock(b, b % 3 == 0 ? 1 : 0);
+	nand_emulSetReadDisturb(0);
+	nand_emulStats(&stats);
+	kprintf("%ld bit flips injected, %ld fixed\n", (long)stats.bit_flips, (long)chip.ecc_fixed);
+	ASSERT(stats.bit_flips > 0);
+	ASSERT(kblock_error(&ftl.fd) == 0);
+}
+
+static void test_badBlocks(void)
+{
+	int marked = 0;
+
+	kputs("Run-time bad blocks\n");
+	// Make some of the unused blocks fail
+	for (uint16_t p = 0; p < NAND_NUM_USER_BLOCKS && marked < 2; p++)
+	{
+		block_idx_t b;
+
+		for (b = 0; b < NAND_FTL_NUM_BLOCKS; b++)
+			if (ftl.map[b] == p)
+				break;
+		if (b == NAND_FTL_NUM_BLOCKS && chip.block_map[p] != FACTORY_BAD)
+		{
+			nand_emulSetBadBlock(chip.block_map[p]);
+			marked++;
+		}
+	}
+
+	for (uint32_t gen = 2; gen < 2 + 4 * CONFIG_NAND_FTL_RESERVED_BLOCKS; gen++)
+	{
+		writeBlock(0, gen);
+		nandftl_gc(&ftl, 1);
+	}
+	kprintf("%d blocks retired\n", ftl.stats.bad);
+	ASSERT(ftl.stats.bad == 2);
+	ASSERT(kblock_error(&ftl.fd) == 0);
+	checkBlock(0, 1 + 4 * CONFIG_NAND_FTL_RESERVED_BLOCKS);
+
+	mount();
+	checkBlock(0, 1 + 4 * CONFIG_NAND_FTL_RESERVED_BLOCKS);
+	checkBlock(1, 0);
+}
+
+/*
+ * Hot/cold workload: few blocks are rewritten continuously, the others
+ * hold static data.
+ */
+static void hotCold(KBlock *kb, void (*idle)(void))
+{
+	for (block_idx_t b = 0; b < NAND_FTL_NUM_BLOCKS; b++)
+	{
+		fillPattern(wbuf, b, 0);
+		ASSERT(kblock_write(kb, b, wbuf, 0, NAND_BLOCK_SIZE) == NAND_BLOCK_SIZE);
+	}
+	for (uint32_t i = 0; i < HOT_WRITES; i++)
+	{
+		block_idx_t b = i % HOT_BLOCKS;
+
+		fillPattern(wbuf, b, i);
+		ASSERT(kblock_write(kb, b, wbuf, 0, NAND_BLOCK_SIZE) == NAND_BLOCK_SIZE);
+		if (idle)
+			idle();
+	}
+	ASSERT(kblock_flush(kb) == 0);
+	for (block_idx_t b = HOT_BLOCKS; b < NAND_FTL_NUM_BLOCKS; b++)
+	{
+		fillPattern(wbuf, b, 0);
+		ASSERT(kblock_read(kb, b, rbuf, 0, NAND_BLOCK_SIZE) == NAND_BLOCK_SIZE);
+		ASSERT(memcmp(wbuf, rbuf, NAND_BLOCK_SIZE) == 0);
+	}
+}
+
+static void ftlIdle(void)
+{
+	nandftl_gc(&ftl, 1);
+}
+
+static void report(const char *name, uint32_t *max_cnt)
+{
+	NandEmulStats stats;
+	uint32_t min, max;
+	uint32_t host_pages = (NAND_FTL_NUM_BLOCKS + HOT_WRITES) * CONFIG_NAND_PAGES_PER_BLOCK;
+
+	nand_emulStats(&stats);
+	maxEraseCount(&min, &max);
+	/* Each page is programmed twice by the driver: data and spare area */
+	kprintf("%s: erase count min %ld max %ld, erases %ld, write amplification %ld.%02ld\n",
+		name, (long)min, (long)max, (long)stats.block_erases,
+		(long)(stats.page_programs / 2 / host_pages),
+		(long)((stats.page_programs / 2 * 100 / host_pages) % 100));
+	*max_cnt = max;
+}
+
+static void test_wear(void)
+{
+	uint32_t raw_max, ftl_max;
+	uint32_t min, max;
+
+	kputs("Hot/cold workload on plain NAND\n");
+	nand_emulReset();
+	nand_emulSetBadBlock(FACTORY_BAD);
+	heap_init(&heap, heap_buf, sizeof(heap_buf));
+	ASSERT(nand_init(&chip, &heap, 0));
+	hotCold(&chip.fd, NULL);
+	report("nand", &raw_max);
+
+	kputs("Hot/cold workload on translation layer\n");
+	nand_emulReset();
+	nand_emulSetBadBlock(FACTORY_BAD);
+	mount();
+	hotCold(&ftl.fd, ftlIdle);
+	report("nand_ftl", &ftl_max);
+	nandftl_eraseCountRange(&ftl, &min, &max);
+	kprintf("nand_ftl: %ld moves, erase count spread %ld\n", (long)ftl.stats.moves, (long)(max - min));
+
+	ASSERT(ftl_max * 4 < raw_max);
+	ASSERT(max - min <= 2 * CONFIG_NAND_FTL_WL_THRESHOLD);
+	ASSERT(kblock_error(&ftl.fd) == 0);
+}
+
+int nand_ftl_testSetup(void)
+{
+	kdbg_init();
+	nand_emulReset();
+	nand_emulSetBadBlock(FACTORY_BAD);
+	mount();
+	return 0;
+}
+
+int nand_ftl_testRun(void)
+{
+	test_persistence();
+	test_ecc();
+	test_badBlocks();
+	test_wear();
+	return 0;
+}
+
+int nand_ftl_testTearDown(void)
+{
+	return kblock_close(&ftl.fd);
+}
+
+TEST_MAIN(nand_ftl);
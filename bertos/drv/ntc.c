@@ -85,11 +85,11 @@ static size_t upper_bound(const res_t *orig_table, size_t size, res_t val)
 
 
 /**
- * Read the temperature for the NTC channel \a dev.
- * First read the resistence of the NTC through ntc_hw_read(), then,
- * for the conversion from resistance to temperature, since the formula
- * varies from device to device, we implemented a generic system using
- * a table of data which maps temperature (index) to resistance (data).
+ * Convert the resistance \a rx of a NTC described by \a hw to temperature.
+ *
+ * Since the formula varies from device to device, we implemented a generic
+ * system using a table of data which maps temperature (index) to
+ * resistance (data).
  * The range of the table (min/max temperature) and the step
  * (temperature difference between two consecutive elements of the table)
  * is variable and can be specified. Notice that values inbetween the
@@ -97,21 +97,15 @@ static size_t upper_bound(const res_t *orig_table, size_t size, res_t val)
  * interpolation using the actual calculated resistance to find out
  * the exact temperature.
  *
- * The low-level API provides a function to get access to a description
- * of the NTC (ntc_hw_getInfo()), including the resistance table.
- *
+ * The interpolation is in fixed point: with the reciprocals of the table
+ * intervals (see NtcHwInfo) it is a multiply and a shift, otherwise a 32 bit
+ * division.
  */
-deg_t ntc_read(NtcDev dev)
+deg_t ntc_convert(const NtcHwInfo *hw, res_t rx)
 {
-	const NtcHwInfo* hw = ntc_hw_getInfo(dev);
 	const res_t* r = hw->resistances;
-
-	res_t rx;
 	size_t i;
-	deg_t degrees = 0;
-
-	rx = ntc_hw_read(dev);
-
+	uint32_t tmp;
 
 	i = upper_bound(r, hw->num_resistances, rx);
 	ASSERT(i <= hw->num_resistances);
@@ -127,19 +121,43 @@ deg_t ntc_read(NtcDev dev)
 	 * ----------  = ----------------
 	 * (rx - r[i])   (r[i-1] - r [i])
 	 */
-	float tmp;
-	tmp = 10 * hw->degrees_step * (rx - r[i]) / (r[i - 1] - r[i]);
+	res_t num = rx - r[i];
+	if (hw->recip)
+		tmp = (num * hw->recip[i]) >> hw->recip_shift;
+	else
+	{
+		res_t den = r[i - 1] - r[i];
+
+		/* Scale down to keep the product in 32 bits */
+		ASSERT(hw->degrees_step < 3276);
+		while (den > 0xFFFF)
+		{
+			num >>= 1;
+			den >>= 1;
+		}
+		tmp = (10 * hw->degrees_step * num) / den;
+	}
 
 	/*
 	 * degrees = integer part corresponding to the superior index
 	 *           in the table multiplied by 10
 	 *           - decimal part interpolated (already multiplied by 10)
 	 */
-	degrees = (i * hw->degrees_step + hw->degrees_min) * 10 - (int)(tmp);
-
-	//kprintf("dev= %d, I=%d, degrees = %d\n", dev, i , degrees);
+	return (i * hw->degrees_step + hw->degrees_min) * 10 - (deg_t)tmp;
+}
 
-	return degrees;
+/**
+ * Read the temperature for the NTC channel \a dev.
+ * First read the resistence of the NTC through ntc_hw_read(), then
+ * convert it with ntc_convert().
+ *
+ * The low-level API provides a function to get access to a description
+ * of the NTC (ntc_hw_getInfo()), including the resistance table.
+ *
+ */
+deg_t ntc_read(NtcDev dev)
+{
+	return ntc_convert(ntc_hw_getInfo(dev), ntc_hw_read(dev));
 }
 
 
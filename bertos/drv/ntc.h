@@ -72,13 +72,25 @@ typedef float    amp_t; /** type for defining amplifications  amp_t = A, where A
 DB(extern bool ntc_initialized;)
 
 
-/** Describe a NTC chip */
+/**
+ * Describe a NTC chip.
+ *
+ * \a recip is optional: when present, recip[i] is
+ * ((10 * degrees_step) << recip_shift) / (resistances[i - 1] - resistances[i])
+ * rounded up, and ntc_read() interpolates with a multiply and a shift
+ * instead of a division. \a recip_shift must keep the products of the
+ * interpolation, less than ((10 * degrees_step) << recip_shift) plus the
+ * interval, within 32 bits. test/gen_ntc_table.py generates the whole structure out of
+ * the NTC datasheet.
+ */
 typedef struct NtcHwInfo
 {
 	const res_t *resistances; ///< resistances of the NTC (ohms * 100)
 	size_t num_resistances;   ///< number of resistances
-	deg_t degrees_min;        ///< degrees corresponding to the first entry in the table (celsius * 10)
-	deg_t degrees_step;       ///< difference in degrees between two consecutive elements in the table (celsius * 10)
+	deg_t degrees_min;        ///< degrees corresponding to the first entry in the table (celsius)
+	deg_t degrees_step;       ///< difference in degrees between two consecutive elements in the table (celsius)
+	const uint32_t *recip;    ///< reciprocals of the table intervals, or NULL
+	uint8_t recip_shift;      ///< fixed point format of \a recip
 } NtcHwInfo;
 
 /** Initialize the NTC module */
@@ -87,4 +99,10 @@ void ntc_init(void);
 /** Read a single temperature value from the NTC */
 deg_t ntc_read(NtcDev dev);
 
+deg_t ntc_convert(const NtcHwInfo *hw, res_t rx);
+
+int ntc_testSetup(void);
+int ntc_testRun(void);
+int ntc_testTearDown(void);
+
 #endif /* DRV_NTC_H */
@@ -0,0 +1,222 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Test the NTC conversion.
+ *
+ * Check the fixed point conversions (with and without the reciprocal
+ * table) and the evenly spaced ADC table against the floating point
+ * conversion of the same NTC, and compare their speed.
+ * The hw/hw_ntc.h of the tree needs an ADC, so it is replaced by a stub
+ * returning the resistance under test.
+ *
+ * $test$: mkdir -p $testdir/hw
+ * $test$: echo '#include <drv/ntc.h>' > $testdir/hw/hw_ntc.h
+ * $test$: echo 'res_t ntc_hw_read(NtcDev dev);' >> $testdir/hw/hw_ntc.h
+ * $test$: echo 'const NtcHwInfo *ntc_hw_getInfo(NtcDev dev);' >> $testdir/hw/hw_ntc.h
+ * $test$: echo '#define NTC_HW_INIT do { } while (0)' >> $testdir/hw/hw_ntc.h
+ * $test$: python test/gen_ntc_table.py -n ntc_test_info -b 3950 -r 10000 -a 10:10000:100000:1:3 -o $testdir/ntc_test_table.c
+ */
+
+/* Built with the stub hw/hw_ntc.h, see above */
+#include "drv/ntc.c"
+#include "ntc_test_table.c"
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+#include <cfg/macros.h> // MAX(), ABS()
+
+#include <algo/table.h>
+
+#include <os/hptime.h>
+
+/* The NTC generated by the $test$ line above */
+#define RSER      10000.0
+#define RPAR      100000.0
+#define ADC_BITS  10
+
+static res_t test_res;
+
+res_t ntc_hw_read(UNUSED_ARG(NtcDev, dev))
+{
+	return test_res;
+}
+
+const NtcHwInfo *ntc_hw_getInfo(UNUSED_ARG(NtcDev, dev))
+{
+	return &ntc_test_info;
+}
+
+/* The conversion of ntc_read() before fixed point */
+static deg_t ntc_convertFloat(const NtcHwInfo *hw, res_t rx)
+{
+	const res_t *r = hw->resistances;
+	size_t i = upper_bound(r, hw->num_resistances, rx);
+
+	if (i >= hw->num_resistances)
+		return NTC_SHORT_CIRCUIT;
+	else if (i == 0)
+		return NTC_OPEN_CIRCUIT;
+
+	float tmp = 10.0f * hw->degrees_step * (rx - r[i]) / (r[i - 1] - r[i]);
+	return (i * hw->degrees_step + hw->degrees_min) * 10 - (int)tmp;
+}
+
+/* NTC resistance (ohm * 100) read by the ADC, from hw/hw_ntc.h */
+static res_t adcToRes(int adc)
+{
+	float rp = (adc * RSER) / ((1 << ADC_BITS) - adc);
+
+	return (RPAR * rp) / (RPAR - rp) * 100;
+}
+
+static int accuracy(void)
+{
+	NtcHwInfo div = ntc_test_info;
+	const res_t *r = ntc_test_info.resistances;
+	size_t n = ntc_test_info.num_resistances;
+	int err_div = 0, err_recip = 0;
+
+	div.recip = NULL;
+
+	/* Out of the table */
+	ASSERT(ntc_convert(&div, r[0] + 1) == NTC_OPEN_CIRCUIT);
+	ASSERT(ntc_convert(&ntc_test_info, r[0] + 1) == NTC_OPEN_CIRCUIT);
+	ASSERT(ntc_convert(&div, r[n - 1] - 1) == NTC_SHORT_CIRCUIT);
+	ASSERT(ntc_convert(&ntc_test_info, r[n - 1] - 1) == NTC_SHORT_CIRCUIT);
+
+	/* Every interval, including its ends */
+	for (size_t i = 1; i < n; ++i)
+	{
+		for (res_t rx = r[i] + 1; rx <= r[i - 1]; rx += (r[i - 1] - r[i]) / 1000 + 1)
+		{
+			deg_t ref = ntc_convertFloat(&ntc_test_info, rx);
+
+			err_div = MAX(err_div, ABS(ntc_convert(&div, rx) - ref));
+			err_recip = MAX(err_recip, ABS(ntc_convert(&ntc_test_info, rx) - ref));
+		}
+	}
+
+	/* Going through the driver */
+	test_res = 1000000;
+	ASSERT(ntc_read(NTC_TEST) == 250);
+
+	/*
+	 * The ADC table against float hw read and conversion, over the table
+	 * range: they differ mostly for the error of the linear interpolation
+	 * of the resistance table, sampled every 5 C.
+	 */
+	int err_adc = 0;
+	for (int adc = 0; adc < (1 << ADC_BITS); ++adc)
+	{
+		res_t rx = adcToRes(adc);
+		if (rx >= r[0] || rx <= r[n - 1])
+			continue;
+
+		deg_t ref = ntc_convertFloat(&ntc_test_info, rx);
+		err_adc = MAX(err_adc, ABS(table_evenInterpolation(&ntc_test_info_adc, adc) - ref));
+	}
+
+	kprintf("max error vs float (0.1 C): division %d, reciprocal %d, ADC table %d\n",
+		err_div, err_recip, err_adc);
+
+	/* Fixed point may round the other way, the two tables may differ by 1 C */
+	if (err_div > 1 || err_recip > 1 || err_adc > 10)
+		return -1;
+	return 0;
+}
+
+#define BENCH_LOOPS 200
+#define BENCH_SAMPLES 256
+
+static res_t bench_res[BENCH_SAMPLES];
+static int bench_adc[BENCH_SAMPLES];
+
+/* Average ns per conversion */
+#define BENCH(expr) \
+	({ \
+		hptime_t start = hptime_get(); \
+		for (int j = 0; j < BENCH_LOOPS; ++j) \
+			for (int i = 0; i < BENCH_SAMPLES; ++i) \
+				sink += (expr); \
+		(long)((hptime_get() - start) * 1000 / (BENCH_LOOPS * BENCH_SAMPLES)); \
+	})
+
+static void benchmark(void)
+{
+	NtcHwInfo div = ntc_test_info;
+	volatile long sink = 0;
+
+	div.recip = NULL;
+	for (int i = 0; i < BENCH_SAMPLES; ++i)
+	{
+		/* Over the whole range of the NTC */
+		bench_adc[i] = 40 + i * 3;
+		bench_res[i] = adcToRes(bench_adc[i]);
+	}
+
+	long t_float = BENCH(ntc_convertFloat(&ntc_test_info, bench_res[i]));
+	long t_div = BENCH(ntc_convert(&div, bench_res[i]));
+	long t_recip = BENCH(ntc_convert(&ntc_test_info, bench_res[i]));
+	long t_hw = BENCH(ntc_convert(&ntc_test_info, adcToRes(bench_adc[i])));
+	long t_adc = BENCH(table_evenInterpolation(&ntc_test_info_adc, bench_adc[i]));
+
+	kprintf("resistance to deg (host ns): float %ld ns, division %ld ns, reciprocal %ld ns\n",
+		t_float, t_div, t_recip);
+	kprintf("ADC to deg (host ns): float hw read + reciprocal %ld ns, ADC table %ld ns\n", t_hw, t_adc);
+}
+
+int ntc_testRun(void)
+{
+	if (accuracy())
+	{
+		kprintf("ntc_test failed\n");
+		return -1;
+	}
+
+	benchmark();
+	kprintf("ntc_test successful\n");
+	return 0;
+}
+
+int ntc_testSetup(void)
+{
+	kdbg_init();
+	ntc_init();
+	return 0;
+}
+
+int ntc_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(ntc);
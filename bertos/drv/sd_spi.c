@@ -66,6 +66,21 @@ struct SdHardware
 #define TIMEOUT_NAC   16384
 #define SD_BUSY_TIMEOUT ms_to_ticks(200)
 
+static bool sd_waitReady(Sd *sd)
+{
+	ticks_t start = timer_clock();
+	do
+	{
+		if (kfile_getc(sd->ch) == 0xff)
+			return true;
+
+		cpu_relax();
+	}
+	while (timer_clock() - start < SD_BUSY_TIMEOUT);
+
+	return false;
+}
+
 static bool sd_select(Sd *sd, bool state)
 {
 	KFile *fd = sd->ch;
@@ -74,15 +89,8 @@ static bool sd_select(Sd *sd, bool state)
 	{
 		SD_CS_ON();
 
-		ticks_t start = timer_clock();
-		do
-		{
-			if (kfile_getc(fd) == 0xff)
-				return true;
-
-			cpu_relax();
-		}
-		while (timer_clock() - start < SD_BUSY_TIMEOUT);
+		if (sd_waitReady(sd))
+			return true;
 
 		SD_CS_OFF();
 		LOG_ERR("sd_select timeout\n");
@@ -111,6 +119,8 @@ static int16_t sd_waitR1(Sd *sd)
 	return EOF;
 }
 
+#define SD_STOP_TRANSMISSION 0x4C
+
 static int16_t sd_sendCommand(Sd *sd, uint8_t cmd, uint32_t param, uint8_t crc)
 {
 	KFile *fd = sd->ch;
@@ -125,6 +135,10 @@ static int16_t sd_sendCommand(Sd *sd, uint8_t cmd, uint32_t param, uint8_t crc)
 
 	kfile_putc(crc, fd);
 
+	/* The byte following a stop command is a stuff byte: skip it */
+	if (cmd == SD_STOP_TRANSMISSION)
+		kfile_getc(fd);
+
 	return sd_waitR1(sd);
 }
 
@@ -323,6 +337,122 @@ static size_t sd_SpiWriteDirect(KBlock *b, block_idx_t idx, const void *buf, siz
 	return SD_DEFAULT_BLOCKLEN;
 }
 
+#define SD_READ_MULTIBLOCK   0x52
+#define SD_WRITE_MULTIBLOCK  0x59
+#define SD_MULTI_STARTTOKEN  0xFC
+#define SD_MULTI_STOPTOKEN   0xFD
+
+static bool sd_setDefaultBlockLen(Sd *sd)
+{
+	if (sd->hw->tranfer_len != SD_DEFAULT_BLOCKLEN)
+	{
+		if ((sd->status = sd_setBlockLen(sd, SD_DEFAULT_BLOCKLEN)))
+		{
+			LOG_ERR("setBlockLen failed: %08lX\n", sd->status);
+			return false;
+		}
+		sd->hw->tranfer_len = SD_DEFAULT_BLOCKLEN;
+	}
+	return true;
+}
+
+/*
+ * Read a run of blocks with a single READ_MULTIPLE_BLOCK command,
+ * avoiding the command/response round trip for every block.
+ */
+static block_idx_t sd_SpiReadRange(KBlock *b, block_idx_t idx, void *buf, block_idx_t count)
+{
+	Sd *sd = SD_CAST(b);
+	uint8_t *p = (uint8_t *)buf;
+	block_idx_t done;
+
+	LOG_INFO("reading %ld blocks from %ld\n", count, idx);
+	if (!sd_setDefaultBlockLen(sd))
+		return 0;
+
+	if (!sd_select(sd, true))
+		return 0;
+
+	sd->status = sd_sendCommand(sd, SD_READ_MULTIBLOCK, idx * SD_DEFAULT_BLOCKLEN, 0);
+	if (sd->status)
+	{
+		LOG_ERR("read multiple block failed: %08lX\n", sd->status);
+		sd_select(sd, false);
+		return 0;
+	}
+
+	for (done = 0; done < count; done++, p += SD_DEFAULT_BLOCKLEN)
+		if (!sd_getBlock(sd, p, SD_DEFAULT_BLOCKLEN))
+		{
+			LOG_ERR("read multiple block failed at block %ld\n", idx + done);
+			break;
+		}
+
+	if ((sd->status = sd_sendCommand(sd, SD_STOP_TRANSMISSION, 0, 0)))
+		LOG_ERR("stop transmission failed: %08lX\n", sd->status);
+
+	sd_select(sd, false);
+	return done;
+}
+
+/*
+ * Write a run of blocks with a single WRITE_MULTIPLE_BLOCK command,
+ * so the card can program them without closing the transfer each time.
+ */
+static block_idx_t sd_SpiWriteRange(KBlock *b, block_idx_t idx, const void *buf, block_idx_t count)
+{
+	Sd *sd = SD_CAST(b);
+	KFile *fd = sd->ch;
+	const uint8_t *p = (const uint8_t *)buf;
+	block_idx_t done;
+
+	LOG_INFO("writing %ld blocks from %ld\n", count, idx);
+	if (!sd_setDefaultBlockLen(sd))
+		return 0;
+
+	if (!sd_select(sd, true))
+		return 0;
+
+	sd->status = sd_sendCommand(sd, SD_WRITE_MULTIBLOCK, idx * SD_DEFAULT_BLOCKLEN, 0);
+	if (sd->status)
+	{
+		LOG_ERR("write multiple block failed: %08lX\n", sd->status);
+		sd_select(sd, false);
+		return 0;
+	}
+
+	for (done = 0; done < count; done++, p += SD_DEFAULT_BLOCKLEN)
+	{
+		kfile_putc(SD_MULTI_STARTTOKEN, fd);
+		kfile_write(fd, p, SD_DEFAULT_BLOCKLEN);
+		/* send fake crc */
+		kfile_putc(0, fd);
+		kfile_putc(0, fd);
+
+		uint8_t dataresp = kfile_getc(fd);
+		if ((dataresp & 0x1f) != SD_DATA_ACCEPTED)
+		{
+			LOG_ERR("write block %ld failed: %02X\n", idx + done, dataresp);
+			break;
+		}
+
+		if (!sd_waitReady(sd))
+		{
+			LOG_ERR("write block %ld timeout\n", idx + done);
+			break;
+		}
+	}
+
+	kfile_putc(SD_MULTI_STOPTOKEN, fd);
+	/* Skip one byte before the card asserts busy */
+	kfile_getc(fd);
+	if (!sd_waitReady(sd))
+		LOG_ERR("stop token timeout\n");
+
+	sd_select(sd, false);
+	return done;
+}
+
 static int sd_SpiError(KBlock *b)
 {
 	Sd *sd = SD_CAST(b);
@@ -431,6 +561,8 @@ static const KBlockVTable sd_unbuffered_vt =
 {
 	.readDirect = sd_SpiReadDirect,
 	.writeDirect = sd_SpiWriteDirect,
+	.readRange = sd_SpiReadRange,
+	.writeRange = sd_SpiWriteRange,
 
 	.error = sd_SpiError,
 	.clearerr = sd_SpiClearerr,
@@ -440,6 +572,8 @@ static const KBlockVTable sd_buffered_vt =
 {
 	.readDirect = sd_SpiReadDirect,
 	.writeDirect = sd_SpiWriteDirect,
+	.readRange = sd_SpiReadRange,
+	.writeRange = sd_SpiWriteRange,
 
 	.readBuf = kblock_swReadBuf,
 	.writeBuf = kblock_swWriteBuf,
@@ -165,7 +165,12 @@ static void stepper_accel(struct Stepper *motor)
 
 	ASSERT(motor->rampClock != 0);
 
-	motor->rampValue = ramp_evaluate(ramp, motor->rampClock);
+#if !RAMP_USE_FLOATING_POINT
+	if (motor->rampStep < ramp->table.len)
+		motor->rampValue = ramp_tableNext(ramp, motor->rampStep, motor->rampValue);
+	else
+#endif
+		motor->rampValue = ramp_evaluate(ramp, motor->rampClock);
 	motor->rampClock += motor->rampValue;
 	motor->rampStep++;
 
@@ -184,7 +189,21 @@ static void stepper_decel(struct Stepper *motor)
 
 	motor->rampClock -= motor->rampValue;
 	ASSERT(motor->rampClock != 0);
-	motor->rampValue = ramp_evaluate(ramp, motor->rampClock);
+#if !RAMP_USE_FLOATING_POINT
+	/*
+	 * Within the table, walk back the same intervals used to accelerate.
+	 * When coming back into it, resync with the exact clock of its end.
+	 */
+	if (motor->rampStep > 0 && motor->rampStep <= ramp->table.len)
+		motor->rampValue = ramp_tablePrev(ramp, motor->rampStep, motor->rampValue);
+	else if (motor->rampStep == ramp->table.len + 1 && ramp->table.len)
+	{
+		motor->rampClock = ramp->table.end_clock;
+		motor->rampValue = ramp->table.last;
+	}
+	else
+#endif
+		motor->rampValue = ramp_evaluate(ramp, motor->rampClock);
 	motor->rampStep--;
 	DB(ASSERT(!old_val || motor->rampValue >= old_val););
 }
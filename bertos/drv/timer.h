@@ -222,6 +222,25 @@ INLINE utime_t hptime_to_us(hptime_t hpticks)
 #endif /* TIMER_HW_HPTICKS_PER_SEC < 100000UL */
 }
 
+/**
+ * High precision clock for time measurements [hpticks].
+ *
+ * On the target the system tick count is extended with the position of
+ * the hardware counter inside the current tick, hosted builds read the
+ * host clock.  The value wraps around, so only differences between two
+ * readings are meaningful.
+ *
+ * Like timer_clock_unlocked(), it must be called with the timer interrupt
+ * disabled.  This is a macro since not every CPU timer driver
+ * provides timer_hw_hpread().
+ */
+#if OS_HOSTED
+	#define timer_hpclock_unlocked()  ((uint32_t)hptime_get())
+#else
+	#define timer_hpclock_unlocked() \
+		((uint32_t)timer_clock_unlocked() * TIMER_HW_CNT + (uint32_t)timer_hw_hpread())
+#endif
+
 void timer_delayTicks(ticks_t delay);
 /**
  * Wait some time [ms].
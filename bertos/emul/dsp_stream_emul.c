@@ -0,0 +1,132 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Simulated sample clocks for the streaming DSP pipeline.
+ */
+
+#include "dsp_stream_emul.h"
+
+#include <cfg/debug.h>
+#include <cfg/macros.h>
+
+#include <string.h>
+
+/* Time since start at which input sample \a n is captured */
+static hptime_t dsp_stream_emulSampleTime(DspStreamEmul *e, uint32_t n)
+{
+	return (hptime_t)n * HPTIME_TICKS_PER_SECOND / e->in_rate;
+}
+
+static size_t dsp_stream_emulProbe(DspStage *stage, DspBuf *buf)
+{
+	DspStreamEmul *e = containerof(stage, DspStreamEmul, probe);
+	hptime_t lat = hptime_get() - e->start
+		- dsp_stream_emulSampleTime(e, (buf->seq + 1) * e->in_samples);
+
+	e->lat_min = e->lat_count ? MIN(e->lat_min, lat) : lat;
+	e->lat_max = e->lat_count ? MAX(e->lat_max, lat) : lat;
+	e->lat_sum += lat;
+	e->lat_count++;
+
+	return buf->len;
+}
+
+static void dsp_stream_emulTick(iptr_t data)
+{
+	DspStreamEmul *e = (DspStreamEmul *)data;
+	hptime_t now;
+
+	if (!e->running)
+		return;
+	now = hptime_get() - e->start;
+
+	/* Complete the buffers filled by the input clock */
+	while (dsp_stream_emulSampleTime(e, (e->in_count + 1) * e->in_samples) <= now)
+	{
+		e->source(e, e->in->data, e->in_samples, e->in_count * e->in_samples);
+		e->in = dsp_stream_produce(e->s, e->in, e->in_samples * sizeof(uint16_t));
+		e->in_count++;
+	}
+
+	/* Play the processed buffers, or a buffer time of silence */
+	while (e->out_end <= now)
+	{
+		e->out = dsp_stream_consume(e->s, e->out);
+		if (e->out)
+		{
+			e->sink(e, e->out);
+			e->out_end += (hptime_t)(e->out->len / sizeof(uint16_t))
+				* HPTIME_TICKS_PER_SECOND / e->out_rate;
+		}
+		else
+			e->out_end += e->buf_time;
+	}
+
+	timer_add(&e->timer);
+}
+
+void dsp_stream_emulInit(DspStreamEmul *e, DspStream *s,
+	uint32_t in_rate, size_t in_samples, uint32_t out_rate, mtime_t out_delay,
+	dsp_emul_source_t source, dsp_emul_sink_t sink)
+{
+	ASSERT(in_rate && out_rate && in_samples);
+	ASSERT(source && sink);
+
+	memset(e, 0, sizeof(*e));
+	e->s = s;
+	e->source = source;
+	e->sink = sink;
+	e->in_rate = in_rate;
+	e->out_rate = out_rate;
+	e->in_samples = in_samples;
+	e->buf_time = dsp_stream_emulSampleTime(e, in_samples);
+	e->out_end = (hptime_t)out_delay * HPTIME_TICKS_PER_MILLISEC;
+	e->probe.process = dsp_stream_emulProbe;
+
+	timer_setDelay(&e->timer, 1);
+	timer_setSoftint(&e->timer, dsp_stream_emulTick, (iptr_t)e);
+}
+
+void dsp_stream_emulStart(DspStreamEmul *e)
+{
+	e->in = dsp_stream_produce(e->s, NULL, 0);
+	ASSERT(e->in);
+	e->start = hptime_get();
+	e->running = true;
+	timer_add(&e->timer);
+}
+
+void dsp_stream_emulStop(DspStreamEmul *e)
+{
+	e->running = false;
+	timer_abort(&e->timer);
+}
@@ -0,0 +1,128 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Simulated sample clocks for the streaming DSP pipeline (interface).
+ *
+ * Emulates the producer and the sink DMA drivers of a DspStream
+ * (io/dsp_stream.h) on the host. A system timer checks the elapsed time
+ * at every tick and completes the input buffers that a sample clock of
+ * the given rate would have filled by then; the samples come from a
+ * generator callback. On the output side, each processed buffer is
+ * played for the time it takes at the output sample rate, then it is
+ * returned to the stream and the next one is taken.
+ *
+ * Appending the \c probe stage at the end of the processing chain
+ * measures the latency from the capture of the last sample of each buffer
+ * to the end of its processing. Buffers are completed on timer ticks, so
+ * the latency includes up to a tick of delay that a real DMA would not
+ * have.
+ */
+
+#ifndef EMUL_DSP_STREAM_EMUL_H
+#define EMUL_DSP_STREAM_EMUL_H
+
+#include <io/dsp_stream.h>
+
+#include <drv/timer.h>
+
+#include <os/hptime.h>
+
+#include <cfg/compiler.h>
+
+struct DspStreamEmul;
+
+/**
+ * Fill \a buf with \a n input samples, the first one being the sample
+ * number \a first since the start of the clock.
+ */
+typedef void (*dsp_emul_source_t)(struct DspStreamEmul *e, void *buf, size_t n, uint32_t first);
+
+/**
+ * Output the processed buffer \a buf, when the sink starts playing it.
+ */
+typedef void (*dsp_emul_sink_t)(struct DspStreamEmul *e, const DspBuf *buf);
+
+/**
+ * Emulated producer and sink.
+ */
+typedef struct DspStreamEmul
+{
+	DspStream *s;
+	Timer timer;
+	dsp_emul_source_t source;
+	dsp_emul_sink_t sink;
+
+	uint32_t in_rate;      ///< Input sample rate, Hz
+	uint32_t out_rate;     ///< Output sample rate, Hz
+	size_t in_samples;     ///< Samples per input buffer
+
+	hptime_t start;        ///< Start of the sample clocks
+	hptime_t buf_time;     ///< Duration of an input buffer
+	DspBuf *in;            ///< Buffer being filled
+	uint32_t in_count;     ///< Input buffers completed
+	DspBuf *out;           ///< Buffer being played
+	hptime_t out_end;      ///< End of the buffer being played, since start
+
+	DspStage probe;        ///< Latency measurement stage
+
+	/* Latency from the last sample of a buffer to the end of the chain */
+	hptime_t lat_min;
+	hptime_t lat_max;
+	hptime_t lat_sum;
+	uint32_t lat_count;
+
+	volatile bool running;
+} DspStreamEmul;
+
+/**
+ * Initialize the emulated drivers of stream \a s.
+ *
+ * \param in_rate Input sample rate, Hz.
+ * \param in_samples Number of 16 bit samples per input buffer.
+ * \param out_rate Output sample rate, Hz.
+ * \param out_delay Time the sink waits before taking the first buffer, ms.
+ */
+void dsp_stream_emulInit(DspStreamEmul *e, DspStream *s,
+	uint32_t in_rate, size_t in_samples, uint32_t out_rate, mtime_t out_delay,
+	dsp_emul_source_t source, dsp_emul_sink_t sink);
+
+/**
+ * Start the sample clocks.
+ */
+void dsp_stream_emulStart(DspStreamEmul *e);
+
+/**
+ * Stop the sample clocks.
+ */
+void dsp_stream_emulStop(DspStreamEmul *e);
+
+#endif /* EMUL_DSP_STREAM_EMUL_H */
@@ -0,0 +1,268 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief RAM backed NAND simulator.
+ *
+ * Command decoding follows what drv/nand.c sends through nand_sendCommand():
+ * page reads and writes start at the given column and use the data buffer
+ * returned by nand_dataBuffer() from its beginning.
+ * Program operations can only clear bits, like real NAND cells.
+ * The chip content is kept across driver re-initializations, in order to
+ * simulate power cycles.
+ *
+ */
+
+#include "nand_emul.h"
+
+#include <drv/nand.h>
+
+#include <cfg/debug.h>
+#include <cfg/macros.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define NAND_EMUL_PAGES   ((uint32_t)CONFIG_NAND_NUM_BLOCK * CONFIG_NAND_PAGES_PER_BLOCK)
+
+static uint8_t *nand_mem;
+static uint8_t nand_buf[NAND_PAGE_SIZE];
+static uint32_t erase_cnt[CONFIG_NAND_NUM_BLOCK];
+static bool bad_block[CONFIG_NAND_NUM_BLOCK];
+
+static NandEmulStats stats;
+static uint32_t read_disturb;
+
+static uint8_t chip_status;
+static uint32_t write_page;
+static uint16_t write_col;
+
+INLINE uint8_t *pageAddr(uint32_t page)
+{
+	ASSERT(page < NAND_EMUL_PAGES);
+	return nand_mem + page * NAND_PAGE_SIZE;
+}
+
+static void eraseBlock(uint16_t blk)
+{
+	memset(pageAddr((uint32_t)blk * CONFIG_NAND_PAGES_PER_BLOCK), 0xff,
+		(size_t)CONFIG_NAND_PAGES_PER_BLOCK * NAND_PAGE_SIZE);
+}
+
+static void allocMem(void)
+{
+	if (!nand_mem)
+	{
+		nand_mem = (uint8_t *)malloc(NAND_EMUL_PAGES * NAND_PAGE_SIZE);
+		ASSERT(nand_mem);
+		nand_emulReset();
+	}
+}
+
+void nand_emulReset(void)
+{
+	allocMem();
+	for (uint16_t blk = 0; blk < CONFIG_NAND_NUM_BLOCK; blk++)
+	{
+		eraseBlock(blk);
+		erase_cnt[blk] = 0;
+		bad_block[blk] = false;
+	}
+	memset(&stats, 0, sizeof(stats));
+	read_disturb = 0;
+}
+
+void nand_emulStats(NandEmulStats *s)
+{
+	*s = stats;
+}
+
+uint32_t nand_emulEraseCount(uint16_t blk)
+{
+	ASSERT(blk < CONFIG_NAND_NUM_BLOCK);
+	return erase_cnt[blk];
+}
+
+void nand_emulSetBadBlock(uint16_t blk)
+{
+	allocMem();
+	ASSERT(blk < CONFIG_NAND_NUM_BLOCK);
+	bad_block[blk] = true;
+	/* ONFI bad block mark: first spare byte of the first page cleared */
+	pageAddr((uint32_t)blk * CONFIG_NAND_PAGES_PER_BLOCK)[CONFIG_NAND_DATA_SIZE] = 0;
+}
+
+void nand_emulFlipBit(uint32_t page, uint16_t offset, uint8_t bit)
+{
+	allocMem();
+	ASSERT(offset < NAND_PAGE_SIZE);
+	pageAddr(page)[offset] ^= BV(bit & 7);
+}
+
+void nand_emulSetReadDisturb(uint32_t one_in)
+{
+	read_disturb = one_in;
+}
+
+static void readPage(uint32_t page, uint16_t col)
+{
+	size_t len = NAND_PAGE_SIZE - col;
+
+	memcpy(nand_buf, pageAddr(page) + col, len);
+	stats.page_reads++;
+
+	if (read_disturb && (uint32_t)rand() % read_disturb == 0)
+	{
+		size_t bit = (size_t)rand() % (len * 8);
+		nand_buf[bit / 8] ^= BV(bit % 8);
+		stats.bit_flips++;
+	}
+}
+
+static void programPage(uint32_t page, uint16_t col)
+{
+	uint8_t *dst = pageAddr(page) + col;
+
+	stats.page_programs++;
+	if (bad_block[page / CONFIG_NAND_PAGES_PER_BLOCK])
+	{
+		chip_status |= BV(0);
+		return;
+	}
+
+	/* Programming can only clear bits */
+	for (size_t i = 0; i < (size_t)(NAND_PAGE_SIZE - col); i++)
+		dst[i] &= nand_buf[i];
+}
+
+bool nand_waitReadyBusy(UNUSED_ARG(Nand *, chip), UNUSED_ARG(time_t, timeout))
+{
+	return true;
+}
+
+bool nand_waitTransferComplete(UNUSED_ARG(Nand *, chip), UNUSED_ARG(time_t, timeout))
+{
+	return true;
+}
+
+void nand_sendCommand(UNUSED_ARG(Nand *, chip),
+		uint32_t cmd1, uint32_t cmd2,
+		int num_cycles, uint32_t cycle0, uint32_t cycle1234)
+{
+	uint32_t page = cycle1234 >> 8;
+	uint16_t col = cycle0 | ((cycle1234 & 0xf) << 8);
+
+	switch (cmd1)
+	{
+	case NAND_CMD_RESET:
+		chip_status = 0;
+		break;
+
+	case NAND_CMD_READID:
+		memset(nand_buf, 0, 5);
+		nand_buf[0] = 0x2c; /* Emulated manufacturer ID */
+		nand_buf[1] = 0xd3;
+		break;
+
+	case NAND_CMD_STATUS:
+		/* Keep error bit of last operation */
+		break;
+
+	case NAND_CMD_READ_1:
+		ASSERT(cmd2 == NAND_CMD_READ_2);
+		ASSERT(num_cycles == 5);
+		chip_status = 0;
+		readPage(page, col);
+		break;
+
+	case NAND_CMD_WRITE_1:
+		ASSERT(num_cycles == 5);
+		chip_status = 0;
+		write_page = page;
+		write_col = col;
+		break;
+
+	case NAND_CMD_WRITE_2:
+		programPage(write_page, write_col);
+		break;
+
+	case NAND_CMD_ERASE_1:
+	{
+		ASSERT(cmd2 == NAND_CMD_ERASE_2);
+		/* Three cycles: the row address only */
+		uint16_t blk = cycle1234 / CONFIG_NAND_PAGES_PER_BLOCK;
+
+		ASSERT(blk < CONFIG_NAND_NUM_BLOCK);
+		chip_status = 0;
+		stats.block_erases++;
+		if (bad_block[blk])
+			chip_status |= BV(0);
+		else
+		{
+			eraseBlock(blk);
+			erase_cnt[blk]++;
+		}
+		break;
+	}
+
+	default:
+		ASSERT(0);
+	}
+}
+
+uint8_t nand_getChipStatus(UNUSED_ARG(Nand *, chip))
+{
+	/* Always ready, error bit set if last operation failed */
+	return BV(6) | chip_status;
+}
+
+void *nand_dataBuffer(UNUSED_ARG(Nand *, chip))
+{
+	return nand_buf;
+}
+
+bool nand_checkEcc(UNUSED_ARG(Nand *, chip))
+{
+	/* No hardware ECC: use CONFIG_NAND_ECC_SW to check data */
+	return true;
+}
+
+void nand_computeEcc(UNUSED_ARG(Nand *, chip),
+		UNUSED_ARG(const void *, buf), UNUSED_ARG(size_t, size), uint32_t *ecc, size_t ecc_size)
+{
+	memset(ecc, 0xff, ecc_size * sizeof(*ecc));
+}
+
+void nand_hwInit(UNUSED_ARG(Nand *, chip))
+{
+	allocMem();
+	chip_status = 0;
+}
@@ -0,0 +1,96 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief RAM backed NAND simulator (interface).
+ *
+ * Implements the hardware specific functions of the NAND driver
+ * (drv/nand.h) on a RAM array, so that the driver and the layers above
+ * it can be tested on the host.
+ * The simulator counts the operations done on each block and can inject
+ * faults: read bit flips, factory bad blocks and program/erase failures.
+ */
+
+#ifndef EMUL_NAND_EMUL_H
+#define EMUL_NAND_EMUL_H
+
+#include <cfg/compiler.h>
+
+/**
+ * Operation counters of the simulated chip.
+ */
+typedef struct NandEmulStats
+{
+	uint32_t page_reads;      ///< Page (or spare) read operations.
+	uint32_t page_programs;   ///< Page program operations.
+	uint32_t block_erases;    ///< Block erase operations.
+	uint32_t bit_flips;       ///< Bit flips injected on reads.
+} NandEmulStats;
+
+/**
+ * Erase the whole simulated chip, clear bad blocks, fault injection
+ * and counters.
+ */
+void nand_emulReset(void);
+
+/**
+ * Get operation counters.
+ */
+void nand_emulStats(NandEmulStats *stats);
+
+/**
+ * \return the number of times block \a blk has been erased.
+ */
+uint32_t nand_emulEraseCount(uint16_t blk);
+
+/**
+ * Mark block \a blk as bad: the bad block mark is written and
+ * every following program or erase operation on it will fail.
+ */
+void nand_emulSetBadBlock(uint16_t blk);
+
+/**
+ * Flip a bit stored in the simulated chip.
+ *
+ * \param page physical page.
+ * \param offset byte offset in page, spare area included.
+ * \param bit bit number in byte.
+ */
+void nand_emulFlipBit(uint32_t page, uint16_t offset, uint8_t bit);
+
+/**
+ * Inject a random single bit flip once every \a one_in page reads.
+ * Flips are transient: data stored in the chip is not modified.
+ * Use 0 to disable.
+ */
+void nand_emulSetReadDisturb(uint32_t one_in);
+
+#endif /* EMUL_NAND_EMUL_H */
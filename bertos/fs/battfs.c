@@ -574,6 +574,7 @@ static size_t battfs_write(struct KFile *fd, const void *_buf, size_t size)
 	pgaddr_t wr_len;
 	BattFsPageHeader curr_hdr;
 	pgcnt_t new_page;
+	bool hdr_pending = false;
 
 	if (fd->seek_pos < 0)
 	{
@@ -612,26 +613,16 @@ static size_t battfs_write(struct KFile *fd, const void *_buf, size_t size)
 			new_page = fdb->start[fdb->max_off];
 
 		/* Fill unused space of first page with 0s */
-		uint8_t dummy = 0;
-		// TODO: write in blocks to speed up things
 		pgaddr_t zero_bytes = MIN(fd->seek_pos - fd->size, (kfile_off_t)(disk->data_size - curr_hdr.fill));
-		while (zero_bytes--)
-		{
-			if (kblock_write(disk->dev, new_page, &dummy, curr_hdr.fill, 1) != 1)
-			{
-				fdb->errors |= BATTFS_DISK_WRITE_ERR;
-				return total_write;
-			}
-			curr_hdr.fill++;
-			fd->size++;
-			disk->free_bytes--;
-		}
-		curr_hdr.seq++;
-		if (!writeHdr(disk, new_page, &curr_hdr))
+		if (kblock_fill(disk->dev, new_page, 0, curr_hdr.fill, zero_bytes) != zero_bytes)
 		{
 			fdb->errors |= BATTFS_DISK_WRITE_ERR;
 			return total_write;
 		}
+		curr_hdr.fill += zero_bytes;
+		fd->size += zero_bytes;
+		disk->free_bytes -= zero_bytes;
+		curr_hdr.seq++;
 
 		/* Allocate the missing pages first. */
 		pgoff_t missing_pages = fd->seek_pos / disk->data_size - fdb->max_off;
@@ -640,6 +631,13 @@ static size_t battfs_write(struct KFile *fd, const void *_buf, size_t size)
 
 		while (missing_pages--)
 		{
+			/* Header of the previous page is complete, write it */
+			if (!writeHdr(disk, new_page, &curr_hdr))
+			{
+				fdb->errors |= BATTFS_DISK_WRITE_ERR;
+				return total_write;
+			}
+
 			zero_bytes = MIN((kfile_off_t)disk->data_size, fd->seek_pos - fd->size);
 
 			new_page = allocateNewPage(disk, (fdb->start - disk->page_array) + fdb->max_off + 1, fdb->inode);
@@ -649,32 +647,36 @@ static size_t battfs_write(struct KFile *fd, const void *_buf, size_t size)
 				return total_write;
 			}
 
-
-			// TODO: write in blocks to speed up things
 			/* Fill page buffer with 0 to avoid filling unused pages with garbage */
-			for (pgaddr_t off = 0; off < disk->data_size; off++)
+			if (kblock_fill(disk->dev, new_page, 0, 0, disk->data_size) != disk->data_size)
 			{
-				if (kblock_write(disk->dev, new_page, &dummy, off, 1) != 1)
-				{
-					fdb->errors |= BATTFS_DISK_WRITE_ERR;
-					return total_write;
-				}
+				fdb->errors |= BATTFS_DISK_WRITE_ERR;
+				return total_write;
 			}
 			curr_hdr.inode = fdb->inode;
 			curr_hdr.pgoff = ++fdb->max_off;
 			curr_hdr.fill = zero_bytes;
 			curr_hdr.seq = 0;
 
-			if (!writeHdr(disk, new_page, &curr_hdr))
-			{
-				fdb->errors |= BATTFS_DISK_WRITE_ERR;
-				return total_write;
-			}
-
 			/* Update size and free space left */
 			fd->size += zero_bytes;
 			disk->free_bytes -= zero_bytes;
 		}
+
+		/*
+		 * The last page filled is the one where the write starts:
+		 * if there is data to write, its header will be updated below,
+		 * so keep it in memory and write it only once, when the
+		 * write loop is done with the page.
+		 */
+		ASSERT(curr_hdr.pgoff == fd->seek_pos / disk->data_size);
+		if (size)
+			hdr_pending = true;
+		else if (!writeHdr(disk, new_page, &curr_hdr))
+		{
+			fdb->errors |= BATTFS_DISK_WRITE_ERR;
+			return total_write;
+		}
 	}
 
 	while (size)
@@ -683,8 +685,27 @@ static size_t battfs_write(struct KFile *fd, const void *_buf, size_t size)
 		addr_offset = fd->seek_pos % disk->data_size;
 		wr_len = MIN(size, (size_t)(disk->data_size - addr_offset));
 
+		/*
+		 * Headers are written only when leaving a page, after its last
+		 * data write: the page header still in memory is complete now.
+		 */
+		if (hdr_pending && pg_offset != curr_hdr.pgoff)
+		{
+			hdr_pending = false;
+			if (!writeHdr(disk, new_page, &curr_hdr))
+			{
+				fdb->errors |= BATTFS_DISK_WRITE_ERR;
+				goto out;
+			}
+		}
+
+		if (hdr_pending)
+		{
+			/* Page just filled with 0s above, header is already in memory */
+			ASSERT(pg_offset == curr_hdr.pgoff);
+		}
 		/* Handle write outside EOF */
-		if (pg_offset > fdb->max_off)
+		else if (pg_offset > fdb->max_off)
 		{
 			LOG_INFO("New page needed, pg_offset %d, pos %d\n", pg_offset, (int)((fdb->start - disk->page_array) + pg_offset));
 
@@ -692,7 +713,7 @@ static size_t battfs_write(struct KFile *fd, const void *_buf, size_t size)
 			if (new_page == NO_SPACE)
 			{
 				fdb->errors |= BATTFS_DISK_SPACEOVER_ERR;
-				return total_write;
+				goto out;
 			}
 
 			curr_hdr.inode = fdb->inode;
@@ -706,7 +727,7 @@ static size_t battfs_write(struct KFile *fd, const void *_buf, size_t size)
 			if (!readHdr(disk, fdb->start[pg_offset], &curr_hdr))
 			{
 				fdb->errors |= BATTFS_DISK_READ_ERR;
-				return total_write;
+				goto out;
 			}
 
 			/* Renew page only if is not in cache. */
@@ -717,14 +738,14 @@ static size_t battfs_write(struct KFile *fd, const void *_buf, size_t size)
 				if (new_page == NO_SPACE)
 				{
 					fdb->errors |= BATTFS_DISK_SPACEOVER_ERR;
-					return total_write;
+					goto out;
 				}
 
 				LOG_INFO("Re-writing page %d to %d\n", fdb->start[pg_offset], new_page);
 				if (kblock_copy(disk->dev, fdb->start[pg_offset], new_page) != 0)
 				{
 					fdb->errors |= BATTFS_DISK_WRITE_ERR;
-					return total_write;
+					goto out;
 				}
 				fdb->start[pg_offset] = new_page;
 			}
@@ -740,7 +761,7 @@ static size_t battfs_write(struct KFile *fd, const void *_buf, size_t size)
 		if (kblock_write(disk->dev, new_page, buf, addr_offset, wr_len) != wr_len)
 		{
 			fdb->errors |= BATTFS_DISK_WRITE_ERR;
-			return total_write;
+			goto out;
 		}
 
 		size -= wr_len;
@@ -751,15 +772,19 @@ static size_t battfs_write(struct KFile *fd, const void *_buf, size_t size)
 		disk->free_bytes -= fill_delta;
 		fd->size += fill_delta;
 		curr_hdr.fill += fill_delta;
-
-		if (!writeHdr(disk, new_page, &curr_hdr))
-		{
-			fdb->errors |= BATTFS_DISK_WRITE_ERR;
-			return total_write;
-		}
+		hdr_pending = true;
 
 		//LOG_INFO("free_bytes %d, seek_pos %d, size %d, curr_hdr.fill %d\n", disk->free_bytes, fd->seek_pos, fd->size, curr_hdr.fill);
 	}
+
+out:
+	/*
+	 * Header of the last page written, also on errors: after the
+	 * sparse filling, size and free space already account for it.
+	 */
+	if (hdr_pending && !writeHdr(disk, new_page, &curr_hdr))
+		fdb->errors |= BATTFS_DISK_WRITE_ERR;
+
 	return total_write;
 }
 
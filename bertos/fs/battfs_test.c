@@ -36,10 +36,13 @@
 
 #include <fs/battfs.h>
 #include <io/kblock_posix.h>
+#include <io/kblock_ram.h>
 
 #include <cfg/debug.h>
 #include <cfg/test.h>
 
+#include <os/hptime.h>
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -51,6 +54,8 @@
 #define PAGE_COUNT (FILE_SIZE / PAGE_SIZE)
 
 #define HW_PAGEBUF true
+
+#define BENCH_ROUNDS 50
 #if UNIT_TEST
 
 const char test_filename[]="battfs_disk.bin";
@@ -1071,6 +1076,177 @@ static void openAllFiles(BattFsSuper *disk)
 }
 
 
+static uint8_t ram_disk[FILE_SIZE + PAGE_SIZE];
+
+static void ramDiskInit(KBlockRam *ram)
+{
+	memset(ram_disk, 0xff, sizeof(ram_disk));
+	kblockram_init(ram, ram_disk, sizeof(ram_disk), PAGE_SIZE, true, true);
+}
+
+static void benchSparseAppend(BattFsSuper *disk)
+{
+	TRACEMSG("23: benchmark sparse append\n");
+
+	KBlockRam ram;
+	BattFs fd1;
+	uint8_t buf[DATA_SIZE];
+	hptime_t elapsed = 0;
+	/* Leave a couple of free pages for page renewal */
+	kfile_off_t gap = (PAGE_COUNT - 3) * DATA_SIZE - 4;
+
+	for (int round = 0; round < BENCH_ROUNDS; round++)
+	{
+		ramDiskInit(&ram);
+		ASSERT(battfs_mount(disk, &ram.b, page_array, sizeof(page_array)));
+		ASSERT(battfs_fileopen(disk, &fd1, 0, BATTFS_CREATE));
+
+		hptime_t start = hptime_get();
+		ASSERT(kfile_seek(&fd1.fd, gap, KSM_SEEK_SET) == gap);
+		ASSERT(kfile_write(&fd1.fd, "BeRT", 4) == 4);
+		ASSERT(kfile_flush(&fd1.fd) == 0);
+		elapsed += hptime_get() - start;
+
+		ASSERT(fd1.fd.size == gap + 4);
+		ASSERT(kfile_close(&fd1.fd) == 0);
+		ASSERT(kfile_error(&fd1.fd) == 0);
+		ASSERT(battfs_fsck(disk));
+		ASSERT(battfs_umount(disk));
+	}
+
+	/* Check that the gap is really filled with 0s */
+	ASSERT(battfs_mount(disk, &ram.b, page_array, sizeof(page_array)));
+	ASSERT(battfs_fileopen(disk, &fd1, 0, 0));
+	ASSERT(fd1.fd.size == gap + 4);
+	for (kfile_off_t pos = 0; pos < gap; pos += sizeof(buf))
+	{
+		size_t len = MIN((kfile_off_t)sizeof(buf), gap - pos);
+		memset(buf, 0xaa, sizeof(buf));
+		ASSERT(kfile_read(&fd1.fd, buf, len) == len);
+		for (size_t i = 0; i < len; i++)
+			ASSERT(buf[i] == 0);
+	}
+	ASSERT(kfile_read(&fd1.fd, buf, sizeof(buf)) == 4);
+	ASSERT(memcmp(buf, "BeRT", 4) == 0);
+	ASSERT(kfile_close(&fd1.fd) == 0);
+	ASSERT(battfs_umount(disk));
+
+	kprintf("sparse append: %ld bytes gap, %ld us per write\n",
+		(long)gap, (long)(elapsed / BENCH_ROUNDS));
+	TRACEMSG("23: passed\n");
+}
+
+static void benchSequentialAppend(BattFsSuper *disk)
+{
+	TRACEMSG("24: benchmark sequential append\n");
+
+	KBlockRam ram;
+	BattFs fd1;
+	uint8_t buf[37];
+	hptime_t elapsed = 0;
+	kfile_off_t total = (PAGE_COUNT / 2) * DATA_SIZE;
+
+	for (unsigned i = 0; i < sizeof(buf); i++)
+		buf[i] = i;
+
+	for (int round = 0; round < BENCH_ROUNDS; round++)
+	{
+		ramDiskInit(&ram);
+		ASSERT(battfs_mount(disk, &ram.b, page_array, sizeof(page_array)));
+		ASSERT(battfs_fileopen(disk, &fd1, 0, BATTFS_CREATE));
+
+		hptime_t start = hptime_get();
+		for (kfile_off_t pos = 0; pos < total; pos += sizeof(buf))
+			ASSERT(kfile_write(&fd1.fd, buf, sizeof(buf)) == sizeof(buf));
+		ASSERT(kfile_flush(&fd1.fd) == 0);
+		elapsed += hptime_get() - start;
+
+		ASSERT(kfile_close(&fd1.fd) == 0);
+		ASSERT(kfile_error(&fd1.fd) == 0);
+		ASSERT(battfs_fsck(disk));
+		ASSERT(battfs_umount(disk));
+	}
+
+	kprintf("sequential append: %ld bytes in %u bytes chunks, %ld us per file\n",
+		(long)total, (unsigned)sizeof(buf), (long)(elapsed / BENCH_ROUNDS));
+	TRACEMSG("24: passed\n");
+}
+
+/* Buffer writes fail while this is not zero, to inject data write errors */
+static int faulty_writes;
+static const KBlockVTable *faulty_orig_vt;
+static KBlockVTable faulty_vt;
+
+static size_t faultyWriteBuf(struct KBlock *b, const void *buf, size_t offset, size_t size)
+{
+	/* Headers (at page end) are written as usual */
+	if (faulty_writes && offset < DATA_SIZE)
+	{
+		faulty_writes--;
+		return 0;
+	}
+	return faulty_orig_vt->writeBuf(b, buf, offset, size);
+}
+
+static void writeEOFError(BattFsSuper *disk)
+{
+	TRACEMSG("25: write error after a seek past EOF\n");
+
+	FILE *fpt = fopen(test_filename, "w+");
+	for (int i = 0; i < FILE_SIZE; i++)
+		fputc(0xff, fpt);
+	KBlockPosix f;
+	kblockposix_init(&f, fpt, HW_PAGEBUF, page_buffer, PAGE_SIZE, PAGE_COUNT);
+
+	BattFs fd1;
+	inode_t INODE = 0;
+	uint8_t buf[10];
+	kfile_off_t end = DATA_SIZE * 2 + 5;
+
+	for (unsigned i = 0; i < sizeof(buf); i++)
+		buf[i] = i;
+
+	ASSERT(battfs_mount(disk, &f.b, page_array, sizeof(page_array)));
+	ASSERT(battfs_fsck(disk));
+	ASSERT(battfs_fileopen(disk, &fd1, INODE, BATTFS_CREATE));
+	ASSERT(kfile_write(&fd1.fd, buf, sizeof(buf)) == sizeof(buf));
+	ASSERT(kfile_seek(&fd1.fd, end, KSM_SEEK_SET) == end);
+
+	faulty_orig_vt = f.b.priv.vt;
+	faulty_vt = *faulty_orig_vt;
+	faulty_vt.writeBuf = faultyWriteBuf;
+	f.b.priv.vt = &faulty_vt;
+	faulty_writes = 1;
+
+	/* The gap is filled, but the data can not be written */
+	ASSERT(kfile_write(&fd1.fd, buf, sizeof(buf)) == 0);
+	ASSERT(kfile_error(&fd1.fd) & BATTFS_DISK_WRITE_ERR);
+	ASSERT(fd1.fd.size == end);
+
+	f.b.priv.vt = faulty_orig_vt;
+	ASSERT(kfile_close(&fd1.fd) == 0);
+	ASSERT(battfs_fsck(disk));
+	ASSERT(battfs_umount(disk));
+
+	/* The headers on disk must agree with the size in memory */
+	fpt = fopen(test_filename, "r+");
+	kblockposix_init(&f, fpt, HW_PAGEBUF, page_buffer, PAGE_SIZE, PAGE_COUNT);
+	ASSERT(battfs_mount(disk, &f.b, page_array, sizeof(page_array)));
+	ASSERT(battfs_fsck(disk));
+	ASSERT(battfs_fileopen(disk, &fd1, INODE, 0));
+	ASSERT(fd1.fd.size == end);
+
+	for (kfile_off_t i = 0; i < end; i++)
+		ASSERT(kfile_getc(&fd1.fd) == (i < (kfile_off_t)sizeof(buf) ? i : 0));
+
+	ASSERT(kfile_close(&fd1.fd) == 0);
+	ASSERT(kfile_error(&fd1.fd) == 0);
+	ASSERT(battfs_fsck(disk));
+	ASSERT(battfs_umount(disk));
+
+	TRACEMSG("25: passed\n");
+}
+
 int battfs_testRun(void)
 {
 	BattFsSuper disk;
@@ -1095,6 +1271,9 @@ int battfs_testRun(void)
 	endOfSpace(&disk);
 	multipleFilesRW(&disk);
 	openAllFiles(&disk);
+	benchSparseAppend(&disk);
+	benchSequentialAppend(&disk);
+	writeEOFError(&disk);
 
 	kprintf("All tests passed!\n");
 
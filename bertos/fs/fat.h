@@ -80,5 +80,27 @@ INLINE FatFile * FATFILE_CAST(KFile *fd)
  */
 FRESULT fatfile_open(FatFile *file, const char *file_path, BYTE mode);
 
+#if _USE_FASTSEEK
+/**
+ * Enable fast seek on an open \a file, using \a tbl as cluster link map.
+ *
+ * The map is created on the first seek, then seeking doesn't need to follow
+ * the cluster chain from the start of the file anymore.  Each fragment
+ * of the file takes two items of the table, plus three items of overhead:
+ * if the table is too small only the beginning of the file is mapped.
+ *
+ * \param file A pointer to an open FatFile.
+ * \param tbl The link map table, it must be valid until the file is closed.
+ * \param len Number of items in \a tbl, at least 5.
+ */
+INLINE void fatfile_setLinkMap(FatFile *file, DWORD *tbl, size_t len)
+{
+	ASSERT(len >= 5);
+	tbl[0] = len;
+	tbl[1] = 0;
+	file->fat_file.cltbl = tbl;
+}
+#endif
+
 #endif /* FS_FAT_H */
 
@@ -47,20 +47,48 @@
 
 #include <cfg/test.h>
 
+#include <io/kblock_posix.h>
+
+#include <os/hptime.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAG_FILE_SIZE   (1024L * 1024)  ///< Size of the fragmented file.
+#define FRAG_CHUNK       4096            ///< Files are interleaved in chunks this big.
+#define SEEK_ROUNDS      500
+#define LINKMAP_LEN      (3 + 2 * (FRAG_FILE_SIZE / FRAG_CHUNK))
+#define PREALLOC_SIZE    (256L * 1024)
+#define DISK_SECTORS     65536
+#define CLUSTER_SIZE     4096
+#define BENCH_FILE_SIZE  (4L * 1024 * 1024)
+#define BENCH_BIG_READ   (32L * 1024)
+
 /* avoid compiler warnings... */
 int fatfile_testSetup(void);
 int fatfile_testTearDown(void);
 int fatfile_testRun(void);
 
 static FATFS file_system;
+static KBlockPosix disk;
 
 int fatfile_testSetup(void)
 {
 	FRESULT err;
+	FILE *fp = fopen("emuldisk.dsk", "w+");
+	ASSERT(fp);
+
+	// Give the image its full size, so that every sector can be read back
+	fseek(fp, DISK_SECTORS * 512L - 1, SEEK_SET);
+	fputc(0, fp);
+
+	kblockposix_init(&disk, fp, false, NULL, 512, DISK_SECTORS);
+	disk_assignDrive(&disk.b, 0);
+
 	err = f_mount(0, &file_system);
 	ASSERT(err == FR_OK);
 
-	err = f_mkfs(0, 0, 512);
+	err = f_mkfs(0, 0, CLUSTER_SIZE);
 	ASSERT(err == FR_OK);
 	return 0;
 }
@@ -70,9 +98,183 @@ int fatfile_testTearDown(void)
 	FRESULT err;
 	err = f_mount(0, 0);
 	ASSERT(err == FR_OK);
+	ASSERT(kblock_close(&disk.b) == 0);
 	return 0;
 }
 
+/*
+ * Write two files interleaving their clusters, so that the first
+ * one is split in FRAG_FILE_SIZE / FRAG_CHUNK fragments.
+ * Each 32 bit word of the file contains its own offset.
+ */
+static void writeFragmented(void)
+{
+	FatFile a, b;
+	uint32_t buf[FRAG_CHUNK / sizeof(uint32_t)];
+
+	ASSERT(fatfile_open(&a, "frag.bin", FA_WRITE | FA_CREATE_ALWAYS) == FR_OK);
+	ASSERT(fatfile_open(&b, "other.bin", FA_WRITE | FA_CREATE_ALWAYS) == FR_OK);
+	for (uint32_t off = 0; off < FRAG_FILE_SIZE; off += FRAG_CHUNK)
+	{
+		for (size_t i = 0; i < countof(buf); i++)
+			buf[i] = off + i * sizeof(uint32_t);
+		ASSERT(kfile_write(&a.fd, buf, sizeof(buf)) == sizeof(buf));
+		ASSERT(kfile_flush(&a.fd) == 0);
+		ASSERT(kfile_write(&b.fd, buf, sizeof(buf)) == sizeof(buf));
+		ASSERT(kfile_flush(&b.fd) == 0);
+	}
+	ASSERT(kfile_close(&a.fd) == 0);
+	ASSERT(kfile_close(&b.fd) == 0);
+}
+
+static hptime_t randomSeeks(FatFile *file)
+{
+	hptime_t start = hptime_get();
+
+	srand(42);
+	for (int i = 0; i < SEEK_ROUNDS; i++)
+	{
+		uint32_t off = ((uint32_t)rand() % FRAG_FILE_SIZE) & ~3UL;
+		uint32_t val;
+
+		ASSERT(kfile_seek(&file->fd, off, KSM_SEEK_SET) == (kfile_off_t)off);
+		ASSERT(kfile_read(&file->fd, &val, sizeof(val)) == sizeof(val));
+		ASSERT(val == off);
+	}
+	return hptime_get() - start;
+}
+
+static void fatfile_testFragmented(void)
+{
+	static DWORD linkmap[LINKMAP_LEN];
+	FatFile file;
+	hptime_t chain, fast, partial;
+
+	writeFragmented();
+
+	ASSERT(fatfile_open(&file, "frag.bin", FA_READ) == FR_OK);
+	chain = randomSeeks(&file);
+
+	fatfile_setLinkMap(&file, linkmap, countof(linkmap));
+	fast = randomSeeks(&file);
+	kprintf("link map: %ld runs, %ld clusters\n", (long)linkmap[1], (long)linkmap[2 + 2 * linkmap[1]]);
+	ASSERT(linkmap[1] == FRAG_FILE_SIZE / FRAG_CHUNK);
+
+	// A map too small for the whole file covers its beginning only
+	fatfile_setLinkMap(&file, linkmap, 21);
+	partial = randomSeeks(&file);
+	ASSERT(linkmap[1] == 9);
+	ASSERT(kfile_close(&file.fd) == 0);
+
+	kprintf("%d random seeks in a %ld bytes file, %ld fragments:\n",
+		SEEK_ROUNDS, FRAG_FILE_SIZE, FRAG_FILE_SIZE / FRAG_CHUNK);
+	kprintf(" chain walk %ld us, partial map %ld us, link map %ld us\n",
+		(long)chain, (long)partial, (long)fast);
+}
+
+static void fatfile_testExpand(void)
+{
+	static DWORD linkmap[LINKMAP_LEN];
+	FATFS *fs;
+	FatFile file;
+	DWORD free_before, free_after, n;
+	uint8_t buf[1000];
+	hptime_t start;
+	long written = 0;
+
+	ASSERT(f_getfree("", &free_before, &fs) == FR_OK);
+
+	start = hptime_get();
+	ASSERT(fatfile_open(&file, "stream.bin", FA_WRITE | FA_CREATE_ALWAYS) == FR_OK);
+	ASSERT(f_expand(&file.fat_file, PREALLOC_SIZE) == FR_OK);
+	// Only empty files can be expanded
+	ASSERT(f_expand(&file.fat_file, PREALLOC_SIZE) == FR_DENIED);
+
+	memset(buf, 0x5a, sizeof(buf));
+	while (written + (long)sizeof(buf) < PREALLOC_SIZE / 2)
+	{
+		ASSERT(kfile_write(&file.fd, buf, sizeof(buf)) == sizeof(buf));
+		written += sizeof(buf);
+	}
+	// Release the clusters not used
+	ASSERT(f_truncate(&file.fat_file) == FR_OK);
+	ASSERT(kfile_close(&file.fd) == 0);
+	kprintf("streamed %ld bytes in a pre-allocated file in %ld us\n",
+		written, (long)(hptime_get() - start));
+
+	// Written data is contiguous
+	ASSERT(fatfile_open(&file, "stream.bin", FA_READ) == FR_OK);
+	ASSERT(file.fat_file.fsize == (DWORD)written);
+	fatfile_setLinkMap(&file, linkmap, countof(linkmap));
+	ASSERT(f_lseek(&file.fat_file, CREATE_LINKMAP) == FR_OK);
+	ASSERT(linkmap[1] == 1);
+	ASSERT(kfile_close(&file.fd) == 0);
+
+	// Cached free cluster count is consistent with the FAT
+	n = (written + fs->csize * 512 - 1) / (fs->csize * 512);
+	ASSERT(f_getfree("", &free_after, &fs) == FR_OK);
+	ASSERT(free_after == free_before - n);
+	fs->free_clust = 0xFFFFFFFF;
+	ASSERT(f_getfree("", &free_after, &fs) == FR_OK);
+	ASSERT(free_after == free_before - n);
+}
+
+static long readFile(const char *name, void *buf, size_t chunk)
+{
+	FatFile file;
+	hptime_t start = hptime_get();
+	long total = 0;
+	size_t len;
+
+	ASSERT(fatfile_open(&file, name, FA_READ) == FR_OK);
+	while ((len = kfile_read(&file.fd, buf, chunk)) > 0)
+		total += len;
+	ASSERT(total == BENCH_FILE_SIZE);
+	ASSERT(kfile_close(&file.fd) == 0);
+
+	return (long)(hptime_get() - start);
+}
+
+#define MBS(bytes, us)  ((us) ? (long)((bytes) / (us)) : 0)
+
+/*
+ * Sequential read throughput: with big reads FatFs asks the disk layer
+ * for whole clusters, which go to the device as a single range transfer.
+ */
+static void fatfile_testThroughput(void)
+{
+	static uint8_t buf[BENCH_BIG_READ];
+	KBlockVTable no_range;
+	const KBlockVTable *vt = disk.b.priv.vt;
+	FatFile file;
+	long small, big, fallback;
+
+	ASSERT(fatfile_open(&file, "seq.bin", FA_WRITE | FA_CREATE_ALWAYS) == FR_OK);
+	for (size_t i = 0; i < sizeof(buf); i++)
+		buf[i] = i;
+	for (long off = 0; off < BENCH_FILE_SIZE; off += sizeof(buf))
+		ASSERT(kfile_write(&file.fd, buf, sizeof(buf)) == sizeof(buf));
+	ASSERT(kfile_close(&file.fd) == 0);
+
+	small = readFile("seq.bin", buf, 512);
+	big = readFile("seq.bin", buf, sizeof(buf));
+	for (size_t i = 0; i < sizeof(buf); i++)
+		ASSERT(buf[i] == (uint8_t)i);
+
+	// Same reads, with the device moving one sector at a time
+	no_range = *vt;
+	no_range.readRange = NULL;
+	no_range.writeRange = NULL;
+	disk.b.priv.vt = &no_range;
+	fallback = readFile("seq.bin", buf, sizeof(buf));
+	disk.b.priv.vt = vt;
+
+	kprintf("sequential read of %ld bytes:\n", BENCH_FILE_SIZE);
+	kprintf(" 512 B reads %ld us (%ld MB/s)\n", small, MBS(BENCH_FILE_SIZE, small));
+	kprintf(" %ld B reads, per sector %ld us (%ld MB/s)\n", BENCH_BIG_READ, fallback, MBS(BENCH_FILE_SIZE, fallback));
+	kprintf(" %ld B reads, range %ld us (%ld MB/s)\n", BENCH_BIG_READ, big, MBS(BENCH_FILE_SIZE, big));
+}
+
 int fatfile_testRun(void)
 {
 	FRESULT fat_err;
@@ -120,7 +322,11 @@ int fatfile_testRun(void)
 	fatfile_open(&file_handler, "foo.txt", FA_READ | FA_WRITE);
 	ASSERT((size_t)kfile_seek(&file_handler.fd, sizeof(int), KSM_SEEK_END) == sizeof(int) * (SIZE + 1));
 	ASSERT(kfile_seek(&file_handler.fd, -SIZE, KSM_SEEK_SET) == 0);
+	ASSERT(kfile_close(&file_handler.fd) == 0);
 
+	fatfile_testFragmented();
+	fatfile_testExpand();
+	fatfile_testThroughput();
 	return 0;
 }
 
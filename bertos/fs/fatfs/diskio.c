@@ -67,13 +67,18 @@ DRESULT disk_read (
 	KBlock *dev = devs[drv];
 	ASSERT(dev);
 
-
-	while (count--)
+	/*
+	 * Multi sector requests come from FatFs when it moves whole clusters
+	 * straight to the user buffer: pass them to the device in one go.
+	 */
+	if (count == 1)
 	{
-		if (kblock_read(dev, sector++, buff, 0, dev->blk_size) != dev->blk_size)
+		if (kblock_read(dev, sector, buff, 0, dev->blk_size) != dev->blk_size)
 			return RES_ERROR;
-		buff += dev->blk_size;
 	}
+	else if (kblock_readRange(dev, sector, buff, count) != count)
+		return RES_ERROR;
+
 	return RES_OK;
 }
 
@@ -93,12 +98,14 @@ DRESULT disk_write (
 	KBlock *dev = devs[drv];
 	ASSERT(dev);
 
-	while (count--)
+	if (count == 1)
 	{
-		if (kblock_write(dev, sector++, buff, 0, dev->blk_size) != dev->blk_size)
+		if (kblock_write(dev, sector, buff, 0, dev->blk_size) != dev->blk_size)
 			return RES_ERROR;
-		buff += dev->blk_size;
 	}
+	else if (kblock_writeRange(dev, sector, buff, count) != count)
+		return RES_ERROR;
+
 	return RES_OK;
 }
 #endif /* _READONLY */
@@ -502,6 +502,81 @@ DWORD clust2sect (	/* !=0: sector number, 0: failed - invalid cluster# */
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Fast seek: cluster link map                                           */
+/*-----------------------------------------------------------------------*/
+/* The link map table pointed by FIL.cltbl has the following layout:
+/   [0]: Table size in number of items, set by the user
+/   [1]: Number of runs of contiguous clusters in the map (0: not created)
+/   [2 + 2*i]: File cluster index where run i starts
+/   [3 + 2*i]: Cluster# where run i starts
+/   [2 + 2*n]: Number of mapped clusters (n = number of runs)
+/  Runs are sorted by file cluster index and can be searched by bisection.
+/  When the table is too small to hold the whole chain only its head is
+/  mapped: the remaining clusters are reached following the chain from
+/  the last mapped one. */
+#if _USE_FASTSEEK
+static
+FRESULT create_linkmap (
+	FIL *fp			/* Pointer to the file object with the table */
+)
+{
+	DWORD *tbl = fp->cltbl, *p = tbl + 2;
+	DWORD clst, nxt, ncl = 0, nruns = 0;
+
+
+	tbl[1] = 0;
+	clst = fp->org_clust;
+	while (clst >= 2 && clst < fp->fs->max_clust) {
+		if (p + 3 > tbl + tbl[0]) break;	/* No room for another run and the end mark */
+		*p++ = ncl;							/* Store the run */
+		*p++ = clst;
+		nruns++;
+		for (;;) {							/* Follow the contiguous clusters */
+			nxt = get_cluster(fp->fs, clst);
+			if (nxt == 0xFFFFFFFF) return FR_DISK_ERR;
+			if (nxt < 2) return FR_INT_ERR;
+			ncl++;
+			if (nxt != clst + 1) break;
+			clst = nxt;
+		}
+		clst = nxt;
+	}
+	if (nruns) {
+		*p = ncl;							/* Number of mapped clusters */
+		tbl[1] = nruns;
+	}
+
+	return FR_OK;
+}
+
+
+static
+DWORD clmt_clust (	/* 0: Not mapped, >=2: Cluster# */
+	FIL *fp,		/* Pointer to the file object */
+	DWORD ci		/* File cluster index */
+)
+{
+	DWORD *tbl = fp->cltbl;
+	DWORD lo, hi, mid;
+
+
+	if (!tbl[1] || ci >= tbl[2 + 2 * tbl[1]]) return 0;
+	lo = 0; hi = tbl[1] - 1;
+	while (lo < hi) {				/* Find the last run starting at or before ci */
+		mid = (lo + hi + 1) / 2;
+		if (tbl[2 + 2 * mid] <= ci)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return tbl[3 + 2 * lo] + (ci - tbl[2 + 2 * lo]);
+}
+#endif /* _USE_FASTSEEK */
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Seek directory index                                                  */
 /*-----------------------------------------------------------------------*/
@@ -1443,6 +1518,7 @@ FRESULT auto_mount (	/* FR_OK(0): successful, !=0: any error occured */
 #if !_FS_READONLY
 	/* Initialize allocation information */
 	fs->free_clust = 0xFFFFFFFF;
+	fs->last_clust = 0;
 	fs->wflag = 0;
 	/* Get fsinfo if needed */
 	if (fmt == FS_FAT32) {
@@ -1454,6 +1530,8 @@ FRESULT auto_mount (	/* FR_OK(0): successful, !=0: any error occured */
 			LD_DWORD(fs->win+FSI_StrucSig) == 0x61417272) {
 			fs->last_clust = LD_DWORD(fs->win+FSI_Nxt_Free);
 			fs->free_clust = LD_DWORD(fs->win+FSI_Free_Count);
+			if (fs->last_clust >= mclst) fs->last_clust = 0;		/* Ignore out of range hints */
+			if (fs->free_clust > mclst - 2) fs->free_clust = 0xFFFFFFFF;
 		}
 	}
 #endif
@@ -1627,6 +1705,9 @@ FRESULT f_open (
 	fp->fsize = LD_DWORD(dir+DIR_FileSize);	/* File size */
 	fp->fptr = 0; fp->csect = 255;		/* File pointer */
 	fp->dsect = 0;
+#if _USE_FASTSEEK
+	fp->cltbl = 0;						/* No link map */
+#endif
 	fp->fs = dj.fs; fp->id = dj.fs->id;	/* Owner file system object of the file */
 
 	LEAVE_FF(dj.fs, FR_OK);
@@ -1928,6 +2009,13 @@ FRESULT f_lseek (
 	if (res != FR_OK) LEAVE_FF(fp->fs, res);
 	if (fp->flag & FA__ERROR)			/* Check abort flag */
 		LEAVE_FF(fp->fs, FR_INT_ERR);
+#if _USE_FASTSEEK
+	if (ofs == CREATE_LINKMAP) {		/* Create the link map table */
+		if (!fp->cltbl) LEAVE_FF(fp->fs, FR_INT_ERR);
+		res = create_linkmap(fp);
+		LEAVE_FF(fp->fs, res);
+	}
+#endif
 	if (ofs > fp->fsize					/* In read-only mode, clip offset with the file size */
 #if !_FS_READONLY
 		 && !(fp->flag & FA_WRITE)
@@ -1956,6 +2044,26 @@ FRESULT f_lseek (
 #endif
 			fp->curr_clust = clst;
 		}
+#if _USE_FASTSEEK
+		if (clst != 0 && fp->cltbl) {				/* Skip the chain using the link map */
+			DWORD ci, si;
+
+			if (!fp->cltbl[1]) {					/* Create the map on first use */
+				res = create_linkmap(fp);
+				if (res != FR_OK) ABORT(fp->fs, res);
+			}
+			si = fp->fptr / bcs;					/* Current cluster index */
+			ci = (fp->fptr + ofs - 1) / bcs;		/* Target cluster index */
+			if (fp->cltbl[1] && ci >= fp->cltbl[2 + 2 * fp->cltbl[1]])
+				ci = fp->cltbl[2 + 2 * fp->cltbl[1]] - 1;	/* Beyond the map: start from its end */
+			if (fp->cltbl[1] && ci > si) {
+				clst = clmt_clust(fp, ci);
+				fp->curr_clust = clst;
+				fp->fptr += (ci - si) * bcs;
+				ofs -= (ci - si) * bcs;
+			}
+		}
+#endif
 		if (clst != 0) {
 			while (ofs > bcs) {						/* Cluster following loop */
 #if !_FS_READONLY
@@ -2148,20 +2256,26 @@ FRESULT f_truncate (
 	if (fp->fsize > fp->fptr) {
 		fp->fsize = fp->fptr;	/* Set file size to current R/W point */
 		fp->flag |= FA__WRITTEN;
-		if (fp->fptr == 0) {	/* When set file size to zero, remove entire cluster chain */
+	}
+	/* Remove the clusters following the R/W point, also the ones pre-allocated with f_expand */
+	if (fp->fptr == 0) {		/* When set file size to zero, remove entire cluster chain */
+		if (fp->org_clust) {
 			res = remove_chain(fp->fs, fp->org_clust);
 			fp->org_clust = 0;
-		} else {				/* When truncate a part of the file, remove remaining clusters */
-			ncl = get_cluster(fp->fs, fp->curr_clust);
-			res = FR_OK;
-			if (ncl == 0xFFFFFFFF) res = FR_DISK_ERR;
-			if (ncl == 1) res = FR_INT_ERR;
-			if (res == FR_OK && ncl < fp->fs->max_clust) {
-				res = put_cluster(fp->fs, fp->curr_clust, 0x0FFFFFFF);
-				if (res == FR_OK) res = remove_chain(fp->fs, ncl);
-			}
+			fp->flag |= FA__WRITTEN;
+		}
+	} else {					/* When truncate a part of the file, remove remaining clusters */
+		ncl = get_cluster(fp->fs, fp->curr_clust);
+		if (ncl == 0xFFFFFFFF) res = FR_DISK_ERR;
+		if (ncl == 1) res = FR_INT_ERR;
+		if (res == FR_OK && ncl < fp->fs->max_clust) {
+			res = put_cluster(fp->fs, fp->curr_clust, 0x0FFFFFFF);
+			if (res == FR_OK) res = remove_chain(fp->fs, ncl);
 		}
 	}
+#if _USE_FASTSEEK
+	if (fp->cltbl) fp->cltbl[1] = 0;	/* The link map is no longer valid */
+#endif
 	if (res != FR_OK) fp->flag |= FA__ERROR;
 
 	LEAVE_FF(fp->fs, res);
@@ -2170,6 +2284,79 @@ FRESULT f_truncate (
 
 
 
+#if _USE_EXPAND
+/*-----------------------------------------------------------------------*/
+/* Allocate a Contiguous Block to the File                               */
+/*-----------------------------------------------------------------------*/
+/* The file must be empty and open in write mode. The allocated clusters
+/  are followed by f_write, so that a streaming writer never waits for
+/  cluster allocation and its data is not fragmented. The file size is
+/  not changed: call f_truncate() after the last write to release the
+/  clusters not used. */
+
+FRESULT f_expand (
+	FIL *fp,		/* Pointer to the file object */
+	DWORD fsz		/* Number of bytes to allocate */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+	DWORD n, bcs, clst, stcl, scl, ncl, cs;
+
+
+	res = validate(fp->fs, fp->id);		/* Check validity of the object */
+	if (res != FR_OK) LEAVE_FF(fp->fs, res);
+	if (fp->flag & FA__ERROR)			/* Check abort flag */
+		LEAVE_FF(fp->fs, FR_INT_ERR);
+	if (!(fp->flag & FA_WRITE) || fp->org_clust || !fsz)	/* Check access mode and file state */
+		LEAVE_FF(fp->fs, FR_DENIED);
+
+	fs = fp->fs;
+	bcs = (DWORD)fs->csize * SS(fs);	/* Cluster size (byte) */
+	n = (fsz + bcs - 1) / bcs;			/* Number of clusters required */
+	stcl = fs->last_clust + 1;			/* Search from the allocation hint */
+	if (stcl < 2 || stcl >= fs->max_clust) stcl = 2;
+
+	scl = clst = stcl; ncl = 0;
+	for (;;) {							/* Find a contiguous free block */
+		cs = get_cluster(fs, clst);
+		if (cs == 0xFFFFFFFF) { res = FR_DISK_ERR; break; }
+		if (cs == 1) { res = FR_INT_ERR; break; }
+		if (cs == 0) {
+			if (++ncl == n) break;		/* Found */
+		} else {
+			scl = clst + 1; ncl = 0;	/* Restart after the cluster in use */
+		}
+		if (++clst >= fs->max_clust) {	/* Wrap around: a block cannot cross the end */
+			scl = clst = 2; ncl = 0;
+		}
+		if (clst == stcl) { res = FR_DENIED; break; }	/* No contiguous free block */
+	}
+
+	if (res == FR_OK) {					/* Create the cluster chain */
+		for (clst = scl; clst < scl + n - 1 && res == FR_OK; clst++)
+			res = put_cluster(fs, clst, clst + 1);
+		if (res == FR_OK)
+			res = put_cluster(fs, clst, 0x0FFFFFFF);
+	}
+	if (res == FR_OK) {
+		fp->org_clust = scl;
+		fp->flag |= FA__WRITTEN;
+		fs->last_clust = scl + n - 1;	/* Update FSINFO */
+		if (fs->free_clust != 0xFFFFFFFF) {
+			fs->free_clust -= n;
+			fs->fsi_flag = 1;
+		}
+	}
+	if (res != FR_OK && res != FR_DENIED) fp->flag |= FA__ERROR;
+
+	LEAVE_FF(fs, res);
+}
+#endif /* _USE_EXPAND */
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Get Number of Free Clusters                                           */
 /*-----------------------------------------------------------------------*/
@@ -2181,7 +2368,7 @@ FRESULT f_getfree (
 )
 {
 	FRESULT res;
-	DWORD n, clst, sect;
+	DWORD n, clst, sect, first;
 	BYTE fat, f, *p;
 
 
@@ -2197,14 +2384,17 @@ FRESULT f_getfree (
 
 	/* Get number of free clusters */
 	fat = (*fatfs)->fs_type;
-	n = 0;
+	n = 0; first = 0;
 	if (fat == FS_FAT12) {
 		clst = 2;
 		do {
-			if ((WORD)get_cluster(*fatfs, clst) == 0) n++;
+			if ((WORD)get_cluster(*fatfs, clst) == 0) {
+				if (!n) first = clst;
+				n++;
+			}
 		} while (++clst < (*fatfs)->max_clust);
 	} else {
-		clst = (*fatfs)->max_clust;
+		clst = 0;
 		sect = (*fatfs)->fatbase;
 		f = 0; p = 0;
 		do {
@@ -2215,15 +2405,23 @@ FRESULT f_getfree (
 				p = (*fatfs)->win;
 			}
 			if (fat == FS_FAT16) {
-				if (LD_WORD(p) == 0) n++;
+				if (LD_WORD(p) == 0 && clst >= 2) {
+					if (!n) first = clst;
+					n++;
+				}
 				p += 2; f += 1;
 			} else {
-				if (LD_DWORD(p) == 0) n++;
+				if (LD_DWORD(p) == 0 && clst >= 2) {
+					if (!n) first = clst;
+					n++;
+				}
 				p += 4; f += 2;
 			}
-		} while (--clst);
+		} while (++clst < (*fatfs)->max_clust);
 	}
 	(*fatfs)->free_clust = n;
+	if (n && (*fatfs)->last_clust < 2)		/* Start next allocations from the first free cluster */
+		(*fatfs)->last_clust = first - 1;
 	if (fat == FS_FAT32) (*fatfs)->fsi_flag = 1;
 	*nclst = n;
 
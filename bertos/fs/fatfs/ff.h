@@ -82,6 +82,18 @@
 /* To enable f_forward function, set _USE_FORWARD to 1 and set _FS_TINY to 1. */
 
 
+#ifndef _USE_FASTSEEK
+#define	_USE_FASTSEEK	0
+#endif
+/* To enable fast seek feature (cluster link map table), set _USE_FASTSEEK to 1. */
+
+
+#ifndef _USE_EXPAND
+#define	_USE_EXPAND	0
+#endif
+/* To enable f_expand function, set _USE_EXPAND to 1 and set _FS_READONLY to 0. */
+
+
 #ifndef _DRIVES
 #define _DRIVES		1
 #endif
@@ -246,6 +258,9 @@ typedef struct _FIL {
 	DWORD	dir_sect;	/* Sector containing the directory entry */
 	BYTE*	dir_ptr;	/* Ponter to the directory entry in the window */
 #endif
+#if _USE_FASTSEEK
+	DWORD*	cltbl;		/* Pointer to the cluster link map table (set by the user) */
+#endif
 #if !_FS_TINY
 	BYTE	buf[_MAX_SS];/* File R/W buffer */
 #endif
@@ -411,6 +426,7 @@ FRESULT f_utime (const char*, const FILINFO*);		/* Change timestamp of the file/
 FRESULT f_rename (const char*, const char*);		/* Rename/Move a file or directory */
 FRESULT f_forward (FIL*, UINT(*)(const BYTE*,UINT), UINT, UINT*);	/* Forward data to the stream */
 FRESULT f_mkfs (BYTE, BYTE, WORD);					/* Create a file system on the drive */
+FRESULT f_expand (FIL*, DWORD);						/* Allocate a contiguous block to the file */
 
 #if _USE_STRFUNC
 int f_putc (int, FIL*);								/* Put a character to the file */
@@ -468,6 +484,12 @@ void ff_rel_grant(_SYNC_t);
 #endif
 #define FA__ERROR			0x80
 
+/* Fast seek: f_lseek() offset that (re)builds the cluster link map of a file */
+
+#if _USE_FASTSEEK
+#define CREATE_LINKMAP		0xFFFFFFFF
+#endif
+
 
 /* FAT sub type (FATFS.fs_type) */
 
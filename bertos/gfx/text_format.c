@@ -72,6 +72,18 @@ int PGM_FUNC(text_puts)(const char * PGM_ATTR str, struct Bitmap *bm)
 }
 
 
+static void text_sinkPutc(char c, void *bm)
+{
+	text_putchar(c, (struct Bitmap *)bm);
+}
+
+/* Render a whole run without going through the formatter for each glyph */
+static void text_sinkWrite(const char *buf, size_t len, void *bm)
+{
+	while (len--)
+		text_putchar(*buf++, (struct Bitmap *)bm);
+}
+
 /**
  * vprintf()-like formatter to render text in a Bitmap.
  *
@@ -84,7 +96,13 @@ int PGM_FUNC(text_puts)(const char * PGM_ATTR str, struct Bitmap *bm)
  */
 int PGM_FUNC(text_vprintf)(struct Bitmap *bm, const char * PGM_ATTR fmt, va_list ap)
 {
-	return PGM_FUNC(_formatted_write)(fmt, (void (*)(char, void *))text_putchar, bm, ap);
+	FmtSink sink;
+
+	sink.put_char = text_sinkPutc;
+	sink.write = text_sinkWrite;
+	sink.user_data = bm;
+
+	return PGM_FUNC(_formatted_write_sink)(fmt, &sink, ap);
 }
 
 /**
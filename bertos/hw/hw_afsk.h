@@ -47,6 +47,8 @@
  * The adc should be configured to have a continuos stream of convertions.
  * For every convertion there must be an ISR that read the sample
  * and call afsk_adc_isr(), passing the context and the sample.
+ * If the ADC is served by DMA, the transfer complete ISR should call
+ * afsk_adc_block() with the whole buffer instead.
  *
  * \param ch channel to be used for AFSK demodulation.
  * \param ctx AFSK context (\see Afsk). This parameter must be saved and
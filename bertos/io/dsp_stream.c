@@ -0,0 +1,270 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Streaming DSP pipeline (implementation).
+ */
+
+#include "dsp_stream.h"
+
+#include <cpu/irq.h>
+
+#include <cfg/debug.h>
+#include <cfg/macros.h>
+
+#include <string.h>
+
+void dsp_stream_init(DspStream *s, DspBuf *bufs, void *mem, size_t nbufs, size_t buf_size)
+{
+	ASSERT(nbufs);
+	ASSERT(buf_size);
+
+	LIST_INIT(&s->free);
+	LIST_INIT(&s->full);
+	LIST_INIT(&s->ready);
+	LIST_INIT(&s->stages);
+	event_initGeneric(&s->work);
+	s->stop = false;
+	s->seq = 0;
+	memset(&s->stats, 0, sizeof(s->stats));
+
+	for (size_t i = 0; i < nbufs; i++)
+	{
+		bufs[i].data = (uint8_t *)mem + i * buf_size;
+		bufs[i].len = 0;
+		ADDTAIL(&s->free, &bufs[i].link);
+	}
+}
+
+void dsp_stream_addStage(DspStream *s, DspStage *stage)
+{
+	ASSERT(stage->process);
+	ADDTAIL(&s->stages, &stage->link);
+}
+
+DspBuf *dsp_stream_produce(DspStream *s, DspBuf *buf, size_t len)
+{
+	cpu_flags_t flags;
+	DspBuf *next;
+
+	IRQ_SAVE_DISABLE(flags);
+	next = (DspBuf *)list_remHead(&s->free);
+	if (buf)
+	{
+		buf->len = len;
+		buf->seq = s->seq++;
+		if (next)
+		{
+			ADDTAIL(&s->full, &buf->link);
+			s->stats.produced++;
+		}
+		else
+		{
+			s->stats.overruns++;
+			next = buf;
+		}
+	}
+	IRQ_RESTORE(flags);
+
+	if (buf && next != buf)
+		event_do(&s->work);
+	return next;
+}
+
+DspBuf *dsp_stream_consume(DspStream *s, DspBuf *done)
+{
+	cpu_flags_t flags;
+	DspBuf *next;
+
+	IRQ_SAVE_DISABLE(flags);
+	if (done)
+		ADDTAIL(&s->free, &done->link);
+	next = (DspBuf *)list_remHead(&s->ready);
+	if (next)
+		s->stats.consumed++;
+	else
+		s->stats.underruns++;
+	IRQ_RESTORE(flags);
+
+	return next;
+}
+
+/*
+ * Pass a buffer through the whole chain, stopping early if a stage
+ * drops it.
+ */
+static size_t dsp_stream_process(DspStream *s, DspBuf *buf)
+{
+	DspStage *stage;
+
+	FOREACH_NODE(stage, &s->stages)
+	{
+		if (!buf->len)
+			break;
+		DB(size_t in = buf->len;)
+		buf->len = stage->process(stage, buf);
+		ASSERT(buf->len <= in);
+	}
+	return buf->len;
+}
+
+int dsp_stream_poll(DspStream *s)
+{
+	int n = 0;
+	DspBuf *buf;
+
+	while (1)
+	{
+		ATOMIC(buf = (DspBuf *)list_remHead(&s->full));
+		if (!buf)
+			break;
+
+		bool keep = dsp_stream_process(s, buf) > 0;
+
+		ATOMIC(
+			if (keep)
+				ADDTAIL(&s->ready, &buf->link);
+			else
+				ADDTAIL(&s->free, &buf->link);
+			s->stats.processed++;
+		);
+		n++;
+	}
+	return n;
+}
+
+void dsp_stream_run(DspStream *s)
+{
+	while (!s->stop)
+	{
+		event_wait(&s->work);
+		dsp_stream_poll(s);
+	}
+}
+
+void dsp_stream_stop(DspStream *s)
+{
+	s->stop = true;
+	event_do(&s->work);
+}
+
+
+/*
+ * Format conversion: every format is mapped to and from the signed 16
+ * bit full scale one, by moving the sign bit and the alignment.
+ */
+static size_t dsp_convert(DspStage *stage, DspBuf *buf)
+{
+	DspConvert *c = containerof(stage, DspConvert, stage);
+	uint16_t *p = (uint16_t *)buf->data;
+	size_t n = buf->len / sizeof(*p);
+	uint16_t x;
+
+	if (c->from == c->to)
+		return buf->len;
+
+	for (size_t i = 0; i < n; i++)
+	{
+		x = p[i];
+		if (c->from != DSP_FMT_S16)
+			x = (x << (16 - c->from)) ^ 0x8000;
+		if (c->to != DSP_FMT_S16)
+			x = (x ^ 0x8000) >> (16 - c->to);
+		p[i] = x;
+	}
+	return buf->len;
+}
+
+void dsp_convertInit(DspConvert *c, int from, int to)
+{
+	ASSERT(from >= 0 && from <= 16);
+	ASSERT(to >= 0 && to <= 16);
+
+	c->stage.process = dsp_convert;
+	c->from = from;
+	c->to = to;
+}
+
+static size_t dsp_gain(DspStage *stage, DspBuf *buf)
+{
+	DspGain *g = containerof(stage, DspGain, stage);
+	int16_t *p = (int16_t *)buf->data;
+	size_t n = buf->len / sizeof(*p);
+	int16_t gain = g->gain;
+
+	for (size_t i = 0; i < n; i++)
+	{
+		int32_t y = ((int32_t)p[i] * gain) >> 8;
+		p[i] = MINMAX(INT16_MIN, y, INT16_MAX);
+	}
+	return buf->len;
+}
+
+void dsp_gainInit(DspGain *g, int16_t gain)
+{
+	g->stage.process = dsp_gain;
+	g->gain = gain;
+}
+
+static size_t dsp_decimate(DspStage *stage, DspBuf *buf)
+{
+	DspDecimate *d = containerof(stage, DspDecimate, stage);
+	int16_t *p = (int16_t *)buf->data;
+	int16_t *out = p;
+	size_t n = buf->len / sizeof(*p);
+	int32_t acc = d->acc;
+	uint8_t count = d->count;
+
+	for (size_t i = 0; i < n; i++)
+	{
+		acc += p[i];
+		if (++count == d->factor)
+		{
+			*out++ = acc / d->factor;
+			acc = 0;
+			count = 0;
+		}
+	}
+	d->acc = acc;
+	d->count = count;
+
+	return (out - p) * sizeof(*p);
+}
+
+void dsp_decimateInit(DspDecimate *d, uint8_t factor)
+{
+	ASSERT(factor);
+
+	d->stage.process = dsp_decimate;
+	d->factor = factor;
+	d->acc = 0;
+	d->count = 0;
+}
@@ -0,0 +1,292 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \defgroup dsp_stream Streaming DSP pipeline
+ * \ingroup core
+ * \{
+ *
+ * \brief Zero-copy streaming of sample buffers between DMA drivers and
+ * processing stages.
+ *
+ * A DspStream owns a set of equally sized sample buffers and moves them
+ * through three queues:
+ *
+ * <pre>
+ *   free -> producer -> full -> worker (stages) -> ready -> sink -> free
+ * </pre>
+ *
+ * The producer is typically the completion interrupt of an ADC or I2S
+ * receive DMA: dsp_stream_produce() queues the buffer just filled and
+ * returns the next empty one to hand to the hardware. The worker, a
+ * process running dsp_stream_run() or a main loop calling
+ * dsp_stream_poll(), passes every filled buffer through the chain of
+ * stages, in place. The sink, typically the completion interrupt of a
+ * DAC or I2S transmit DMA, takes the processed buffers with
+ * dsp_stream_consume() and returns them to the free queue once played.
+ * Samples are never copied: only buffer descriptors change hands.
+ *
+ * A stage can shorten a buffer (eg. a decimator) or drop it returning a
+ * length of 0, and the buffer goes back to the free queue: this is the
+ * way to terminate a stream that has no sink, with a stage that
+ * consumes the samples.
+ *
+ * When the producer fills a buffer and no empty one is available, the
+ * filled buffer is discarded and handed back to the producer
+ * (an overrun); when the sink asks for a buffer and none is ready, it gets
+ * NULL (an underrun) and must output silence on its own. Both are counted
+ * in DspStreamStats. Every filled buffer, discarded or not, gets a
+ * sequence number, so downstream code can detect the gaps.
+ *
+ * Drivers which have more than one buffer queued to the DMA (double
+ * buffering) take the additional ones with dsp_stream_produce(s, NULL, 0)
+ * and dsp_stream_consume(s, NULL) before starting the transfers.
+ *
+ * Example, with an ADC DMA that can queue the next buffer:
+ * \code
+ * static uint16_t mem[4][128];
+ * static DspBuf bufs[4];
+ * static DspStream stream;
+ * static DspConvert conv;
+ *
+ * static DspBuf *cur, *next;
+ *
+ * static void adc_dma_isr(void)
+ * {
+ * 	// cur is full, the hardware moved on to next
+ * 	DspBuf *filled = cur;
+ *
+ * 	cur = next;
+ * 	next = dsp_stream_produce(&stream, filled, sizeof(mem[0]));
+ * 	adc_queue_next(next->data, sizeof(mem[0]));
+ * }
+ *
+ * dsp_stream_init(&stream, bufs, mem, countof(bufs), sizeof(mem[0]));
+ * dsp_convertInit(&conv, DSP_FMT_U(12), DSP_FMT_S16);
+ * dsp_stream_addStage(&stream, &conv.stage);
+ * dsp_stream_addStage(&stream, &my_demodulator_stage);
+ * \endcode
+ *
+ * $WIZ$ module_name = "dsp_stream"
+ * $WIZ$ module_depends = "event"
+ */
+
+#ifndef IO_DSP_STREAM_H
+#define IO_DSP_STREAM_H
+
+#include <mware/event.h>
+
+#include <struct/list.h>
+
+#include <cfg/compiler.h>
+
+/**
+ * Buffer descriptor.
+ */
+typedef struct DspBuf
+{
+	Node link;       ///< Queue the buffer belongs to
+	uint8_t *data;   ///< Samples
+	size_t len;      ///< Length of the samples, in bytes
+	uint32_t seq;    ///< Sequence number given by the producer
+} DspBuf;
+
+struct DspStage;
+
+/**
+ * Process the buf->len bytes of samples of \a buf, in place.
+ *
+ * A stage with a memory of the past samples can check buf->seq to find
+ * out when buffers were discarded before reaching it.
+ *
+ * \return The length of the samples left in \a buf, in bytes, which
+ *         can not be more than buf->len, or 0 to drop the buffer.
+ */
+typedef size_t (*dsp_process_t)(struct DspStage *stage, DspBuf *buf);
+
+/**
+ * Processing stage.
+ *
+ * Stages with a state embed this structure, and get back their context
+ * with containerof().
+ */
+typedef struct DspStage
+{
+	Node link;
+	dsp_process_t process;
+} DspStage;
+
+/**
+ * Stream counters.
+ */
+typedef struct DspStreamStats
+{
+	uint32_t produced;   ///< Buffers filled by the producer and queued
+	uint32_t processed;  ///< Buffers that went through the stages
+	uint32_t consumed;   ///< Buffers taken by the sink
+	uint32_t overruns;   ///< Filled buffers discarded for lack of empty ones
+	uint32_t underruns;  ///< Sink requests with no processed buffer
+} DspStreamStats;
+
+/**
+ * Streaming context.
+ */
+typedef struct DspStream
+{
+	List free;            ///< Empty buffers
+	List full;            ///< Buffers filled by the producer
+	List ready;           ///< Processed buffers, for the sink
+	List stages;          ///< Processing chain
+
+	Event work;           ///< Triggered when a buffer is filled
+	volatile bool stop;   ///< Set by dsp_stream_stop()
+	uint32_t seq;         ///< Next sequence number
+
+	DspStreamStats stats;
+} DspStream;
+
+/**
+ * Initialize \a s with \a nbufs buffers of \a buf_size bytes each,
+ * carved out of \a mem.
+ *
+ * \param bufs Array of \a nbufs buffer descriptors.
+ * \param mem Memory for the samples, \a nbufs * \a buf_size bytes.
+ */
+void dsp_stream_init(DspStream *s, DspBuf *bufs, void *mem, size_t nbufs, size_t buf_size);
+
+/**
+ * Append \a stage to the processing chain of \a s.
+ *
+ * \note Call it before starting the stream.
+ */
+void dsp_stream_addStage(DspStream *s, DspStage *stage);
+
+/**
+ * Queue the buffer \a buf, filled with \a len bytes of samples, to the
+ * worker and return an empty buffer for the producer.
+ *
+ * If there is no empty buffer, \a buf is discarded and returned back.
+ * With \a buf NULL just take an empty buffer, or return NULL if there is
+ * none.
+ *
+ * \note Can be called from interrupt context.
+ */
+DspBuf *dsp_stream_produce(DspStream *s, DspBuf *buf, size_t len);
+
+/**
+ * Release the buffer \a done, already output by the sink (can be NULL),
+ * and return the next processed buffer, or NULL if there is none.
+ *
+ * \note Can be called from interrupt context.
+ */
+DspBuf *dsp_stream_consume(DspStream *s, DspBuf *done);
+
+/**
+ * Pass all the filled buffers through the stages.
+ *
+ * \return The number of buffers processed.
+ */
+int dsp_stream_poll(DspStream *s);
+
+/**
+ * Worker loop: process the buffers as they are filled, until
+ * dsp_stream_stop() is called.
+ *
+ * Meant to be the body of a dedicated process.
+ */
+void dsp_stream_run(DspStream *s);
+
+/**
+ * Make dsp_stream_run() return, as soon as the current buffer is done.
+ */
+void dsp_stream_stop(DspStream *s);
+
+/**
+ * Sample formats, for DspConvert.
+ * \{
+ */
+#define DSP_FMT_S16     0           ///< Signed 16 bit, full scale
+#define DSP_FMT_U(bits) (bits)      ///< Unsigned, right aligned, \a bits wide (ADC and DAC)
+/* \} */
+
+/**
+ * Format conversion stage, between 16 bit containers.
+ */
+typedef struct DspConvert
+{
+	DspStage stage;
+	uint8_t from;
+	uint8_t to;
+} DspConvert;
+
+/**
+ * Initialize a stage converting samples from format \a from to format
+ * \a to, both DSP_FMT_* values.
+ */
+void dsp_convertInit(DspConvert *c, int from, int to);
+
+/**
+ * Gain stage, on DSP_FMT_S16 samples.
+ */
+typedef struct DspGain
+{
+	DspStage stage;
+	int16_t gain;     ///< 8.8 fixed point
+} DspGain;
+
+/**
+ * Initialize a stage multiplying the samples by \a gain / 256, with
+ * saturation. The gain can be changed at any time.
+ */
+void dsp_gainInit(DspGain *g, int16_t gain);
+
+/**
+ * Decimation stage, on DSP_FMT_S16 samples.
+ *
+ * Each output sample is the average of \a factor input samples. Blocks
+ * need not be a multiple of \a factor: the partial sum is carried over
+ * to the next buffer.
+ */
+typedef struct DspDecimate
+{
+	DspStage stage;
+	int32_t acc;
+	uint8_t factor;
+	uint8_t count;
+} DspDecimate;
+
+/**
+ * Initialize a decimation stage by \a factor.
+ */
+void dsp_decimateInit(DspDecimate *d, uint8_t factor);
+
+/** \} */ //defgroup dsp_stream
+#endif /* IO_DSP_STREAM_H */
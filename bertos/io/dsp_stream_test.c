@@ -0,0 +1,327 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Streaming DSP pipeline test and benchmark.
+ *
+ * The chain under test converts 12 bit ADC samples to signed ones, halves
+ * them, decimates by 2 and converts them back for a 12 bit DAC.
+ *
+ * First the queues are driven by hand, checking the output samples, the
+ * zero-copy handoff and the overrun, underrun and drop paths. Then the
+ * emulated sample clocks feed the stream in real time, with the stages run
+ * by a worker process, to measure the latency; finally the cost of the
+ * chain per sample is measured.
+ *
+ * notest:avr
+ *
+ * $test$: cp bertos/cfg/cfg_proc.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN" >> $cfgdir/cfg_proc.h
+ * $test$: echo "#define CONFIG_KERN 1" >> $cfgdir/cfg_proc.h
+ * $test$: echo  "#undef CONFIG_KERN_PREEMPT" >> $cfgdir/cfg_proc.h
+ * $test$: echo "#define CONFIG_KERN_PREEMPT 1" >> $cfgdir/cfg_proc.h
+ * $test$: cp bertos/cfg/cfg_signal.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN_SIGNALS" >> $cfgdir/cfg_signal.h
+ * $test$: echo "#define CONFIG_KERN_SIGNALS 1" >> $cfgdir/cfg_signal.h
+ */
+
+#include "dsp_stream.h"
+
+#include <emul/dsp_stream_emul.h>
+
+#include <kern/proc.h>
+
+#include <drv/timer.h>
+
+#include <os/hptime.h>
+
+#include <cfg/test.h>
+#include <cfg/debug.h>
+
+#define NBUFS       8
+#define SAMPLES     64
+#define IN_RATE     8000
+#define DECIMATION  2
+#define RUN_MS      1000
+#define BENCH_LOOPS 20000
+
+/* avoid compiler warnings... */
+int dsp_stream_testSetup(void);
+int dsp_stream_testTearDown(void);
+int dsp_stream_testRun(void);
+
+static uint16_t mem[NBUFS][SAMPLES];
+static DspBuf bufs[NBUFS];
+static DspStream stream;
+static DspConvert to_s16, to_u12;
+static DspGain gain;
+static DspDecimate decim;
+
+static DspStreamEmul emul;
+static uint32_t sink_bufs, sink_errors;
+
+PROC_DEFINE_STACK(worker_stack, KERN_MINSTACKSIZE * 2);
+
+/* ADC sample number n */
+static uint16_t adc_sample(uint32_t n)
+{
+	return (n * 37 + (n >> 6) * 1000) & 0xFFF;
+}
+
+/* DAC sample expected for input samples n and n + 1 */
+static uint16_t dac_sample(uint32_t n)
+{
+	int16_t a = (int16_t)((adc_sample(n) << 4) ^ 0x8000) >> 1;
+	int16_t b = (int16_t)((adc_sample(n + 1) << 4) ^ 0x8000) >> 1;
+
+	return (uint16_t)((int16_t)(((int32_t)a + b) / 2) ^ 0x8000) >> 4;
+}
+
+static void fill(DspBuf *buf, uint32_t seq)
+{
+	uint16_t *p = (uint16_t *)buf->data;
+
+	for (int i = 0; i < SAMPLES; i++)
+		p[i] = adc_sample(seq * SAMPLES + i);
+}
+
+static bool check(const DspBuf *buf)
+{
+	const uint16_t *p = (const uint16_t *)buf->data;
+
+	if (buf->len != SAMPLES / DECIMATION * sizeof(uint16_t))
+		return false;
+	for (int i = 0; i < SAMPLES / DECIMATION; i++)
+		if (p[i] != dac_sample(buf->seq * SAMPLES + i * DECIMATION))
+			return false;
+	return true;
+}
+
+static void setup_stream(void)
+{
+	dsp_stream_init(&stream, bufs, mem, NBUFS, sizeof(mem[0]));
+	dsp_convertInit(&to_s16, DSP_FMT_U(12), DSP_FMT_S16);
+	dsp_gainInit(&gain, 128);
+	dsp_decimateInit(&decim, DECIMATION);
+	dsp_convertInit(&to_u12, DSP_FMT_S16, DSP_FMT_U(12));
+	dsp_stream_addStage(&stream, &to_s16.stage);
+	dsp_stream_addStage(&stream, &gain.stage);
+	dsp_stream_addStage(&stream, &decim.stage);
+	dsp_stream_addStage(&stream, &to_u12.stage);
+}
+
+static size_t drop_all(DspStage *stage, DspBuf *buf)
+{
+	(void)stage;
+	(void)buf;
+	return 0;
+}
+
+static int manual_test(void)
+{
+	DspBuf *in[2], *out, *first;
+	uint32_t seq = 0;
+
+	setup_stream();
+
+	/* Nothing to play yet */
+	ASSERT(dsp_stream_consume(&stream, NULL) == NULL);
+	ASSERT(stream.stats.underruns == 1);
+
+	/* Double buffered producer */
+	in[0] = dsp_stream_produce(&stream, NULL, 0);
+	in[1] = dsp_stream_produce(&stream, NULL, 0);
+	ASSERT(in[0] && in[1] && in[0] != in[1]);
+
+	first = in[0];
+	fill(in[0], seq++);
+	in[0] = dsp_stream_produce(&stream, in[0], sizeof(mem[0]));
+	ASSERT(dsp_stream_poll(&stream) == 1);
+
+	/* The very same buffer comes out, processed in place */
+	out = dsp_stream_consume(&stream, NULL);
+	ASSERT(out == first);
+	ASSERT(out->seq == 0);
+	ASSERT(check(out));
+
+	/*
+	 * Fill everything without running the stages: the producer holds
+	 * two buffers and the sink one, the others get queued and then
+	 * the producer starts discarding.
+	 */
+	for (int i = 0; i < NBUFS; i++)
+	{
+		DspBuf *filled = in[i & 1];
+		fill(filled, seq++);
+		in[i & 1] = dsp_stream_produce(&stream, filled, sizeof(mem[0]));
+	}
+	ASSERT(stream.stats.produced == 1 + NBUFS - 3);
+	ASSERT(stream.stats.overruns == 3);
+	ASSERT(dsp_stream_poll(&stream) == NBUFS - 3);
+
+	/* The buffers come out in order, with a gap where data was lost */
+	uint32_t expect = 1;
+	for (int i = 0; i < NBUFS - 3; i++)
+	{
+		out = dsp_stream_consume(&stream, out);
+		ASSERT(out);
+		ASSERT(out->seq == expect++);
+		ASSERT(check(out));
+	}
+	ASSERT(dsp_stream_consume(&stream, out) == NULL);
+	ASSERT(stream.stats.underruns == 2);
+
+	/* A stage dropping the buffers returns them to the producer */
+	DspStage drop;
+	drop.process = drop_all;
+	dsp_stream_addStage(&stream, &drop);
+	fill(in[0], seq++);
+	in[0] = dsp_stream_produce(&stream, in[0], sizeof(mem[0]));
+	ASSERT(dsp_stream_poll(&stream) == 1);
+	ASSERT(dsp_stream_consume(&stream, NULL) == NULL);
+	ASSERT(dsp_stream_produce(&stream, NULL, 0));
+
+	kprintf("Manual test: produced %lu, overruns %lu, underruns %lu\n",
+		(unsigned long)stream.stats.produced, (unsigned long)stream.stats.overruns,
+		(unsigned long)stream.stats.underruns);
+	return 0;
+}
+
+static void emul_source(DspStreamEmul *e, void *buf, size_t n, uint32_t first)
+{
+	uint16_t *p = (uint16_t *)buf;
+
+	(void)e;
+	for (size_t i = 0; i < n; i++)
+		p[i] = adc_sample(first + i);
+}
+
+static void emul_sink(DspStreamEmul *e, const DspBuf *buf)
+{
+	(void)e;
+	sink_bufs++;
+	if (!check(buf))
+		sink_errors++;
+}
+
+static void worker(void)
+{
+	dsp_stream_run(&stream);
+}
+
+static int emul_test(void)
+{
+	setup_stream();
+	dsp_stream_emulInit(&emul, &stream, IN_RATE, SAMPLES, IN_RATE / DECIMATION,
+		3 * SAMPLES * 1000 / IN_RATE, emul_source, emul_sink);
+	dsp_stream_addStage(&stream, &emul.probe);
+
+	proc_new(worker, NULL, sizeof(worker_stack), worker_stack);
+	dsp_stream_emulStart(&emul);
+	timer_delay(RUN_MS);
+	dsp_stream_emulStop(&emul);
+	dsp_stream_stop(&stream);
+	timer_delay(10);
+
+	kprintf("Emulated run: %lu Hz, %d samples per buffer, %d buffers\n",
+		(unsigned long)IN_RATE, SAMPLES, NBUFS);
+	kprintf("  produced %lu, played %lu, overruns %lu, underruns %lu\n",
+		(unsigned long)stream.stats.produced, (unsigned long)sink_bufs,
+		(unsigned long)stream.stats.overruns, (unsigned long)stream.stats.underruns);
+	if (emul.lat_count)
+		kprintf("  latency: min %ldus, avg %ldus, max %ldus (buffer %ldus, tick %ldus)\n",
+			(long)emul.lat_min, (long)(emul.lat_sum / emul.lat_count), (long)emul.lat_max,
+			(long)emul.buf_time, (long)(1000000 / TIMER_TICKS_PER_SEC));
+
+	ASSERT(stream.stats.produced > 0);
+	ASSERT(sink_bufs > 0);
+	ASSERT(sink_errors == 0);
+	ASSERT(emul.lat_count == stream.stats.processed);
+	/* A buffer is never processed before its last sample is captured */
+	ASSERT(emul.lat_min >= 0);
+	return 0;
+}
+
+static void benchmark(void)
+{
+	DspBuf *in, *out = NULL;
+	hptime_t start;
+
+	setup_stream();
+	in = dsp_stream_produce(&stream, NULL, 0);
+
+	start = hptime_get();
+	for (uint32_t seq = 0; seq < BENCH_LOOPS; seq++)
+	{
+		in = dsp_stream_produce(&stream, in, sizeof(mem[0]));
+		dsp_stream_poll(&stream);
+		out = dsp_stream_consume(&stream, out);
+	}
+	hptime_t t = hptime_get() - start;
+
+	/* The same loop, without the stages */
+	LIST_INIT(&stream.stages);
+	start = hptime_get();
+	for (uint32_t seq = 0; seq < BENCH_LOOPS; seq++)
+	{
+		in = dsp_stream_produce(&stream, in, sizeof(mem[0]));
+		dsp_stream_poll(&stream);
+		out = dsp_stream_consume(&stream, out);
+	}
+	hptime_t t0 = hptime_get() - start;
+
+	kprintf("Chain: %ld ns/sample, buffer handoff: %ld ns/buffer\n",
+		(long)((t - t0) * 1000 / ((hptime_t)BENCH_LOOPS * SAMPLES)),
+		(long)(t0 * 1000 / BENCH_LOOPS));
+}
+
+int dsp_stream_testSetup(void)
+{
+	kdbg_init();
+	timer_init();
+	proc_init();
+	return 0;
+}
+
+int dsp_stream_testRun(void)
+{
+	if (manual_test() || emul_test())
+		return -1;
+	benchmark();
+	return 0;
+}
+
+int dsp_stream_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(dsp_stream);
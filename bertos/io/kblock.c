@@ -73,6 +73,13 @@ INLINE size_t kblock_writeBuf(struct KBlock *b, const void *buf, size_t offset,
 	return b->priv.vt->writeBuf(b, buf, offset, size);
 }
 
+INLINE size_t kblock_fillBuf(struct KBlock *b, int value, size_t offset, size_t size)
+{
+	KB_ASSERT_METHOD(b, fillBuf);
+	ASSERT(offset + size <= b->blk_size);
+	return b->priv.vt->fillBuf(b, value, offset, size);
+}
+
 INLINE int kblock_load(struct KBlock *b, block_idx_t index)
 {
 	KB_ASSERT_METHOD(b, load);
@@ -118,8 +125,9 @@ int kblock_flush(struct KBlock *b)
 {
 	ASSERT(b);
 
+	/* Unbuffered devices may still keep their own write-back state */
 	if (!kblock_buffered(b))
-		return 0;
+		return b->priv.vt->flush ? b->priv.vt->flush(b) : 0;
 
 	if (kblock_cacheDirty(b))
 	{
@@ -193,6 +201,134 @@ size_t kblock_write(struct KBlock *b, block_idx_t idx, const void *buf, size_t o
 	}
 }
 
+/*
+ * Generic fill, used when the driver does not supply a native one.
+ * The range is written in small chunks using the write primitives.
+ */
+static size_t kblock_genericFill(struct KBlock *b, block_idx_t idx, int value, size_t offset, size_t size)
+{
+	uint8_t buf[16];
+	size_t total = 0;
+
+	memset(buf, value, sizeof(buf));
+	while (size)
+	{
+		size_t len = MIN(sizeof(buf), size);
+		size_t wr;
+
+		if (kblock_buffered(b))
+			wr = kblock_writeBuf(b, buf, offset, len);
+		else
+			wr = kblock_writeDirect(b, idx, buf, offset, len);
+
+		total += wr;
+		if (wr != len)
+			break;
+
+		size -= len;
+		offset += len;
+	}
+	return total;
+}
+
+size_t kblock_fill(struct KBlock *b, block_idx_t idx, int value, size_t offset, size_t size)
+{
+	ASSERT(b);
+	ASSERT(idx < b->blk_cnt);
+	ASSERT(offset + size <= b->blk_size);
+
+	LOG_INFO("blk_idx %ld, value %d, offset %u, size %u\n", idx, value, offset, size);
+
+	if (kblock_buffered(b))
+	{
+		if (!kblock_loadPage(b, idx))
+			return 0;
+
+		kblock_setDirty(b, true);
+		if (b->priv.vt->fillBuf)
+			return kblock_fillBuf(b, value, offset, size);
+	}
+	else
+	{
+		#ifdef _DEBUG
+		if (offset != 0 || size != b->blk_size)
+			ASSERT(kblock_partialWrite(b));
+		#endif
+		if (b->priv.vt->fillDirect)
+			return b->priv.vt->fillDirect(b, b->priv.blk_start + idx, value, offset, size);
+	}
+
+	return kblock_genericFill(b, idx, value, offset, size);
+}
+
+block_idx_t kblock_readRange(struct KBlock *b, block_idx_t idx, void *buf, block_idx_t count)
+{
+	uint8_t *p = (uint8_t *)buf;
+	block_idx_t done;
+
+	ASSERT(b);
+	ASSERT(buf);
+	ASSERT(idx + count <= b->blk_cnt);
+
+	LOG_INFO("blk_idx %ld, count %ld\n", idx, count);
+
+	if (kblock_buffered(b) && kblock_cacheDirty(b)
+		&& b->priv.curr_blk >= idx && b->priv.curr_blk < idx + count)
+	{
+		if (kblock_flush(b) != 0)
+			return 0;
+	}
+
+	if (b->priv.vt->readRange)
+		return b->priv.vt->readRange(b, b->priv.blk_start + idx, buf, count);
+
+	for (done = 0; done < count; done++, p += b->blk_size)
+		if (kblock_readDirect(b, idx + done, p, 0, b->blk_size) != b->blk_size)
+			break;
+
+	return done;
+}
+
+block_idx_t kblock_writeRange(struct KBlock *b, block_idx_t idx, const void *buf, block_idx_t count)
+{
+	const uint8_t *p = (const uint8_t *)buf;
+	block_idx_t done;
+
+	ASSERT(b);
+	ASSERT(buf);
+	ASSERT(idx + count <= b->blk_cnt);
+
+	LOG_INFO("blk_idx %ld, count %ld\n", idx, count);
+
+	if (!b->priv.vt->writeRange && !b->priv.vt->writeDirect)
+	{
+		/* Hardware buffered device: go through the page buffer */
+		for (done = 0; done < count; done++, p += b->blk_size)
+			if (kblock_write(b, idx + done, p, 0, b->blk_size) != b->blk_size)
+				break;
+		return (kblock_flush(b) == 0) ? done : 0;
+	}
+
+	if (b->priv.vt->writeRange)
+		done = b->priv.vt->writeRange(b, b->priv.blk_start + idx, buf, count);
+	else
+	{
+		for (done = 0; done < count; done++, p += b->blk_size)
+			if (kblock_writeDirect(b, idx + done, p, 0, b->blk_size) != b->blk_size)
+				break;
+	}
+
+	/* Keep the cache coherent with what is now on the device */
+	if (kblock_buffered(b) && b->priv.curr_blk >= idx && b->priv.curr_blk < idx + done)
+	{
+		p = (const uint8_t *)buf + (b->priv.curr_blk - idx) * b->blk_size;
+		kblock_writeBuf(b, p, 0, b->blk_size);
+		kblock_setDirty(b, false);
+	}
+
+	return done;
+}
+
 int kblock_copy(struct KBlock *b, block_idx_t src, block_idx_t dest)
 {
 	ASSERT(b);
@@ -275,6 +411,13 @@ size_t kblock_swWriteBuf(struct KBlock *b, const void *buf, size_t offset, size_
 	return size;
 }
 
+size_t kblock_swFillBuf(struct KBlock *b, int value, size_t offset, size_t size)
+{
+	ASSERT(offset + size <= b->blk_size);
+	memset((uint8_t *)b->priv.buf + offset, value, size);
+	return size;
+}
+
 int kblock_swClose(UNUSED_ARG(struct KBlock, *b))
 {
 	return 0;
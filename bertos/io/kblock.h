@@ -101,15 +101,20 @@ struct KBlock;
  */
 typedef size_t (* kblock_read_direct_t)  (struct KBlock *b, block_idx_t index, void *buf, size_t offset, size_t size);
 typedef size_t (* kblock_write_direct_t) (struct KBlock *b, block_idx_t index, const void *buf, size_t offset, size_t size);
+typedef size_t (* kblock_fill_direct_t)  (struct KBlock *b, block_idx_t index, int value, size_t offset, size_t size);
+typedef block_idx_t (* kblock_read_range_t)  (struct KBlock *b, block_idx_t index, void *buf, block_idx_t count);
+typedef block_idx_t (* kblock_write_range_t) (struct KBlock *b, block_idx_t index, const void *buf, block_idx_t count);
 
 typedef size_t (* kblock_read_t)        (struct KBlock *b, void *buf, size_t offset, size_t size);
 typedef size_t (* kblock_write_t)       (struct KBlock *b, const void *buf, size_t offset, size_t size);
+typedef size_t (* kblock_fill_t)        (struct KBlock *b, int value, size_t offset, size_t size);
 typedef int    (* kblock_load_t)        (struct KBlock *b, block_idx_t index);
 typedef int    (* kblock_store_t)       (struct KBlock *b, block_idx_t index);
 
 typedef int    (* kblock_error_t)       (struct KBlock *b);
 typedef void   (* kblock_clearerr_t)    (struct KBlock *b);
 typedef int    (* kblock_close_t)       (struct KBlock *b);
+typedef int    (* kblock_flush_t)       (struct KBlock *b);
 /* \} */
 
 /*
@@ -119,14 +124,19 @@ typedef struct KBlockVTable
 {
 	kblock_read_direct_t readDirect;
 	kblock_write_direct_t writeDirect;
+	kblock_fill_direct_t fillDirect;   // Optional, \sa kblock_fill()
+	kblock_read_range_t readRange;     // Optional, \sa kblock_readRange()
+	kblock_write_range_t writeRange;   // Optional, \sa kblock_writeRange()
 
 	kblock_read_t  readBuf;
 	kblock_write_t writeBuf;
+	kblock_fill_t  fillBuf;            // Optional, \sa kblock_fill()
 	kblock_load_t  load;
 	kblock_store_t store;
 
 	kblock_error_t    error;    // \sa kblock_error()
 	kblock_clearerr_t clearerr; // \sa kblock_clearerr()
+	kblock_flush_t    flush;    // Optional, \sa kblock_flush()
 
 	kblock_close_t  close; // \sa kblock_close()
 } KBlockVTable;
@@ -246,7 +256,9 @@ INLINE void kblock_clearerr(struct KBlock *b)
  * Flush the cache (if any) to the device.
  *
  * This function will write any pending modifications to the device.
- * If the device does not have a cache, this function will do nothing.
+ * If the device does not have a cache, this function will do nothing,
+ * unless the driver keeps its own write-back state and supplies a
+ * flush method.
  *
  * \return 0 if all is OK, EOF on errors.
  * \sa kblock_read(), kblock_write(), kblock_buffered().
@@ -372,6 +384,80 @@ size_t kblock_read(struct KBlock *b, block_idx_t idx, void *buf, size_t offset,
  */
 size_t kblock_write(struct KBlock *b, block_idx_t idx, const void *buf, size_t offset, size_t size);
 
+/**
+ * Fill a portion of a block with a constant value.
+ *
+ * This function will set \a size bytes of block \a idx, starting at
+ * address \a offset inside the block, to \a value.
+ * The result is the same of a kblock_write() of a buffer filled with
+ * \a value, but no such buffer is needed and the whole range is handled
+ * in a single call.
+ *
+ * Drivers can supply a native implementation (memset on a RAM buffer,
+ * hardware fill commands, etc...); if they don't, a generic version
+ * that writes the range in small chunks is used.
+ *
+ * \note The same restrictions of kblock_write() about partial block
+ *       writes apply here.
+ *
+ * \param b KBlock device.
+ * \param idx the block number where you want to write.
+ * \param value the value used to fill the block, converted to uint8_t.
+ * \param offset the offset inside the block from which filling will start.
+ * \param size the number of bytes to be filled.
+ *
+ * \return the number of bytes written.
+ *
+ * \sa kblock_write(), kblock_partialWrite().
+ */
+size_t kblock_fill(struct KBlock *b, block_idx_t idx, int value, size_t offset, size_t size);
+
+/**
+ * Read a run of consecutive whole blocks.
+ *
+ * This function will read \a count blocks, starting from block \a idx,
+ * into \a buf, which must be at least \a count * blk_size bytes long.
+ * The result is the same of calling kblock_read() on each block, but
+ * drivers can transfer the whole run in a single operation (multi block
+ * commands, a single file read, etc...).
+ * If the driver does not supply a native implementation, a generic one
+ * that reads the blocks one by one is used.
+ *
+ * On buffered devices the cached block, if dirty and inside the range,
+ * is flushed before reading.
+ *
+ * \param b KBlock device.
+ * \param idx the first block to read.
+ * \param buf destination buffer.
+ * \param count the number of blocks to read.
+ *
+ * \return the number of whole blocks read.
+ *
+ * \sa kblock_read(), kblock_writeRange().
+ */
+block_idx_t kblock_readRange(struct KBlock *b, block_idx_t idx, void *buf, block_idx_t count);
+
+/**
+ * Write a run of consecutive whole blocks.
+ *
+ * This function will write \a count blocks, starting from block \a idx,
+ * taking data from \a buf.
+ * Blocks are always written entirely, so this function is available on
+ * every device, regardless of partial write support.
+ * Data is sent straight to the device; on buffered devices, if the cached
+ * block is inside the range, the cache is updated with the new content.
+ *
+ * \param b KBlock device.
+ * \param idx the first block to write.
+ * \param buf source buffer.
+ * \param count the number of blocks to write.
+ *
+ * \return the number of whole blocks written.
+ *
+ * \sa kblock_write(), kblock_readRange().
+ */
+block_idx_t kblock_writeRange(struct KBlock *b, block_idx_t idx, const void *buf, block_idx_t count);
+
 /**
  * Copy one block to another.
  *
@@ -392,6 +478,7 @@ int kblock_swLoad(struct KBlock *b, block_idx_t index);
 int kblock_swStore(struct KBlock *b, block_idx_t index);
 size_t kblock_swReadBuf(struct KBlock *b, void *buf, size_t offset, size_t size);
 size_t kblock_swWriteBuf(struct KBlock *b, const void *buf, size_t offset, size_t size);
+size_t kblock_swFillBuf(struct KBlock *b, int value, size_t offset, size_t size);
 int kblock_swClose(struct KBlock *b);
 
 /** \} */ //defgroup io_kblock
@@ -88,6 +88,59 @@ static size_t kblockposix_writeDirect(struct KBlock *b, block_idx_t index, const
 	return fwrite(buf, 1, size, f->fp);
 }
 
+static size_t kblockposix_fillBuf(struct KBlock *b, int value, size_t offset, size_t size)
+{
+	KBlockPosix *f = KBLOCKPOSIX_CAST(b);
+	memset((uint8_t *)f->b.priv.buf + offset, value, size);
+	return size;
+}
+
+static size_t kblockposix_fillDirect(struct KBlock *b, block_idx_t index, int value, size_t offset, size_t size)
+{
+	KBlockPosix *f = KBLOCKPOSIX_CAST(b);
+	uint8_t buf[64];
+	size_t total = 0;
+
+	ASSERT(index < b->blk_cnt);
+	memset(buf, value, sizeof(buf));
+
+	/* Seek only once, then write the whole range */
+	fseek(f->fp, index * b->blk_size + offset, SEEK_SET);
+	while (size)
+	{
+		size_t len = MIN(sizeof(buf), size);
+		size_t wr = fwrite(buf, 1, len, f->fp);
+
+		total += wr;
+		if (wr != len)
+			break;
+		size -= len;
+	}
+	return total;
+}
+
+/*
+ * Whole block runs are moved with a single seek and a single stdio
+ * transfer, instead of one seek and one call for each block.
+ */
+static block_idx_t kblockposix_readRange(struct KBlock *b, block_idx_t index, void *buf, block_idx_t count)
+{
+	KBlockPosix *f = KBLOCKPOSIX_CAST(b);
+	ASSERT(index + count <= b->blk_cnt);
+
+	fseek(f->fp, index * b->blk_size, SEEK_SET);
+	return fread(buf, b->blk_size, count, f->fp);
+}
+
+static block_idx_t kblockposix_writeRange(struct KBlock *b, block_idx_t index, const void *buf, block_idx_t count)
+{
+	KBlockPosix *f = KBLOCKPOSIX_CAST(b);
+	ASSERT(index + count <= b->blk_cnt);
+
+	fseek(f->fp, index * b->blk_size, SEEK_SET);
+	return fwrite(buf, b->blk_size, count, f->fp);
+}
+
 static int kblockposix_error(struct KBlock *b)
 {
 	KBlockPosix *f = KBLOCKPOSIX_CAST(b);
@@ -113,9 +166,11 @@ static int kblockposix_close(struct KBlock *b)
 static const KBlockVTable kblockposix_hwbuffered_vt =
 {
 	.readDirect = kblockposix_readDirect,
+	.readRange = kblockposix_readRange,
 
 	.readBuf = kblockposix_readBuf,
 	.writeBuf = kblockposix_writeBuf,
+	.fillBuf = kblockposix_fillBuf,
 	.load = kblockposix_load,
 	.store = kblockposix_store,
 
@@ -128,9 +183,13 @@ static const KBlockVTable kblockposix_swbuffered_vt =
 {
 	.readDirect = kblockposix_readDirect,
 	.writeDirect =kblockposix_writeDirect,
+	.fillDirect = kblockposix_fillDirect,
+	.readRange = kblockposix_readRange,
+	.writeRange = kblockposix_writeRange,
 
 	.readBuf = kblock_swReadBuf,
 	.writeBuf = kblock_swWriteBuf,
+	.fillBuf = kblock_swFillBuf,
 	.load = kblock_swLoad,
 	.store = kblock_swStore,
 
@@ -143,6 +202,9 @@ static const KBlockVTable kblockposix_unbuffered_vt =
 {
 	.readDirect = kblockposix_readDirect,
 	.writeDirect =kblockposix_writeDirect,
+	.fillDirect = kblockposix_fillDirect,
+	.readRange = kblockposix_readRange,
+	.writeRange = kblockposix_writeRange,
 
 	.error = kblockposix_error,
 	.clearerr = kblockposix_claererr,
@@ -90,6 +90,40 @@ static size_t kblockram_writeDirect(struct KBlock *b, block_idx_t index, const v
 	return size;
 }
 
+static size_t kblockram_fillBuf(struct KBlock *b, int value, size_t offset, size_t size)
+{
+	KBlockRam *r = KBLOCKRAM_CAST(b);
+	memset((uint8_t *)r->b.priv.buf + offset, value, size);
+	return size;
+}
+
+static size_t kblockram_fillDirect(struct KBlock *b, block_idx_t index, int value, size_t offset, size_t size)
+{
+	KBlockRam *r = KBLOCKRAM_CAST(b);
+	ASSERT(index < b->blk_cnt);
+
+	memset(r->membuf + index * r->b.blk_size + offset, value, size);
+	return size;
+}
+
+static block_idx_t kblockram_readRange(struct KBlock *b, block_idx_t index, void *buf, block_idx_t count)
+{
+	KBlockRam *r = KBLOCKRAM_CAST(b);
+	ASSERT(index + count <= b->blk_cnt);
+
+	memcpy(buf, r->membuf + index * r->b.blk_size, count * r->b.blk_size);
+	return count;
+}
+
+static block_idx_t kblockram_writeRange(struct KBlock *b, block_idx_t index, const void *buf, block_idx_t count)
+{
+	KBlockRam *r = KBLOCKRAM_CAST(b);
+	ASSERT(index + count <= b->blk_cnt);
+
+	memcpy(r->membuf + index * r->b.blk_size, buf, count * r->b.blk_size);
+	return count;
+}
+
 static int kblockram_dummy(UNUSED_ARG(struct KBlock *,b))
 {
 	return 0;
@@ -98,9 +132,11 @@ static int kblockram_dummy(UNUSED_ARG(struct KBlock *,b))
 static const KBlockVTable kblockram_hwbuffered_vt =
 {
 	.readDirect = kblockram_readDirect,
+	.readRange = kblockram_readRange,
 
 	.readBuf = kblockram_readBuf,
 	.writeBuf = kblockram_writeBuf,
+	.fillBuf = kblockram_fillBuf,
 	.load = kblockram_load,
 	.store = kblockram_store,
 
@@ -115,8 +151,13 @@ static const KBlockVTable kblockram_swbuffered_vt =
 	.readDirect = kblockram_readDirect,
 	.writeDirect = kblockram_writeDirect,
 
+	.fillDirect = kblockram_fillDirect,
+	.readRange = kblockram_readRange,
+	.writeRange = kblockram_writeRange,
+
 	.readBuf = kblock_swReadBuf,
 	.writeBuf = kblock_swWriteBuf,
+	.fillBuf = kblock_swFillBuf,
 	.load = kblock_swLoad,
 	.store = kblock_swStore,
 
@@ -129,6 +170,9 @@ static const KBlockVTable kblockram_unbuffered_vt =
 {
 	.readDirect = kblockram_readDirect,
 	.writeDirect = kblockram_writeDirect,
+	.fillDirect = kblockram_fillDirect,
+	.readRange = kblockram_readRange,
+	.writeRange = kblockram_writeRange,
 
 	.error = kblockram_dummy,
 	.clearerr = (kblock_clearerr_t)kblockram_dummy,
@@ -86,16 +86,34 @@ int kfile_getc(struct KFile *fd)
 }
 
 #if CONFIG_PRINTF
+static void kfile_sinkPutc(char c, void *fd)
+{
+	kfile_putc(c, (KFile *)fd);
+}
+
+static void kfile_sinkWrite(const char *buf, size_t len, void *fd)
+{
+	kfile_write((KFile *)fd, buf, len);
+}
+
 /**
  * Formatted write.
+ *
+ * Literal text and converted values reach the file with a single
+ * kfile_write() each, instead of one call per character.
  */
 int kfile_printf(struct KFile *fd, const char *format, ...)
 {
 	va_list ap;
 	int len;
+	FmtSink sink;
+
+	sink.put_char = kfile_sinkPutc;
+	sink.write = kfile_sinkWrite;
+	sink.user_data = fd;
 
 	va_start(ap, format);
-	len = _formatted_write(format, (void (*)(char, void *))kfile_putc, fd, ap);
+	len = _formatted_write_sink(format, &sink, ap);
 	va_end(ap);
 
 	return len;
@@ -0,0 +1,295 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Read-ahead and write-behind buffering over any KFile.
+ */
+
+#include "kfile_buffered.h"
+
+#include <string.h>
+
+/*
+ * Send the content of the write buffer to the channel.
+ */
+static int kfilebuf_drain(KFileBuffered *kb)
+{
+	size_t len = kb->wpos - kb->wbuf;
+
+	if (!len)
+		return 0;
+
+	size_t wr = kfile_write(kb->ch, kb->wbuf, len);
+
+	// Keep what has not been written at the buffer start
+	if (wr < len)
+		memmove(kb->wbuf, kb->wbuf + wr, len - wr);
+	kb->wpos -= wr;
+
+	return (wr == len) ? 0 : EOF;
+}
+
+/**
+ * Refill the read buffer and return the next character.
+ * Slow path of kfilebuf_getc().
+ */
+int kfilebuf_fill(KFileBuffered *kb)
+{
+	if (!kb->rbuf)
+	{
+		int c = kfile_getc(kb->ch);
+
+		if (c != EOF)
+			kb->fd.seek_pos++;
+		return c;
+	}
+
+	size_t len = kfile_read(kb->ch, kb->rbuf, kb->rsize);
+
+	kb->rpos = kb->rbuf;
+	kb->rend = kb->rbuf + len;
+
+	if (!len)
+		return EOF;
+
+	kb->fd.seek_pos++;
+	return *kb->rpos++;
+}
+
+/**
+ * Drain the write buffer, as needed, and write a character.
+ * Slow path of kfilebuf_putc().
+ */
+int kfilebuf_drainPutc(int c, KFileBuffered *kb)
+{
+	if (!kb->wbuf)
+	{
+		c = kfile_putc(c, kb->ch);
+		if (c != EOF)
+			kb->fd.seek_pos++;
+		return c;
+	}
+
+	if (kb->wpos >= kb->wend && kfilebuf_drain(kb) != 0)
+		return EOF;
+
+	*kb->wpos++ = (uint8_t)c;
+
+	if (c == '\n' && (kb->flags & KFB_LINEFLUSH) && kfilebuf_drain(kb) != 0)
+	{
+		// Not accepted by the channel: do not send it later
+		kb->wpos--;
+		return EOF;
+	}
+
+	kb->fd.seek_pos++;
+	return (unsigned char)c;
+}
+
+static size_t kfilebuf_read(struct KFile *fd, void *_buf, size_t size)
+{
+	KFileBuffered *kb = KFILEBUFFERED_CAST(fd);
+	uint8_t *buf = (uint8_t *)_buf;
+	size_t total = 0;
+
+	while (size)
+	{
+		size_t avail = kb->rend - kb->rpos;
+		size_t len;
+
+		if (avail)
+		{
+			len = MIN(avail, size);
+
+			memcpy(buf, kb->rpos, len);
+			kb->rpos += len;
+			buf += len;
+			size -= len;
+			total += len;
+			continue;
+		}
+
+		// Big requests skip the buffer
+		if (size >= kb->rsize)
+		{
+			total += kfile_read(kb->ch, buf, size);
+			break;
+		}
+
+		len = kfile_read(kb->ch, kb->rbuf, kb->rsize);
+		kb->rpos = kb->rbuf;
+		kb->rend = kb->rbuf + len;
+		if (!len)
+			break;
+	}
+
+	fd->seek_pos += total;
+	return total;
+}
+
+static size_t kfilebuf_write(struct KFile *fd, const void *_buf, size_t size)
+{
+	KFileBuffered *kb = KFILEBUFFERED_CAST(fd);
+	const uint8_t *buf = (const uint8_t *)_buf;
+	size_t total = 0;
+	// Bytes of this write still in the buffer, at its end
+	size_t queued = 0;
+
+	if (!kb->wbuf)
+	{
+		total = kfile_write(kb->ch, buf, size);
+		fd->seek_pos += total;
+		return total;
+	}
+
+	while (size)
+	{
+		size_t room = kb->wend - kb->wpos;
+
+		if (!room)
+		{
+			int err = kfilebuf_drain(kb);
+
+			// The buffer is drained in order: ours are the last to go
+			queued = MIN(queued, (size_t)(kb->wpos - kb->wbuf));
+			if (err)
+				break;
+			continue;
+		}
+
+		// Big writes go straight to the channel once the buffer is empty
+		if (kb->wpos == kb->wbuf && size >= (size_t)(kb->wend - kb->wbuf))
+		{
+			total += kfile_write(kb->ch, buf, size);
+			break;
+		}
+
+		size_t len = MIN(room, size);
+		memcpy(kb->wpos, buf, len);
+		kb->wpos += len;
+		buf += len;
+		size -= len;
+		total += len;
+		queued += len;
+	}
+
+	if ((kb->flags & KFB_LINEFLUSH) && memchr(_buf, '\n', total)
+		&& kfilebuf_drain(kb) != 0)
+	{
+		/*
+		 * Only report what the channel accepted: drop the part of
+		 * this write that is still in the buffer.
+		 */
+		queued = MIN(queued, (size_t)(kb->wpos - kb->wbuf));
+		kb->wpos -= queued;
+		total -= queued;
+	}
+
+	fd->seek_pos += total;
+	return total;
+}
+
+static int kfilebuf_flush(struct KFile *fd)
+{
+	KFileBuffered *kb = KFILEBUFFERED_CAST(fd);
+
+	if (kfilebuf_drain(kb) != 0)
+		return EOF;
+
+	return kfile_flush(kb->ch);
+}
+
+static kfile_off_t kfilebuf_seek(struct KFile *fd, kfile_off_t offset, KSeekMode whence)
+{
+	KFileBuffered *kb = KFILEBUFFERED_CAST(fd);
+
+	if (kfilebuf_drain(kb) != 0)
+		return EOF;
+
+	// The channel is ahead of the user by the data still buffered
+	if (whence == KSM_SEEK_CUR)
+		offset -= kb->rend - kb->rpos;
+	kb->rpos = kb->rend = kb->rbuf;
+
+	fd->seek_pos = kfile_seek(kb->ch, offset, whence);
+	return fd->seek_pos;
+}
+
+static int kfilebuf_error(struct KFile *fd)
+{
+	return kfile_error(KFILEBUFFERED_CAST(fd)->ch);
+}
+
+static void kfilebuf_clearerr(struct KFile *fd)
+{
+	kfile_clearerr(KFILEBUFFERED_CAST(fd)->ch);
+}
+
+static int kfilebuf_close(struct KFile *fd)
+{
+	KFileBuffered *kb = KFILEBUFFERED_CAST(fd);
+	int err = kfilebuf_drain(kb);
+
+	kb->rpos = kb->rend = kb->rbuf;
+	return kfile_close(kb->ch) | err;
+}
+
+void kfilebuf_init(KFileBuffered *kb, KFile *ch, void *rbuf, size_t rsize,
+	void *wbuf, size_t wsize, int flags)
+{
+	ASSERT(kb);
+	ASSERT(ch);
+	ASSERT(!rbuf || rsize);
+	ASSERT(!wbuf || wsize);
+
+	memset(kb, 0, sizeof(*kb));
+	kfile_init(&kb->fd);
+	DB(kb->fd._type = KFT_KFILEBUFFERED);
+
+	kb->fd.read = kfilebuf_read;
+	kb->fd.write = kfilebuf_write;
+	kb->fd.flush = kfilebuf_flush;
+	kb->fd.seek = kfilebuf_seek;
+	kb->fd.error = kfilebuf_error;
+	kb->fd.clearerr = kfilebuf_clearerr;
+	kb->fd.close = kfilebuf_close;
+
+	kb->ch = ch;
+	kb->flags = flags;
+
+	kb->rbuf = (uint8_t *)rbuf;
+	kb->rsize = rbuf ? rsize : 0;
+	kb->rpos = kb->rend = kb->rbuf;
+
+	kb->wbuf = (uint8_t *)wbuf;
+	kb->wpos = kb->wbuf;
+	kb->wend = wbuf ? kb->wbuf + wsize : kb->wbuf;
+}
@@ -0,0 +1,179 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \defgroup kfile_buffered Buffered KFile stream
+ * \ingroup core
+ * \{
+ *
+ * \brief Read-ahead and write-behind buffering over any KFile.
+ *
+ * Byte oriented consumers (protocol parsers, command lines, formatted
+ * output) access their channel one character at a time. Through the
+ * generic kfile_getc() and kfile_putc() every byte costs a full call
+ * of the channel read or write method.
+ *
+ * A KFileBuffered wraps an existing KFile with a read-ahead buffer and
+ * a write-behind buffer. kfilebuf_getc() and kfilebuf_putc() are inline
+ * and only touch the buffer pointers; the underlying channel is called
+ * only to refill the read buffer or to drain the write buffer.
+ * The wrapper is a KFile itself, so it can also be passed to code that
+ * uses the generic interface.
+ *
+ * Data written is sent to the channel when the write buffer is full, on
+ * kfile_flush() and kfile_close() and, if KFB_LINEFLUSH is set, at the
+ * end of each line.
+ *
+ * \note Refilling asks the channel for a whole buffer of data. On channels
+ *       whose read blocks until the request is completely satisfied, use a
+ *       read timeout or a small read buffer.
+ * \note Reads and writes are buffered independently, as on serial lines;
+ *       on seekable files call kfile_seek() when switching direction.
+ *
+ * Example:
+ * \code
+ * static uint8_t rx_buf[64], tx_buf[64];
+ * KFileBuffered kb;
+ *
+ * kfilebuf_init(&kb, &ser.fd, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf), KFB_LINEFLUSH);
+ *
+ * while ((c = kfilebuf_getc(&kb)) != EOF)
+ * 	parse(c);
+ * \endcode
+ *
+ * $WIZ$ module_name = "kfile_buffered"
+ * $WIZ$ module_depends = "kfile"
+ */
+
+#ifndef IO_KFILE_BUFFERED_H
+#define IO_KFILE_BUFFERED_H
+
+#include <io/kfile.h>
+
+#include <cfg/compiler.h>
+#include <cfg/macros.h>
+
+/**
+ * KFileBuffered flags.
+ * \{
+ */
+#define KFB_LINEFLUSH  BV(0) ///< Drain the write buffer at every '\n'.
+/* \} */
+
+/**
+ * Buffered KFile context.
+ */
+typedef struct KFileBuffered
+{
+	KFile fd;        ///< KFile base class
+	KFile *ch;       ///< Underlying channel
+
+	uint8_t *rbuf;   ///< Read-ahead buffer
+	size_t rsize;    ///< Size of the read-ahead buffer
+	uint8_t *rpos;   ///< Next byte to be read
+	uint8_t *rend;   ///< End of data in the read-ahead buffer
+
+	uint8_t *wbuf;   ///< Write-behind buffer
+	uint8_t *wpos;   ///< Next free byte in the write-behind buffer
+	uint8_t *wend;   ///< End of the write-behind buffer
+
+	int flags;       ///< KFB_* flags
+} KFileBuffered;
+
+/**
+ * ID for buffered KFile.
+ */
+#define KFT_KFILEBUFFERED MAKE_ID('K', 'F', 'B', 'F')
+
+/**
+ * Convert + ASSERT from generic KFile to KFileBuffered.
+ */
+INLINE KFileBuffered * KFILEBUFFERED_CAST(KFile *fd)
+{
+	ASSERT(fd->_type == KFT_KFILEBUFFERED);
+	return (KFileBuffered *)fd;
+}
+
+int kfilebuf_fill(KFileBuffered *kb);
+int kfilebuf_drainPutc(int c, KFileBuffered *kb);
+
+/**
+ * Read a character from the buffered stream.
+ *
+ * \return the character read, or EOF if the channel has no more data
+ *         or an error occurred.
+ */
+INLINE int kfilebuf_getc(KFileBuffered *kb)
+{
+	if (LIKELY(kb->rpos < kb->rend))
+	{
+		kb->fd.seek_pos++;
+		return *kb->rpos++;
+	}
+
+	return kfilebuf_fill(kb);
+}
+
+/**
+ * Write a character to the buffered stream.
+ *
+ * \return the character written, or EOF on errors.
+ */
+INLINE int kfilebuf_putc(int c, KFileBuffered *kb)
+{
+	if (LIKELY(kb->wpos < kb->wend)
+		&& (c != '\n' || !(kb->flags & KFB_LINEFLUSH)))
+	{
+		*kb->wpos++ = (uint8_t)c;
+		kb->fd.seek_pos++;
+		return (unsigned char)c;
+	}
+
+	return kfilebuf_drainPutc(c, kb);
+}
+
+/**
+ * Init a buffered stream over KFile \a ch.
+ *
+ * \param kb KFileBuffered context.
+ * \param ch underlying channel.
+ * \param rbuf read-ahead buffer, NULL to disable read buffering.
+ * \param rsize size of \a rbuf.
+ * \param wbuf write-behind buffer, NULL to disable write buffering.
+ * \param wsize size of \a wbuf.
+ * \param flags KFB_* flags.
+ */
+void kfilebuf_init(KFileBuffered *kb, KFile *ch, void *rbuf, size_t rsize,
+	void *wbuf, size_t wsize, int flags);
+
+/** \} */ //defgroup kfile_buffered
+
+#endif /* IO_KFILE_BUFFERED_H */
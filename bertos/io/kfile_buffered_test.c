@@ -0,0 +1,303 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Buffered KFile test and NMEA parsing benchmark.
+ *
+ * notest:avr
+ */
+
+#include "kfile_buffered.h"
+
+#include <struct/kfile_mem.h>
+#include <net/nmea.h>
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+
+#include <os/hptime.h>
+
+#include <string.h>
+
+#define DATA_LEN      1000
+#define CAPTURE_LEN   (32 * 1024L)
+#define ROUNDS        20
+
+/* avoid compiler warnings... */
+int kfilebuf_testSetup(void);
+int kfilebuf_testTearDown(void);
+int kfilebuf_testRun(void);
+
+static const char sentences[] =
+	"$GPGGA,100019.604,4351.1480,N,01108.8750,E,1,03,16.8,0.0,M,45.2,M,,*64\r\n"
+	"$GPRMC,100019.604,A,4351.1480,N,01108.8750,E,2.03,134.29,131009,,,A*6F\r\n"
+	"$GPVTG,134.29,T,,,2.03,N,3.75,K,A*7D\r\n"
+	"$GPGSA,A,2,09,27,29,,,,,,,,,,16.8,16.8,0.0*34\r\n"
+	"$GPGSV,3,1,09,2,34,087,,4,20,052,,9,32,142,31,14,38,267,*49\r\n"
+	"$GPRMC,100020.604,A,4351.1491,N,01108.8751,E,2.11,134.29,131009,,,A*67\r\n";
+
+static uint8_t capture[CAPTURE_LEN];
+static uint8_t data[DATA_LEN];
+static uint8_t out[DATA_LEN];
+static uint8_t rx_buf[64];
+static uint8_t tx_buf[32];
+
+static KFileMem mem;
+static KFileBuffered kb;
+
+static nmeap_context_t nmea;
+static NmeaGga gga;
+static NmeaRmc rmc;
+static NmeaVtg vtg;
+static int parsed;
+
+static void count_callout(UNUSED_ARG(nmeap_context_t *, context),
+	UNUSED_ARG(void *, data), UNUSED_ARG(void *, user_data))
+{
+	parsed++;
+}
+
+static void kfilebuf_testRead(void)
+{
+	uint8_t buf[100];
+	int c;
+
+	kfilemem_init(&mem, data, sizeof(data));
+	kfilebuf_init(&kb, &mem.fd, rx_buf, sizeof(rx_buf), NULL, 0, 0);
+
+	for (int i = 0; i < 10; i++)
+		ASSERT(kfilebuf_getc(&kb) == data[i]);
+	ASSERT(kb.fd.seek_pos == 10);
+
+	// Mixed with block reads, both smaller and bigger than the buffer
+	ASSERT(kfile_read(&kb.fd, buf, 5) == 5);
+	ASSERT(memcmp(buf, data + 10, 5) == 0);
+	ASSERT(kfile_read(&kb.fd, buf, sizeof(buf)) == sizeof(buf));
+	ASSERT(memcmp(buf, data + 15, sizeof(buf)) == 0);
+	ASSERT(kfile_getc(&kb.fd) == data[115]);
+	ASSERT(kb.fd.seek_pos == 116);
+
+	// Relative seek takes read-ahead data into account
+	ASSERT(kfile_seek(&kb.fd, -16, KSM_SEEK_CUR) == 100);
+	ASSERT(kfilebuf_getc(&kb) == data[100]);
+
+	ASSERT(kfile_seek(&kb.fd, DATA_LEN - 3, KSM_SEEK_SET) == DATA_LEN - 3);
+	for (int i = DATA_LEN - 3; (c = kfilebuf_getc(&kb)) != EOF; i++)
+		ASSERT(c == data[i]);
+	ASSERT(kfile_read(&kb.fd, buf, sizeof(buf)) == 0);
+}
+
+static void kfilebuf_testWrite(void)
+{
+	uint8_t buf[64];
+
+	memset(out, 0, sizeof(out));
+	kfilemem_init(&mem, out, sizeof(out));
+	kfilebuf_init(&kb, &mem.fd, NULL, 0, tx_buf, sizeof(tx_buf), KFB_LINEFLUSH);
+
+	// Nothing reaches the channel until the end of the line
+	for (int i = 0; i < 10; i++)
+		ASSERT(kfilebuf_putc('a' + i, &kb) == 'a' + i);
+	ASSERT(out[0] == 0);
+	ASSERT(kfilebuf_putc('\n', &kb) == '\n');
+	ASSERT(memcmp(out, "abcdefghij\n", 11) == 0);
+	ASSERT(kb.fd.seek_pos == 11);
+
+	// Long writes drain the buffer as it fills
+	ASSERT(kfile_write(&kb.fd, data, 100) == 100);
+	ASSERT(memcmp(out + 11, data, 96) == 0);
+	ASSERT(kfile_flush(&kb.fd) == 0);
+	ASSERT(memcmp(out + 11, data, 100) == 0);
+	ASSERT(kb.fd.seek_pos == 111);
+
+	kb.flags = 0;
+	for (int i = 0; i < 300; i++)
+		ASSERT(kfilebuf_putc(data[i], &kb) == data[i]);
+	ASSERT(kfile_close(&kb.fd) == 0);
+	ASSERT(memcmp(out + 111, data, 300) == 0);
+
+	// Writes beyond the end of the channel are reported
+	kfilemem_init(&mem, out, sizeof(out));
+	kfilebuf_init(&kb, &mem.fd, NULL, 0, tx_buf, sizeof(tx_buf), 0);
+	ASSERT(kfile_seek(&kb.fd, DATA_LEN - 10, KSM_SEEK_SET) == DATA_LEN - 10);
+	ASSERT(kfile_write(&kb.fd, data, 20) == 20);
+	ASSERT(kfile_flush(&kb.fd) == EOF);
+
+	// Line flushing reports only what the channel has accepted
+	kfilemem_init(&mem, out, sizeof(out));
+	kfilebuf_init(&kb, &mem.fd, NULL, 0, tx_buf, sizeof(tx_buf), KFB_LINEFLUSH);
+	ASSERT(kfile_seek(&kb.fd, DATA_LEN - 4, KSM_SEEK_SET) == DATA_LEN - 4);
+	ASSERT(kfile_write(&kb.fd, "ab\ncd\n", 6) == 4);
+	ASSERT(kb.fd.seek_pos == DATA_LEN);
+	ASSERT(memcmp(out + DATA_LEN - 4, "ab\nc", 4) == 0);
+	ASSERT(kfilebuf_putc('\n', &kb) == EOF);
+	ASSERT(kb.fd.seek_pos == DATA_LEN);
+	ASSERT(kfile_flush(&kb.fd) == 0);
+
+	// Partial line flush after a full buffer has already been drained
+	memset(out, 0, sizeof(out));
+	kfilemem_init(&mem, out, sizeof(tx_buf) + 8);
+	kfilebuf_init(&kb, &mem.fd, NULL, 0, tx_buf, sizeof(tx_buf), KFB_LINEFLUSH);
+	memcpy(buf, data, sizeof(buf));
+	buf[5] = '\n';
+	ASSERT(kfile_write(&kb.fd, buf, sizeof(tx_buf) + 18) == sizeof(tx_buf) + 8);
+	ASSERT(kb.fd.seek_pos == sizeof(tx_buf) + 8);
+	ASSERT(memcmp(out, buf, sizeof(tx_buf) + 8) == 0);
+	ASSERT(kfile_flush(&kb.fd) == 0);
+
+	// Data buffered by earlier writes reaches the channel first
+	kfilemem_init(&mem, out, 25);
+	kfilebuf_init(&kb, &mem.fd, NULL, 0, tx_buf, sizeof(tx_buf), KFB_LINEFLUSH);
+	for (int i = 0; i < 5; i++)
+		ASSERT(kfilebuf_putc('a' + i, &kb) == 'a' + i);
+	ASSERT(kfile_write(&kb.fd, buf, 30) == 20);
+	ASSERT(kb.fd.seek_pos == 25);
+	ASSERT(memcmp(out, "abcde", 5) == 0);
+	ASSERT(memcmp(out + 5, buf, 20) == 0);
+	ASSERT(kfile_flush(&kb.fd) == 0);
+}
+
+static hptime_t parseDirect(void)
+{
+	hptime_t start = hptime_get();
+	int c;
+
+	kfile_seek(&mem.fd, 0, KSM_SEEK_SET);
+	while ((c = kfile_getc(&mem.fd)) != EOF)
+		nmeap_parse(&nmea, c);
+
+	return hptime_get() - start;
+}
+
+static hptime_t parseBuffered(void)
+{
+	hptime_t start = hptime_get();
+	int c;
+
+	kfile_seek(&kb.fd, 0, KSM_SEEK_SET);
+	while ((c = kfilebuf_getc(&kb)) != EOF)
+		nmeap_parse(&nmea, c);
+
+	return hptime_get() - start;
+}
+
+static hptime_t readDirect(void)
+{
+	hptime_t start = hptime_get();
+	long sum = 0;
+	int c;
+
+	kfile_seek(&mem.fd, 0, KSM_SEEK_SET);
+	while ((c = kfile_getc(&mem.fd)) != EOF)
+		sum += c;
+
+	ASSERT(sum);
+	return hptime_get() - start;
+}
+
+static hptime_t readBuffered(void)
+{
+	hptime_t start = hptime_get();
+	long sum = 0;
+	int c;
+
+	kfile_seek(&kb.fd, 0, KSM_SEEK_SET);
+	while ((c = kfilebuf_getc(&kb)) != EOF)
+		sum += c;
+
+	ASSERT(sum);
+	return hptime_get() - start;
+}
+
+/*
+ * Parse an NMEA capture from memory, reading it byte by byte with and
+ * without the buffered stream.
+ */
+static void kfilebuf_testNmea(void)
+{
+	hptime_t direct = 0, buffered = 0, raw_direct = 0, raw_buffered = 0;
+	int direct_parsed, len = sizeof(sentences) - 1;
+
+	for (long i = 0; i + len <= CAPTURE_LEN; i += len)
+		memcpy(capture + i, sentences, len);
+
+	kfilemem_init(&mem, capture, (CAPTURE_LEN / len) * len);
+	kfilebuf_init(&kb, &mem.fd, rx_buf, sizeof(rx_buf), NULL, 0, 0);
+
+	nmeap_init(&nmea, NULL);
+	nmeap_addParser(&nmea, "GPGGA", nmea_gpgga, count_callout, &gga);
+	nmeap_addParser(&nmea, "GPRMC", nmea_gprmc, count_callout, &rmc);
+	nmeap_addParser(&nmea, "GPVTG", nmea_gpvtg, count_callout, &vtg);
+
+	for (int i = 0; i < ROUNDS; i++)
+	{
+		direct += parseDirect();
+		raw_direct += readDirect();
+	}
+	direct_parsed = parsed;
+
+	parsed = 0;
+	for (int i = 0; i < ROUNDS; i++)
+	{
+		buffered += parseBuffered();
+		raw_buffered += readBuffered();
+	}
+	ASSERT(parsed == direct_parsed);
+	ASSERT(parsed == ROUNDS * 4 * (CAPTURE_LEN / len));
+
+	kprintf("NMEA capture, %d x %ld bytes, %d sentences parsed:\n",
+		ROUNDS, (long)mem.fd.size, parsed);
+	kprintf(" kfile_getc:     read %ld us, read and parse %ld us\n", (long)raw_direct, (long)direct);
+	kprintf(" kfilebuf_getc:  read %ld us, read and parse %ld us\n", (long)raw_buffered, (long)buffered);
+}
+
+int kfilebuf_testSetup(void)
+{
+	kdbg_init();
+	for (int i = 0; i < DATA_LEN; i++)
+		data[i] = i * 7 + 3;
+	return 0;
+}
+
+int kfilebuf_testRun(void)
+{
+	kfilebuf_testRead();
+	kfilebuf_testWrite();
+	kfilebuf_testNmea();
+	return 0;
+}
+
+int kfilebuf_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(kfilebuf);
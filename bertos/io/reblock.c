@@ -30,12 +30,24 @@
  *
  * -->
  *
- * \brief KBlock block size reducer
+ * \brief KBlock block size adapter
  *
- * This module allows access to a KBlock device using a smaller block
- * size than the native one exported by the device.
- * Note that the device being remapped needs either to be opened in buffered
- * mode or to support partial writes.
+ * This module allows access to a KBlock device using a block size
+ * different from the native one exported by the device.
+ *
+ * When the new block size is a submultiple of the native one, each
+ * logical block is a slice of a native block.
+ * With reblock_init() accesses are passed straight to the native
+ * device, which needs either to be opened in buffered mode or to support
+ * partial writes.
+ * With reblock_initBuffered() up to CONFIG_REBLOCK_SLOTS native blocks are
+ * kept in memory and written back only when a slot is reused or on
+ * kblock_flush(), so that interleaved writes to different native blocks
+ * don't cause a native flush and reload on every access.
+ *
+ * When the new block size is a multiple of the native one, each logical
+ * block spans several native blocks, and whole block accesses are sent
+ * to the native device as a single range transfer.
  *
  * \author Stefano Fedrigo <aleph@develer.com>
  *
@@ -50,8 +62,8 @@ static size_t reblock_readDirect(struct KBlock *b, block_idx_t idx, void *buf, s
 {
 	Reblock *r = REBLOCK_CAST(b);
 
-	offset += idx % (r->native_fd->blk_size / r->fd.blk_size) * r->fd.blk_size;
-	idx    =  idx / (r->native_fd->blk_size / r->fd.blk_size);
+	offset += idx % r->ratio * r->fd.blk_size;
+	idx    =  idx / r->ratio;
 
 	return kblock_read(r->native_fd, idx, buf, offset, size);
 }
@@ -61,13 +73,210 @@ static size_t reblock_writeDirect(struct KBlock *b, block_idx_t idx, const void
 {
 	Reblock *r = REBLOCK_CAST(b);
 
-	offset += idx % (r->native_fd->blk_size / r->fd.blk_size) * r->fd.blk_size;
-	idx    =  idx / (r->native_fd->blk_size / r->fd.blk_size);
+	offset += idx % r->ratio * r->fd.blk_size;
+	idx    =  idx / r->ratio;
 
 	return kblock_write(r->native_fd, idx, buf, offset, size);
 }
 
 
+/*
+ * Buffered mode: native blocks staged in slots.
+ */
+INLINE uint8_t *reblock_slotBuf(Reblock *r, ReblockSlot *slot)
+{
+	return r->slot_buf + (slot - r->slots) * r->native_fd->blk_size;
+}
+
+static ReblockSlot *reblock_findSlot(Reblock *r, block_idx_t native_idx)
+{
+	for (size_t i = 0; i < r->num_slots; i++)
+		if (r->slots[i].used && r->slots[i].idx == native_idx)
+			return &r->slots[i];
+
+	return NULL;
+}
+
+static int reblock_storeSlot(Reblock *r, ReblockSlot *slot)
+{
+	if (slot->used && slot->dirty)
+	{
+		if (kblock_writeRange(r->native_fd, slot->idx, reblock_slotBuf(r, slot), 1) != 1)
+			return EOF;
+		slot->dirty = false;
+	}
+	return 0;
+}
+
+/*
+ * Return the slot holding \a native_idx, loading it in the least
+ * recently used slot if needed.
+ */
+static ReblockSlot *reblock_loadSlot(Reblock *r, block_idx_t native_idx)
+{
+	ReblockSlot *slot = reblock_findSlot(r, native_idx);
+
+	if (!slot)
+	{
+		slot = &r->slots[0];
+		for (size_t i = 0; i < r->num_slots && slot->used; i++)
+			if (!r->slots[i].used || r->slots[i].stamp < slot->stamp)
+				slot = &r->slots[i];
+
+		if (reblock_storeSlot(r, slot) != 0)
+			return NULL;
+
+		slot->used = false;
+		if (kblock_readRange(r->native_fd, native_idx, reblock_slotBuf(r, slot), 1) != 1)
+			return NULL;
+
+		slot->idx = native_idx;
+		slot->used = true;
+		slot->dirty = false;
+	}
+
+	slot->stamp = ++r->clock;
+	return slot;
+}
+
+static size_t reblock_bufReadDirect(struct KBlock *b, block_idx_t idx, void *buf, size_t offset, size_t size)
+{
+	Reblock *r = REBLOCK_CAST(b);
+	ReblockSlot *slot;
+
+	offset += idx % r->ratio * r->fd.blk_size;
+	idx    =  idx / r->ratio;
+
+	/* Read misses don't take a slot, they go straight to the device */
+	slot = reblock_findSlot(r, idx);
+	if (!slot)
+		return kblock_read(r->native_fd, idx, buf, offset, size);
+
+	slot->stamp = ++r->clock;
+	memcpy(buf, reblock_slotBuf(r, slot) + offset, size);
+	return size;
+}
+
+static size_t reblock_bufWriteDirect(struct KBlock *b, block_idx_t idx, const void *buf, size_t offset, size_t size)
+{
+	Reblock *r = REBLOCK_CAST(b);
+	ReblockSlot *slot;
+
+	offset += idx % r->ratio * r->fd.blk_size;
+	idx    =  idx / r->ratio;
+
+	slot = reblock_loadSlot(r, idx);
+	if (!slot)
+		return 0;
+
+	memcpy(reblock_slotBuf(r, slot) + offset, buf, size);
+	slot->dirty = true;
+	return size;
+}
+
+
+/*
+ * Aggregate mode: one logical block spans several native blocks.
+ */
+static size_t reblock_aggrReadDirect(struct KBlock *b, block_idx_t idx, void *buf, size_t offset, size_t size)
+{
+	Reblock *r = REBLOCK_CAST(b);
+	size_t native_size = r->native_fd->blk_size;
+	block_idx_t native_idx = idx * r->ratio + offset / native_size;
+	uint8_t *p = (uint8_t *)buf;
+	size_t total = 0;
+
+	offset %= native_size;
+	while (size)
+	{
+		size_t len;
+
+		if (offset == 0 && size >= native_size)
+		{
+			block_idx_t count = size / native_size;
+
+			if (kblock_readRange(r->native_fd, native_idx, p, count) != count)
+				break;
+			len = count * native_size;
+			native_idx += count;
+		}
+		else
+		{
+			len = MIN(size, native_size - offset);
+			if (kblock_read(r->native_fd, native_idx, p, offset, len) != len)
+				break;
+			native_idx++;
+			offset = 0;
+		}
+		p += len;
+		size -= len;
+		total += len;
+	}
+	return total;
+}
+
+static size_t reblock_aggrWriteDirect(struct KBlock *b, block_idx_t idx, const void *buf, size_t offset, size_t size)
+{
+	Reblock *r = REBLOCK_CAST(b);
+	size_t native_size = r->native_fd->blk_size;
+	block_idx_t native_idx = idx * r->ratio + offset / native_size;
+	const uint8_t *p = (const uint8_t *)buf;
+	size_t total = 0;
+
+	offset %= native_size;
+	while (size)
+	{
+		size_t len;
+
+		if (offset == 0 && size >= native_size)
+		{
+			block_idx_t count = size / native_size;
+
+			if (kblock_writeRange(r->native_fd, native_idx, p, count) != count)
+				break;
+			len = count * native_size;
+			native_idx += count;
+		}
+		else
+		{
+			len = MIN(size, native_size - offset);
+			if (kblock_write(r->native_fd, native_idx, p, offset, len) != len)
+				break;
+			native_idx++;
+			offset = 0;
+		}
+		p += len;
+		size -= len;
+		total += len;
+	}
+	return total;
+}
+
+static block_idx_t reblock_aggrReadRange(struct KBlock *b, block_idx_t idx, void *buf, block_idx_t count)
+{
+	Reblock *r = REBLOCK_CAST(b);
+	return kblock_readRange(r->native_fd, idx * r->ratio, buf, count * r->ratio) / r->ratio;
+}
+
+static block_idx_t reblock_aggrWriteRange(struct KBlock *b, block_idx_t idx, const void *buf, block_idx_t count)
+{
+	Reblock *r = REBLOCK_CAST(b);
+	return kblock_writeRange(r->native_fd, idx * r->ratio, buf, count * r->ratio) / r->ratio;
+}
+
+
+static int reblock_flush(struct KBlock *b)
+{
+	Reblock *r = REBLOCK_CAST(b);
+	int err = 0;
+
+	for (size_t i = 0; i < r->num_slots; i++)
+		if (reblock_storeSlot(r, &r->slots[i]) != 0)
+			err = EOF;
+
+	return (kblock_flush(r->native_fd) == 0) ? err : EOF;
+}
+
 static int reblock_error(struct KBlock *b)
 {
 	return kblock_error(REBLOCK_CAST(b)->native_fd);
@@ -91,10 +300,60 @@ static const KBlockVTable reblock_vt =
 
 	.error = reblock_error,
 	.clearerr = reblock_clearerr,
+	.flush = reblock_flush,
+	.close = reblock_close,
+};
+
+static const KBlockVTable reblock_buffered_vt =
+{
+	.readDirect = reblock_bufReadDirect,
+	.writeDirect = reblock_bufWriteDirect,
+
+	.error = reblock_error,
+	.clearerr = reblock_clearerr,
+	.flush = reblock_flush,
+	.close = reblock_close,
+};
+
+static const KBlockVTable reblock_aggregate_vt =
+{
+	.readDirect = reblock_aggrReadDirect,
+	.writeDirect = reblock_aggrWriteDirect,
+	.readRange = reblock_aggrReadRange,
+	.writeRange = reblock_aggrWriteRange,
+
+	.error = reblock_error,
+	.clearerr = reblock_clearerr,
+	.flush = reblock_flush,
 	.close = reblock_close,
 };
 
 
+static void reblock_setup(Reblock *rbl, KBlock *native_fd, size_t new_blk_size)
+{
+	ASSERT(new_blk_size);
+
+	memset(rbl, 0, sizeof(Reblock));
+
+	DB(rbl->fd.priv.type = KBT_REBLOCK);
+
+	rbl->fd.blk_size = new_blk_size;
+	rbl->native_fd = native_fd;
+
+	if (new_blk_size <= native_fd->blk_size)
+	{
+		ASSERT(native_fd->blk_size % new_blk_size == 0);
+		rbl->ratio = native_fd->blk_size / new_blk_size;
+		rbl->fd.blk_cnt = native_fd->blk_cnt * rbl->ratio;
+	}
+	else
+	{
+		ASSERT(new_blk_size % native_fd->blk_size == 0);
+		rbl->ratio = new_blk_size / native_fd->blk_size;
+		rbl->fd.blk_cnt = native_fd->blk_cnt / rbl->ratio;
+	}
+}
+
 /*
  * Initialize reblock device.
  *
@@ -102,25 +361,57 @@ static const KBlockVTable reblock_vt =
  * \param native_fd     kblock descriptor of the reblocked device
  * \param new_blk_size  new block size to export
  *
- * \note new block size is required to be a submultiple of the
- *       native device block size.
+ * \note new block size is required to be a submultiple or a multiple
+ *       of the native device block size.
+ *       If it is a submultiple, the native device needs either to be
+ *       buffered or to support partial writes.
+ *       If it is a multiple, partial writes of the new blocks are
+ *       available only if the native device supports them.
  */
 void reblock_init(Reblock *rbl, KBlock *native_fd, size_t new_blk_size)
 {
-	ASSERT(new_blk_size);
-	ASSERT(new_blk_size < native_fd->blk_size);
-	ASSERT(native_fd->blk_size % new_blk_size == 0);
-	ASSERT(kblock_buffered(native_fd) || kblock_partialWrite(native_fd));
+	reblock_setup(rbl, native_fd, new_blk_size);
 
-	memset(rbl, 0, sizeof(Reblock));
+	if (new_blk_size <= native_fd->blk_size)
+	{
+		ASSERT(kblock_buffered(native_fd) || kblock_partialWrite(native_fd));
+		rbl->fd.priv.flags |= KB_PARTIAL_WRITE;
+		rbl->fd.priv.vt = &reblock_vt;
+	}
+	else
+	{
+		if (kblock_buffered(native_fd) || kblock_partialWrite(native_fd))
+			rbl->fd.priv.flags |= KB_PARTIAL_WRITE;
+		rbl->fd.priv.vt = &reblock_aggregate_vt;
+	}
+}
 
-	DB(rbl->fd.priv.type = KBT_REBLOCK);
+/*
+ * Initialize reblock device with write-back buffering.
+ *
+ * \param rbl           kblock reblock device
+ * \param native_fd     kblock descriptor of the reblocked device
+ * \param new_blk_size  new block size to export
+ * \param buf           buffer for the native block slots
+ * \param buf_size      size of \a buf, one native block for each slot
+ *
+ * \note new block size is required to be a submultiple of the native
+ *       device block size. Native blocks are always read and written
+ *       entirely, so the native device needs no partial write support.
+ *       Modifications reach the device when a slot is reused or on
+ *       kblock_flush().
+ */
+void reblock_initBuffered(Reblock *rbl, KBlock *native_fd, size_t new_blk_size, void *buf, size_t buf_size)
+{
+	ASSERT(buf);
+	ASSERT(new_blk_size <= native_fd->blk_size);
 
-	rbl->fd.blk_size = new_blk_size;
-	rbl->fd.blk_cnt = native_fd->blk_cnt * (native_fd->blk_size / new_blk_size);
+	reblock_setup(rbl, native_fd, new_blk_size);
 
-	rbl->fd.priv.flags |= KB_PARTIAL_WRITE;
-	rbl->fd.priv.vt = &reblock_vt;
+	rbl->slot_buf = (uint8_t *)buf;
+	rbl->num_slots = MIN(buf_size / native_fd->blk_size, (size_t)CONFIG_REBLOCK_SLOTS);
+	ASSERT(rbl->num_slots);
 
-	rbl->native_fd = native_fd;
+	rbl->fd.priv.flags |= KB_PARTIAL_WRITE;
+	rbl->fd.priv.vt = &reblock_buffered_vt;
 }
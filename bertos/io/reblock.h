@@ -30,12 +30,13 @@
  *
  * -->
  *
- * \brief KBlock block size reducer
+ * \brief KBlock block size adapter
  *
  * \author Stefano Fedrigo <aleph@develer.com>
  *
  * $WIZ$ module_name = "reblock"
  * $WIZ$ module_depends = "kblock"
+ * $WIZ$ module_configuration = "bertos/cfg/cfg_reblock.h"
  */
 
 #ifndef REBLOCK_H
@@ -43,11 +44,30 @@
 
 #include "kblock.h"
 
+#include "cfg/cfg_reblock.h"
+
+
+/**
+ * State of a native block staged in memory.
+ */
+typedef struct ReblockSlot
+{
+	block_idx_t idx;    ///< Native block held by the slot.
+	uint32_t    stamp;  ///< Last access time, for LRU replacement.
+	bool        used;   ///< Slot holds valid data.
+	bool        dirty;  ///< Slot content differs from the native block.
+} ReblockSlot;
 
 typedef struct Reblock
 {
 	KBlock  fd;
 	KBlock *native_fd;
+
+	size_t   ratio;      ///< Native blocks per logical block, or vice versa.
+	uint8_t *slot_buf;   ///< Slot buffers, one native block each.
+	size_t   num_slots;  ///< Slots in use, 0 if unbuffered.
+	uint32_t clock;      ///< LRU time reference.
+	ReblockSlot slots[CONFIG_REBLOCK_SLOTS];
 } Reblock;
 
 #define KBT_REBLOCK MAKE_ID('R', 'E', 'B', 'L')
@@ -59,6 +79,7 @@ INLINE Reblock *REBLOCK_CAST(KBlock *b)
 	return (Reblock *)b;
 }
 
-void reblock_init(Reblock *rbl, KBlock *native_fd, size_t native_blk_size);
+void reblock_init(Reblock *rbl, KBlock *native_fd, size_t new_blk_size);
+void reblock_initBuffered(Reblock *rbl, KBlock *native_fd, size_t new_blk_size, void *buf, size_t buf_size);
 
 #endif /* REBLOCK_H */
@@ -0,0 +1,285 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Reblock test: native block accesses for logical access patterns.
+ *
+ * $test$: cp bertos/cfg/cfg_reblock.h $cfgdir/
+ * $test$: echo "#undef CONFIG_REBLOCK_SLOTS" >> $cfgdir/cfg_reblock.h
+ * $test$: echo "#define CONFIG_REBLOCK_SLOTS 3" >> $cfgdir/cfg_reblock.h
+ */
+
+#include <io/reblock.h>
+#include <io/kblock_ram.h>
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define NATIVE_SIZE   512
+#define NATIVE_CNT    32
+#define LOGIC_SIZE    128
+#define RATIO         (NATIVE_SIZE / LOGIC_SIZE)
+#define ROUNDS        64
+
+/* avoid compiler warnings... */
+int reblock_testSetup(void);
+int reblock_testTearDown(void);
+int reblock_testRun(void);
+
+/* One more block for the page buffer of the buffered ram device */
+static uint8_t disk[(NATIVE_CNT + 1) * NATIVE_SIZE];
+static uint8_t reference[NATIVE_CNT * NATIVE_SIZE];
+static uint8_t slots[CONFIG_REBLOCK_SLOTS * NATIVE_SIZE];
+static KBlockRam ram;
+static Reblock rbl;
+
+/*
+ * Native device wrapper counting block transfers.
+ */
+static const KBlockVTable *ram_vt;
+static KBlockVTable count_vt;
+static struct
+{
+	unsigned loads;
+	unsigned stores;
+} native_ops;
+
+static size_t count_readDirect(struct KBlock *b, block_idx_t idx, void *buf, size_t offset, size_t size)
+{
+	native_ops.loads++;
+	return ram_vt->readDirect(b, idx, buf, offset, size);
+}
+
+static size_t count_writeDirect(struct KBlock *b, block_idx_t idx, const void *buf, size_t offset, size_t size)
+{
+	native_ops.stores++;
+	return ram_vt->writeDirect(b, idx, buf, offset, size);
+}
+
+static block_idx_t count_readRange(struct KBlock *b, block_idx_t idx, void *buf, block_idx_t count)
+{
+	native_ops.loads++;
+	return ram_vt->readRange(b, idx, buf, count);
+}
+
+static block_idx_t count_writeRange(struct KBlock *b, block_idx_t idx, const void *buf, block_idx_t count)
+{
+	native_ops.stores++;
+	return ram_vt->writeRange(b, idx, buf, count);
+}
+
+static int count_load(struct KBlock *b, block_idx_t idx)
+{
+	native_ops.loads++;
+	return ram_vt->load(b, idx);
+}
+
+static int count_store(struct KBlock *b, block_idx_t idx)
+{
+	native_ops.stores++;
+	return ram_vt->store(b, idx);
+}
+
+static void initNative(size_t blk_size, bool buffered)
+{
+	memset(disk, 0, sizeof(disk));
+	memset(reference, 0, sizeof(reference));
+	kblockram_init(&ram, disk, buffered ? sizeof(disk) : sizeof(reference), blk_size, buffered, false);
+
+	ram_vt = ram.b.priv.vt;
+	count_vt = *ram_vt;
+	count_vt.readDirect = count_readDirect;
+	count_vt.writeDirect = count_writeDirect;
+	count_vt.readRange = ram_vt->readRange ? count_readRange : NULL;
+	count_vt.writeRange = ram_vt->writeRange ? count_writeRange : NULL;
+	count_vt.load = ram_vt->load ? count_load : NULL;
+	count_vt.store = ram_vt->store ? count_store : NULL;
+	ram.b.priv.vt = &count_vt;
+
+	memset(&native_ops, 0, sizeof(native_ops));
+}
+
+static void writeLogic(block_idx_t idx, uint8_t val, size_t offset, size_t size)
+{
+	uint8_t buf[NATIVE_SIZE];
+
+	memset(buf, val, size);
+	ASSERT(kblock_write(&rbl.fd, idx, buf, offset, size) == size);
+	memset(reference + idx * rbl.fd.blk_size + offset, val, size);
+}
+
+static void checkLogic(block_idx_t idx)
+{
+	uint8_t buf[NATIVE_SIZE];
+
+	ASSERT(kblock_read(&rbl.fd, idx, buf, 0, rbl.fd.blk_size) == rbl.fd.blk_size);
+	ASSERT(memcmp(buf, reference + idx * rbl.fd.blk_size, rbl.fd.blk_size) == 0);
+}
+
+static void checkNative(void)
+{
+	const uint8_t *membuf = kblock_buffered(&ram.b) ? disk + NATIVE_SIZE : disk;
+	ASSERT(memcmp(membuf, reference, ram.b.blk_cnt * ram.b.blk_size) == 0);
+}
+
+/*
+ * Write logical blocks living in two distant native blocks, alternating
+ * between them.
+ */
+static void interleavedWrites(void)
+{
+	for (int i = 0; i < ROUNDS; i++)
+	{
+		writeLogic(0 * RATIO + i % RATIO, i, 0, LOGIC_SIZE);
+		writeLogic(5 * RATIO + i % RATIO, i + 1, 0, LOGIC_SIZE);
+	}
+}
+
+static void reblock_testInterleaved(void)
+{
+	unsigned loads, stores;
+
+	// Single native buffer
+	initNative(NATIVE_SIZE, true);
+	reblock_init(&rbl, &ram.b, LOGIC_SIZE);
+	interleavedWrites();
+	ASSERT(kblock_flush(&rbl.fd) == 0);
+	checkNative();
+	loads = native_ops.loads;
+	stores = native_ops.stores;
+
+	// Two native blocks staged
+	initNative(NATIVE_SIZE, false);
+	reblock_initBuffered(&rbl, &ram.b, LOGIC_SIZE, slots, 2 * NATIVE_SIZE);
+	interleavedWrites();
+	ASSERT(native_ops.loads == 2);
+	ASSERT(native_ops.stores == 0);
+	for (int i = 0; i < RATIO; i++)
+	{
+		checkLogic(i);
+		checkLogic(5 * RATIO + i);
+	}
+	ASSERT(native_ops.loads == 2);
+	ASSERT(kblock_flush(&rbl.fd) == 0);
+	ASSERT(native_ops.stores == 2);
+	checkNative();
+
+	kprintf("%d interleaved writes: single buffer %u loads, %u stores; "
+		"2 slots %u loads, %u stores\n",
+		2 * ROUNDS, loads, stores, native_ops.loads, native_ops.stores);
+}
+
+/*
+ * Random accesses over more native blocks than slots, checked against
+ * a reference image.
+ */
+static void reblock_testRandom(void)
+{
+	initNative(NATIVE_SIZE, false);
+	reblock_initBuffered(&rbl, &ram.b, LOGIC_SIZE, slots, sizeof(slots));
+	ASSERT(rbl.num_slots == CONFIG_REBLOCK_SLOTS);
+
+	srand(7);
+	for (int i = 0; i < 2000; i++)
+	{
+		// Stay on a few native blocks, to get both hits and evictions
+		block_idx_t idx = rand() % (RATIO * (CONFIG_REBLOCK_SLOTS + 2));
+		size_t offset = rand() % LOGIC_SIZE;
+		size_t size = rand() % (LOGIC_SIZE - offset) + 1;
+
+		if (rand() % 3)
+			writeLogic(idx, rand(), offset, size);
+		else
+			checkLogic(idx);
+	}
+	ASSERT(kblock_close(&rbl.fd) == 0);
+	checkNative();
+	kprintf("2000 random accesses: %u loads, %u stores\n",
+		native_ops.loads, native_ops.stores);
+}
+
+/*
+ * Logical blocks bigger than the native ones.
+ */
+static void reblock_testAggregate(void)
+{
+	uint8_t buf[3 * NATIVE_SIZE];
+	const size_t native_size = LOGIC_SIZE;
+
+	initNative(native_size, false);
+	reblock_init(&rbl, &ram.b, NATIVE_SIZE);
+	ASSERT(rbl.fd.blk_cnt == ram.b.blk_cnt / RATIO);
+	ASSERT(kblock_partialWrite(&rbl.fd));
+
+	// A whole logical block is a single native transfer
+	for (block_idx_t i = 0; i < rbl.fd.blk_cnt; i++)
+		writeLogic(i, i + 1, 0, NATIVE_SIZE);
+	ASSERT(native_ops.stores == rbl.fd.blk_cnt);
+
+	// Partial write across native blocks
+	native_ops.stores = 0;
+	writeLogic(2, 0xaa, native_size - 10, native_size + 20);
+	ASSERT(native_ops.stores == 3);
+
+	native_ops.loads = 0;
+	ASSERT(kblock_readRange(&rbl.fd, 1, buf, 3) == 3);
+	ASSERT(native_ops.loads == 1);
+	ASSERT(memcmp(buf, reference + NATIVE_SIZE, sizeof(buf)) == 0);
+
+	ASSERT(kblock_read(&rbl.fd, 2, buf, native_size - 10, native_size + 20) == native_size + 20);
+	ASSERT(memcmp(buf, reference + 2 * NATIVE_SIZE + native_size - 10, native_size + 20) == 0);
+	checkLogic(rbl.fd.blk_cnt - 1);
+	checkNative();
+}
+
+int reblock_testSetup(void)
+{
+	kdbg_init();
+	return 0;
+}
+
+int reblock_testRun(void)
+{
+	reblock_testInterleaved();
+	reblock_testRandom();
+	reblock_testAggregate();
+	return 0;
+}
+
+int reblock_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(reblock);
@@ -51,10 +51,229 @@
 #include <kern/proc.h>
 
 #include <cpu/frame.h> /* CPU_STACK_GROWS_UPWARD */
+#include <cpu/irq.h>
+
+#if CONFIG_KERN_MONITOR_TRACE
+	#include <io/kfile.h>
+
+	#include <string.h> /* strlen() */
+#endif
+
+#define MONITOR_STAMPS (CONFIG_KERN_MONITOR_ACCT | CONFIG_KERN_MONITOR_TRACE)
+#define MONITOR_HOOKS  (MONITOR_STAMPS | CONFIG_KERN_MONITOR_GUARD)
 
 /* Access to this list must be protected against the scheduler */
 static List MonitorProcs;
 
+/*
+ * Next process to be checked by the monitor process.
+ *
+ * The monitor releases the CPU between one process and the next, so
+ * monitor_remove() moves this forward if the process goes away.
+ */
+static Node *monitor_next;
+
+#if MONITOR_STAMPS
+
+/* Next process id for the scheduler trace */
+static uint8_t monitor_nextId;
+
+#endif /* MONITOR_STAMPS */
+
+#if CONFIG_KERN_MONITOR_TRACE
+
+STATIC_ASSERT(IS_POW2(CONFIG_KERN_MONITOR_TRACE));
+
+typedef struct MonitorEvent
+{
+	uint32_t stamp;
+	uint32_t arg;
+	uint8_t type;
+	uint8_t id;
+} MonitorEvent;
+
+/*
+ * Trace ring.
+ *
+ * trace_head is a free running counter of the events written so far:
+ * the last CONFIG_KERN_MONITOR_TRACE of them are in the ring, at index
+ * head % size.  Writers fill a slot with interrupts disabled, the
+ * reader never stops them and detects overwritten slots by looking at
+ * trace_head again.
+ */
+static MonitorEvent trace_ring[CONFIG_KERN_MONITOR_TRACE];
+static uint32_t trace_head;
+
+/* Record an event, must be called with interrupts disabled */
+static void monitor_traceEvent(uint8_t type, uint8_t id, uint32_t arg)
+{
+	MonitorEvent *ev = &trace_ring[trace_head & (CONFIG_KERN_MONITOR_TRACE - 1)];
+
+	ev->stamp = timer_hpclock_unlocked();
+	ev->arg = arg;
+	ev->type = type;
+	ev->id = id;
+	trace_head++;
+}
+
+void monitor_trace(uint32_t arg)
+{
+	cpu_flags_t flags;
+
+	IRQ_SAVE_DISABLE(flags);
+	monitor_traceEvent(MONITOR_EV_USER,
+		current_process ? current_process->monitor.id : 0xff, arg);
+	IRQ_RESTORE(flags);
+}
+
+static int monitor_writeLE(struct KFile *fd, uint32_t val, size_t size)
+{
+	uint8_t buf[4];
+
+	for (size_t i = 0; i < size; i++, val >>= 8)
+		buf[i] = (uint8_t)val;
+
+	return kfile_write(fd, buf, size) == size ? 0 : EOF;
+}
+
+int monitor_traceDump(struct KFile *fd)
+{
+	Node *node;
+	uint32_t head, idx, count = 0;
+	uint8_t nproc = 0;
+	int err;
+
+	proc_forbid();
+	FOREACH_NODE(node, &MonitorProcs)
+		nproc++;
+
+	err = monitor_writeLE(fd, MONITOR_TRACE_MAGIC, 4);
+	err |= monitor_writeLE(fd, MONITOR_TRACE_VERSION, 1);
+	err |= monitor_writeLE(fd, nproc, 1);
+	err |= monitor_writeLE(fd, TIMER_HW_HPTICKS_PER_SEC, 4);
+	FOREACH_NODE(node, &MonitorProcs)
+	{
+		Process *p = containerof(node, Process, monitor.link);
+		const char *name = p->monitor.name ? p->monitor.name : "";
+		size_t len = MIN(strlen(name), (size_t)255);
+
+		err |= monitor_writeLE(fd, p->monitor.id, 1);
+		err |= monitor_writeLE(fd, len, 1);
+		if (kfile_write(fd, name, len) != len)
+			err = EOF;
+	}
+	proc_permit();
+
+	/*
+	 * Take a snapshot of the ring limits: the event count is written
+	 * before the events, events lost while dumping are replaced by
+	 * filler entries that the decoder ignores.
+	 */
+	ATOMIC(head = trace_head);
+	idx = head > CONFIG_KERN_MONITOR_TRACE ? head - CONFIG_KERN_MONITOR_TRACE : 0;
+	err |= monitor_writeLE(fd, head - idx, 4);
+
+	for (; idx != head; idx++)
+	{
+		MonitorEvent ev = trace_ring[idx & (CONFIG_KERN_MONITOR_TRACE - 1)];
+		uint32_t now;
+
+		/* Slot overwritten while we were copying it? */
+		MEMORY_BARRIER;
+		ATOMIC(now = trace_head);
+		if (now - idx > CONFIG_KERN_MONITOR_TRACE)
+		{
+			ev.type = 0xff;
+			ev.id = 0xff;
+		}
+		else
+			count++;
+
+		err |= monitor_writeLE(fd, ev.stamp, 4);
+		err |= monitor_writeLE(fd, ev.arg, 4);
+		err |= monitor_writeLE(fd, ev.type, 1);
+		err |= monitor_writeLE(fd, ev.id, 1);
+		if (err)
+			break;
+	}
+
+	return err ? EOF : (int)count;
+}
+
+#define MONITOR_TRACE(type, proc, arg)  monitor_traceEvent((type), (proc)->monitor.id, (arg))
+#else
+#define MONITOR_TRACE(type, proc, arg)  do {} while (0)
+#endif /* CONFIG_KERN_MONITOR_TRACE */
+
+#if MONITOR_HOOKS
+
+void monitor_ready(Process *proc)
+{
+	IRQ_ASSERT_DISABLED();
+	(void)proc;
+#if CONFIG_KERN_MONITOR_ACCT
+	proc->monitor.stamp = timer_hpclock_unlocked();
+#endif
+	MONITOR_TRACE(MONITOR_EV_READY, proc, 0);
+}
+
+#if CONFIG_KERN_MONITOR_GUARD
+/* Last word of the stack, the first one to be overwritten by an overflow */
+INLINE cpu_stack_t *monitor_guard(Process *proc)
+{
+	return CPU_STACK_GROWS_UPWARD ?
+		proc->stack_base + proc->stack_size / sizeof(cpu_stack_t) - 1 :
+		proc->stack_base;
+}
+#endif
+
+void monitor_schedOut(Process *proc, int reason)
+{
+	IRQ_ASSERT_DISABLED();
+
+	/* The process is exiting */
+	if (!proc)
+		return;
+
+#if CONFIG_KERN_MONITOR_GUARD
+	if (proc->stack_base && *monitor_guard(proc) != CONFIG_KERN_STACKFILLCODE)
+	{
+		kprintf("MONITOR: Stack overflow in process '%s'\n", proc->monitor.name);
+		ASSERT2(0, "Stack overflow");
+	}
+#endif
+
+#if CONFIG_KERN_MONITOR_ACCT
+	proc->monitor.run_time += timer_hpclock_unlocked() - proc->monitor.stamp;
+	proc->monitor.switches++;
+	if (reason == MONITOR_OUT_PREEMPTED)
+		proc->monitor.preempted++;
+#endif
+	MONITOR_TRACE(MONITOR_EV_OUT, proc, reason);
+	(void)reason;
+}
+
+void monitor_schedIn(Process *proc)
+{
+	uint32_t latency = 0;
+
+	IRQ_ASSERT_DISABLED();
+	(void)proc;
+
+#if CONFIG_KERN_MONITOR_ACCT
+	uint32_t now = timer_hpclock_unlocked();
+
+	latency = now - proc->monitor.stamp;
+	if (latency > proc->monitor.max_latency)
+		proc->monitor.max_latency = latency;
+	proc->monitor.stamp = now;
+#endif
+	MONITOR_TRACE(MONITOR_EV_IN, proc, latency);
+	(void)latency;
+}
+
+#endif /* MONITOR_HOOKS */
+
 void monitor_init(void)
 {
 	LIST_INIT(&MonitorProcs);
@@ -64,6 +283,20 @@ void monitor_init(void)
 void monitor_add(Process *proc, const char *name)
 {
 	proc->monitor.name = name;
+	proc->monitor.free_words = proc->stack_size / sizeof(cpu_stack_t);
+	proc->monitor.scan_words = 0;
+
+#if MONITOR_STAMPS
+	PROC_ATOMIC(proc->monitor.id = monitor_nextId++);
+#endif
+#if CONFIG_KERN_MONITOR_ACCT
+	proc->monitor.run_time = 0;
+	proc->monitor.switches = 0;
+	proc->monitor.preempted = 0;
+	proc->monitor.max_latency = 0;
+	/* The main process is already running */
+	ATOMIC(proc->monitor.stamp = timer_hpclock_unlocked());
+#endif
 
 	PROC_ATOMIC(ADDTAIL(&MonitorProcs, &proc->monitor.link));
 }
@@ -71,7 +304,12 @@ void monitor_add(Process *proc, const char *name)
 
 void monitor_remove(Process *proc)
 {
-	PROC_ATOMIC(REMOVE(&proc->monitor.link));
+	proc_forbid();
+	if (monitor_next == &proc->monitor.link)
+		monitor_next = monitor_next->succ;
+	REMOVE(&proc->monitor.link);
+	proc_permit();
+	ATOMIC(MONITOR_TRACE(MONITOR_EV_EXIT, proc, 0));
 }
 
 void monitor_rename(Process *proc, const char *name)
@@ -111,24 +349,118 @@ size_t monitor_checkStack(cpu_stack_t *stack_base, size_t stack_size)
 	return sp_free;
 }
 
+/*
+ * The high-water mark is kept as the number of words, counted from the
+ * far end of the stack, that still hold the fill code.  Each update:
+ *  - walks back from the mark over words that have been overwritten
+ *    since the last update (the usual, contiguous, stack growth);
+ *  - checks the next \a budget words of a sweep over the free area, to
+ *    catch deeper writes that left untouched words in between (e.g.
+ *    large local arrays).  When the sweep reaches the mark it starts
+ *    again from the end of the stack.
+ * Each word of the free area is thus examined once per sweep, and only
+ * the free area is examined, not the whole stack.
+ */
+size_t monitor_updateStack(Process *proc, size_t budget)
+{
+	cpu_stack_t *far_end = proc->stack_base;
+	size_t free = proc->monitor.free_words;
+	size_t scan = proc->monitor.scan_words;
+	size_t end;
+	ptrdiff_t inc = +1;
+
+	if (!far_end)
+		return 0;
+
+	if (CPU_STACK_GROWS_UPWARD)
+	{
+		far_end += proc->stack_size / sizeof(cpu_stack_t) - 1;
+		inc = -1;
+	}
+
+	while (free && far_end[(ptrdiff_t)(free - 1) * inc] != CONFIG_KERN_STACKFILLCODE)
+		free--;
+	/* The stack grew past the sweep position: restart the sweep */
+	if (scan >= free)
+		scan = 0;
+
+	/* A budget covering the whole stack is a full scan from the far end */
+	if (budget >= free)
+		scan = 0;
+	end = (budget >= free - scan) ? free : scan + budget;
+	for (; scan < end; scan++)
+	{
+		if (far_end[(ptrdiff_t)scan * inc] != CONFIG_KERN_STACKFILLCODE)
+		{
+			free = scan;
+			break;
+		}
+	}
+	if (scan >= free)
+		scan = 0;
+
+	proc->monitor.free_words = free;
+	proc->monitor.scan_words = scan;
+	return free;
+}
+
+
+#if CONFIG_KERN_MONITOR_ACCT
+/* Convert high precision timer ticks to microseconds */
+static uint64_t monitor_toUs(uint64_t hp)
+{
+	return hp * 1000000UL / TIMER_HW_HPTICKS_PER_SEC;
+}
+#endif
 
 void monitor_report(void)
 {
 	Node *node;
 	int i;
+#if CONFIG_KERN_MONITOR_ACCT
+	uint64_t total = 0;
+#endif
 
 	proc_forbid();
+#if CONFIG_KERN_MONITOR_ACCT
+	FOREACH_NODE(node, &MonitorProcs)
+		total += containerof(node, Process, monitor.link)->monitor.run_time;
+
+	kprintf("%-9s%-9s%-9s%-9s%-11s%-6s%-16s%-11s%s\n", "TCB", "SPbase", "SPsize", "SPfree",
+		"Run[ms]", "CPU%", "Sw(pre/tot)", "MaxLat[us]", "Name");
+	for (i = 0; i < 99; i++)
+		kputchar('-');
+#else
 	kprintf("%-9s%-9s%-9s%-9s%s\n", "TCB", "SPbase", "SPsize", "SPfree", "Name");
 	for (i = 0; i < 56; i++)
 		kputchar('-');
+#endif
 	kputchar('\n');
 
 	FOREACH_NODE(node, &MonitorProcs)
 	{
 		Process *p = containerof(node, Process, monitor.link);
-		size_t free = monitor_checkStack(p->stack_base, p->stack_size);
+		size_t free = monitor_updateStack(p, (size_t)-1) * sizeof(cpu_stack_t);
+#if CONFIG_KERN_MONITOR_ACCT
+		uint64_t run_time;
+		uint32_t switches, preempted, max_latency;
+
+		ATOMIC(
+			run_time = p->monitor.run_time;
+			switches = p->monitor.switches;
+			preempted = p->monitor.preempted;
+			max_latency = p->monitor.max_latency;
+		);
+		kprintf("%-9p%-9p%-9zu%-9zu%-11lu%-6u%7lu/%-8lu%-11lu%s\n",
+			p, p->stack_base, p->stack_size, free,
+			(unsigned long)(monitor_toUs(run_time) / 1000),
+			total ? (unsigned)(run_time * 100 / total) : 0,
+			(unsigned long)preempted, (unsigned long)switches,
+			(unsigned long)monitor_toUs(max_latency), p->monitor.name);
+#else
 		kprintf("%-9p%-9p%-9zu%-9zu%s\n",
 			p, p->stack_base, p->stack_size, free, p->monitor.name);
+#endif
 	}
 	proc_permit();
 }
@@ -136,21 +468,34 @@ void monitor_report(void)
 
 static void NORETURN monitor(void)
 {
-	Node *node;
-
 	for (;;)
 	{
-		proc_forbid();
-		FOREACH_NODE(node, &MonitorProcs)
+		PROC_ATOMIC(monitor_next = LIST_HEAD(&MonitorProcs));
+		for (;;)
 		{
-			Process *p = containerof(node, Process, monitor.link);
-			size_t free = monitor_checkStack(p->stack_base, p->stack_size);
-
-			if (p->stack_base && free < 0x20)
+			Process *p;
+			const char *name;
+			size_t free;
+			bool check;
+
+			/* Preemption is disabled only while checking one process */
+			proc_forbid();
+			if (!monitor_next->succ)
+			{
+				proc_permit();
+				break;
+			}
+			p = containerof(monitor_next, Process, monitor.link);
+			monitor_next = monitor_next->succ;
+			free = monitor_updateStack(p, CONFIG_KERN_MONITOR_SCAN) * sizeof(cpu_stack_t);
+			name = p->monitor.name;
+			check = p->stack_base != NULL;
+			proc_permit();
+
+			if (check && free < 0x20)
 				kprintf("MONITOR: Free stack of process '%s' is only %u chars\n",
-						p->monitor.name, (unsigned int)free);
+						name, (unsigned int)free);
 		}
-		proc_permit();
 
 		/* Give some rest to the system */
 		timer_delay(500);
@@ -32,6 +32,16 @@
  *
  * \brief Monitor to check for stack overflows
  *
+ * With CONFIG_KERN_MONITOR_ACCT the monitor also accounts the CPU time
+ * of each process: cumulative run time, number of context switches
+ * (voluntary and preempted) and the maximum latency from the moment a
+ * process becomes ready to the moment it actually runs.  Times are
+ * measured with the high precision timer and reported by
+ * monitor_report().
+ *
+ * With CONFIG_KERN_MONITOR_TRACE the scheduler records its decisions
+ * in a binary ring of events, which can be dumped on a KFile with
+ * monitor_traceDump() and decoded on the host with test/monitor_trace.py.
  *
  * \author Giovanni Bajo <rasky@develer.com>
  *
@@ -45,12 +55,59 @@
 
 #include "cfg/cfg_monitor.h"
 
+#include <cfg/compiler.h>
+
 #include <cpu/types.h>
 
+/* Silence warnings for projects generated before these options existed */
+#ifndef CONFIG_KERN_MONITOR_ACCT
+#define CONFIG_KERN_MONITOR_ACCT 0
+#endif
+#ifndef CONFIG_KERN_MONITOR_TRACE
+#define CONFIG_KERN_MONITOR_TRACE 0
+#endif
+#ifndef CONFIG_KERN_MONITOR_SCAN
+#define CONFIG_KERN_MONITOR_SCAN 64
+#endif
+#ifndef CONFIG_KERN_MONITOR_GUARD
+#define CONFIG_KERN_MONITOR_GUARD 0
+#endif
+
+struct KFile;
+
+/**
+ * \name Scheduler trace event types.
+ * \{
+ */
+#define MONITOR_EV_READY   0  ///< Process enqueued in the ready list
+#define MONITOR_EV_IN      1  ///< Process got the CPU, arg is the wakeup latency [hp ticks]
+#define MONITOR_EV_OUT     2  ///< Process left the CPU, arg is one of MONITOR_OUT_*
+#define MONITOR_EV_EXIT    3  ///< Process terminated
+#define MONITOR_EV_USER    4  ///< Application event, see monitor_trace()
+/* \} */
+
+/**
+ * \name Reasons for a process to leave the CPU.
+ * \{
+ */
+#define MONITOR_OUT_BLOCKED   0  ///< Waiting for an event (signal, semaphore...)
+#define MONITOR_OUT_YIELD     1  ///< Voluntary release with proc_yield() or a direct wakeup
+#define MONITOR_OUT_PREEMPTED 2  ///< Kernel preemption
+/* \} */
+
+/** Magic number at the start of a trace dump ("BTRC") */
+#define MONITOR_TRACE_MAGIC 0x43525442UL
+/** Version of the trace dump format */
+#define MONITOR_TRACE_VERSION 1
+
 /**
  * Start the kernel monitor. It is a special process which checks every second the stacks of the
  * running processes trying to detect stack overflows.
  *
+ * The monitor keeps a high-water mark for each stack and refines it a
+ * little at each wakeup (see CONFIG_KERN_MONITOR_SCAN), so that it never
+ * disables preemption for long.
+ *
  * \param stacksize Size of stack in chars
  * \param stack Pointer to the stack that will be used by the monitor
  *
@@ -71,7 +128,45 @@ void monitor_start(size_t stacksize, cpu_stack_t *stack);
 size_t monitor_checkStack(cpu_stack_t *stack_base, size_t stack_size);
 
 
-/** Print a report of the stack status through kdebug */
+/**
+ * Print a report of the stack status through kdebug.
+ *
+ * When accounting is enabled, also print the run time of each process,
+ * its share of the total run time of all processes, the number of context switches
+ * (preempted / total) and the maximum wakeup latency.
+ */
 void monitor_report(void);
 
+#if CONFIG_KERN_MONITOR_TRACE
+/**
+ * Record an application event in the scheduler trace.
+ *
+ * The event is attributed to the current process. Can be called from
+ * both process and interrupt context.
+ */
+void monitor_trace(uint32_t arg);
+
+/**
+ * Dump the scheduler trace on \a fd.
+ *
+ * The dump is a binary stream with all fields in little endian:
+ * \code
+ * magic    u32   MONITOR_TRACE_MAGIC
+ * version  u8    MONITOR_TRACE_VERSION
+ * nproc    u8    number of process entries
+ * hz       u32   frequency of the time stamps [hp ticks per second]
+ * nproc x { id u8, len u8, name[len] }
+ * count    u32   number of events
+ * count x { stamp u32, arg u32, type u8, id u8 }
+ * \endcode
+ *
+ * The ring is read without stopping the scheduler: events overwritten
+ * while dumping are skipped.
+ *
+ * \return the number of events written, or EOF on write errors.
+ */
+int monitor_traceDump(struct KFile *fd);
+#endif
+
+
 #endif /* KERN_MONITOR_H */
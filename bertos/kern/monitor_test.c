@@ -0,0 +1,322 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Test for the monitor CPU accounting and scheduler trace.
+ *
+ * A "spinner" process burns CPU and gets preempted, a "sleeper" process
+ * blocks on timer_delay(). The test checks that the accounting sees the
+ * difference between the two, then dumps the scheduler trace into a
+ * memory buffer and checks its format.
+ *
+ * A set of idle processes with large stacks is then used to check the
+ * incremental stack high-water tracking against a full scan, and to
+ * compare the time spent with preemption disabled by the two.
+ *
+ * $test$: cp bertos/cfg/cfg_proc.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN" >> $cfgdir/cfg_proc.h
+ * $test$: echo "#define CONFIG_KERN 1" >> $cfgdir/cfg_proc.h
+ * $test$: echo  "#undef CONFIG_KERN_PREEMPT" >> $cfgdir/cfg_proc.h
+ * $test$: echo "#define CONFIG_KERN_PREEMPT 1" >> $cfgdir/cfg_proc.h
+ * $test$: cp bertos/cfg/cfg_signal.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN_SIGNALS" >> $cfgdir/cfg_signal.h
+ * $test$: echo "#define CONFIG_KERN_SIGNALS 1" >> $cfgdir/cfg_signal.h
+ * $test$: cp bertos/cfg/cfg_monitor.h $cfgdir/
+ * $test$: sed -i "s/CONFIG_KERN_MONITOR 0/CONFIG_KERN_MONITOR 1/" $cfgdir/cfg_monitor.h
+ * $test$: sed -i "s/CONFIG_KERN_MONITOR_ACCT 0/CONFIG_KERN_MONITOR_ACCT 1/" $cfgdir/cfg_monitor.h
+ * $test$: sed -i "s/CONFIG_KERN_MONITOR_TRACE 0/CONFIG_KERN_MONITOR_TRACE 1024/" $cfgdir/cfg_monitor.h
+ * $test$: sed -i "s/CONFIG_KERN_MONITOR_GUARD 0/CONFIG_KERN_MONITOR_GUARD 1/" $cfgdir/cfg_monitor.h
+ */
+#include <kern/proc.h>
+#include <kern/proc_p.h>
+#include <kern/monitor.h>
+
+#include <drv/timer.h>
+
+#include <struct/kfile_mem.h>
+
+#include <os/hptime.h>
+
+#include <cfg/test.h>
+#include <cfg/debug.h>
+
+#include <string.h>
+
+#define SLEEPS     10
+#define SPIN_MS    200
+
+PROC_DEFINE_STACK(spinner_stack, KERN_MINSTACKSIZE * 2);
+PROC_DEFINE_STACK(sleeper_stack, KERN_MINSTACKSIZE * 2);
+
+static volatile bool spinner_done, sleeper_done, release;
+
+#define IDLE_PROCS       8
+#define IDLE_STACK_SIZE  KERN_MINSTACKSIZE
+
+static PROC_DEFINE_STACK(idle_stack[IDLE_PROCS], IDLE_STACK_SIZE);
+static volatile bool idle_release, deep_call;
+
+static void spinner(void)
+{
+	ticks_t start = timer_clock(), last = start, now;
+
+	/* Busy loop, leaving a mark in the trace at each tick */
+	while ((now = timer_clock()) - start < ms_to_ticks(SPIN_MS))
+	{
+		if (now != last)
+			monitor_trace(now);
+		last = now;
+	}
+	spinner_done = true;
+	while (!release)
+		timer_delay(10);
+}
+
+static void sleeper(void)
+{
+	for (int i = 0; i < SLEEPS; i++)
+		timer_delay(5);
+	sleeper_done = true;
+	while (!release)
+		timer_delay(10);
+}
+
+/* Touch only the deepest word of a large frame, leaving a gap above it */
+static NOINLINE void deep_frame(void)
+{
+	volatile cpu_stack_t buf[IDLE_STACK_SIZE / sizeof(cpu_stack_t) / 2];
+
+	buf[CPU_STACK_GROWS_UPWARD ? countof(buf) - 1 : 0] = 0;
+}
+
+static void idle(void)
+{
+	while (!idle_release)
+	{
+		if (deep_call)
+		{
+			deep_frame();
+			deep_call = false;
+		}
+		timer_delay(10);
+	}
+}
+
+/* Elapsed time of the old monitor loop: a full scan of all the stacks with preemption disabled */
+static hptime_t stack_fullScan(Process **procs)
+{
+	hptime_t start = hptime_get();
+
+	proc_forbid();
+	for (int i = 0; i < IDLE_PROCS; i++)
+		monitor_checkStack(procs[i]->stack_base, procs[i]->stack_size);
+	proc_permit();
+	return hptime_get() - start;
+}
+
+static void stack_test(void)
+{
+	Process *procs[IDLE_PROCS];
+	hptime_t full = 0, step = 0, t;
+	size_t ref, mark;
+	int i, j, n;
+
+	for (i = 0; i < IDLE_PROCS; i++)
+		procs[i] = proc_new(idle, NULL, sizeof(idle_stack[i]), idle_stack[i]);
+	timer_delay(50);
+
+	/* Forbid window: whole scan against one incremental step */
+	for (j = 0; j < 100; j++)
+	{
+		full = MAX(full, stack_fullScan(procs));
+		for (i = 0; i < IDLE_PROCS; i++)
+		{
+			t = hptime_get();
+			proc_forbid();
+			monitor_updateStack(procs[i], CONFIG_KERN_MONITOR_SCAN);
+			proc_permit();
+			step = MAX(step, hptime_get() - t);
+		}
+	}
+	kprintf("Max forbid window: full scan %ld us, incremental step %ld us\n",
+		(long)full, (long)step);
+
+	/* The incremental mark must converge to the full scan result */
+	for (i = 0; i < IDLE_PROCS; i++)
+	{
+		ref = monitor_checkStack(procs[i]->stack_base, procs[i]->stack_size);
+		ASSERT(monitor_updateStack(procs[i], (size_t)-1) * sizeof(cpu_stack_t) == ref);
+	}
+
+	/* A deep write past a gap is found by the sweep within one round */
+	mark = monitor_updateStack(procs[0], (size_t)-1) * sizeof(cpu_stack_t);
+	deep_call = true;
+	while (deep_call)
+		timer_delay(10);
+	ref = monitor_checkStack(procs[0]->stack_base, procs[0]->stack_size);
+	ASSERT(ref < mark);
+	n = IDLE_STACK_SIZE / sizeof(cpu_stack_t) / CONFIG_KERN_MONITOR_SCAN + 2;
+	for (j = 0; j < n; j++)
+		if (monitor_updateStack(procs[0], CONFIG_KERN_MONITOR_SCAN) * sizeof(cpu_stack_t) == ref)
+			break;
+	kprintf("Deep frame found after %d steps\n", j + 1);
+	ASSERT(j < n);
+
+	idle_release = true;
+	timer_delay(50);
+}
+
+#define GROW_WORDS 64
+
+/* Index of the \a i-th word of a stack, counted from its far end */
+#define GROW_WORD(i) (CPU_STACK_GROWS_UPWARD ? GROW_WORDS - 1 - (i) : (i))
+
+/*
+ * The stack grows in one step past the position of the sweep: the mark
+ * must follow the growth, not restart from the sweep position.
+ */
+static void stack_growTest(void)
+{
+	static cpu_stack_t words[GROW_WORDS];
+	Process fake;
+	size_t free;
+	int i;
+
+	memset(&fake, 0, sizeof(fake));
+	for (i = 0; i < GROW_WORDS; i++)
+		words[i] = CONFIG_KERN_STACKFILLCODE;
+	fake.stack_base = words;
+	fake.stack_size = sizeof(words);
+	fake.monitor.free_words = GROW_WORDS - 8;
+	fake.monitor.scan_words = 0;
+
+	/* Move the sweep to word 40 */
+	for (i = 0; i < 5; i++)
+		ASSERT(monitor_updateStack(&fake, 8) == GROW_WORDS - 8);
+	ASSERT(fake.monitor.scan_words == 40);
+
+	/* Grow contiguously down to word 20 */
+	for (i = 20; i < GROW_WORDS; i++)
+		words[GROW_WORD(i)] = 0;
+	free = monitor_updateStack(&fake, 8);
+	kprintf("Stack grown past the sweep: %d free words\n", (int)free);
+	ASSERT(free == 20);
+	ASSERT(monitor_updateStack(&fake, (size_t)-1) == 20);
+}
+
+static uint8_t dump[16384];
+
+static uint32_t readLE(const uint8_t *buf, size_t size)
+{
+	uint32_t val = 0;
+
+	while (size--)
+		val = (val << 8) | buf[size];
+	return val;
+}
+
+/* Parse a trace dump, return the number of events of type \a type for process \a id */
+static int trace_count(const uint8_t *buf, size_t len, uint8_t type, uint8_t id)
+{
+	const uint8_t *end = buf + len;
+	uint8_t nproc;
+	uint32_t count;
+	int found = 0;
+
+	ASSERT(readLE(buf, 4) == MONITOR_TRACE_MAGIC);
+	ASSERT(buf[4] == MONITOR_TRACE_VERSION);
+	nproc = buf[5];
+	buf += 10;
+	while (nproc--)
+		buf += 2 + buf[1];
+	count = readLE(buf, 4);
+	buf += 4;
+	ASSERT(buf + count * 10 <= end);
+	while (count--)
+	{
+		if (buf[8] == type && buf[9] == id)
+			found++;
+		buf += 10;
+	}
+	return found;
+}
+
+int monitor_testSetup(void)
+{
+	kdbg_init();
+	timer_init();
+	proc_init();
+	return 0;
+}
+
+int monitor_testRun(void)
+{
+	Process *spin, *sleep;
+	KFileMem mem;
+	int events;
+
+	spin = proc_new(spinner, NULL, sizeof(spinner_stack), spinner_stack);
+	sleep = proc_new(sleeper, NULL, sizeof(sleeper_stack), sleeper_stack);
+
+	while (!spinner_done || !sleeper_done)
+		timer_delay(10);
+
+	monitor_report();
+	release = true;
+	timer_delay(50);
+
+	/* The spinner ran most of the time and was preempted */
+	ASSERT(spin->monitor.run_time > sleep->monitor.run_time);
+	ASSERT(spin->monitor.preempted > 0);
+	/* The sleeper blocked at least once per delay */
+	ASSERT(sleep->monitor.switches >= SLEEPS);
+	ASSERT(sleep->monitor.switches > sleep->monitor.preempted);
+
+	kfilemem_init(&mem, dump, sizeof(dump));
+	events = monitor_traceDump(&mem.fd);
+	kprintf("Trace dump: %d events, %ld bytes\n", events, (long)mem.fd.seek_pos);
+	ASSERT(events > 0);
+	ASSERT(trace_count(dump, mem.fd.seek_pos, MONITOR_EV_USER, spin->monitor.id) > 0);
+	ASSERT(trace_count(dump, mem.fd.seek_pos, MONITOR_EV_EXIT, sleep->monitor.id) == 1);
+	ASSERT(trace_count(dump, mem.fd.seek_pos, MONITOR_EV_IN, proc_current()->monitor.id) > 0);
+
+	stack_growTest();
+	stack_test();
+
+	return 0;
+}
+
+int monitor_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(monitor);
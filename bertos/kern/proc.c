@@ -115,9 +115,17 @@
  * The scheduer tracks ready processes by enqueuing them in the
  * ready list.
  *
+ * The list is statically initialized: cpu_relax() may call proc_yield()
+ * before proc_init() (e.g. from kdbg_init()), and it must find an empty
+ * list rather than a NULL head.
+ *
  * \note Access to the list must occur while interrupts are disabled.
  */
-REGISTER List proc_ready_list;
+REGISTER List proc_ready_list =
+{
+	{ &proc_ready_list.tail, NULL },
+	{ NULL, &proc_ready_list.head },
+};
 
 /*
  * Holds a pointer to the TCB of the currently running process.
@@ -562,6 +570,7 @@ static void proc_schedule(void)
 		MEMORY_BARRIER;
 		IRQ_DISABLE;
 	}
+	MONITOR_SCHED_IN(current_process);
 	if (CONTEXT_SWITCH_FROM_ISR())
 		proc_context_switch(current_process, old_process);
 	/* This RET resumes the execution on the new process */
@@ -605,6 +614,7 @@ void proc_preempt(void)
 	/* Perform the kernel preemption */
 	LOG_INFO("preempting %p:%s\n", current_process, proc_currentName());
 	/* We are inside a IRQ context, so ATOMIC is not needed here */
+	MONITOR_SCHED_OUT(current_process, MONITOR_OUT_PREEMPTED);
 	SCHED_ENQUEUE(current_process);
 	preempt_reset_quantum();
 	proc_schedule();
@@ -616,9 +626,11 @@ static void proc_switchTo(Process *proc)
 {
 	Process *old_process = current_process;
 
+	MONITOR_SCHED_OUT(current_process, MONITOR_OUT_YIELD);
 	SCHED_ENQUEUE(current_process);
 	preempt_reset_quantum();
 	current_process = proc;
+	MONITOR_SCHED_IN(current_process);
 	proc_context_switch(current_process, old_process);
 }
 
@@ -634,6 +646,7 @@ void proc_switch(void)
 {
 	ASSERT(proc_preemptAllowed());
 	ATOMIC(
+		MONITOR_SCHED_OUT(current_process, MONITOR_OUT_BLOCKED);
 		preempt_reset_quantum();
 		proc_schedule();
 	);
@@ -649,7 +662,10 @@ void proc_wakeup(Process *proc)
 	IRQ_ASSERT_DISABLED();
 
 	if (prio_proc(proc) >= prio_curr())
+	{
+		MONITOR_READY(proc);
 		proc_switchTo(proc);
+	}
 	else
 		SCHED_ENQUEUE_HEAD(proc);
 }
@@ -95,6 +95,7 @@
 #include "cfg/cfg_proc.h"
 #include "cfg/cfg_signal.h"
 #include "cfg/cfg_monitor.h"
+#include "monitor.h"
 #include "sem.h"
 
 #include <struct/list.h> // Node, PriNode
@@ -156,6 +157,18 @@ typedef struct Process
 	{
 		Node        link;
 		const char *name;
+		size_t      free_words;   /**< Stack words never used, from the far end */
+		size_t      scan_words;   /**< Next word to check in the free area */
+	# if CONFIG_KERN_MONITOR_ACCT | CONFIG_KERN_MONITOR_TRACE
+		uint8_t     id;           /**< Process id in the scheduler trace */
+	# endif
+	# if CONFIG_KERN_MONITOR_ACCT
+		uint32_t    stamp;        /**< Time the process got ready or started running */
+		uint64_t    run_time;     /**< Cumulative run time [hp ticks] */
+		uint32_t    switches;     /**< Number of times the process left the CPU */
+		uint32_t    preempted;    /**< Switches caused by kernel preemption */
+		uint32_t    max_latency;  /**< Max time from wakeup to run [hp ticks] */
+	# endif
 	} monitor;
 #endif
 
@@ -103,6 +103,21 @@ extern REGISTER List     proc_ready_list;
 	#define SCHED_ENQUEUE_HEAD_INTERNAL(proc) ADDHEAD(&proc_ready_list, &(proc)->link)
 #endif
 
+#if CONFIG_KERN_MONITOR && (CONFIG_KERN_MONITOR_ACCT | CONFIG_KERN_MONITOR_TRACE | CONFIG_KERN_MONITOR_GUARD)
+	/* Scheduler hooks for the monitor, called with interrupts disabled */
+	void monitor_ready(Process *proc);
+	void monitor_schedOut(Process *proc, int reason);
+	void monitor_schedIn(Process *proc);
+
+	#define MONITOR_READY(proc)             monitor_ready(proc)
+	#define MONITOR_SCHED_OUT(proc, reason) monitor_schedOut((proc), (reason))
+	#define MONITOR_SCHED_IN(proc)          monitor_schedIn(proc)
+#else
+	#define MONITOR_READY(proc)             do {} while (0)
+	#define MONITOR_SCHED_OUT(proc, reason) do {} while (0)
+	#define MONITOR_SCHED_IN(proc)          do {} while (0)
+#endif
+
 /**
  * Enqueue a process in the ready list.
  *
@@ -115,12 +130,14 @@ extern REGISTER List     proc_ready_list;
 #define SCHED_ENQUEUE(proc)  do { \
 		IRQ_ASSERT_DISABLED(); \
 		LIST_ASSERT_VALID(&proc_ready_list); \
+		MONITOR_READY(proc); \
 		SCHED_ENQUEUE_INTERNAL(proc); \
 	} while (0)
 
 #define SCHED_ENQUEUE_HEAD(proc)  do { \
 		IRQ_ASSERT_DISABLED(); \
 		LIST_ASSERT_VALID(&proc_ready_list); \
+		MONITOR_READY(proc); \
 		SCHED_ENQUEUE_HEAD_INTERNAL(proc); \
 	} while (0)
 
@@ -185,6 +202,12 @@ void proc_schedInit(void);
 
 	/** Rename a process */
 	void monitor_rename(Process *proc, const char *name);
+
+	/**
+	 * Refine the stack high-water mark of \a proc, examining at most
+	 * \a budget words. Return the free stack words.
+	 */
+	size_t monitor_updateStack(Process *proc, size_t budget);
 #endif /* CONFIG_KERN_MONITOR */
 
 /*
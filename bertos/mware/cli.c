@@ -49,6 +49,7 @@
 #include <cfg/log.h>
 #include <cfg/compiler.h>
 #include <cfg/debug.h>
+#include <cfg/macros.h>
 
 #include <mware/readline.h>
 #include <mware/parser.h>
@@ -81,23 +82,17 @@ INLINE void REPLY(KFile *fd, int err_code, const char *err)
  */
 static bool cli_reply(KFile *fd, const struct CmdTemplate *t, const parms *args)
 {
-	unsigned short offset = strlen(t->arg_fmt) + 1;
-	unsigned short nres = strlen(t->result_fmt);
+	struct ParserCmdDesc desc;
 
-	for (unsigned short i = 0; i < nres; ++i)
+	parser_get_cmd_desc(t, &desc);
+	args += desc.nargs + 1;
+
+	for (uint8_t i = 0; i < desc.nres; ++i, ++args)
 	{
-		if (t->result_fmt[i] == 'd')
-		{
-			kfile_printf(fd, " %ld", args[offset+i].l);
-		}
-		else if (t->result_fmt[i] == 's')
-		{
-			kfile_printf(fd, " %s", args[offset+i].s);
-		}
+		if (desc.res_str & BV(i))
+			kfile_printf(fd, " %.*s", args->s.sz, args->s.p);
 		else
-		{
-			return false;
-		}
+			kfile_printf(fd, " %ld", args->l);
 	}
 
 	kfile_printf(fd, "\r\n");
@@ -138,39 +133,35 @@ static void cli_parse(CLI *cli, const char *buf)
 	return;
 }
 
-/**
- * CLI poll function.
- *
- * Call this function to process all incoming message from
- * fd channel.
- *
- * \param fd kfile channel context.
+/*
+ * Start a new session, if needed.
  */
-void cli_poll(KFile *fd)
+static void cli_checkSession(CLI *cli)
 {
 	/* Check with user function if session was end */
-	if (!local_cli->is_new_session && local_cli->check_newSession)
+	if (!cli->is_new_session && cli->check_newSession)
 	{
-		if (local_cli->check_newSession(fd))
-			local_cli->is_new_session = true;
+		if (cli->check_newSession(cli->fd))
+			cli->is_new_session = true;
 	}
 
 	/* Print ready promt at first time that we connect */
-	if (local_cli->is_new_session)
+	if (cli->is_new_session)
 	{
 		/* If defined call the custom procedure for new session */
-		if (local_cli->handshake)
-			local_cli->handshake(local_cli->fd);
+		if (cli->handshake)
+			cli->handshake(cli->fd);
 
-		rl_refresh(&local_cli->rl_ctx);
-		local_cli->is_new_session = false;
+		rl_refresh(&cli->rl_ctx);
+		cli->is_new_session = false;
 	}
+}
 
-	const char *buf = rl_readline(&local_cli->rl_ctx);
-
-	if((buf == NULL))
-		return;
-
+/*
+ * Execute a line read by readline.
+ */
+static void cli_line(CLI *cli, const char *buf)
+{
 	if (buf[0] == '\0')
 		return;
 
@@ -178,24 +169,80 @@ void cli_poll(KFile *fd)
 	they are stripped out from commands */
 	if (buf[0] == '#')
 	{
-		rl_refresh(&local_cli->rl_ctx);
+		rl_refresh(&cli->rl_ctx);
 		return;
 	}
 
 	/* Close connetion on exit command */
 	if (!strcmp(buf, "exit") || !strcmp(buf, "quit"))
 	{
-		rl_clear_history(&local_cli->rl_ctx);
-		kfile_close(local_cli->fd);
-		local_cli->is_new_session = true;
+		rl_clear_history(&cli->rl_ctx);
+		kfile_close(cli->fd);
+		cli->is_new_session = true;
 	}
 	else
 	{
-		cli_parse(local_cli, buf);
-		rl_refresh(&local_cli->rl_ctx);
+		cli_parse(cli, buf);
+		rl_refresh(&cli->rl_ctx);
 	}
 }
 
+/*
+ * Readline write hook.
+ */
+static void cli_write(const char *buf, size_t len, void *fd)
+{
+	kfile_write((KFile *)fd, buf, len);
+}
+
+/**
+ * CLI poll function.
+ *
+ * Call this function to process all incoming message from
+ * fd channel.
+ *
+ * \param fd kfile channel context.
+ */
+void cli_poll(KFile *fd)
+{
+	(void)fd;
+	cli_checkSession(local_cli);
+
+	const char *buf = rl_readline(&local_cli->rl_ctx);
+
+	if((buf == NULL))
+		return;
+
+	cli_line(local_cli, buf);
+}
+
+/**
+ * Process the input \a buf of \a len characters received by session \a cli.
+ *
+ * Unlike cli_poll(), this function never waits for input: the line
+ * editing state is kept in the session, and every line completed by
+ * \a buf is executed right away. The input following an exit command
+ * is discarded.
+ */
+void cli_feed(CLI *cli, const char *buf, size_t len)
+{
+	cli_checkSession(cli);
+
+	while (len)
+	{
+		const char *line;
+		size_t n = rl_feed(&cli->rl_ctx, buf, len, &line);
+
+		buf += n;
+		len -= n;
+		if (line)
+		{
+			cli_line(cli, line);
+			if (cli->is_new_session)
+				break;
+		}
+	}
+}
 
 /**
  * Init CLI module.
@@ -219,7 +266,23 @@ void cli_init(CLI *cli, KFile *ch, cli_t cmds_register, cli_handshake_t handshak
 	cmds_register();
 
 	local_cli = cli;
+	cli_initSession(cli, ch, handshake, check_newSession);
+}
 
+/**
+ * Init a further CLI session on channel \a ch.
+ *
+ * The commands are shared by all the sessions: register them once with
+ * cli_init(), then call this function for each additional session, to be
+ * served with cli_feed().
+ *
+ * \param cli cli context
+ * \param ch pointer to kfile channel context
+ * \param handshake custom fuction called on every new session, or NULL.
+ * \param check_newSession custom funtion should return true if we are in new session, false otherwise.
+ */
+void cli_initSession(CLI *cli, KFile *ch, cli_handshake_t handshake, cli_check_t check_newSession)
+{
 	cli->fd = ch;
 	cli->handshake = handshake;
 	cli->check_newSession = check_newSession;
@@ -229,5 +292,6 @@ void cli_init(CLI *cli, KFile *ch, cli_t cmds_register, cli_handshake_t handshak
 	rl_setprompt(&cli->rl_ctx, CONFIG_CLI_PROMT_STR);
 	rl_sethook_get(&cli->rl_ctx, (getc_hook)kfile_getc, cli->fd);
 	rl_sethook_put(&cli->rl_ctx, (putc_hook)kfile_putc, cli->fd);
+	rl_sethook_write(&cli->rl_ctx, cli_write, cli->fd);
 	rl_sethook_match(&cli->rl_ctx, parser_rl_match, NULL);
 }
@@ -78,6 +78,29 @@
  *
  * \endcode
  *
+ * cli_poll() blocks until a whole line is read. To serve several channels
+ * from a single process, init the other sessions with cli_initSession()
+ * and push the input to cli_feed() as it arrives, waiting for it with
+ * event_select():
+ *
+ * \code
+ * cli_init(&ser_cli, &ser.fd, cli_registerCmds, NULL, NULL);
+ * cli_initSession(&tcp_cli, &tcp.fd, NULL, NULL);
+ *
+ * CLI *clis[] = { &ser_cli, &tcp_cli };
+ * Event *evs[] = { &ser_rx_event, &tcp_rx_event };
+ *
+ * while (1)
+ * {
+ *    char buf[32];
+ *    int i = event_select(evs, countof(evs), 0);
+ *
+ *    // Read only what is available, without blocking
+ *    size_t len = kfile_read(clis[i]->fd, buf, sizeof(buf));
+ *    cli_feed(clis[i], buf, len);
+ * }
+ * \endcode
+ *
  * \author Marco Benelli <marco@develer.com>
  * \author Daniele Basile <asterix@develer.com>
  *
@@ -114,7 +137,9 @@ typedef struct CLI
 } CLI;
 
 void cli_poll(KFile *fd);
+void cli_feed(CLI *cli, const char *buf, size_t len);
 void cli_init(CLI *cli, KFile *ch, cli_t cmds_register, cli_handshake_t handshake, cli_check_t check_newSession);
+void cli_initSession(CLI *cli, KFile *ch, cli_handshake_t handshake, cli_check_t check_newSession);
 
 /** \} */ //defgroup cli_module.
 
@@ -43,6 +43,8 @@
 
 #include <drv/timer.h> /* timer_clock() */
 
+#include <cpu/irq.h>
+
 void event_hook_ignore(UNUSED_ARG(Event *, e))
 {
 }
@@ -58,7 +60,126 @@ void event_hook_generic(Event *e)
 	MEMORY_BARRIER;
 }
 
+/*
+ * Event set hook: queue the event in the ready list of every set it
+ * belongs to, unless it is already there. Only the first event queued
+ * wakes up the waiter: it will collect the others before sleeping again.
+ */
+void event_hook_set(Event *e)
+{
+	cpu_flags_t flags;
+	EventLink *l;
+
+	IRQ_SAVE_DISABLE(flags);
+	for (l = e->Ev.Set.links; l; l = l->next)
+	{
+		EventSet *set = l->set;
+
+		if (l->ready)
+			continue;
+
+		l->ready = true;
+#if CONFIG_KERN && CONFIG_KERN_SIGNALS
+		if (LIST_EMPTY(&set->ready))
+			sig_postSignal(&set->sig, set->proc, EVENT_GENERIC_SIGNAL);
+#endif
+		ADDTAIL(&set->ready, &l->link);
+	}
+	IRQ_RESTORE(flags);
+}
+
+void event_setInit(EventSet *set)
+{
+	LIST_INIT(&set->ready);
+#if CONFIG_KERN && CONFIG_KERN_SIGNALS
+	set->proc = NULL;
+	set->sig.wait = 0;
+	set->sig.recv = 0;
+#endif
+}
+
+void event_setAdd(EventSet *set, EventLink *link, Event *e)
+{
+	ASSERT(e->action == event_hook_set);
+
+	link->event = e;
+	link->set = set;
+	link->ready = false;
+	ATOMIC(
+		link->next = e->Ev.Set.links;
+		e->Ev.Set.links = link;
+	);
+}
+
+void event_setRemove(EventLink *link)
+{
+	cpu_flags_t flags;
+	EventLink **l;
+
+	IRQ_SAVE_DISABLE(flags);
+	for (l = &link->event->Ev.Set.links; *l != link; l = &(*l)->next)
+		ASSERT(*l);
+	*l = link->next;
+
+	if (link->ready)
+	{
+		REMOVE(&link->link);
+		link->ready = false;
+	}
+	IRQ_RESTORE(flags);
+}
+
+EventLink *event_setPoll(EventSet *set)
+{
+	cpu_flags_t flags;
+	EventLink *l = NULL;
+
+	IRQ_SAVE_DISABLE(flags);
+	if (!LIST_EMPTY(&set->ready))
+	{
+		l = containerof(list_remHead(&set->ready), EventLink, link);
+		l->ready = false;
+	}
+	IRQ_RESTORE(flags);
+	return l;
+}
+
 #if CONFIG_KERN && CONFIG_KERN_SIGNALS
+/*
+ * Custom timer hook to notify the timeout of a event_setWait().
+ */
+static void event_hook_set_timeout_signal(void *arg)
+{
+	EventSet *set = (EventSet *)arg;
+
+	sig_postSignal(&set->sig, set->proc, SIG_TIMEOUT);
+}
+
+EventLink *event_setWait(EventSet *set, ticks_t timeout)
+{
+	ticks_t end = timer_clock() + timeout;
+	EventLink *l;
+
+	set->proc = proc_current();
+	while (!(l = event_setPoll(set)))
+	{
+		ticks_t now = timer_clock();
+
+		/*
+		 * The wake up signal can be left over by events already
+		 * collected: go on waiting for the remaining time.
+		 */
+		if (!timeout)
+			sig_waitSignal(&set->sig, EVENT_GENERIC_SIGNAL);
+		else if (TIMER_AFTER(end, now))
+			sig_waitTimeoutSignal(&set->sig, EVENT_GENERIC_SIGNAL,
+				end - now, event_hook_set_timeout_signal, set);
+		else
+			break;
+	}
+	return l;
+}
+
 void event_hook_signal(Event *e)
 {
 	sig_post((e)->Ev.Sig.sig_proc, (e)->Ev.Sig.sig_bit);
@@ -175,6 +296,20 @@ int event_select(Event **evs, int n, ticks_t timeout)
 	return event_selectSlowPath(evs, n, timeout);
 }
 #else /* !(CONFIG_KERN && CONFIG_KERN_SIGNALS) */
+EventLink *event_setWait(EventSet *set, ticks_t timeout)
+{
+	ticks_t end = timer_clock() + timeout;
+	EventLink *l;
+
+	while (!(l = event_setPoll(set)))
+	{
+		if (timeout && TIMER_AFTER(timer_clock(), end))
+			break;
+		cpu_relax();
+	}
+	return l;
+}
+
 bool event_waitTimeout(Event *e, ticks_t timeout)
 {
 	ticks_t end = timer_clock() + timeout;
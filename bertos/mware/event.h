@@ -131,6 +131,36 @@
  * }
  * \endcode
  *
+ * event_select() maps each event to a signal bit of the process, so it can
+ * wait for a few events only, and every call costs O(n). To wait for many
+ * events, add them once to an event set: a triggered event is appended to
+ * the ready list of the set, and the waiter gets it from there, without
+ * scanning the others. An event can belong to more than one set, so several
+ * processes can wait for it.
+ *
+ * Example usage: wait for the input of many channels via an EventSet
+ * \code
+ * static Event rx_event[PORTS];
+ * static EventLink rx_link[PORTS];
+ * static EventSet set;
+ *
+ * void gateway(void)
+ * {
+ *      event_setInit(&set);
+ *      for (int i = 0; i < PORTS; i++)
+ *      {
+ *              event_initSelectable(&rx_event[i]);
+ *              event_setAdd(&set, &rx_link[i], &rx_event[i]);
+ *      }
+ *
+ *      while (1)
+ *      {
+ *              EventLink *l = event_setWait(&set, 0);
+ *              serve_port(l - rx_link);
+ *      }
+ * }
+ * \endcode
+ *
  * \author Bernie Innocenti <bernie@codewiz.org>
  *
  * $WIZ$ module_name = "event"
@@ -146,12 +176,16 @@
 
 #include <cpu/power.h> /* cpu_relax() */
 
+#include <struct/list.h>
+
 #if CONFIG_KERN && CONFIG_KERN_SIGNALS
 #include <kern/signal.h>
 /* Forward decl */
 struct Process;
 #endif
 
+struct EventLink;
+
 typedef struct Event
 {
 	void (*action)(struct Event *);
@@ -175,6 +209,11 @@ typedef struct Event
 		{
 			bool completed;             /* Generic event completion */
 		} Gen;
+
+		struct
+		{
+			struct EventLink *links;    /* Sets waiting for the event */
+		} Set;
 	} Ev;
 } Event;
 
@@ -183,6 +222,7 @@ void event_hook_signal(Event *event);
 void event_hook_softint(Event *event);
 void event_hook_generic(Event *event);
 void event_hook_generic_signal(Event *event);
+void event_hook_set(Event *event);
 
 /** Initialize the event \a e as a no-op */
 #define event_initNone(e) \
@@ -281,10 +321,88 @@ INLINE void event_wait(Event *e)
  *
  * NOTE: timeout == 0 means no timeout.
  *
+ * \note At most SIG_USER_MAX events; use an EventSet for more.
  * \attention The API is work in progress and may change in future versions.
  */
 int event_select(Event **evs, int n, ticks_t timeout);
 
+/**
+ * Membership of an event in an event set.
+ */
+typedef struct EventLink
+{
+	Node link;                  ///< Node in the ready list of the set
+	struct EventLink *next;     ///< Next set of the same event
+	struct Event *event;        ///< Event
+	struct EventSet *set;       ///< Set
+	bool ready;                 ///< The event is in the ready list
+} EventLink;
+
+/**
+ * A set of events, to wait for any of them.
+ */
+typedef struct EventSet
+{
+	List ready;                 ///< Events triggered and not yet collected
+#if CONFIG_KERN && CONFIG_KERN_SIGNALS
+	struct Process *proc;       ///< Process waiting on the set
+	Signal sig;                 ///< Wake up signal
+#endif
+} EventSet;
+
+/** Initialize the event \a e to be waited through event sets */
+#define event_initSelectable(e) \
+	((e)->action = event_hook_set, (e)->Ev.Set.links = NULL)
+
+/** Same as event_initSelectable(), but returns the initialized event */
+INLINE Event event_createSelectable(void)
+{
+	Event e;
+	event_initSelectable(&e);
+	return e;
+}
+
+/**
+ * Initialize the empty event set \a set.
+ */
+void event_setInit(EventSet *set);
+
+/**
+ * Add the event \a e to \a set, using \a link for the membership.
+ *
+ * The event must be initialized with event_initSelectable(). It can be
+ * added to any number of sets, with a different link for each set.
+ */
+void event_setAdd(EventSet *set, EventLink *link, Event *e);
+
+/**
+ * Remove an event from its set, given its \a link.
+ */
+void event_setRemove(EventLink *link);
+
+/**
+ * Collect a triggered event from \a set, without waiting.
+ *
+ * The events are returned in the order they were triggered. An event
+ * triggered more than once before being collected is returned once.
+ *
+ * \return the link of the event, or NULL if no event was triggered.
+ */
+EventLink *event_setPoll(EventSet *set);
+
+/**
+ * Wait until an event of \a set is triggered, or \a timeout elapses, and
+ * collect it like event_setPoll().
+ *
+ * Only one process at a time can wait on a set.
+ *
+ * NOTE: timeout == 0 means no timeout.
+ *
+ * \return the link of the event, or NULL if the timeout expired.
+ * \note It's forbidden to use this function inside irq handling functions.
+ */
+EventLink *event_setWait(EventSet *set, ticks_t timeout);
+
 /**
  * Wait the completion of event \a e or \a timeout elapses.
  *
@@ -307,6 +425,10 @@ INLINE void event_do(struct Event *e)
 	e->action(e);
 }
 
+int event_testSetup(void);
+int event_testRun(void);
+int event_testTearDown(void);
+
 /** \} */
 
 #endif /* KERN_EVENT_H */
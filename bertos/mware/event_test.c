@@ -0,0 +1,316 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Event sets test.
+ *
+ * Checks the ready list of an event set (order, coalescing, removal,
+ * events shared by several sets, timeout), then wakes two processes
+ * waiting on sets of the same events, from a process and from a timer.
+ *
+ * The benchmark measures the cost of triggering and collecting an event,
+ * and of waking a process through a set, with 4, 32 and 256 events: it
+ * does not depend on the size of the set. event_select() is measured on
+ * 4 events for comparison.
+ *
+ * notest:avr
+ *
+ * $test$: cp bertos/cfg/cfg_proc.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN" >> $cfgdir/cfg_proc.h
+ * $test$: echo "#define CONFIG_KERN 1" >> $cfgdir/cfg_proc.h
+ * $test$: echo  "#undef CONFIG_KERN_PREEMPT" >> $cfgdir/cfg_proc.h
+ * $test$: echo "#define CONFIG_KERN_PREEMPT 1" >> $cfgdir/cfg_proc.h
+ * $test$: cp bertos/cfg/cfg_signal.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN_SIGNALS" >> $cfgdir/cfg_signal.h
+ * $test$: echo "#define CONFIG_KERN_SIGNALS 1" >> $cfgdir/cfg_signal.h
+ */
+
+#include "event.h"
+
+#include <kern/proc.h>
+
+#include <drv/timer.h>
+
+#include <os/hptime.h>
+
+#include <cfg/test.h>
+#include <cfg/debug.h>
+#include <cfg/macros.h>
+
+#define MAX_EVENTS  256
+#define WAITERS     2
+#define WAKEUPS     500
+#define POLL_LOOPS  20000
+
+static Event events[MAX_EVENTS];
+static EventLink links[WAITERS][MAX_EVENTS];
+static EventSet sets[WAITERS];
+
+/* Waiter processes */
+static PROC_DEFINE_STACK(waiter_stack[WAITERS], KERN_MINSTACKSIZE * 2);
+static Event ack[WAITERS];
+static volatile int last_id[WAITERS];
+static volatile bool stop;
+
+static uint32_t rand_state = 1;
+
+static int rand_event(int n)
+{
+	rand_state = rand_state * 1664525 + 1013904223;
+	return (rand_state >> 16) % n;
+}
+
+static void init_sets(int n, int nsets)
+{
+	for (int i = 0; i < MAX_EVENTS; i++)
+		event_initSelectable(&events[i]);
+
+	for (int s = 0; s < nsets; s++)
+	{
+		event_setInit(&sets[s]);
+		for (int i = 0; i < n; i++)
+			event_setAdd(&sets[s], &links[s][i], &events[i]);
+	}
+}
+
+/* Return the index in the set of a collected event, -1 for none */
+static int link_id(int set, EventLink *l)
+{
+	if (!l)
+		return -1;
+	ASSERT(l->set == &sets[set]);
+	return l - links[set];
+}
+
+static int event_testReadyList(void)
+{
+	static const int order[] = { 7, 200, 3, 7, 255, 0, 200 };
+	static const int expect[] = { 7, 200, 3, 255, 0 };
+	int i;
+
+	init_sets(MAX_EVENTS, 2);
+
+	if (event_setPoll(&sets[0]))
+		return -1;
+
+	/* Coalesced, in trigger order, in both sets */
+	for (i = 0; i < (int)countof(order); i++)
+		event_do(&events[order[i]]);
+	for (i = 0; i < (int)countof(expect); i++)
+	{
+		if (link_id(0, event_setPoll(&sets[0])) != expect[i])
+			return -1;
+		if (link_id(1, event_setPoll(&sets[1])) != expect[i])
+			return -1;
+	}
+	if (event_setPoll(&sets[0]) || event_setPoll(&sets[1]))
+		return -1;
+
+	/* A removed event is dropped from the ready list, and never queued again */
+	event_do(&events[10]);
+	event_do(&events[11]);
+	event_setRemove(&links[0][10]);
+	event_do(&events[10]);
+	if (link_id(0, event_setPoll(&sets[0])) != 11 || event_setPoll(&sets[0]))
+		return -1;
+	if (link_id(1, event_setPoll(&sets[1])) != 10 || link_id(1, event_setPoll(&sets[1])) != 11)
+		return -1;
+
+	/* Timeout */
+	ticks_t start = timer_clock();
+	if (event_setWait(&sets[0], ms_to_ticks(20)))
+		return -1;
+	if (timer_clock() - start < ms_to_ticks(20))
+	{
+		kprintf("timeout too short: %ld ticks\n", (long)(timer_clock() - start));
+		return -1;
+	}
+
+	/* Already triggered: no wait */
+	event_do(&events[42]);
+	if (link_id(0, event_setWait(&sets[0], ms_to_ticks(20))) != 42)
+		return -1;
+
+	return 0;
+}
+
+static void waiter(void)
+{
+	int w = (EventSet *)proc_currentUserData() - sets;
+
+	while (!stop)
+	{
+		EventLink *l = event_setWait(&sets[w], ms_to_ticks(100));
+
+		if (l)
+		{
+			last_id[w] = link_id(w, l);
+			event_do(&ack[w]);
+		}
+	}
+}
+
+static void start_waiters(int n)
+{
+	stop = false;
+	for (int w = 0; w < n; w++)
+	{
+		event_initGeneric(&ack[w]);
+		last_id[w] = -1;
+		proc_new(waiter, (iptr_t)&sets[w], sizeof(waiter_stack[w]), waiter_stack[w]);
+	}
+}
+
+static void stop_waiters(void)
+{
+	stop = true;
+	/* Let them see the flag */
+	timer_delay(250);
+}
+
+static void timer_trigger(void *arg)
+{
+	event_do((Event *)arg);
+}
+
+static int event_testWaiters(void)
+{
+	Timer t;
+
+	init_sets(MAX_EVENTS, WAITERS);
+	start_waiters(WAITERS);
+
+	/* Both processes wake up for every event */
+	for (int i = 0; i < 100; i++)
+	{
+		int id = rand_event(MAX_EVENTS);
+
+		event_do(&events[id]);
+		for (int w = 0; w < WAITERS; w++)
+		{
+			if (!event_waitTimeout(&ack[w], ms_to_ticks(100)) || last_id[w] != id)
+			{
+				kprintf("waiter %d: got %d instead of %d\n", w, last_id[w], id);
+				return -1;
+			}
+		}
+	}
+
+	/* From interrupt context */
+	timer_setSoftint(&t, timer_trigger, &events[123]);
+	timer_setDelay(&t, ms_to_ticks(10));
+	timer_add(&t);
+	for (int w = 0; w < WAITERS; w++)
+		if (!event_waitTimeout(&ack[w], ms_to_ticks(100)) || last_id[w] != 123)
+			return -1;
+
+	stop_waiters();
+	return 0;
+}
+
+static void event_benchmark(int n)
+{
+	hptime_t start, t_poll, t_wake;
+	volatile int sink = 0;
+
+	init_sets(n, 1);
+
+	start = hptime_get();
+	for (int i = 0; i < POLL_LOOPS; i++)
+	{
+		event_do(&events[rand_event(n)]);
+		sink += link_id(0, event_setPoll(&sets[0]));
+	}
+	t_poll = hptime_get() - start;
+
+	start_waiters(1);
+	start = hptime_get();
+	for (int i = 0; i < WAKEUPS; i++)
+	{
+		event_do(&events[rand_event(n)]);
+		event_wait(&ack[0]);
+	}
+	t_wake = hptime_get() - start;
+	stop_waiters();
+
+	kprintf("%3d events: trigger+poll %ldns, wake up %ldus\n", n,
+		(long)(t_poll * 1000 / POLL_LOOPS), (long)(t_wake / WAKEUPS));
+}
+
+static void event_selectBenchmark(void)
+{
+	Event gen[4];
+	Event *evs[4];
+	hptime_t start;
+	volatile int sink = 0;
+
+	for (int i = 0; i < 4; i++)
+	{
+		event_initGeneric(&gen[i]);
+		evs[i] = &gen[i];
+	}
+
+	start = hptime_get();
+	for (int i = 0; i < POLL_LOOPS; i++)
+	{
+		event_do(&gen[rand_event(4)]);
+		sink += event_select(evs, 4, 0);
+	}
+	kprintf("  4 events: event_select() %ldns\n",
+		(long)((hptime_get() - start) * 1000 / POLL_LOOPS));
+}
+
+int event_testSetup(void)
+{
+	kdbg_init();
+	timer_init();
+	proc_init();
+	return 0;
+}
+
+int event_testRun(void)
+{
+	if (event_testReadyList() || event_testWaiters())
+		return -1;
+
+	event_benchmark(4);
+	event_benchmark(32);
+	event_benchmark(256);
+	event_selectBenchmark();
+	return 0;
+}
+
+int event_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(event);
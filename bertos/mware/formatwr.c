@@ -80,6 +80,7 @@
 
 #include "cfg/cfg_formatwr.h"  /* CONFIG_ macros */
 #include <cfg/debug.h>         /* ASSERT */
+#include <cfg/macros.h>        /* MIN */
 
 #include <cpu/pgm.h>
 #include <mware/hex.h>
@@ -324,16 +325,67 @@ CLEAN_UP:
 
 #endif /* CONFIG_PRINTF > PRINTF_NOFLOAT */
 
+#if CONFIG_PRINTF > PRINTF_REDUCED
+/*
+ * Emit a run of characters, in a single call if the sink allows it.
+ */
+static void sink_write(const FmtSink *sink, const char *buf, size_t len)
+{
+	if (sink->write)
+		sink->write(buf, len, sink->user_data);
+	else
+		while (len--)
+			sink->put_char(*buf++, sink->user_data);
+}
+
+/*
+ * Emit \a n padding spaces.
+ */
+static void sink_pad(const FmtSink *sink, int n)
+{
+	static const char spaces[] = "                ";
+
+	while (n > 0)
+	{
+		int len = MIN(n, (int)sizeof(spaces) - 1);
+
+		sink_write(sink, spaces, len);
+		n -= len;
+	}
+}
+#endif /* CONFIG_PRINTF > PRINTF_REDUCED */
+
 /**
- * This routine forms the core and entry of the formatter.
+ * Per-character formatter entry point, kept for compatibility.
  *
- * The conversion performed conforms to the ANSI specification for "printf".
+ * \sa _formatted_write_sink()
  */
 int
 PGM_FUNC(_formatted_write)(const char * PGM_ATTR format,
 		void put_one_char(char, void *),
 		void *secret_pointer,
 		va_list ap)
+{
+	FmtSink sink;
+
+	sink.put_char = put_one_char;
+	sink.write = NULL;
+	sink.user_data = secret_pointer;
+
+	return PGM_FUNC(_formatted_write_sink)(format, &sink, ap);
+}
+
+/**
+ * This routine forms the core and entry of the formatter.
+ *
+ * The conversion performed conforms to the ANSI specification for "printf".
+ * Characters are sent to \a sink; runs of literal text, converted
+ * values and padding are emitted as a whole when the sink supports it.
+ */
+int
+PGM_FUNC(_formatted_write_sink)(const char * PGM_ATTR format,
+		const FmtSink *sink,
+		va_list ap)
 {
 #if CONFIG_PRINTF > PRINTF_REDUCED
 	MEM_ATTRIBUTE static char bad_conversion[] = "???";
@@ -382,12 +434,16 @@ PGM_FUNC(_formatted_write)(const char * PGM_ATTR format,
 	MEM_ATTRIBUTE char *ptr;
 	MEM_ATTRIBUTE const char *hex;
 	MEM_ATTRIBUTE char buf[FRMWRI_BUFSIZE];
+#ifndef _PROGMEM
+	MEM_ATTRIBUTE const char *run;
+#endif
 
 #if CONFIG_PRINTF_COUNT_CHARS
 	nr_of_chars = 0;
 #endif
 	for (;;)    /* Until full format string read */
 	{
+#ifdef _PROGMEM
 		while ((format_flag = PGM_READ_CHAR(format++)) != '%')    /* Until '%' or '\0' */
 		{
 			if (!format_flag)
@@ -396,15 +452,34 @@ PGM_FUNC(_formatted_write)(const char * PGM_ATTR format,
 #else
 				return 0;
 #endif
-			put_one_char(format_flag, secret_pointer);
+			sink->put_char(format_flag, sink->user_data);
 #if CONFIG_PRINTF_COUNT_CHARS
 			nr_of_chars++;
 #endif
 		}
+#else
+		/* Emit literal text up to the next '%' as a single run */
+		run = format;
+		while ((format_flag = *format) && format_flag != '%')
+			format++;
+		if (format != run)
+		{
+			sink_write(sink, run, format - run);
+#if CONFIG_PRINTF_COUNT_CHARS
+			nr_of_chars += format - run;
+#endif
+		}
+		if (!*format++)
+#if CONFIG_PRINTF_RETURN_COUNT
+			return (nr_of_chars);
+#else
+			return 0;
+#endif
+#endif /* _PROGMEM */
 		if (PGM_READ_CHAR(format) == '%')    /* %% prints as % */
 		{
 			format++;
-			put_one_char('%', secret_pointer);
+			sink->put_char('%', sink->user_data);
 #if CONFIG_PRINTF_COUNT_CHARS
 			nr_of_chars++;
 #endif
@@ -761,7 +836,7 @@ FLOATING_CONVERSION:
 		}
 
 		/*
-		 * This part emittes the formatted string to "put_one_char".
+		 * This part emittes the formatted string to the sink.
 		 */
 
 		/* If field_width == 0 then nothing should be written. */
@@ -777,19 +852,18 @@ FLOATING_CONVERSION:
 		}
 
 		/* emit any leading pad characters */
-		if (!flags.left_adjust)
-			while (--n >= 0)
-			{
-				put_one_char(' ', secret_pointer);
+		if (!flags.left_adjust && n > 0)
+		{
+			sink_pad(sink, n);
 #if CONFIG_PRINTF_COUNT_CHARS
-				nr_of_chars++;
+			nr_of_chars += n;
 #endif
-			}
+		}
 
 		/* emit flag characters (if any) */
 		if (flags.plus_space_flag)
 		{
-			put_one_char(flags.plus_space_flag == PSF_PLUS ? '+' : '-', secret_pointer);
+			sink->put_char(flags.plus_space_flag == PSF_PLUS ? '+' : '-', sink->user_data);
 #if CONFIG_PRINTF_COUNT_CHARS
 			nr_of_chars++;
 #endif
@@ -800,7 +874,7 @@ FLOATING_CONVERSION:
 		{
 			while (--precision >= 0)
 			{
-				put_one_char(pgm_read_char(buf_pointer++), secret_pointer);
+				sink->put_char(pgm_read_char(buf_pointer++), sink->user_data);
 #if CONFIG_PRINTF_COUNT_CHARS
 				nr_of_chars++;
 #endif
@@ -808,26 +882,23 @@ FLOATING_CONVERSION:
 		}
 		else
 #endif /* CPU_HARVARD */
+		if (precision > 0)
 		{
 			/* emit the string itself */
-			while (--precision >= 0)
-			{
-				put_one_char(*buf_pointer++, secret_pointer);
+			sink_write(sink, buf_pointer, precision);
 #if CONFIG_PRINTF_COUNT_CHARS
-				nr_of_chars++;
+			nr_of_chars += precision;
 #endif
-			}
 		}
 
 		/* emit trailing space characters */
-		if (flags.left_adjust)
-			while (--n >= 0)
-			{
-				put_one_char(' ', secret_pointer);
+		if (flags.left_adjust && n > 0)
+		{
+			sink_pad(sink, n);
 #if CONFIG_PRINTF_COUNT_CHARS
-				nr_of_chars++;
+			nr_of_chars += n;
 #endif
-			}
+		}
 	}
 
 #else /* PRINTF_REDUCED starts here */
@@ -851,7 +922,7 @@ FLOATING_CONVERSION:
 		{
 			if (!format_flag)
 				return (nr_of_chars);
-			put_one_char(format_flag, secret_pointer);
+			sink->put_char(format_flag, sink->user_data);
 			nr_of_chars++;
 		}
 
@@ -885,7 +956,7 @@ FLOATING_CONVERSION:
 			case 'c':
 				format_flag = va_arg(ap, int);
 			default:
-				put_one_char(format_flag, secret_pointer);
+				sink->put_char(format_flag, sink->user_data);
 				nr_of_chars++;
 				continue;
 
@@ -893,7 +964,7 @@ FLOATING_CONVERSION:
 				ptr = va_arg(ap, char *);
 				while ((format_flag = *ptr++))
 				{
-					put_one_char(format_flag, secret_pointer);
+					sink->put_char(format_flag, sink->user_data);
 					nr_of_chars++;
 				}
 				continue;
@@ -949,7 +1020,7 @@ CONVERSION_LOOP:
 					if (((int)u_val) < 0)
 					{
 						u_val = - u_val;
-						put_one_char('-', secret_pointer);
+						sink->put_char('-', sink->user_data);
 						nr_of_chars++;
 					}
 				}
@@ -967,7 +1038,7 @@ CONVERSION_LOOP:
 						else
 							outChar += 'A'-'9'-1;
 					}
-					put_one_char(outChar, secret_pointer);
+					sink->put_char(outChar, sink->user_data);
 					nr_of_chars++;
 					u_val %= div_val;
 					div_val /= base;
@@ -47,6 +47,7 @@
 #include <cpu/attr.h>    /* CPU_HARVARD */
 
 #include <stdarg.h>      /* va_list */
+#include <stddef.h>      /* size_t */
 
 /**
  * \name _formatted_write() configuration
@@ -65,6 +66,21 @@
 	#define CONFIG_PRINTF_RETURN_COUNT 1
 #endif
 
+/**
+ * Output sink for the formatter.
+ *
+ * \a put_char is always required and receives one character at a time.
+ * \a write is optional: when supplied, the formatter uses it to emit
+ * whole runs of characters (literal text, converted numbers, strings and
+ * padding) with a single call.
+ */
+typedef struct FmtSink
+{
+	void (*put_char)(char c, void *user_data);                  ///< Emit one character.
+	void (*write)(const char *buf, size_t len, void *user_data); ///< Emit a run of characters, may be NULL.
+	void *user_data;                                             ///< Opaque sink state.
+} FmtSink;
+
 int
 _formatted_write(
 	const char *format,
@@ -72,6 +88,8 @@ _formatted_write(
 	void *user_data,
 	va_list ap);
 
+int _formatted_write_sink(const char *format, const FmtSink *sink, va_list ap);
+
 #if CPU_HARVARD
 	#include <cpu/pgm.h>
 	int _formatted_write_P(
@@ -79,6 +97,8 @@ _formatted_write(
 		void put_char_func(char c, void *user_data),
 		void *user_data,
 		va_list ap);
+
+	int _formatted_write_sink_P(const char * PROGMEM format, const FmtSink *sink, va_list ap);
 #endif /* CPU_HARVARD */
 
 int sprintf_testSetup(void);
@@ -37,6 +37,8 @@
 
 #include "ini_reader.h"
 #include "cfg/cfg_ini_reader.h"
+#include <cfg/compiler.h>
+#include <cfg/macros.h> // MAX()
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h> //strtol
@@ -204,10 +206,10 @@ int ini_getInteger(KFile *fd, const char *section, const char *key, long default
 	if (ini_getString(fd, section, key, "", buf, sizeof(buf)) == EOF)
 		goto error;
 
-	char **endptr = NULL;
-	*val = strtol(buf, endptr, base);
+	char *endptr;
+	*val = strtol(buf, &endptr, base);
 
-	if (buf[0] == 0 || **endptr != 0)
+	if (buf[0] == 0 || *endptr != 0)
 		goto error;
 
 	return 0;
@@ -311,3 +313,422 @@ int ini_setString(KFile *in, KFile *out, const char *section, const char *key, c
 	return 0;
 }
 
+
+
+/*
+ * Indexed access.
+ */
+
+#define INI_FREE  ((kfile_off_t)-1)
+
+/* FNV-1a, continued over \a len chars of \a s */
+static uint32_t hashStr(uint32_t h, const char *s, size_t len)
+{
+	while (len--)
+	{
+		h ^= (unsigned char)*s++;
+		h *= 0x01000193UL;
+	}
+	return h;
+}
+
+#define HASH_INIT  0x811C9DC5UL
+
+INLINE uint32_t hashSection(const char *section, size_t len)
+{
+	return hashStr(HASH_INIT, section, len);
+}
+
+/*
+ * The key hash continues the one of its section name, which is computed
+ * without the brackets. Mixing in ']' first keeps key "c" of section "ab"
+ * from hashing like section "abc".
+ */
+INLINE uint32_t hashKey(uint32_t section_hash, const char *key, size_t len)
+{
+	return hashStr(section_hash ^ ']', key, len);
+}
+
+/*
+ * Return the section name of a "[name]" line and its length, NULL if
+ * \a line is not a valid section.
+ */
+static const char *sectionName(const char *line, size_t *len)
+{
+	const char *end;
+
+	if (*line != '[' || !(end = strchr(line, ']')))
+		return NULL;
+
+	*len = end - line - 1;
+	return line + 1;
+}
+
+/*
+ * Return the key of a "key = value" line and its length, NULL if \a line
+ * does not contain a key.
+ */
+static const char *keyName(const char *line, size_t *len)
+{
+	const char *key, *end;
+
+	if (!strchr(line, '='))
+		return NULL;
+
+	while (isspace((unsigned char)*line))
+		++line;
+	key = end = line;
+	while (*end != '=' && !isspace((unsigned char)*end))
+		++end;
+
+	*len = end - key;
+	return *len ? key : NULL;
+}
+
+static int indexInsert(IniFile *ini, uint32_t hash, kfile_off_t off, kfile_off_t aux)
+{
+	/* Keep one slot free, so that probing for a missing entry always ends */
+	if (ini->count + 1 >= ini->size)
+		return EOF;
+
+	size_t i = hash % ini->size;
+	while (ini->index[i].off != INI_FREE)
+		i = (i + 1) % ini->size;
+
+	ini->index[i].hash = hash;
+	ini->index[i].off = off;
+	ini->index[i].aux = aux;
+	ini->count++;
+	return (int)i;
+}
+
+/**
+ * Build the index of the sections and keys of an ini file.
+ *
+ * The file is read once: every section and every key line is recorded in
+ * \a index by hash and file offset, so that following lookups with
+ * ini_lookupString() and ini_lookupInteger() read just the lines of the
+ * section and of the key instead of scanning the file.
+ *
+ * \a index is an open addressing table, make it some 30% bigger than the
+ * number of sections plus keys in the file.
+ * Keys are matched in the first section with their name that contains them,
+ * while ini_getString() only looks in the first section with that name.
+ *
+ * \param ini Context to initialize.
+ * \param fd An initialized KFile structure, it must not be modified while
+ *           the index is in use.
+ * \param index Storage for the index.
+ * \param size Number of elements of \a index.
+ * \return 0 if the whole file was indexed, EOF on read errors or if
+ *         \a index is too small.
+ */
+int ini_open(IniFile *ini, KFile *fd, IniEntry *index, size_t size)
+{
+	char line[CONFIG_INI_MAX_LINE_LEN];
+	int section = -1;
+	int err;
+
+	ini->fd = fd;
+	ini->index = index;
+	ini->size = size;
+	ini->count = 0;
+	ini->end = 0;
+	for (size_t i = 0; i < size; ++i)
+		index[i].off = INI_FREE;
+
+	if (kfile_seek(fd, 0, KSM_SEEK_SET) == EOF)
+		return EOF;
+
+	do
+	{
+		kfile_off_t pos = fd->seek_pos;
+		const char *name;
+		size_t len;
+
+		err = kfile_gets(fd, line, sizeof(line));
+
+		if (lineEmpty(line))
+			continue;
+		ini->end = fd->seek_pos;
+
+		if (*line == '[')
+		{
+			section = -1;
+			if ((name = sectionName(line, &len)))
+			{
+				section = indexInsert(ini, hashSection(name, len), pos, fd->seek_pos);
+				if (section < 0)
+					return EOF;
+			}
+			continue;
+		}
+
+		if (section < 0)
+			continue;
+
+		/* Track the end of the section, where new keys are added */
+		index[section].aux = fd->seek_pos;
+
+		if ((name = keyName(line, &len))
+			&& indexInsert(ini, hashKey(index[section].hash, name, len), pos, index[section].off) < 0)
+			return EOF;
+	}
+	while (err != EOF);
+
+	return 0;
+}
+
+/* Read the line at \a off */
+static int readLine(KFile *fd, kfile_off_t off, char *line, size_t size)
+{
+	if (kfile_seek(fd, off, KSM_SEEK_SET) == EOF)
+		return EOF;
+	kfile_gets(fd, line, size);
+	return 0;
+}
+
+static bool sameName(const char *name, size_t len, const char *str)
+{
+	return name && strlen(str) == len && !strncmp(name, str, len);
+}
+
+/*
+ * Find the index entry of \a key in \a section, or of \a section if \a key
+ * is NULL. \a line is filled with the line of the entry.
+ */
+static IniEntry *indexFind(IniFile *ini, const char *section, const char *key, char *line, size_t size)
+{
+	uint32_t hash = hashSection(section, strlen(section));
+	const char *name;
+	size_t len;
+
+	if (key)
+		hash = hashKey(hash, key, strlen(key));
+
+	for (size_t i = hash % ini->size; ini->index[i].off != INI_FREE; i = (i + 1) % ini->size)
+	{
+		IniEntry *e = &ini->index[i];
+
+		if (e->hash != hash)
+			continue;
+
+		/* Hashes collide: check the names on the file */
+		if (key)
+		{
+			if (readLine(ini->fd, e->aux, line, size) == EOF)
+				return NULL;
+			name = sectionName(line, &len);
+			if (!sameName(name, len, section))
+				continue;
+		}
+
+		if (readLine(ini->fd, e->off, line, size) == EOF)
+			return NULL;
+		name = key ? keyName(line, &len) : sectionName(line, &len);
+		if (sameName(name, len, key ? key : section))
+			return e;
+	}
+	return NULL;
+}
+
+/**
+ * Indexed version of ini_getString().
+ *
+ * \param ini Context initialized with ini_open().
+ * \param section The section to be looked for.
+ * \param key The key to search for.
+ * \param default_value The default value.
+ * \param buf The buffer to be filled.
+ * \param size The size of the provided buffer.
+ * \return 0 if section and key were found, EOF on errors.
+ */
+int ini_lookupString(IniFile *ini, const char *section, const char *key, const char *default_value, char *buf, size_t size)
+{
+	char line[CONFIG_INI_MAX_LINE_LEN];
+
+	if (!indexFind(ini, section, key, line, sizeof(line)))
+	{
+		strncpy(buf, default_value, size);
+		if (size > 0)
+			buf[size - 1] = '\0';
+		return EOF;
+	}
+
+	getValue(line, buf, size);
+	return 0;
+}
+
+/**
+ * Indexed version of ini_getInteger().
+ */
+int ini_lookupInteger(IniFile *ini, const char *section, const char *key, long default_value, long *val, int base)
+{
+	char buf[CONFIG_INI_MAX_LINE_LEN];
+	char *endptr;
+
+	if (ini_lookupString(ini, section, key, "", buf, sizeof(buf)) == EOF)
+		goto error;
+
+	*val = strtol(buf, &endptr, base);
+	if (buf[0] == 0 || *endptr != 0)
+		goto error;
+
+	return 0;
+
+error:
+	*val = default_value;
+	return EOF;
+}
+
+/* Copy \a in up to \a pos */
+static int copyTo(KFile *in, KFile *out, kfile_off_t pos)
+{
+	kfile_off_t len = pos - in->seek_pos;
+
+	return (kfile_copy(in, out, len) == len) ? 0 : EOF;
+}
+
+static int writeKey(KFile *out, const IniUpdate *u)
+{
+	return ((size_t)kfile_printf(out, "%s=%s\n", u->key, u->value) ==
+		strlen(u->key) + strlen(u->value) + 2) ? 0 : EOF;
+}
+
+/* True if a later update in the batch overrides \a u */
+static bool overridden(const IniUpdate *u, const IniUpdate *last)
+{
+	for (const IniUpdate *v = u + 1; v <= last; ++v)
+		if (!strcmp(u->section, v->section) && !strcmp(u->key, v->key))
+			return true;
+	return false;
+}
+
+/**
+ * Write several keys in a single copy of the file.
+ *
+ * This is the batched version of ini_setString(): \a in is copied to \a out
+ * once, replacing, adding or (when the value is NULL) removing the keys in
+ * \a upd. New keys are added at the end of their section; keys of sections
+ * not in the file are grouped at the end of the file in new sections, in
+ * batch order. If a key appears more than once in the batch, the last value
+ * is written.
+ *
+ * \a upd is also used as scratch space: its private fields are overwritten.
+ * The index is still valid for \a in, not for \a out: call ini_open() on
+ * \a out to read the new values.
+ *
+ * \param ini Context initialized with ini_open() on the input file.
+ * \param out Output file, must be different from the input one.
+ * \param upd Keys to be written.
+ * \param count Number of elements of \a upd, if 0 nothing is written.
+ * \return 0 if everything is ok, EOF on errors.
+ */
+int ini_update(IniFile *ini, KFile *out, IniUpdate *upd, size_t count)
+{
+	char line[CONFIG_INI_MAX_LINE_LEN];
+	KFile *in = ini->fd;
+	IniUpdate *last;
+	IniEntry *e;
+
+	if (!count)
+		return 0;
+	last = upd + count - 1;
+
+	/* Plan: find where each update goes */
+	for (IniUpdate *u = upd; u <= last; ++u)
+	{
+		u->pos = INI_FREE;
+		u->replace = false;
+
+		if (overridden(u, last))
+			continue;
+
+		if ((e = indexFind(ini, u->section, u->key, line, sizeof(line))))
+		{
+			u->pos = e->off;
+			u->replace = true;
+		}
+		else if (u->value && (e = indexFind(ini, u->section, NULL, line, sizeof(line))))
+			u->pos = e->aux;
+		else if (u->value)
+			u->pos = ini->end + 1;
+	}
+
+	if (kfile_seek(in, 0, KSM_SEEK_SET) == EOF
+		|| kfile_seek(out, 0, KSM_SEEK_SET) == EOF)
+		return EOF;
+
+	/* Apply the updates inside the file, in offset order */
+	for (kfile_off_t cur_pos = -1;;)
+	{
+		IniUpdate *next = NULL;
+
+		for (IniUpdate *u = upd; u <= last; ++u)
+			if (u->pos > cur_pos && u->pos <= ini->end && (!next || u->pos < next->pos))
+				next = u;
+		if (!next)
+			break;
+
+		/* All the insertions at the end of the same section */
+		cur_pos = next->pos;
+		if (copyTo(in, out, cur_pos) == EOF)
+			return EOF;
+
+		for (IniUpdate *u = next; u <= last; ++u)
+		{
+			if (u->pos != cur_pos)
+				continue;
+			if (u->value && writeKey(out, u) == EOF)
+				return EOF;
+			/* Skip the old line with the key */
+			if (u->replace)
+				kfile_gets(in, line, sizeof(line));
+		}
+	}
+
+	/* New sections */
+	if (copyTo(in, out, MAX(in->seek_pos, ini->end)) == EOF)
+		return EOF;
+
+	for (IniUpdate *u = upd; u <= last; ++u)
+	{
+		if (u->pos != ini->end + 1)
+			continue;
+
+		/* First key of its section */
+		bool first = true;
+		for (IniUpdate *v = upd; v < u; ++v)
+			if (v->pos == u->pos && !strcmp(v->section, u->section))
+				first = false;
+		if (!first)
+			continue;
+
+		if ((size_t)kfile_printf(out, "\n[%s]\n", u->section) != (strlen(u->section) + 4))
+			return EOF;
+		for (IniUpdate *v = u; v <= last; ++v)
+			if (v->pos == u->pos && !strcmp(v->section, u->section) && writeKey(out, v) == EOF)
+				return EOF;
+	}
+
+	/*
+	 * Copy the rest of the input file: only empty lines are left, so do not
+	 * fail if the out KFile is of fixed size, like in ini_setString().
+	 */
+	kfile_copy(in, out, in->size - in->seek_pos);
+
+	kfile_off_t fill = out->size - out->seek_pos;
+
+	if (fill--)
+	{
+		if (kfile_putc('\n', out) == EOF)
+			return EOF;
+		while (fill--)
+		{
+			if (kfile_putc(' ', out) == EOF)
+				return EOF;
+		}
+	}
+
+	return 0;
+}
@@ -44,6 +44,13 @@
  * - no comments are allowed inside a line with key=value pair.
  * - every line that doesn't contain a '=' or doesn't start with '[' will be ignored.
  *
+ * ini_getString() and ini_getInteger() scan the file from the beginning at
+ * every call. To read many values, index the file once with ini_open() and
+ * use ini_lookupString() and ini_lookupInteger(): each lookup then costs a
+ * hash and the read of the section and key lines. ini_update() writes a
+ * batch of keys with a single copy of the file, where ini_setString() copies
+ * it once per key.
+ *
  * \author Luca Ottaviano <lottaviano@develer.com>
  *
  * $WIZ$ module_name = "ini_reader"
@@ -56,6 +63,42 @@
 
 #include <io/kfile.h>
 
+/**
+ * Entry of the index built by ini_open().
+ */
+typedef struct IniEntry
+{
+	uint32_t hash;    ///< Hash of the section name, followed by the key for keys.
+	kfile_off_t off;  ///< Offset of the section or key line, -1 for free entries.
+	kfile_off_t aux;  ///< Keys: offset of their section line, sections: end of their last non-empty line.
+} IniEntry;
+
+/**
+ * Indexed ini file, see ini_open().
+ */
+typedef struct IniFile
+{
+	KFile *fd;        ///< The ini file.
+	IniEntry *index;  ///< Index storage.
+	size_t size;      ///< Number of entries of the index.
+	size_t count;     ///< Used entries.
+	kfile_off_t end;  ///< End of the last non-empty line of the file.
+} IniFile;
+
+/**
+ * A key to be written by ini_update().
+ */
+typedef struct IniUpdate
+{
+	const char *section;  ///< Section of the key.
+	const char *key;      ///< Key name.
+	const char *value;    ///< New value, NULL to remove the key.
+
+	/* private */
+	kfile_off_t pos;      ///< Where the key goes in the input file.
+	bool replace;         ///< True if the key replaces the line at \a pos.
+} IniUpdate;
+
 /**
  * \brief Returns the value for the given string in char* format.
  * Reads the whole input file looking for section and key and fills the provided buffer with
@@ -75,6 +118,11 @@ int ini_getString(KFile *fd, const char *section, const char *key, const char *d
 int ini_getInteger(KFile *fd, const char *section, const char *key, long default_value, long *val, int base);
 int ini_setString(KFile *in, KFile *out, const char *section, const char *key, const char *value);
 
+int ini_open(IniFile *ini, KFile *fd, IniEntry *index, size_t size);
+int ini_lookupString(IniFile *ini, const char *section, const char *key, const char *default_value, char *buf, size_t size);
+int ini_lookupInteger(IniFile *ini, const char *section, const char *key, long default_value, long *val, int base);
+int ini_update(IniFile *ini, KFile *out, IniUpdate *upd, size_t count);
+
 int ini_reader_testSetup(void);
 int ini_reader_testRun(void);
 int ini_reader_testTearDown(void);
@@ -31,6 +31,9 @@
  *
  * \brief Test function for ini_reader module.
  *
+ * Check the indexed lookups and the batched updates against the plain
+ * functions, and compare their cost reading a configuration at boot.
+ *
  * $test$: cp bertos/cfg/cfg_kfile.h $cfgdir/
  * $test$: echo "#undef CONFIG_KFILE_GETS" >> $cfgdir/cfg_kfile.h
  * $test$: echo "#define CONFIG_KFILE_GETS 1" >> $cfgdir/cfg_kfile.h
@@ -40,7 +43,12 @@
 
 #include <emul/kfile_posix.h>
 #include <cfg/test.h>
+#include <cfg/macros.h> // countof()
+
+#include <os/hptime.h>
+#include <struct/kfile_mem.h>
 
+#include <stdio.h> // sprintf
 #include <string.h> // strcmp
 
 #include "ini_reader.h"
@@ -48,6 +56,179 @@
 const char ini_file[] = "./test/ini_reader_file.ini";
 static KFilePosix kf;
 
+static const char *queries[][2] =
+{
+	{ "First", "String" }, { "First", "Val" }, { "First", "Empty" },
+	{ "First", "Missing" }, { "Second", "Val" },
+	{ "Second", "String" }, { "Second", "Long key" }, { "Second", "Long" },
+	{ "Second", "comment" }, { "Second", "#comment" }, { "Second", "Bar" },
+	{ "Foo", "Bar" }, { "Long section with spaces", "value" },
+	{ "Long section with spaces", "no_new_line" }, { "Long section", "value" },
+	{ "", "Val" },
+};
+
+static int indexed_test(void)
+{
+	IniFile ini;
+	IniEntry index[32];
+	char buf[30], ref[30];
+	long val;
+
+	ASSERT(ini_open(&ini, &kf.fd, index, countof(index)) != EOF);
+	/* 3 sections and 10 keys */
+	ASSERT(ini.count == 13);
+
+	for (unsigned i = 0; i < countof(queries); ++i)
+	{
+		int ret_ref = ini_getString(&kf.fd, queries[i][0], queries[i][1], "default", ref, sizeof(ref));
+		int ret = ini_lookupString(&ini, queries[i][0], queries[i][1], "default", buf, sizeof(buf));
+
+		if (ret != ret_ref || strcmp(buf, ref))
+		{
+			kprintf("[%s] %s: \"%s\" (%d), expected \"%s\" (%d)\n",
+				queries[i][0], queries[i][1], buf, ret, ref, ret_ref);
+			return -1;
+		}
+	}
+
+	/* Lines without '=' have no key (ini_getString() reads past them) */
+	ASSERT(ini_lookupString(&ini, "First", "#comment", "default", buf, sizeof(buf)) == EOF);
+	ASSERT(ini_lookupString(&ini, "First", "", "default", buf, sizeof(buf)) == EOF);
+
+	ASSERT(ini_lookupInteger(&ini, "Second", "Val", 0, &val, 10) != EOF);
+	ASSERT(val == 2);
+	ASSERT(ini_lookupInteger(&ini, "Second", "String", 5, &val, 10) == EOF);
+	ASSERT(val == 5);
+
+	/* Index too small */
+	ASSERT(ini_open(&ini, &kf.fd, index, 8) == EOF);
+	return 0;
+}
+
+#define FILE_SIZE  1024
+
+static char update_in[FILE_SIZE], update_seq[2][FILE_SIZE], update_batch[FILE_SIZE];
+
+/* File contents, up to the padding left by ini_setString() */
+static size_t contents(const char *buf)
+{
+	size_t len = FILE_SIZE;
+
+	while (len && (buf[len - 1] == ' ' || buf[len - 1] == '\n'))
+		--len;
+	return len;
+}
+
+static int update_test(void)
+{
+	IniUpdate upd[] =
+	{
+		{ .section = "Second", .key = "String", .value = "wim" },
+		{ .section = "New", .key = "a", .value = "1" },
+		{ .section = "First", .key = "Val", .value = NULL },
+		{ .section = "First", .key = "Added", .value = "yes" },
+		{ .section = "Other", .key = "b", .value = "2" },
+		{ .section = "Second", .key = "Missing", .value = NULL },
+		{ .section = "New", .key = "c", .value = "3" },
+		{ .section = "Long section with spaces", .key = "no_new_line", .value = "last" },
+		{ .section = "Second", .key = "String", .value = "zus" },
+		{ .section = "Long section with spaces", .key = "tail", .value = "end" },
+	};
+	KFileMem in, out;
+	IniFile ini;
+	IniEntry index[32];
+	size_t len;
+
+	kfile_seek(&kf.fd, 0, KSM_SEEK_SET);
+	memset(update_in, ' ', sizeof(update_in));
+	len = kfile_read(&kf.fd, update_in, sizeof(update_in));
+
+	/* Reference: one ini_setString() per key */
+	kfilemem_init(&in, update_in, len);
+	for (unsigned i = 0; i < countof(upd); ++i)
+	{
+		kfilemem_init(&out, update_seq[i % 2], FILE_SIZE);
+		ASSERT(ini_setString(&in.fd, &out.fd, upd[i].section, upd[i].key, upd[i].value) != EOF);
+		kfilemem_init(&in, update_seq[i % 2], FILE_SIZE);
+	}
+	const char *ref = update_seq[(countof(upd) - 1) % 2];
+
+	kfilemem_init(&in, update_in, len);
+	kfilemem_init(&out, update_batch, FILE_SIZE);
+	ASSERT(ini_open(&ini, &in.fd, index, countof(index)) != EOF);
+	/* Empty batch: nothing to do */
+	ASSERT(ini_update(&ini, &out.fd, upd, 0) == 0);
+	ASSERT(out.fd.seek_pos == 0);
+	ASSERT(ini_update(&ini, &out.fd, upd, countof(upd)) != EOF);
+
+	if (contents(ref) != contents(update_batch)
+		|| memcmp(ref, update_batch, contents(ref)))
+	{
+		kprintf("batched update differs:\n%.*s\nexpected:\n%.*s\n",
+			(int)contents(update_batch), update_batch, (int)contents(ref), ref);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Boot time configuration: read BOOT_KEYS values out of a file with
+ * BOOT_SECTIONS sections of BOOT_SECTION_KEYS keys each.
+ */
+#define BOOT_SECTIONS      10
+#define BOOT_SECTION_KEYS  10
+#define BOOT_KEYS          50
+
+static char boot_file[BOOT_SECTIONS * BOOT_SECTION_KEYS * 24];
+
+static int boot_bench(void)
+{
+	KFileMem km;
+	IniFile ini;
+	IniEntry index[BOOT_SECTIONS * (BOOT_SECTION_KEYS + 1) * 4 / 3];
+	char section[16], key[16];
+	long val, sum_scan = 0, sum_index = 0;
+	size_t len = 0;
+	hptime_t start, t_scan, t_open, t_index;
+
+	for (int s = 0; s < BOOT_SECTIONS; ++s)
+	{
+		len += sprintf(boot_file + len, "[section%d]\n", s);
+		for (int k = 0; k < BOOT_SECTION_KEYS; ++k)
+			len += sprintf(boot_file + len, "key%d = %d\n", k, s * 100 + k);
+		len += sprintf(boot_file + len, "\n");
+	}
+	ASSERT(len < sizeof(boot_file));
+	kfilemem_init(&km, boot_file, len);
+
+	start = hptime_get();
+	for (int i = 0; i < BOOT_KEYS; ++i)
+	{
+		sprintf(section, "section%d", i * 7 % BOOT_SECTIONS);
+		sprintf(key, "key%d", i * 3 % BOOT_SECTION_KEYS);
+		ASSERT(ini_getInteger(&km.fd, section, key, 0, &val, 10) != EOF);
+		sum_scan += val;
+	}
+	t_scan = hptime_get() - start;
+
+	start = hptime_get();
+	ASSERT(ini_open(&ini, &km.fd, index, countof(index)) != EOF);
+	t_open = hptime_get() - start;
+	for (int i = 0; i < BOOT_KEYS; ++i)
+	{
+		sprintf(section, "section%d", i * 7 % BOOT_SECTIONS);
+		sprintf(key, "key%d", i * 3 % BOOT_SECTION_KEYS);
+		ASSERT(ini_lookupInteger(&ini, section, key, 0, &val, 10) != EOF);
+		sum_index += val;
+	}
+	t_index = hptime_get() - start;
+
+	ASSERT(sum_scan == sum_index);
+	kprintf("%d keys out of a %d bytes file: scan %ld us, index %ld us (open %ld us, %d bytes)\n",
+		BOOT_KEYS, (int)len, (long)t_scan, (long)t_index, (long)t_open, (int)sizeof(index));
+	return 0;
+}
+
 int ini_reader_testSetup(void)
 {
 	kdbg_init();
@@ -89,7 +270,14 @@ int ini_reader_testRun(void)
 
 	ASSERT(ini_getString(&kf.fd, "Long section with spaces", "no_new_line", "", buf, 30) != EOF);
 	ASSERT(strcmp(buf, "value") == 0);
-	return 0;
+
+	long val;
+	ASSERT(ini_getInteger(&kf.fd, "First", "Val", 0, &val, 10) != EOF);
+	ASSERT(val == 1);
+	ASSERT(ini_getInteger(&kf.fd, "First", "String", 7, &val, 10) == EOF);
+	ASSERT(val == 7);
+
+	return indexed_test() || update_test() || boot_bench();
 }
 
 int ini_reader_testTearDown(void)
@@ -57,17 +57,26 @@
 
 #include "cfg/cfg_parser.h"
 
+#include <cfg/macros.h> // BV()
+
+#include <cpu/pgm.h>
+
 #include <io/kfile.h>
 #include <struct/hashtable.h>
 
 #include <stdlib.h> // atol(), NULL
 #include <string.h> // strchr(), strcmp()
 
+#if CONFIG_MAX_COMMANDS_NUMBER > 0
 /// Hashtable hook to extract the key from a command
 static const void* get_key_from_command(const void* cmd, uint8_t* length);
 
 /// Hashtable that handles the commands that can be executed
 DECLARE_HASHTABLE_STATIC(commands, CONFIG_MAX_COMMANDS_NUMBER, get_key_from_command);
+#endif
+
+/// Static command table, see parser_register_table()
+static const struct ParserTable *cmd_table;
 
 
 /**
@@ -177,12 +186,160 @@ static bool parseArgs(const char *fmt, const char *input, parms argv[])
 	return true;
 }
 
+/**
+ * \brief Command arguments parser for pre-decoded formats.
+ *
+ * Same as parseArgs(), but the argument types come from the
+ * descriptor generated at build time.
+ */
+static bool parseDesc(const struct ParserCmdDesc *desc, const char *input, parms argv[])
+{
+	const char *begin = input, *end = input;
+	uint8_t str = desc->args_str;
+
+	for (uint8_t i = desc->nargs; i; --i, str >>= 1)
+	{
+		if (!get_word(&begin, &end))
+			return false;
+
+		if (str & 1)
+		{
+			argv->s.p = begin;
+			argv->s.sz = end - begin;
+			if (*begin == '"' && *(end - 1) == '"')
+			{
+				argv->s.p += 1;
+				argv->s.sz -= 2;
+			}
+		}
+		else
+			argv->l = atol(begin);
+		argv++;
+	}
+
+	return !get_word(&begin, &end);
+}
+
+/**
+ * 32 bit FNV-1a hash of a command word.
+ *
+ * \note Must match cmd_hash() in test/gen_cmd_table.py.
+ */
+static uint32_t parser_hash(const char *word, size_t len)
+{
+	uint32_t h = 0x811C9DC5UL;
+
+	while (len--)
+	{
+		h ^= (uint8_t)*word++;
+		h *= 0x01000193UL;
+	}
+	return h;
+}
+
+/**
+ * Slot of the command with hash \a h in the static table.
+ *
+ * \note Must match slot() in test/gen_cmd_table.py.
+ */
+static uint8_t table_slot(const struct ParserTable *t, uint32_t h)
+{
+	uint32_t d = pgm_read16(&t->disp[h % t->disp_size]);
+
+	h ^= d * 0x9E3779B1UL;
+	h ^= h >> 16;
+	h *= 0x85EBCA6BUL;
+	h ^= h >> 13;
+	return h % t->size;
+}
+
+static const struct CmdTemplate *table_find(const char *word, size_t len)
+{
+	const struct ParserTable *t = cmd_table;
+
+	if (!t)
+		return NULL;
+
+	uint8_t i = table_slot(t, parser_hash(word, len));
+
+	/* Perfect hash: any other word lands on a valid slot too, check it */
+	if (pgm_read8(&t->desc[i].name_len) != len
+		|| strncmp(t->cmds[i].name, word, len))
+		return NULL;
+
+	return &t->cmds[i];
+}
+
+/// Index of \a templ in the static table, or -1 if it was registered at runtime
+static int table_index(const struct CmdTemplate *templ)
+{
+	const struct ParserTable *t = cmd_table;
+
+	if (t && templ >= t->cmds && templ < t->cmds + t->size)
+		return templ - t->cmds;
+	return -1;
+}
+
+/// Copy the descriptor of slot \a i of the static table out of program memory
+static void table_desc(int i, struct ParserCmdDesc *desc)
+{
+	const struct ParserCmdDesc *d = &cmd_table->desc[i];
+
+	desc->name_len = pgm_read8(&d->name_len);
+	desc->nargs = pgm_read8(&d->nargs);
+	desc->nres = pgm_read8(&d->nres);
+	desc->args_str = pgm_read8(&d->args_str);
+	desc->res_str = pgm_read8(&d->res_str);
+}
+
+/**
+ * Read the pre-decoded formats of a command.
+ *
+ * Commands from the static table read their descriptor from program
+ * memory, the ones registered with parser_register_cmd() are decoded
+ * from the format strings.
+ */
+void parser_get_cmd_desc(const struct CmdTemplate *templ, struct ParserCmdDesc *desc)
+{
+	int i = table_index(templ);
+
+	if (i >= 0)
+	{
+		table_desc(i, desc);
+		return;
+	}
+
+	desc->name_len = strlen(templ->name);
+	desc->nargs = desc->nres = desc->args_str = desc->res_str = 0;
+	for (const char *f = templ->arg_fmt; *f; ++f, ++desc->nargs)
+		if (*f == 's')
+			desc->args_str |= BV(desc->nargs);
+	for (const char *f = templ->result_fmt; *f; ++f, ++desc->nres)
+		if (*f == 's')
+			desc->res_str |= BV(desc->nres);
+}
+
 /// Hook provided by the parser for matching of command names (TAB completion) for readline
 const char* parser_rl_match(UNUSED_ARG(void *,dummy), const char *word, int word_len)
 {
+	const char *found = NULL;
+
+	if (cmd_table)
+	{
+		for (uint8_t i = 0; i < cmd_table->size; ++i)
+		{
+			if (strncmp(cmd_table->cmds[i].name, word, word_len) == 0)
+			{
+				if (found)
+					return NULL;
+				found = cmd_table->cmds[i].name;
+			}
+		}
+	}
+
+#if CONFIG_MAX_COMMANDS_NUMBER > 0
 	HashIterator cur;
 	HashIterator end = ht_iter_end(&commands);
-	const char *found = NULL;
 
 	for (cur = ht_iter_begin(&commands);
 	     !ht_iter_cmp(cur, end);
@@ -199,6 +356,7 @@ const char* parser_rl_match(UNUSED_ARG(void *,dummy), const char *word, int word
 			found = cmdp->name;
 		}
 	}
+#endif
 
 	return found;
 }
@@ -248,7 +406,13 @@ const struct CmdTemplate* parser_get_cmd_template(const char *input)
 	if (!get_word(&begin, &end))
 		return NULL;
 
-	return (const struct CmdTemplate*)ht_find(&commands, begin, end-begin);
+	const struct CmdTemplate *templ = table_find(begin, end - begin);
+
+#if CONFIG_MAX_COMMANDS_NUMBER > 0
+	if (!templ)
+		templ = (const struct CmdTemplate*)ht_find(&commands, begin, end-begin);
+#endif
+	return templ;
 }
 
 static const char *skip_to_params(const char *input, const struct CmdTemplate *cmdp)
@@ -289,18 +453,30 @@ bool parser_get_cmd_arguments(const char* input, const struct CmdTemplate* cmdp,
 		return false;
 
 	args[0].s.p = cmdp->name;
+
+	int i = table_index(cmdp);
+	if (i >= 0)
+	{
+		struct ParserCmdDesc desc;
+
+		table_desc(i, &desc);
+		return parseDesc(&desc, input, args + 1);
+	}
+
 	if (!parseArgs(cmdp->arg_fmt, input, args + 1))
 		return false;
 
 	return true;
 }
 
+#if CONFIG_MAX_COMMANDS_NUMBER > 0
 static const void* get_key_from_command(const void* cmd, uint8_t* length)
 {
 	const struct CmdTemplate* c = cmd;
 	*length = strlen(c->name);
 	return c->name;
 }
+#endif
 
 /**
  * \brief Command input handler.
@@ -337,11 +513,33 @@ bool parser_process_line(const char* input)
  */
 bool parser_register_cmd(const struct CmdTemplate* cmd)
 {
+#if CONFIG_MAX_COMMANDS_NUMBER > 0
 	return ht_insert(&commands, cmd);
+#else
+	(void)cmd;
+	return false;
+#endif
+}
+
+/**
+ * Register a static command table generated by test/gen_cmd_table.py.
+ *
+ * The table is looked up before the commands registered with
+ * parser_register_cmd(); registering a new table replaces the previous one.
+ *
+ * \param table Command table, NULL to unregister the current one
+ */
+void parser_register_table(const struct ParserTable *table)
+{
+	ASSERT(!table || (table->size && table->disp_size));
+	cmd_table = table;
 }
 
 void parser_init(void)
 {
+#if CONFIG_MAX_COMMANDS_NUMBER > 0
 	// Initialize the hashtable used to store the command description
 	ht_init(&commands);
+#endif
+	cmd_table = NULL;
 }
@@ -65,6 +65,16 @@
  * You can also provide interactive command line completion using
  * parser_rl_match().
  *
+ * When the command set is fixed at build time, the commands can be listed
+ * in a text file and compiled into a static table by test/gen_cmd_table.py.
+ * The generated struct ParserTable holds a minimal perfect hash over the
+ * command names and the pre-decoded argument formats in program memory:
+ * it is installed with a single parser_register_table() call, so there is no
+ * per-command registration at boot, and every lookup costs one hash of the
+ * command word and one string compare.
+ * Set CONFIG_MAX_COMMANDS_NUMBER to 0 to drop the runtime hashtable
+ * altogether when all the commands come from a static table.
+ *
  * Example:
  * \code
  * // Declare a buzzer command
@@ -164,6 +174,38 @@ struct CmdTemplate
 	uint16_t   flags;          ///< Currently unused.
 };
 
+/**
+ * Pre-decoded command formats, generated by test/gen_cmd_table.py.
+ *
+ * Bit i of the string masks is set when the i-th argument (or result)
+ * is a string ('s'), clear for a long integer ('d').
+ */
+struct ParserCmdDesc
+{
+	uint8_t name_len;  ///< Length of the command name
+	uint8_t nargs;     ///< Number of input arguments
+	uint8_t nres;      ///< Number of results
+	uint8_t args_str;  ///< String mask of the input arguments
+	uint8_t res_str;   ///< String mask of the results
+};
+
+/**
+ * Static command table, generated by test/gen_cmd_table.py.
+ *
+ * Commands are stored in hash slot order: a command word hashes to the
+ * displacement bucket \c disp[hash % disp_size], and the displaced hash
+ * modulo \c size is the index of its template and descriptor.
+ * \c desc and \c disp live in program memory.
+ */
+struct ParserTable
+{
+	const struct CmdTemplate *cmds;    ///< Command templates
+	const struct ParserCmdDesc *desc;  ///< Pre-decoded formats (PGM)
+	const uint16_t *disp;              ///< Hash displacements (PGM)
+	uint8_t size;                      ///< Number of commands
+	uint8_t disp_size;                 ///< Number of displacements
+};
+
 #define REGISTER_FUNCTION parser_register_cmd
 
 /**
@@ -232,6 +274,8 @@ MAKE_TEMPLATE(NAME, ARGS, RES, FLAGS)
 void parser_init(void);
 
 bool parser_register_cmd(const struct CmdTemplate* cmd);
+void parser_register_table(const struct ParserTable *table);
+void parser_get_cmd_desc(const struct CmdTemplate *templ, struct ParserCmdDesc *desc);
 
 
 /**
@@ -279,6 +323,9 @@ bool get_word(const char **begin, const char **end);
 bool parser_get_cmd_id(const char* line, unsigned long* ID);
 #endif
 
+int parser_testSetup(void);
+int parser_testRun(void);
+int parser_testTearDown(void);
 
 /** \} */ // defgroup parser
 #endif /* MWARE_PARSER_H */
@@ -0,0 +1,316 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Test the parser module.
+ *
+ * Run the same command lines through the commands registered at runtime
+ * in the hashtable and through the static table compiled by
+ * test/gen_cmd_table.py, check they give the same results and compare RAM,
+ * boot time and command latency of the two backends.
+ *
+ * $test$: python test/gen_cmd_table.py -n parser_test_table -o $testdir/parser_test_table.c test/parser_test_cmds.txt
+ */
+
+#include "parser.h"
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+#include <cfg/macros.h> // countof()
+
+#include <os/hptime.h>
+#include <struct/hashtable.h>
+
+#include <string.h>
+
+static long side_effect;
+
+MAKE_CMD(ver, "", "ddd", ({ args[1].l = 1; args[2].l = 2; args[3].l = 3; RC_OK; }), 0)
+MAKE_CMD(ping, "", "", ({ (void)args; side_effect++; RC_OK; }), 0)
+MAKE_CMD(reset, "", "", ({ (void)args; side_effect = 0; RC_OK; }), 0)
+MAKE_CMD(led, "d", "", ({ side_effect += args[1].l; RC_OK; }), 0)
+MAKE_CMD(beep, "dd", "", ({ side_effect += args[1].l * args[2].l; RC_OK; }), 0)
+MAKE_CMD(sleep, "d", "", ({ args[1].l < 0 ? RC_ERROR : RC_OK; }), 0)
+MAKE_CMD(add, "dd", "d", ({ args[3].l = args[1].l + args[2].l; RC_OK; }), 0)
+MAKE_CMD(mul, "dd", "d", ({ args[3].l = args[1].l * args[2].l; RC_OK; }), 0)
+MAKE_CMD(neg, "d", "d", ({ args[2].l = -args[1].l; RC_OK; }), 0)
+MAKE_CMD(len, "s", "d", ({ args[2].l = args[1].s.sz; RC_OK; }), 0)
+MAKE_CMD(echo, "s", "s", ({ args[2].s = args[1].s; RC_OK; }), 0)
+MAKE_CMD(cat, "ss", "s",
+({
+	args[3].s = args[1].s.sz >= args[2].s.sz ? args[1].s : args[2].s;
+	RC_OK;
+}), 0)
+/* Not in the static table, always registered at runtime */
+MAKE_CMD(extra, "d", "d", ({ args[2].l = args[1].l + 1; RC_OK; }), 0)
+
+/* Static table generated by the $test$ line above */
+#include "parser_test_table.c"
+
+static const char * const lines[] =
+{
+	"ver", "ping", "reset", "led 3", "beep 2 5", "sleep 10", "sleep -1",
+	"add 40 2", "mul -3 7", "neg 12", "len hello", "len \"two words\"",
+	"echo abc", "echo \"a b c\"", "cat \"x y\" zzzz", "  add\t1   2  ",
+	/* Errors */
+	"", "   ", "vers", "ve", "add", "add 1", "add 1 2 3", "echo \"open",
+	"nope 1 2", "ADD 1 2", "pin", "pingg", "led1",
+};
+
+static void register_all(void)
+{
+	REGISTER_CMD(ver);
+	REGISTER_CMD(ping);
+	REGISTER_CMD(reset);
+	REGISTER_CMD(led);
+	REGISTER_CMD(beep);
+	REGISTER_CMD(sleep);
+	REGISTER_CMD(add);
+	REGISTER_CMD(mul);
+	REGISTER_CMD(neg);
+	REGISTER_CMD(len);
+	REGISTER_CMD(echo);
+	REGISTER_CMD(cat);
+}
+
+/// Outcome of a command line, in the same steps of cli_parse()
+struct Outcome
+{
+	const char *name;
+	bool args_ok;
+	bool exec_ok;
+	struct ParserCmdDesc desc;
+	parms args[CONFIG_PARSER_MAX_ARGS];
+	long side_effect;
+};
+
+static void run_line(const char *line, struct Outcome *o)
+{
+	const struct CmdTemplate *templ;
+
+	memset(o, 0, sizeof(*o));
+	side_effect = 0;
+
+	templ = parser_get_cmd_template(line);
+	if (!templ)
+		return;
+
+	o->name = templ->name;
+	parser_get_cmd_desc(templ, &o->desc);
+	o->args_ok = parser_get_cmd_arguments(line, templ, o->args);
+	if (o->args_ok)
+		o->exec_ok = parser_execute_cmd(templ, o->args);
+	o->side_effect = side_effect;
+}
+
+static bool same_outcome(const struct Outcome *a, const struct Outcome *b)
+{
+	if (!a->name || !b->name)
+		return a->name == b->name;
+
+	if (strcmp(a->name, b->name) || a->args_ok != b->args_ok
+		|| a->exec_ok != b->exec_ok || a->side_effect != b->side_effect
+		|| memcmp(&a->desc, &b->desc, sizeof(a->desc)))
+		return false;
+
+	if (!a->args_ok)
+		return true;
+
+	for (int i = 1; i <= a->desc.nargs + a->desc.nres; ++i)
+	{
+		bool str = (i <= a->desc.nargs) ?
+			a->desc.args_str & BV(i - 1) :
+			a->desc.res_str & BV(i - 1 - a->desc.nargs);
+
+		if (str ? (a->args[i].s.sz != b->args[i].s.sz
+				|| memcmp(a->args[i].s.p, b->args[i].s.p, a->args[i].s.sz))
+			: a->args[i].l != b->args[i].l)
+			return false;
+	}
+	return true;
+}
+
+static int compare_backends(void)
+{
+	struct Outcome ht, table;
+
+	for (unsigned i = 0; i < countof(lines); ++i)
+	{
+		parser_init();
+		register_all();
+		run_line(lines[i], &ht);
+
+		parser_init();
+		parser_register_table(&parser_test_table);
+		run_line(lines[i], &table);
+
+		if (!same_outcome(&ht, &table))
+		{
+			kprintf("\"%s\": hashtable and static table differ\n", lines[i]);
+			return -1;
+		}
+	}
+
+	/* Check a few outcomes explicitly */
+	run_line("add 40 2", &table);
+	ASSERT(table.exec_ok && table.args[3].l == 42);
+	run_line("cat \"x y\" zzzz", &table);
+	ASSERT(table.exec_ok && table.args[3].s.sz == 4);
+	run_line("echo \"a b c\"", &table);
+	ASSERT(table.exec_ok && table.args[2].s.sz == 5 && !memcmp(table.args[2].s.p, "a b c", 5));
+	run_line("sleep -1", &table);
+	ASSERT(table.args_ok && !table.exec_ok);
+	run_line("add 1 2 3", &table);
+	ASSERT(table.name && !table.args_ok);
+	run_line("pingg", &table);
+	ASSERT(!table.name);
+
+	/* Every command must land on its own slot */
+	for (unsigned i = 0; i < parser_test_table.size; ++i)
+	{
+		const char *name = parser_test_table.cmds[i].name;
+		ASSERT(parser_get_cmd_template(name) == &parser_test_table.cmds[i]);
+	}
+	return 0;
+}
+
+static int mixed_backends(void)
+{
+	struct Outcome o;
+
+	/* Runtime commands are still found after the static table */
+	parser_init();
+	parser_register_table(&parser_test_table);
+	REGISTER_CMD(extra);
+
+	run_line("extra 41", &o);
+	ASSERT(o.exec_ok && o.args[2].l == 42);
+	ASSERT(o.desc.nargs == 1 && o.desc.nres == 1 && o.desc.name_len == 5);
+	run_line("neg 5", &o);
+	ASSERT(o.exec_ok && o.args[2].l == -5);
+
+	/* Completion walks both */
+	ASSERT(!strcmp(parser_rl_match(NULL, "ex", 2), "extra"));
+	ASSERT(!strcmp(parser_rl_match(NULL, "ec", 2), "echo"));
+	ASSERT(!strcmp(parser_rl_match(NULL, "v", 1), "ver"));
+	ASSERT(parser_rl_match(NULL, "e", 1) == NULL);
+	ASSERT(parser_rl_match(NULL, "le", 2) == NULL);
+	ASSERT(parser_rl_match(NULL, "x", 1) == NULL);
+
+	parser_register_table(NULL);
+	run_line("neg 5", &o);
+	ASSERT(!o.name);
+	return 0;
+}
+
+#define BOOT_LOOPS  2000
+#define LINE_LOOPS  2000
+
+/// Average ns to look up the command (\a full false) or to run the whole line
+static long line_latency(bool full)
+{
+	struct Outcome o;
+	hptime_t start = hptime_get();
+
+	for (int j = 0; j < LINE_LOOPS; ++j)
+		for (unsigned i = 0; i < countof(lines); ++i)
+		{
+			if (full)
+				run_line(lines[i], &o);
+			else
+				parser_get_cmd_template(lines[i]);
+		}
+
+	return (hptime_get() - start) * 1000L / (LINE_LOOPS * (long)countof(lines));
+}
+
+static void benchmark(void)
+{
+	hptime_t start, t_ht, t_table;
+	long find_ht, find_table, lat_ht, lat_table;
+
+	start = hptime_get();
+	for (int i = 0; i < BOOT_LOOPS; ++i)
+	{
+		parser_init();
+		register_all();
+	}
+	t_ht = hptime_get() - start;
+	find_ht = line_latency(false);
+	lat_ht = line_latency(true);
+
+	start = hptime_get();
+	for (int i = 0; i < BOOT_LOOPS; ++i)
+	{
+		parser_init();
+		parser_register_table(&parser_test_table);
+	}
+	t_table = hptime_get() - start;
+	find_table = line_latency(false);
+	lat_table = line_latency(true);
+
+	kprintf("%d commands, %d lines\n", (int)countof(parser_test_table_cmds), (int)countof(lines));
+	/* Templates are const in both cases, only the lookup structures differ */
+	kprintf("ram:    hashtable %d bytes, static table %d bytes (+%d bytes const, %d in PGM)\n",
+		(int)((1 << UINT32_LOG2(CONFIG_MAX_COMMANDS_NUMBER)) * (sizeof(void *) + 1) + sizeof(struct HashTable)),
+		(int)sizeof(const struct ParserTable *), (int)sizeof(parser_test_table),
+		(int)(sizeof(parser_test_table_desc) + sizeof(parser_test_table_disp)));
+	kprintf("boot:   hashtable %ld ns, static table %ld ns\n",
+		(long)(t_ht * 1000L / BOOT_LOOPS), (long)(t_table * 1000L / BOOT_LOOPS));
+	kprintf("lookup: hashtable %ld ns, static table %ld ns\n", find_ht, find_table);
+	kprintf("line:   hashtable %ld ns, static table %ld ns\n", lat_ht, lat_table);
+}
+
+int parser_testRun(void)
+{
+	if (compare_backends() || mixed_backends())
+	{
+		kprintf("parser_test failed\n");
+		return -1;
+	}
+
+	benchmark();
+	kprintf("parser_test successful\n");
+	return 0;
+}
+
+int parser_testSetup(void)
+{
+	kdbg_init();
+	return 0;
+}
+
+int parser_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(parser);
@@ -103,92 +103,159 @@ enum RL_KEYS {
  */
 #define IS_WORD_SEPARATOR(c) ((c) == ' ' || (c) == '\0')
 
-/// Write the string \a txt to the IO output (without any kind of termination)
-INLINE void rl_puts(const struct RLContext* ctx, const char* txt)
+/// Escape sequence decoding states
+enum RL_ESC {
+	ESC_NONE,     ///< Not in a sequence
+	ESC_START,    ///< Got 0x1B
+	ESC_CSI,      ///< Got 0x1B 0x5B
+	ESC_CSI2,     ///< Got 0x1B 0x5B 0x5B
+};
+
+/// Output collected by rl_feed(), to be written in one block.
+struct RLEcho
 {
-	if (!ctx->put)
-		return;
+	size_t len;
+	char buf[RL_ECHO_SIZE];
+};
 
-	while (*txt)
-		ctx->put(*txt++, ctx->put_param);
+/// Write \a len bytes from \a buf to the IO output, through the write hook if available.
+static void rl_output(const struct RLContext* ctx, const char* buf, size_t len)
+{
+	if (ctx->write)
+		ctx->write(buf, len, ctx->write_param);
+	else if (ctx->put)
+		while (len--)
+			ctx->put(*buf++, ctx->put_param);
 }
 
-/// Write character \a ch to the IO output.
-INLINE void rl_putc(const struct RLContext* ctx, char ch)
+/// Write the collected echo to the IO output.
+static void rl_flush(const struct RLContext* ctx)
 {
-	if (ctx->put)
-		ctx->put(ch, ctx->put_param);
+	struct RLEcho *echo = ctx->echo;
+
+	if (echo && echo->len)
+	{
+		rl_output(ctx, echo->buf, echo->len);
+		echo->len = 0;
+	}
 }
 
 /**
- * Read a character from the IO into \a ch. This function also takes
- * care of converting the ANSI escape sequences into one of the codes
- * defined in \c RL_KEYS.
+ * Write \a len bytes from \a buf to the IO output: they are collected in
+ * the echo buffer while feeding input, written right away otherwise.
  */
-static bool rl_getc(const struct RLContext* ctx, int* ch)
+static void rl_write(const struct RLContext* ctx, const char* buf, size_t len)
 {
-	int c = ctx->get(ctx->get_param);
+	struct RLEcho *echo = ctx->echo;
 
-	if (c == EOF)
+	if (!echo)
 	{
-		if (ctx->clear)
-			ctx->clear(ctx->clear_param);
+		rl_output(ctx, buf, len);
+		return;
+	}
 
-		return false;
+	if (echo->len + len > RL_ECHO_SIZE)
+	{
+		rl_flush(ctx);
+		if (len >= RL_ECHO_SIZE)
+		{
+			rl_output(ctx, buf, len);
+			return;
+		}
 	}
+	memcpy(echo->buf + echo->len, buf, len);
+	echo->len += len;
+}
+
+/// Write the string \a txt to the IO output (without any kind of termination)
+INLINE void rl_puts(const struct RLContext* ctx, const char* txt)
+{
+	rl_write(ctx, txt, strlen(txt));
+}
+
+/// Write character \a ch to the IO output.
+INLINE void rl_putc(const struct RLContext* ctx, char ch)
+{
+	rl_write(ctx, &ch, 1);
+}
 
-	if (c == 0x1B)
+/**
+ * Decode the input character \a c, converting the ANSI escape sequences
+ * into one of the codes defined in \c RL_KEYS.
+ *
+ * \return the key, or -1 if \a c is part of an escape sequence. Unknown
+ * sequences are ignored.
+ */
+static int rl_decode(struct RLContext* ctx, int c)
+{
+	switch (ctx->esc)
 	{
-		// Unknown ESC sequence. Ignore it and read
-		//  return next character.
-		if (ctx->get(ctx->get_param) != 0x5B)
-			return rl_getc(ctx, ch);
-
-		/*
-		 * To be added:
-		 * Home:        0x1b 0x5B 0x31 0x7E
-		 * F6:          0x1b 0x5B 0x31 0x37 0x7E
-		 * F7:          0x1b 0x5B 0x31 0x38 0x7E
-		 * F8:          0x1b 0x5B 0x31 0x39 0x7E
-		 * Ins:         0x1b 0x5B 0x32 0x7E
-		 * F9:          0x1b 0x5B 0x32 0x30 0x7E
-		 * F10:         0x1b 0x5B 0x32 0x31 0x7E
-		 * F11:         0x1b 0x5B 0x32 0x33 0x7E
-		 * F12:         0x1b 0x5B 0x32 0x34 0x7E
-		 * Del:         0x1b 0x5B 0x33 0x7E
-		 * End:         0x1b 0x5B 0x34 0x7E
-		 * PgUp:        0x1b 0x5B 0x35 0x7E
-		 * PgDn:        0x1b 0x5B 0x36 0x7E
-		 */
-
-		c = ctx->get(ctx->get_param);
+	case ESC_NONE:
+		if (c == 0x1B)
+		{
+			ctx->esc = ESC_START;
+			return -1;
+		}
+		return c;
+
+	case ESC_START:
+		ctx->esc = (c == 0x5B) ? ESC_CSI : ESC_NONE;
+		return -1;
+
+	/*
+	 * To be added:
+	 * Home:        0x1b 0x5B 0x31 0x7E
+	 * F6:          0x1b 0x5B 0x31 0x37 0x7E
+	 * F7:          0x1b 0x5B 0x31 0x38 0x7E
+	 * F8:          0x1b 0x5B 0x31 0x39 0x7E
+	 * Ins:         0x1b 0x5B 0x32 0x7E
+	 * F9:          0x1b 0x5B 0x32 0x30 0x7E
+	 * F10:         0x1b 0x5B 0x32 0x31 0x7E
+	 * F11:         0x1b 0x5B 0x32 0x33 0x7E
+	 * F12:         0x1b 0x5B 0x32 0x34 0x7E
+	 * Del:         0x1b 0x5B 0x33 0x7E
+	 * End:         0x1b 0x5B 0x34 0x7E
+	 * PgUp:        0x1b 0x5B 0x35 0x7E
+	 * PgDn:        0x1b 0x5B 0x36 0x7E
+	 */
+	case ESC_CSI:
+		ctx->esc = ESC_NONE;
 		switch (c)
 		{
-		case 0x41: c = KEY_UP_ARROW; break;
-		case 0x42: c = KEY_DOWN_ARROW; break;
-		case 0x43: c = KEY_RIGHT_ARROW; break;
-		case 0x44: c = KEY_LEFT_ARROW; break;
-		case 0x50: c = KEY_PAUSE; break;
+		case 0x41: return KEY_UP_ARROW;
+		case 0x42: return KEY_DOWN_ARROW;
+		case 0x43: return KEY_RIGHT_ARROW;
+		case 0x44: return KEY_LEFT_ARROW;
+		case 0x50: return KEY_PAUSE;
 		case 0x5B:
-			c = ctx->get(ctx->get_param);
-			switch (c)
-			{
-			case 0x41: c = KEY_F1; break;
-			case 0x42: c = KEY_F2; break;
-			case 0x43: c = KEY_F3; break;
-			case 0x44: c = KEY_F4; break;
-			case 0x45: c = KEY_F5; break;
-			default: return rl_getc(ctx, ch);
-			}
-			break;
-		default: return rl_getc(ctx, ch);
+			ctx->esc = ESC_CSI2;
+			return -1;
+		default: return -1;
 		}
-	}
 
-	*ch = c;
-	return true;
+	case ESC_CSI2:
+		ctx->esc = ESC_NONE;
+		switch (c)
+		{
+		case 0x41: return KEY_F1;
+		case 0x42: return KEY_F2;
+		case 0x43: return KEY_F3;
+		case 0x44: return KEY_F4;
+		case 0x45: return KEY_F5;
+		default: return -1;
+		}
+
+	default:
+		ASSERT(0);
+		ctx->esc = ESC_NONE;
+		return -1;
+	}
 }
 
+/// Check if \a c is just inserted in the line, with no escape sequence in progress.
+#define IS_PLAIN_CHAR(ctx, c) \
+	((ctx)->esc == ESC_NONE && (c) != 0x1B && (c) != '\t' && (c) != '\b' && (c) != '\r' && (c) != '\n')
+
 INLINE void beep(struct RLContext* ctx)
 {
 	rl_putc(ctx, '\a');
@@ -325,65 +392,32 @@ static bool complete_word(struct RLContext *ctx, size_t *curpos)
 
 void rl_refresh(struct RLContext* ctx)
 {
+	struct RLEcho echo;
+	struct RLEcho *prev = ctx->echo;
+
+	/* Write it in one block, unless called from a hook within rl_feed() */
+	if (!prev)
+	{
+		echo.len = 0;
+		ctx->echo = &echo;
+	}
+
 	rl_puts(ctx, "\r\n");
 	if (ctx->prompt)
 		rl_puts(ctx, ctx->prompt);
 	rl_puts(ctx, ctx->history + ctx->history_pos + 1);
-}
 
-const char* rl_readline(struct RLContext* ctx)
-{
-	while (1)
+	if (!prev)
 	{
-		char ch;
-		int c;
-
-		ASSERT(ctx->history - ctx->real_history + ctx->line_pos < HISTORY_SIZE);
-
-		if (!rl_getc(ctx, &c))
-			return NULL;
-
-		// Just ignore special keys for now
-		if (c > SPECIAL_KEYS)
-			continue;
-
-		if (c == '\t')
-		{
-			// Ask the match hook if available
-			if (!ctx->match)
-				return NULL;
-
-			complete_word(ctx, &ctx->line_pos);
-			continue;
-		}
-
-		// Backspace cancels a character, or it is ignored if at
-		// the start of the line
-		if (c == '\b')
-		{
-			if (ctx->history[ctx->line_pos] != '\0')
-			{
-				--ctx->line_pos;
-				rl_puts(ctx, "\b \b");
-			}
-			continue;
-		}
-
-		if (c == '\r' || c == '\n')
-		{
-			rl_puts(ctx, "\r\n");
-			break;
-		}
-
-
-		// Add a character to the buffer, if possible
-		ch = (char)c;
-		ASSERT2(ch == c, "a special key was not properly handled");
-		if (insert_chars(ctx, &ctx->line_pos, &ch, 1))
-			rl_putc(ctx, ch);
-		else
-			beep(ctx);
+		rl_flush(ctx);
+		ctx->echo = NULL;
 	}
+}
+
+/// Terminate the current line, store it in the history and return it.
+static const char* end_line(struct RLContext* ctx)
+{
+	rl_puts(ctx, "\r\n");
 
 	ctx->history_pos = ctx->line_pos + 1;
 	while (ctx->history[ctx->line_pos] != '\0')
@@ -408,3 +442,149 @@ const char* rl_readline(struct RLContext* ctx)
 	return buf;
 }
 
+/**
+ * Insert the \a len plain characters in \a buf into the line and echo
+ * them, all at once if there is room for them without dropping history.
+ */
+static void insert_run(struct RLContext* ctx, const char* buf, size_t len)
+{
+	if (!is_history_past_end(ctx, ctx->line_pos + len + 1))
+	{
+		insert_chars(ctx, &ctx->line_pos, buf, len);
+		rl_write(ctx, buf, len);
+		return;
+	}
+
+	// Make room a character at a time, beeping if the line is full
+	while (len--)
+	{
+		if (insert_char(ctx, &ctx->line_pos, *buf))
+			rl_putc(ctx, *buf);
+		else
+			beep(ctx);
+		buf++;
+	}
+}
+
+/// Process the decoded key \a c. Return the line if it was completed, NULL otherwise.
+static const char* process_key(struct RLContext* ctx, int c)
+{
+	char ch;
+
+	// Just ignore special keys for now
+	if (c > SPECIAL_KEYS)
+		return NULL;
+
+	if (c == '\t')
+	{
+		// Ask the match hook if available
+		if (ctx->match)
+			complete_word(ctx, &ctx->line_pos);
+		return NULL;
+	}
+
+	// Backspace cancels a character, or it is ignored if at
+	// the start of the line
+	if (c == '\b')
+	{
+		if (ctx->history[ctx->line_pos] != '\0')
+		{
+			--ctx->line_pos;
+			rl_puts(ctx, "\b \b");
+		}
+		return NULL;
+	}
+
+	if (c == '\r' || c == '\n')
+		return end_line(ctx);
+
+	// Add a character to the buffer, if possible
+	ch = (char)c;
+	insert_run(ctx, &ch, 1);
+	return NULL;
+}
+
+/**
+ * Feed the editor with the input characters in \a buf, up to the end of
+ * the first line completed.
+ *
+ * The function never blocks: the characters are processed as they are,
+ * and the editing state (including a partial escape sequence) is kept in
+ * the context until the next call. The echo is written through the I/O
+ * hooks before returning.
+ *
+ * \param ctx readline context.
+ * \param buf input characters.
+ * \param len number of characters in \a buf.
+ * \param line set to the completed line (without terminator), or to NULL
+ *        if all the input was consumed without completing one. The line
+ *        is stored in the history, so it is valid only until the next
+ *        call: feed the rest of the input after processing it.
+ * \return the number of characters consumed.
+ */
+size_t rl_feed(struct RLContext* ctx, const char* buf, size_t len, const char** line)
+{
+	struct RLEcho echo;
+	size_t i = 0;
+
+	ASSERT(!ctx->echo);
+	echo.len = 0;
+	ctx->echo = &echo;
+	*line = NULL;
+
+	while (i < len && !*line)
+	{
+		ASSERT(ctx->history - ctx->real_history + ctx->line_pos < HISTORY_SIZE);
+
+		// Plain characters go into the history a run at a time
+		if (IS_PLAIN_CHAR(ctx, buf[i]))
+		{
+			size_t run = 1;
+
+			while (i + run < len && IS_PLAIN_CHAR(ctx, buf[i + run]))
+				run++;
+			insert_run(ctx, buf + i, run);
+			i += run;
+			continue;
+		}
+
+		int c = rl_decode(ctx, (unsigned char)buf[i++]);
+		if (c >= 0)
+			*line = process_key(ctx, c);
+	}
+
+	rl_flush(ctx);
+	ctx->echo = NULL;
+	return i;
+}
+
+/**
+ * Read a line through the get hook, blocking until it is completed.
+ *
+ * \return the line, or NULL if the get hook returned EOF, or if a TAB
+ * was read and there is no match hook.
+ */
+const char* rl_readline(struct RLContext* ctx)
+{
+	while (1)
+	{
+		const char *line;
+		int c = ctx->get(ctx->get_param);
+		char ch = (char)c;
+
+		if (c == EOF)
+		{
+			if (ctx->clear)
+				ctx->clear(ctx->clear_param);
+
+			return NULL;
+		}
+
+		if (c == '\t' && ctx->esc == ESC_NONE && !ctx->match)
+			return NULL;
+
+		rl_feed(ctx, &ch, 1, &line);
+		if (line)
+			return line;
+	}
+}
@@ -40,6 +40,8 @@
  * Basic feature of this module:
  *
  * \li Abstracted from I/O. The user must provide hooks for getc and putc functions.
+ * \li Non-blocking operation: rl_feed() takes the input as it arrives, a
+ * buffer at a time, and returns the lines as they are completed.
  * \li Basic support for ANSI escape sequences for input of special codes.
  * \li Support for command name completion (through a hook).
  *
@@ -70,6 +72,17 @@
  * always points to the physical start, while \c history is the adjusted pointer (that is
  * dereference to read/write to it).
  *
+ * \li The editor is a state machine: the decoding of the escape sequences is
+ * kept in the context, so a sequence can be split between two calls to
+ * rl_feed(), and a context does not need a process of its own. A single
+ * process can serve any number of terminals, waiting for their input with
+ * event_select(): each session costs only its struct RLContext.
+ *
+ * \li rl_feed() inserts runs of plain characters into the history with
+ * a single copy when they fit without dropping old lines, and collects the
+ * echo in a buffer on the stack, written with one call to the write hook
+ * (if set) at the end of the input, or when the buffer is full.
+ *
  * \todo Use up/down to move through history  The history line will be copied to the current line,
  * making sure there is room for it.
  *
@@ -90,11 +103,17 @@
 
 #define HISTORY_SIZE 32
 
+/// Size of the echo buffer of rl_feed(), allocated on the stack.
+#define RL_ECHO_SIZE 32
+
 typedef int (*getc_hook)(void* user_data);
 typedef void (*putc_hook)(char ch, void* user_data);
+typedef void (*write_hook)(const char* buf, size_t len, void* user_data);
 typedef const char* (*match_hook)(void* user_data, const char* word, int word_len);
 typedef void (*clear_hook)(void* user_data);
 
+struct RLEcho;
+
 struct RLContext
 {
 	getc_hook get;
@@ -103,6 +122,9 @@ struct RLContext
 	putc_hook put;
 	void* put_param;
 
+	write_hook write;
+	void* write_param;
+
 	match_hook match;
 	void* match_param;
 
@@ -115,6 +137,9 @@ struct RLContext
 	char* history;
 	size_t history_pos;
 	size_t line_pos;
+
+	struct RLEcho *echo;  ///< Echo buffer, while feeding input.
+	uint8_t esc;          ///< Escape sequence decoding state.
 };
 
 INLINE void rl_init_ctx(struct RLContext *ctx)
@@ -129,6 +154,7 @@ INLINE void rl_clear_history(struct RLContext *ctx)
 	ctx->history_pos = 0;
 	ctx->line_pos = ctx->history_pos;
 	ctx->history = ctx->real_history;
+	ctx->esc = 0;
 }
 
 INLINE void rl_sethook_get(struct RLContext* ctx, getc_hook get, void* get_param)
@@ -137,6 +163,13 @@ INLINE void rl_sethook_get(struct RLContext* ctx, getc_hook get, void* get_param
 INLINE void rl_sethook_put(struct RLContext* ctx, putc_hook put, void* put_param)
 { ctx->put = put; ctx->put_param = put_param; }
 
+/**
+ * Set the hook used to write the output in blocks. If set, it is used
+ * instead of the put hook.
+ */
+INLINE void rl_sethook_write(struct RLContext* ctx, write_hook write, void* write_param)
+{ ctx->write = write; ctx->write_param = write_param; }
+
 INLINE void rl_sethook_match(struct RLContext* ctx, match_hook match, void* match_param)
 { ctx->match = match; ctx->match_param = match_param; }
 
@@ -148,6 +181,8 @@ INLINE void rl_setprompt(struct RLContext* ctx, const char* prompt)
 
 const char* rl_readline(struct RLContext* ctx);
 
+size_t rl_feed(struct RLContext* ctx, const char* buf, size_t len, const char** line);
+
 void rl_refresh(struct RLContext* ctx);
 
 /* Test prototype */
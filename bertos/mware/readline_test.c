@@ -33,6 +33,12 @@
  *
  * \brief Readline module test.
  *
+ * Besides the history test, a recorded keystroke stream (with escape
+ * sequences, backspaces, completions and a line too long for the history)
+ * is read with the blocking rl_readline(), then pushed to rl_feed() split
+ * in buffers of every size and interleaved among many sessions: the lines
+ * and the echo must be the same.
+ *
  * \author Giovanni Bajo <rasky@develer.com>
  * \author Daniele Basile <asterix@develer.com>
  */
@@ -42,6 +48,7 @@
 #include <cfg/compiler.h>
 #include <cfg/debug.h>
 #include <cfg/test.h>
+#include <cfg/macros.h>
 
 #include <stdio.h>
 
@@ -89,6 +96,208 @@ static bool do_test(char* input_buffer, char* expected_history)
 }
 
 
+/* Recorded keystrokes, and the lines they produce */
+static const char stream[] =
+	"hello wor\x1b[Ald\r"
+	"lx\b\bls -l\n"
+	"\x1b[[Aab\x1bxc\r"
+	"\r"
+	"he\t1\r"
+	"xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx\r"
+	"\b\bend\x1b[";
+
+static const char *stream_lines[] =
+{
+	"hello world",
+	"ls -l",
+	"abc",
+	"",
+	"help 1",
+	/* Then a line longer than the history: it is cut */
+};
+
+#define OUT_SIZE   512
+#define LINES_SIZE 128
+#define SESSIONS   16
+
+/* A terminal session, with its output and the lines read */
+typedef struct TestSession
+{
+	struct RLContext rl;
+	char out[OUT_SIZE];
+	size_t out_len;
+	int writes;
+	char lines[LINES_SIZE];
+	size_t lines_len;
+	size_t pos;
+	size_t chunk;
+} TestSession;
+
+static TestSession ref;
+static TestSession sessions[SESSIONS];
+
+static const char *test_match(void *data, const char *word, int word_len)
+{
+	(void)data;
+	return (word_len <= 4 && !strncmp(word, "help", word_len)) ? "help" : NULL;
+}
+
+static void test_put(char ch, void *data)
+{
+	TestSession *s = (TestSession *)data;
+
+	ASSERT(s->out_len < OUT_SIZE);
+	s->out[s->out_len++] = ch;
+	s->writes++;
+}
+
+static void test_write(const char *buf, size_t len, void *data)
+{
+	TestSession *s = (TestSession *)data;
+
+	ASSERT(s->out_len + len <= OUT_SIZE);
+	memcpy(s->out + s->out_len, buf, len);
+	s->out_len += len;
+	s->writes++;
+}
+
+static int test_stream_getc(void *data)
+{
+	TestSession *s = (TestSession *)data;
+
+	return s->pos < sizeof(stream) - 1 ? stream[s->pos++] : EOF;
+}
+
+static void session_init(TestSession *s, size_t chunk)
+{
+	memset(s, 0, sizeof(*s));
+	rl_init_ctx(&s->rl);
+	rl_sethook_match(&s->rl, test_match, NULL);
+	rl_sethook_put(&s->rl, test_put, s);
+	s->chunk = chunk;
+}
+
+static void session_line(TestSession *s, const char *line)
+{
+	size_t len = strlen(line);
+
+	ASSERT(s->lines_len + len + 1 <= LINES_SIZE);
+	memcpy(s->lines + s->lines_len, line, len);
+	s->lines_len += len;
+	s->lines[s->lines_len++] = '|';
+}
+
+/*
+ * Push the next chunk of the stream to session \a s.
+ * Return false when the stream is over.
+ */
+static bool session_feed(TestSession *s)
+{
+	size_t len = MIN(s->chunk, sizeof(stream) - 1 - s->pos);
+
+	while (len)
+	{
+		const char *line;
+		size_t n = rl_feed(&s->rl, stream + s->pos, len, &line);
+
+		s->pos += n;
+		len -= n;
+		if (line)
+			session_line(s, line);
+	}
+	return s->pos < sizeof(stream) - 1;
+}
+
+static bool session_check(TestSession *s)
+{
+	if (s->lines_len != ref.lines_len || memcmp(s->lines, ref.lines, ref.lines_len)
+		|| s->out_len != ref.out_len || memcmp(s->out, ref.out, ref.out_len)
+		|| memcmp(s->rl.real_history, ref.rl.real_history, HISTORY_SIZE))
+	{
+		kprintf("chunk %d: session differs from rl_readline()\n", (int)s->chunk);
+		return false;
+	}
+	return true;
+}
+
+/* Read the stream with rl_readline() and check the first lines */
+static bool test_reference(void)
+{
+	const char *line;
+	size_t len = 0;
+
+	session_init(&ref, 0);
+	rl_sethook_get(&ref.rl, test_stream_getc, &ref);
+	while ((line = rl_readline(&ref.rl)))
+		session_line(&ref, line);
+
+	for (size_t i = 0; i < countof(stream_lines); i++)
+	{
+		size_t l = strlen(stream_lines[i]);
+
+		if (len + l >= ref.lines_len || strncmp(ref.lines + len, stream_lines[i], l) || ref.lines[len + l] != '|')
+		{
+			kprintf("line %d differs: %.*s\n", (int)i, (int)(ref.lines_len - len), ref.lines + len);
+			return false;
+		}
+		len += l + 1;
+	}
+	return true;
+}
+
+/* Push the stream in chunks of every size, through the put hook and then the write hook */
+static bool test_feed(void)
+{
+	TestSession *s = &sessions[0];
+
+	for (size_t chunk = 1; chunk <= sizeof(stream); chunk++)
+	{
+		session_init(s, chunk);
+		while (session_feed(s))
+			;
+		if (!session_check(s))
+			return false;
+
+		session_init(s, chunk);
+		rl_sethook_write(&s->rl, test_write, s);
+		while (session_feed(s))
+			;
+		if (!session_check(s))
+			return false;
+		if (chunk == sizeof(stream))
+			kprintf("Output of the stream: %d put calls, %d write calls\n", ref.writes, s->writes);
+	}
+	return true;
+}
+
+/* Serve many sessions at once, in round robin */
+static bool test_sessions(void)
+{
+	bool busy = true;
+
+	for (int i = 0; i < SESSIONS; i++)
+	{
+		session_init(&sessions[i], i + 1);
+		if (i & 1)
+			rl_sethook_write(&sessions[i].rl, test_write, &sessions[i]);
+	}
+
+	while (busy)
+	{
+		busy = false;
+		for (int i = 0; i < SESSIONS; i++)
+			busy |= session_feed(&sessions[i]);
+	}
+
+	for (int i = 0; i < SESSIONS; i++)
+		if (!session_check(&sessions[i]))
+			return false;
+
+	kprintf("Per session RAM: %d bytes of struct RLContext, %d of stack in rl_feed()\n",
+		(int)sizeof(struct RLContext), RL_ECHO_SIZE + (int)sizeof(size_t));
+	return true;
+}
+
 int readline_testSetup(void)
 {
 	kdbg_init();
@@ -102,6 +311,9 @@ int readline_testRun(void)
 	if (!do_test(test1_in, test1_hist))
 		return -1;
 
+	if (!test_reference() || !test_feed() || !test_sessions())
+		return -1;
+
 	kprintf("rl_test successful\n");
 	return 0;
 }
@@ -112,5 +324,3 @@ int readline_testTearDown(void)
 }
 
 TEST_MAIN(readline);
-
-
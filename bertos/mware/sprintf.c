@@ -42,8 +42,10 @@
 #include <mware/formatwr.h>
 #include <cpu/pgm.h>
 #include <cfg/compiler.h>
+#include <cfg/macros.h> /* MIN */
 
 #include <stdio.h>
+#include <string.h> /* memcpy */
 
 
 static void __str_put_char(char c, void *ptr)
@@ -57,26 +59,45 @@ static void __str_put_char(char c, void *ptr)
 	(*((char **)ptr))++;
 }
 
+static void __str_write(const char *buf, size_t len, void *ptr)
+{
+	memcpy(*((char **)ptr), buf, len);
+	*((char **)ptr) += len;
+}
+
 static void __null_put_char(UNUSED_ARG(char, c), UNUSED_ARG(void *, ptr))
 {
 	/* nop */
 }
 
+static void __null_write(UNUSED_ARG(const char *, buf), UNUSED_ARG(size_t, len), UNUSED_ARG(void *, ptr))
+{
+	/* nop */
+}
+
 
 int PGM_FUNC(vsprintf)(char *str, const char * PGM_ATTR fmt, va_list ap)
 {
 	int result;
+	FmtSink sink;
 
 	if (str)
 	{
-		result = PGM_FUNC(_formatted_write)(fmt, __str_put_char, &str, ap);
+		sink.put_char = __str_put_char;
+		sink.write = __str_write;
+		sink.user_data = &str;
+		result = PGM_FUNC(_formatted_write_sink)(fmt, &sink, ap);
 
 		/* Terminate string */
 		*str = '\0';
 	}
 	else
-		result = PGM_FUNC(_formatted_write)(fmt, __null_put_char, 0, ap);
-
+	{
+		sink.put_char = __null_put_char;
+		sink.write = __null_write;
+		sink.user_data = 0;
+		result = PGM_FUNC(_formatted_write_sink)(fmt, &sink, ap);
+	}
 
 	return result;
 }
@@ -118,9 +139,24 @@ static void __sn_put_char(char c, void *ptr)
 }
 
 
+/**
+ * formatted_write() span callback used [v]snprintf().
+ */
+static void __sn_write(const char *buf, size_t len, void *ptr)
+{
+	struct __sn_state *state = (struct __sn_state *)ptr;
+
+	len = MIN(len, state->len);
+	memcpy(state->str, buf, len);
+	state->str += len;
+	state->len -= len;
+}
+
+
 int PGM_FUNC(vsnprintf)(char *str, size_t size, const char * PGM_ATTR fmt, va_list ap)
 {
 	int result = 0;
+	FmtSink sink;
 
 	/* Make room for traling '\0'. */
 	if (size--)
@@ -131,13 +167,21 @@ int PGM_FUNC(vsnprintf)(char *str, size_t size, const char * PGM_ATTR fmt, va_li
 			state.str = str;
 			state.len = size;
 
-			result = PGM_FUNC(_formatted_write)(fmt, __sn_put_char, &state, ap);
+			sink.put_char = __sn_put_char;
+			sink.write = __sn_write;
+			sink.user_data = &state;
+			result = PGM_FUNC(_formatted_write_sink)(fmt, &sink, ap);
 
 			/* Terminate string. */
 			*state.str = '\0';
 		}
 		else
-			result = PGM_FUNC(_formatted_write)(fmt, __null_put_char, 0, ap);
+		{
+			sink.put_char = __null_put_char;
+			sink.write = __null_write;
+			sink.user_data = 0;
+			result = PGM_FUNC(_formatted_write_sink)(fmt, &sink, ap);
+		}
 	}
 
 	return result;
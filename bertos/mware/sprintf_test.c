@@ -44,11 +44,75 @@
 
 #include <cpu/pgm.h>
 
+#include <os/hptime.h>
+
 #include <stdio.h>
 
 #include <string.h> /* strcmp() */
 
 
+#define BENCH_ROUNDS 20000
+
+struct bench_state
+{
+	char *str;
+	size_t len;
+};
+
+/* Per-character sink, as used before the span interface */
+static void bench_put_char(char c, void *ptr)
+{
+	struct bench_state *state = (struct bench_state *)ptr;
+
+	if (state->len)
+	{
+		--state->len;
+		*state->str++ = c;
+	}
+}
+
+static int bench_printf(char *str, size_t size, const char *fmt, ...)
+{
+	struct bench_state state;
+	va_list ap;
+	int len;
+
+	state.str = str;
+	state.len = size - 1;
+	va_start(ap, fmt);
+	len = _formatted_write(fmt, bench_put_char, &state, ap);
+	va_end(ap);
+	*state.str = '\0';
+
+	return len;
+}
+
+/*
+ * Format a typical log line through the per-character callback and
+ * through snprintf(), which emits spans.
+ */
+static void sprintf_testBenchmark(void)
+{
+	static const char fmt[] = "%s:%d: blk_idx %ld, offset %u, size %u, status %08lx\n";
+	char buf[128], ref[128];
+	hptime_t start, per_char, span;
+	int len = 0;
+
+	start = hptime_get();
+	for (int i = 0; i < BENCH_ROUNDS; i++)
+		len = bench_printf(ref, sizeof(ref), fmt, "kblock.c", 1234, 123456L, 512, 64, 0xdeadL);
+	per_char = hptime_get() - start;
+
+	start = hptime_get();
+	for (int i = 0; i < BENCH_ROUNDS; i++)
+		ASSERT(snprintf(buf, sizeof(buf), fmt, "kblock.c", 1234, 123456L, 512, 64, 0xdeadL) == len);
+	span = hptime_get() - start;
+
+	ASSERT(strcmp(buf, ref) == 0);
+	kprintf("%d lines of %d chars: per-char sink %ld us, span sink %ld us\n",
+		BENCH_ROUNDS, len, (long)per_char, (long)span);
+}
+
 int sprintf_testSetup(void)
 {
 	kdbg_init();
@@ -103,6 +167,20 @@ int sprintf_testRun(void)
 		return 4;
 	sprintf(NULL, test_string); /* must not crash */
 
+	/*
+	 * Span output: long padding, truncation inside a run.
+	 */
+	TEST("%40s", "x", "                                       x");
+	TEST("%-20d|", 7, "7                   |");
+	if (snprintf(buf, 8, "abc%sdefgh", "XYZ") != 11 || strcmp(buf, "abcXYZd") != 0)
+		return 5;
+	if (snprintf(NULL, 0, "abc%d", 12) != 0 || sprintf(NULL, "abc%d", 12) != 5)
+		return 6;
+	if (bench_printf(buf, sizeof buf, "%5d|%-5s|%%", 42, "ab") != 13 || strcmp(buf, "   42|ab   |%") != 0)
+		return 7;
+
+	sprintf_testBenchmark();
+
 	return 0;
 }
 
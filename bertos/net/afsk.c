@@ -45,6 +45,8 @@
 
 #include <cfg/module.h>
 
+#include <algo/crc_ccitt.h>
+
 #define LOG_LEVEL   AFSK_LOG_LEVEL
 #define LOG_FORMAT  AFSK_LOG_FORMAT
 #include <cfg/log.h>
@@ -52,8 +54,9 @@
 #include <cpu/power.h>
 #include <cpu/pgm.h>
 #include <struct/fifobuf.h>
+#include <struct/list.h>
 
-#include <string.h> /* memset */
+#include <string.h> /* memset, memcpy */
 
 #define PHASE_BIT    8
 #define PHASE_INC    1
@@ -199,18 +202,105 @@ static bool hdlc_parse(Hdlc *hdlc, bool bit, FIFOBuffer *fifo)
 	return ret;
 }
 
+/**
+ * HDLC parsing function for the frame mode.
+ * Like hdlc_parse(), but the characters are collected in the current
+ * receive frame, whose CRC is checked at the closing flag: good frames
+ * are queued in rx_frames.
+ *
+ * \return true if all is ok, false if no free frame was available.
+ */
+static bool hdlc_parseFrame(Afsk *af, bool bit)
+{
+	Hdlc *hdlc = &af->hdlc;
+	AfskFrame *frame = af->rx_frame;
+	bool ret = true;
+
+	hdlc->demod_bits <<= 1;
+	hdlc->demod_bits |= bit ? 1 : 0;
+
+	/* HDLC Flag */
+	if (hdlc->demod_bits == HDLC_FLAG)
+	{
+		if (hdlc->rxstart && frame->len >= AX25_MIN_FRAME_LEN
+			&& af->rx_crc == AX25_CRC_CORRECT)
+		{
+			ADDTAIL(&af->rx_frames, &frame->link);
+			frame = NULL;
+		}
+
+		if (!frame)
+			frame = (AfskFrame *)list_remHead(&af->free_frames);
+		af->rx_frame = frame;
+
+		if (frame)
+		{
+			frame->len = 0;
+			hdlc->rxstart = true;
+		}
+		else
+		{
+			ret = false;
+			hdlc->rxstart = false;
+		}
+
+		af->rx_crc = CRC_CCITT_INIT_VAL;
+		hdlc->currchar = 0;
+		hdlc->bit_idx = 0;
+		return ret;
+	}
+
+	/* Reset */
+	if ((hdlc->demod_bits & HDLC_RESET) == HDLC_RESET)
+	{
+		hdlc->rxstart = false;
+		return ret;
+	}
+
+	if (!hdlc->rxstart)
+		return ret;
+
+	/* Stuffed bit */
+	if ((hdlc->demod_bits & 0x3f) == 0x3e)
+		return ret;
+
+	if (hdlc->demod_bits & 0x01)
+		hdlc->currchar |= 0x80;
+
+	if (++hdlc->bit_idx >= 8)
+	{
+		if (frame->len < sizeof(frame->buf))
+		{
+			frame->buf[frame->len++] = hdlc->currchar;
+			af->rx_crc = updcrc_ccitt(hdlc->currchar, af->rx_crc);
+		}
+		else
+			hdlc->rxstart = false;
+
+		hdlc->currchar = 0;
+		hdlc->bit_idx = 0;
+	}
+	else
+		hdlc->currchar >>= 1;
+
+	return ret;
+}
+
 
 /**
- * ADC ISR callback.
- * This function has to be called by the ADC ISR when a sample of the configured
- * channel is available.
+ * Demodulate a block of ADC samples.
+ * This is meant to be called from the DMA (or double buffered ADC)
+ * completion interrupt, with the buffer just filled by the ADC: the
+ * demodulator state is kept in registers across the whole block, so the
+ * per sample cost is only the filter and PLL math.
+ * The result is the same of calling afsk_adc_isr() on each sample.
+ *
  * \param af Afsk context to operate on.
- * \param curr_sample current sample from the ADC.
+ * \param samples ADC samples, in acquisition order.
+ * \param len number of samples in \a samples.
  */
-void afsk_adc_isr(Afsk *af, int8_t curr_sample)
+void afsk_adc_block(Afsk *af, const int8_t *samples, size_t len)
 {
-	AFSK_STROBE_ON();
-
 	/*
 	 * Frequency discriminator and LP IIR filter.
 	 * This filter is designed to work
@@ -218,100 +308,138 @@ void afsk_adc_isr(Afsk *af, int8_t curr_sample)
 	 */
 	STATIC_ASSERT(SAMPLERATE == 9600);
 	STATIC_ASSERT(BITRATE == 1200);
+	/* The delay line index wraps with a mask */
+	STATIC_ASSERT(IS_POW2(SAMPLEPERBIT / 2));
 
-	/*
-	 * Frequency discrimination is achieved by simply multiplying
-	 * the sample with a delayed sample of (samples per bit) / 2.
-	 * Then the signal is lowpass filtered with a first order,
-	 * 600 Hz filter. The filter implementation is selectable
-	 * through the CONFIG_AFSK_FILTER config variable.
-	 */
-
-	af->iir_x[0] = af->iir_x[1];
+	int16_t x0 = af->iir_x[0], x1 = af->iir_x[1];
+	int16_t y0 = af->iir_y[0], y1 = af->iir_y[1];
+	uint8_t sampled_bits = af->sampled_bits;
+	uint8_t found_bits = af->found_bits;
+	int8_t curr_phase = af->curr_phase;
+	uint8_t delay_idx = af->delay_idx;
 
-	#if (CONFIG_AFSK_FILTER == AFSK_BUTTERWORTH)
-		af->iir_x[1] = ((int8_t)fifo_pop(&af->delay_fifo) * curr_sample) >> 2;
-		//af->iir_x[1] = ((int8_t)fifo_pop(&af->delay_fifo) * curr_sample) / 6.027339492;
-	#elif (CONFIG_AFSK_FILTER == AFSK_CHEBYSHEV)
-		af->iir_x[1] = ((int8_t)fifo_pop(&af->delay_fifo) * curr_sample) >> 2;
-		//af->iir_x[1] = ((int8_t)fifo_pop(&af->delay_fifo) * curr_sample) / 3.558147322;
-	#else
-		#error Filter type not found!
-	#endif
+	AFSK_STROBE_ON();
 
-	af->iir_y[0] = af->iir_y[1];
+	while (len--)
+	{
+		int8_t curr_sample = *samples++;
 
-	#if CONFIG_AFSK_FILTER == AFSK_BUTTERWORTH
-		/*
-		 * This strange sum + shift is an optimization for af->iir_y[0] * 0.668.
-		 * iir * 0.668 ~= (iir * 21) / 32 =
-		 * = (iir * 16) / 32 + (iir * 4) / 32 + iir / 32 =
-		 * = iir / 2 + iir / 8 + iir / 32 =
-		 * = iir >> 1 + iir >> 3 + iir >> 5
-		 */
-		af->iir_y[1] = af->iir_x[0] + af->iir_x[1] + (af->iir_y[0] >> 1) + (af->iir_y[0] >> 3) + (af->iir_y[0] >> 5);
-		//af->iir_y[1] = af->iir_x[0] + af->iir_x[1] + af->iir_y[0] * 0.6681786379;
-	#elif CONFIG_AFSK_FILTER == AFSK_CHEBYSHEV
 		/*
-		 * This should be (af->iir_y[0] * 0.438) but
-		 * (af->iir_y[0] >> 1) is a faster approximation :-)
+		 * Frequency discrimination is achieved by simply multiplying
+		 * the sample with a delayed sample of (samples per bit) / 2.
+		 * Then the signal is lowpass filtered with a first order,
+		 * 600 Hz filter. The filter implementation is selectable
+		 * through the CONFIG_AFSK_FILTER config variable.
 		 */
-		af->iir_y[1] = af->iir_x[0] + af->iir_x[1] + (af->iir_y[0] >> 1);
-		//af->iir_y[1] = af->iir_x[0] + af->iir_x[1] + af->iir_y[0] * 0.4379097269;
-	#endif
+		x0 = x1;
+
+		#if (CONFIG_AFSK_FILTER == AFSK_BUTTERWORTH)
+			x1 = (af->delay_buf[delay_idx] * curr_sample) >> 2;
+			//x1 = (af->delay_buf[delay_idx] * curr_sample) / 6.027339492;
+		#elif (CONFIG_AFSK_FILTER == AFSK_CHEBYSHEV)
+			x1 = (af->delay_buf[delay_idx] * curr_sample) >> 2;
+			//x1 = (af->delay_buf[delay_idx] * curr_sample) / 3.558147322;
+		#else
+			#error Filter type not found!
+		#endif
 
-	/* Save this sampled bit in a delay line */
-	af->sampled_bits <<= 1;
-	af->sampled_bits |= (af->iir_y[1] > 0) ? 1 : 0;
+		y0 = y1;
 
-	/* Store current ADC sample in the af->delay_fifo */
-	fifo_push(&af->delay_fifo, curr_sample);
+		#if CONFIG_AFSK_FILTER == AFSK_BUTTERWORTH
+			/*
+			 * This strange sum + shift is an optimization for y0 * 0.668.
+			 * iir * 0.668 ~= (iir * 21) / 32 =
+			 * = (iir * 16) / 32 + (iir * 4) / 32 + iir / 32 =
+			 * = iir / 2 + iir / 8 + iir / 32 =
+			 * = iir >> 1 + iir >> 3 + iir >> 5
+			 */
+			y1 = x0 + x1 + (y0 >> 1) + (y0 >> 3) + (y0 >> 5);
+			//y1 = x0 + x1 + y0 * 0.6681786379;
+		#elif CONFIG_AFSK_FILTER == AFSK_CHEBYSHEV
+			/*
+			 * This should be (y0 * 0.438) but
+			 * (y0 >> 1) is a faster approximation :-)
+			 */
+			y1 = x0 + x1 + (y0 >> 1);
+			//y1 = x0 + x1 + y0 * 0.4379097269;
+		#endif
 
-	/* If there is an edge, adjust phase sampling */
-	if (EDGE_FOUND(af->sampled_bits))
-	{
-		if (af->curr_phase < PHASE_THRES)
-			af->curr_phase += PHASE_INC;
-		else
-			af->curr_phase -= PHASE_INC;
-	}
-	af->curr_phase += PHASE_BIT;
+		/* Save this sampled bit in a delay line */
+		sampled_bits <<= 1;
+		sampled_bits |= (y1 > 0) ? 1 : 0;
 
-	/* sample the bit */
-	if (af->curr_phase >= PHASE_MAX)
-	{
-		af->curr_phase %= PHASE_MAX;
+		/* Store current ADC sample in place of the oldest one */
+		af->delay_buf[delay_idx] = curr_sample;
+		delay_idx = (delay_idx + 1) & (SAMPLEPERBIT / 2 - 1);
 
-		/* Shift 1 position in the shift register of the found bits */
-		af->found_bits <<= 1;
+		/* If there is an edge, adjust phase sampling */
+		if (EDGE_FOUND(sampled_bits))
+		{
+			if (curr_phase < PHASE_THRES)
+				curr_phase += PHASE_INC;
+			else
+				curr_phase -= PHASE_INC;
+		}
+		curr_phase += PHASE_BIT;
 
-		/*
-		 * Determine bit value by reading the last 3 sampled bits.
-		 * If the number of ones is two or greater, the bit value is a 1,
-		 * otherwise is a 0.
-		 * This algorithm presumes that there are 8 samples per bit.
-		 */
-		STATIC_ASSERT(SAMPLEPERBIT == 8);
-		uint8_t bits = af->sampled_bits & 0x07;
-		if (bits == 0x07 // 111, 3 bits set to 1
-		 || bits == 0x06 // 110, 2 bits
-		 || bits == 0x05 // 101, 2 bits
-		 || bits == 0x03 // 011, 2 bits
-		)
-			af->found_bits |= 1;
+		/* sample the bit */
+		if (curr_phase >= PHASE_MAX)
+		{
+			curr_phase %= PHASE_MAX;
 
-		/*
-		 * NRZI coding: if 2 consecutive bits have the same value
-		 * a 1 is received, otherwise it's a 0.
-		 */
-		if (!hdlc_parse(&af->hdlc, !EDGE_FOUND(af->found_bits), &af->rx_fifo))
-			af->status |= AFSK_RXFIFO_OVERRUN;
+			/* Shift 1 position in the shift register of the found bits */
+			found_bits <<= 1;
+
+			/*
+			 * Determine bit value by reading the last 3 sampled bits.
+			 * If the number of ones is two or greater, the bit value is a 1,
+			 * otherwise is a 0.
+			 * This algorithm presumes that there are 8 samples per bit.
+			 */
+			STATIC_ASSERT(SAMPLEPERBIT == 8);
+			uint8_t bits = sampled_bits & 0x07;
+			if (bits == 0x07 // 111, 3 bits set to 1
+			 || bits == 0x06 // 110, 2 bits
+			 || bits == 0x05 // 101, 2 bits
+			 || bits == 0x03 // 011, 2 bits
+			)
+				found_bits |= 1;
+
+			/*
+			 * NRZI coding: if 2 consecutive bits have the same value
+			 * a 1 is received, otherwise it's a 0.
+			 */
+			bool bit = !EDGE_FOUND(found_bits);
+			if (!(af->frame_mode ? hdlc_parseFrame(af, bit) : hdlc_parse(&af->hdlc, bit, &af->rx_fifo)))
+				af->status |= AFSK_RXFIFO_OVERRUN;
+		}
 	}
 
+	af->iir_x[0] = x0;
+	af->iir_x[1] = x1;
+	af->iir_y[0] = y0;
+	af->iir_y[1] = y1;
+	af->sampled_bits = sampled_bits;
+	af->found_bits = found_bits;
+	af->curr_phase = curr_phase;
+	af->delay_idx = delay_idx;
 
 	AFSK_STROBE_OFF();
 }
 
+/**
+ * ADC ISR callback.
+ * This function has to be called by the ADC ISR when a sample of the configured
+ * channel is available.
+ * Boards that acquire samples by DMA should use afsk_adc_block() instead.
+ * \param af Afsk context to operate on.
+ * \param curr_sample current sample from the ADC.
+ */
+void afsk_adc_isr(Afsk *af, int8_t curr_sample)
+{
+	afsk_adc_block(af, &curr_sample, 1);
+}
+
 static void afsk_txStart(Afsk *af)
 {
 	if (!af->sending)
@@ -349,7 +477,7 @@ uint8_t afsk_dac_isr(Afsk *af)
 		if (af->tx_bit == 0)
 		{
 			/* We have just finished transimitting a char, get a new one. */
-			if (fifo_isempty(&af->tx_fifo) && af->trailer_len == 0)
+			if (fifo_isempty(&af->tx_fifo) && !af->tx_frame && af->trailer_len == 0)
 			{
 				AFSK_DAC_IRQ_STOP(af->dac_ch);
 				af->sending = false;
@@ -358,6 +486,8 @@ uint8_t afsk_dac_isr(Afsk *af)
 			}
 			else
 			{
+				bool frame_data = false;
+
 				/*
 				 * If we have just finished sending an unstuffed byte,
 				 * reset bitstuff counter.
@@ -372,7 +502,31 @@ uint8_t afsk_dac_isr(Afsk *af)
 				 */
 				if (af->preamble_len == 0)
 				{
-					if (fifo_isempty(&af->tx_fifo))
+					if (af->tx_frame)
+					{
+						/*
+						 * Frame mode: opening flag, data bytes as they are
+						 * and closing flag, then on with the next frame.
+						 */
+						if (af->tx_idx == 0)
+						{
+							af->curr_out = HDLC_FLAG;
+							af->tx_idx++;
+						}
+						else if (af->tx_idx <= af->tx_frame->len)
+						{
+							af->curr_out = af->tx_frame->buf[af->tx_idx++ - 1];
+							frame_data = true;
+						}
+						else
+						{
+							af->curr_out = HDLC_FLAG;
+							ADDTAIL(&af->free_frames, &af->tx_frame->link);
+							af->tx_frame = (AfskFrame *)list_remHead(&af->tx_frames);
+							af->tx_idx = 0;
+						}
+					}
+					else if (fifo_isempty(&af->tx_fifo))
 					{
 						af->trailer_len--;
 						af->curr_out = HDLC_FLAG;
@@ -386,8 +540,10 @@ uint8_t afsk_dac_isr(Afsk *af)
 					af->curr_out = HDLC_FLAG;
 				}
 
-				/* Handle char escape */
-				if (af->curr_out == AX25_ESC)
+				/* Handle char escape, frame bytes are only bit stuffed */
+				if (frame_data)
+					af->bit_stuff = true;
+				else if (af->curr_out == AX25_ESC)
 				{
 					if (fifo_isempty(&af->tx_fifo))
 					{
@@ -527,6 +683,110 @@ static void afsk_clearerr(KFile *fd)
 	ATOMIC(af->status = 0);
 }
 
+/**
+ * Switch the modem to frame mode.
+ * Received frames are no more escaped in the byte FIFO: the demodulator
+ * collects them in frames taken from \a pool and queues only the ones
+ * with a good CRC, to be read with afsk_recvFrame(). Frames are sent
+ * with afsk_sendFrame().
+ * The KFile interface of the modem must not be used in frame mode.
+ *
+ * \param af Afsk context to operate on.
+ * \param pool frames used by the receiver and the transmitter.
+ * \param count number of frames in \a pool, at least one.
+ */
+void afsk_framesInit(Afsk *af, AfskFrame *pool, size_t count)
+{
+	ASSERT(count);
+
+	ATOMIC(
+		for (size_t i = 0; i < count; i++)
+			ADDTAIL(&af->free_frames, &pool[i].link);
+		af->rx_frame = NULL;
+		af->hdlc.rxstart = false;
+		af->frame_mode = true;
+	);
+}
+
+/**
+ * Take a free frame to be filled and sent with afsk_sendFrame().
+ * \return the frame, or NULL if none is free.
+ */
+AfskFrame *afsk_allocFrame(Afsk *af)
+{
+	AfskFrame *frame;
+
+	ATOMIC(frame = (AfskFrame *)list_remHead(&af->free_frames));
+	return frame;
+}
+
+/**
+ * Give back a frame got with afsk_recvFrame() or afsk_allocFrame().
+ */
+void afsk_freeFrame(Afsk *af, AfskFrame *frame)
+{
+	ATOMIC(ADDTAIL(&af->free_frames, &frame->link));
+}
+
+/**
+ * Get the next received frame.
+ * The frame has no HDLC flags nor escapes and its CRC is good.
+ * \return the frame, or NULL if none has been received.
+ */
+AfskFrame *afsk_recvFrame(Afsk *af)
+{
+	AfskFrame *frame;
+
+	ATOMIC(frame = (AfskFrame *)list_remHead(&af->rx_frames));
+	return frame;
+}
+
+/**
+ * Queue a frame for transmission.
+ * \a frame must contain a whole frame, FCS included (see ax25_buildFrame());
+ * it is given back to the free frames after being modulated.
+ */
+void afsk_sendFrame(Afsk *af, AfskFrame *frame)
+{
+	ASSERT(frame->len <= sizeof(frame->buf));
+
+	ATOMIC(
+		if (af->tx_frame)
+			ADDTAIL(&af->tx_frames, &frame->link);
+		else
+		{
+			af->tx_frame = frame;
+			af->tx_idx = 0;
+		}
+	);
+	afsk_txStart(af);
+}
+
+/**
+ * Queue a received frame in frame mode.
+ * This is for alternative demodulators that check the CRC on their own.
+ *
+ * \return true if the frame has been queued, false if no frame was free.
+ */
+bool afsk_deliverFrame(Afsk *af, const uint8_t *buf, size_t len)
+{
+	AfskFrame *frame;
+
+	ASSERT(len <= sizeof(frame->buf));
+
+	ATOMIC(frame = (AfskFrame *)list_remHead(&af->free_frames));
+	if (!frame)
+	{
+		af->status |= AFSK_RXFIFO_OVERRUN;
+		return false;
+	}
+
+	memcpy(frame->buf, buf, len);
+	frame->len = len;
+	ATOMIC(ADDTAIL(&af->rx_frames, &frame->link));
+	return true;
+}
+
 
 /**
  * Initialize an AFSK1200 modem.
@@ -543,15 +803,14 @@ void afsk_init(Afsk *af, int adc_ch, int dac_ch)
 	af->adc_ch = adc_ch;
 	af->dac_ch = dac_ch;
 
-	fifo_init(&af->delay_fifo, (uint8_t *)af->delay_buf, sizeof(af->delay_buf));
+	/* The delay line starts filled with 0 by the memset above */
 	fifo_init(&af->rx_fifo, af->rx_buf, sizeof(af->rx_buf));
-
-	/* Fill sample FIFO with 0 */
-	for (int i = 0; i < SAMPLEPERBIT / 2; i++)
-		fifo_push(&af->delay_fifo, 0);
-
 	fifo_init(&af->tx_fifo, af->tx_buf, sizeof(af->tx_buf));
 
+	LIST_INIT(&af->free_frames);
+	LIST_INIT(&af->rx_frames);
+	LIST_INIT(&af->tx_frames);
+
 	AFSK_ADC_INIT(adc_ch, af);
 	AFSK_DAC_INIT(dac_ch, af);
 	AFSK_STROBE_INIT();
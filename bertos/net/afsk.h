@@ -51,20 +51,27 @@
 #include <io/kfile.h>
 
 #include <struct/fifobuf.h>
+#include <struct/list.h>
 
+/*
+ * Fallback for projects with an older cfg_afsk.h.
+ */
+#ifndef CONFIG_AFSK_FRAME_LEN
+	#define CONFIG_AFSK_FRAME_LEN 330
+#endif
 
 
 /**
  * ADC sample rate.
  * The demodulator filters are designed to work at this frequency.
- * If you need to change this remember to update afsk_adc_isr().
+ * If you need to change this remember to update afsk_adc_block().
  */
 #define SAMPLERATE 9600
 
 /**
  * Bitrate of the received/transmitted data.
  * The demodulator filters and decoderes are designed to work at this frequency.
- * If you need to change this remember to update afsk_adc_isr().
+ * If you need to change this remember to update afsk_adc_block().
  */
 #define BITRATE    1200
 
@@ -84,9 +91,21 @@ typedef struct Hdlc
 
 /**
  * RX FIFO buffer full error.
+ * In frame mode, set when a frame is lost for lack of free frames.
  */
 #define AFSK_RXFIFO_OVERRUN BV(0)
 
+/**
+ * Frame buffer for the frame oriented interface of the modem.
+ * \see afsk_framesInit()
+ */
+typedef struct AfskFrame
+{
+	Node link;
+	uint16_t len;                       ///< Frame length, FCS included.
+	uint8_t buf[CONFIG_AFSK_FRAME_LEN]; ///< Frame data, without HDLC flags nor escapes.
+} AfskFrame;
+
 /**
  * AFSK1200 modem context.
  */
@@ -123,15 +142,15 @@ typedef struct Afsk
 	/** Current phase increment for current modulated bit */
 	uint16_t phase_inc;
 
-	/** Delay line used to delay samples by (SAMPLEPERBIT / 2) */
-	FIFOBuffer delay_fifo;
-
 	/**
-	 * Buffer for delay FIFO.
-	 * The 1 is added because the FIFO macros need
-	 * 1 byte more to handle a buffer (SAMPLEPERBIT / 2) bytes long.
+	 * Delay line used to delay samples by (SAMPLEPERBIT / 2).
+	 * This is a ring: delay_idx points to the oldest sample, which is
+	 * overwritten by the current one.
 	 */
-	int8_t delay_buf[SAMPLEPERBIT / 2 + 1];
+	int8_t delay_buf[SAMPLEPERBIT / 2];
+
+	/** Index of the oldest sample in delay_buf */
+	uint8_t delay_idx;
 
 	/** FIFO for received data */
 	FIFOBuffer rx_fifo;
@@ -179,6 +198,30 @@ typedef struct Afsk
 	/** Hdlc context */
 	Hdlc hdlc;
 
+	/** True if the modem exchanges frames instead of using the byte FIFOs */
+	bool frame_mode;
+
+	/** Free frames of the pool */
+	List free_frames;
+
+	/** Frames received, with a good CRC */
+	List rx_frames;
+
+	/** Frame being received, NULL if no frame was free */
+	AfskFrame *rx_frame;
+
+	/** CRC of the frame being received */
+	uint16_t rx_crc;
+
+	/** Frames queued for transmission */
+	List tx_frames;
+
+	/** Frame being transmitted */
+	AfskFrame *tx_frame;
+
+	/** Next byte of tx_frame to be modulated */
+	uint16_t tx_idx;
+
 	/**
 	 * Preamble length.
 	 * When the AFSK modem wants to send data, before sending the actual data,
@@ -205,10 +248,18 @@ INLINE Afsk *AFSK_CAST(KFile *fd)
 }
 
 
+void afsk_adc_block(Afsk *af, const int8_t *samples, size_t len);
 void afsk_adc_isr(Afsk *af, int8_t sample);
 uint8_t afsk_dac_isr(Afsk *af);
 void afsk_init(Afsk *af, int adc_ch, int dac_ch);
 
+void afsk_framesInit(Afsk *af, AfskFrame *pool, size_t count);
+AfskFrame *afsk_allocFrame(Afsk *af);
+void afsk_freeFrame(Afsk *af, AfskFrame *frame);
+AfskFrame *afsk_recvFrame(Afsk *af);
+void afsk_sendFrame(Afsk *af, AfskFrame *frame);
+bool afsk_deliverFrame(Afsk *af, const uint8_t *buf, size_t len);
+
 
 /**
  * \name Afsk filter types.
@@ -0,0 +1,342 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief AFSK1200 correlator demodulator.
+ */
+
+#include "afsk_corr.h"
+
+#include "cfg/cfg_afsk.h"
+#include "hw/hw_afsk.h"
+
+#include <net/ax25.h>
+
+#include <algo/crc_ccitt.h>
+
+#include <cpu/pgm.h>
+#include <struct/fifobuf.h>
+
+#include <string.h> /* memset */
+
+/* Clock recovery, same as the delay demodulator */
+#define PHASE_BIT    8
+#define PHASE_INC    1
+
+#define PHASE_MAX    (SAMPLEPERBIT * PHASE_BIT)
+#define PHASE_THRES  (PHASE_MAX / 2)
+
+#define BIT_DIFFER(bitline1, bitline2) (((bitline1) ^ (bitline2)) & 0x01)
+#define EDGE_FOUND(bitline)            BIT_DIFFER((bitline), (bitline) >> 1)
+
+/*
+ * Reference tones, 127 * cos() and 127 * sin() at SAMPLERATE.
+ * Space tone repeats every 48 samples (11 cycles), mark every 8.
+ */
+#define REF_LEN 48
+
+static const int8_t PROGMEM mark_cos[SAMPLEPERBIT] = { 127, 90, 0, -90, -127, -90, 0, 90 };
+static const int8_t PROGMEM mark_sin[SAMPLEPERBIT] = { 0, 90, 127, 90, 0, -90, -127, -90 };
+
+static const int8_t PROGMEM space_cos[REF_LEN] =
+{
+	127, 17, -123, -49, 110, 77, -90, -101, 64, 117, -33, -126, 0, 126, 33, -117,
+	-63, 101, 90, -77, -110, 49, 123, -17, -127, -17, 123, 49, -110, -77, 90, 101,
+	-64, -117, 33, 126, 0, -126, -33, 117, 63, -101, -90, 77, 110, -49, -123, 17,
+};
+
+static const int8_t PROGMEM space_sin[REF_LEN] =
+{
+	0, 126, 33, -117, -63, 101, 90, -77, -110, 49, 123, -17, -127, -17, 123, 49,
+	-110, -77, 90, 101, -64, -117, 33, 126, 0, -126, -33, 117, 64, -101, -90, 77,
+	110, -49, -123, 17, 127, 17, -123, -49, 110, 77, -90, -101, 64, 117, -33, -126,
+};
+
+STATIC_ASSERT(SAMPLERATE == 9600);
+STATIC_ASSERT(BITRATE == 1200);
+STATIC_ASSERT(REF_LEN % SAMPLEPERBIT == 0);
+
+/*
+ * Correlation sums are shifted down before squaring, so that the
+ * energies times the slicer gain fit in 32 bits:
+ * (SAMPLEPERBIT * 128 * 127) >> 6 = 2032, 2 * 2032^2 * 255 < 2^31.
+ */
+#define CORR_SHIFT 6
+
+/*
+ * Space energy gains of the slicers, 16 is unity.
+ * The first slicer is balanced, the others compensate for increasing
+ * amounts of twist, in both directions.
+ */
+static const uint8_t slicer_gain[] = { 16, 40, 6, 100, 3, 25, 10, 255 };
+
+STATIC_ASSERT(CONFIG_AFSK_CORR_SLICERS >= 1 && CONFIG_AFSK_CORR_SLICERS <= countof(slicer_gain));
+
+/*
+ * Frames decoded by more slicers are received within a few bits
+ * from each other: within this window a frame with the same FCS
+ * and length is a duplicate.
+ */
+#define DEDUP_SAMPLES (SAMPLEPERBIT * 8 * 4)
+
+/* Free space in the receive FIFO */
+static size_t corr_fifoFree(const FIFOBuffer *fb)
+{
+	size_t size = fb->end - fb->begin + 1;
+	size_t used = (fb->tail >= fb->head) ?
+		(size_t)(fb->tail - fb->head) : size - (size_t)(fb->head - fb->tail);
+
+	/* One slot is always left empty to tell full from empty */
+	return size - used - 1;
+}
+
+/* Push a frame in the receive FIFO, escaped as the delay demodulator does */
+static bool corr_pushFifo(Afsk *af, const uint8_t *frame, size_t len)
+{
+	FIFOBuffer *fifo = &af->rx_fifo;
+	size_t need = len + 2;
+
+	for (size_t i = 0; i < len; i++)
+		if (frame[i] == HDLC_FLAG || frame[i] == HDLC_RESET || frame[i] == AX25_ESC)
+			need++;
+
+	if (corr_fifoFree(fifo) < need)
+	{
+		af->status |= AFSK_RXFIFO_OVERRUN;
+		return false;
+	}
+
+	fifo_push(fifo, HDLC_FLAG);
+	for (size_t i = 0; i < len; i++)
+	{
+		uint8_t c = frame[i];
+
+		if (c == HDLC_FLAG || c == HDLC_RESET || c == AX25_ESC)
+			fifo_push(fifo, AX25_ESC);
+		fifo_push(fifo, c);
+	}
+	fifo_push(fifo, HDLC_FLAG);
+	return true;
+}
+
+/*
+ * Hand a good frame to the modem, unless it is a duplicate:
+ * as a whole frame in frame mode, escaped in the receive FIFO otherwise.
+ */
+static void corr_deliver(AfskCorr *corr, const AfskSlicer *s)
+{
+	uint16_t fcs = s->frame[s->len - 2] | (s->frame[s->len - 1] << 8);
+	bool ok;
+
+	if (corr->last_age < DEDUP_SAMPLES && corr->last_fcs == fcs && corr->last_len == s->len)
+	{
+		corr->dups++;
+		return;
+	}
+
+	if (corr->af->frame_mode)
+		ok = afsk_deliverFrame(corr->af, s->frame, s->len);
+	else
+		ok = corr_pushFifo(corr->af, s->frame, s->len);
+
+	if (ok)
+	{
+		corr->last_fcs = fcs;
+		corr->last_len = s->len;
+		corr->last_age = 0;
+		corr->frames++;
+	}
+}
+
+/*
+ * HDLC deframer of a slicer.
+ * Unlike hdlc_parse() in afsk.c this keeps the whole frame and checks
+ * its CRC, so that only good frames leave the slicer.
+ */
+static void corr_hdlc(AfskCorr *corr, AfskSlicer *s, bool bit)
+{
+	s->demod_bits <<= 1;
+	s->demod_bits |= bit ? 1 : 0;
+
+	/* HDLC Flag */
+	if (s->demod_bits == HDLC_FLAG)
+	{
+		if (s->rxstart && s->len >= AX25_MIN_FRAME_LEN && s->crc == AX25_CRC_CORRECT)
+			corr_deliver(corr, s);
+
+		s->rxstart = true;
+		s->crc = CRC_CCITT_INIT_VAL;
+		s->len = 0;
+		s->currchar = 0;
+		s->bit_idx = 0;
+		return;
+	}
+
+	/* Reset */
+	if ((s->demod_bits & HDLC_RESET) == HDLC_RESET)
+	{
+		s->rxstart = false;
+		return;
+	}
+
+	if (!s->rxstart)
+		return;
+
+	/* Stuffed bit */
+	if ((s->demod_bits & 0x3f) == 0x3e)
+		return;
+
+	if (s->demod_bits & 0x01)
+		s->currchar |= 0x80;
+
+	if (++s->bit_idx >= 8)
+	{
+		if (s->len < sizeof(s->frame))
+		{
+			s->frame[s->len++] = s->currchar;
+			s->crc = updcrc_ccitt(s->currchar, s->crc);
+		}
+		else
+			s->rxstart = false;
+
+		s->currchar = 0;
+		s->bit_idx = 0;
+	}
+	else
+		s->currchar >>= 1;
+}
+
+/* Clock recovery and bit decision of a slicer */
+static void corr_slice(AfskCorr *corr, AfskSlicer *s, bool bit)
+{
+	s->sampled_bits <<= 1;
+	s->sampled_bits |= bit ? 1 : 0;
+
+	/* If there is an edge, adjust phase sampling */
+	if (EDGE_FOUND(s->sampled_bits))
+	{
+		if (s->curr_phase < PHASE_THRES)
+			s->curr_phase += PHASE_INC;
+		else
+			s->curr_phase -= PHASE_INC;
+	}
+	s->curr_phase += PHASE_BIT;
+
+	if (s->curr_phase >= PHASE_MAX)
+	{
+		s->curr_phase %= PHASE_MAX;
+		s->found_bits <<= 1;
+
+		/* Majority of the last 3 sampled bits */
+		STATIC_ASSERT(SAMPLEPERBIT == 8);
+		uint8_t bits = s->sampled_bits & 0x07;
+		if (bits == 0x07 || bits == 0x06 || bits == 0x05 || bits == 0x03)
+			s->found_bits |= 1;
+
+		/* NRZI decoding */
+		corr_hdlc(corr, s, !EDGE_FOUND(s->found_bits));
+	}
+}
+
+/**
+ * Demodulate a block of ADC samples with the correlator receiver.
+ * This is the counterpart of afsk_adc_block(), to be called by the ADC
+ * (or ADC DMA) ISR in its place.
+ *
+ * Since the receiver delivers whole frames at once, the receive FIFO of
+ * the modem (CONFIG_AFSK_RX_BUFLEN) must be able to hold an escaped frame;
+ * frames not fitting set AFSK_RXFIFO_OVERRUN and are dropped.
+ *
+ * \param corr Correlator context.
+ * \param samples ADC samples, in acquisition order.
+ * \param len number of samples in \a samples.
+ */
+void afsk_corrBlock(AfskCorr *corr, const int8_t *samples, size_t len)
+{
+	AFSK_STROBE_ON();
+
+	corr->last_age = (corr->last_age + len > DEDUP_SAMPLES) ?
+		DEDUP_SAMPLES : corr->last_age + len;
+
+	while (len--)
+	{
+		int8_t curr = *samples++;
+		int8_t old = corr->win[corr->win_idx];
+		uint8_t r = corr->ref_idx;
+		uint8_t r_old = (r >= SAMPLEPERBIT) ? r - SAMPLEPERBIT : r + REF_LEN - SAMPLEPERBIT;
+
+		/* Slide the window: add the new sample, remove the oldest one */
+		corr->mark_i += curr * (int8_t)pgm_read8(&mark_cos[r % SAMPLEPERBIT])
+			- old * (int8_t)pgm_read8(&mark_cos[r_old % SAMPLEPERBIT]);
+		corr->mark_q += curr * (int8_t)pgm_read8(&mark_sin[r % SAMPLEPERBIT])
+			- old * (int8_t)pgm_read8(&mark_sin[r_old % SAMPLEPERBIT]);
+		corr->space_i += curr * (int8_t)pgm_read8(&space_cos[r])
+			- old * (int8_t)pgm_read8(&space_cos[r_old]);
+		corr->space_q += curr * (int8_t)pgm_read8(&space_sin[r])
+			- old * (int8_t)pgm_read8(&space_sin[r_old]);
+
+		corr->win[corr->win_idx] = curr;
+		corr->win_idx = (corr->win_idx + 1) % SAMPLEPERBIT;
+		corr->ref_idx = (r + 1 == REF_LEN) ? 0 : r + 1;
+
+		int32_t mi = corr->mark_i >> CORR_SHIFT, mq = corr->mark_q >> CORR_SHIFT;
+		int32_t si = corr->space_i >> CORR_SHIFT, sq = corr->space_q >> CORR_SHIFT;
+		int32_t mark = mi * mi + mq * mq;
+		int32_t space = si * si + sq * sq;
+
+		for (int i = 0; i < CONFIG_AFSK_CORR_SLICERS; i++)
+		{
+			AfskSlicer *s = &corr->slicer[i];
+			corr_slice(corr, s, mark * 16 > space * s->space_gain);
+		}
+	}
+
+	AFSK_STROBE_OFF();
+}
+
+/**
+ * Initialize a correlator receiver feeding the modem \a af.
+ * The modem must be already initialized with afsk_init(); its
+ * delay demodulator is simply not used.
+ */
+void afsk_corrInit(AfskCorr *corr, Afsk *af)
+{
+	memset(corr, 0, sizeof(*corr));
+	corr->af = af;
+	corr->last_age = DEDUP_SAMPLES;
+
+	for (int i = 0; i < CONFIG_AFSK_CORR_SLICERS; i++)
+	{
+		corr->slicer[i].space_gain = slicer_gain[i];
+		/* Start the slicers spread over the bit period */
+		corr->slicer[i].curr_phase = i * PHASE_MAX / CONFIG_AFSK_CORR_SLICERS;
+	}
+}
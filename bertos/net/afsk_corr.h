@@ -0,0 +1,128 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief AFSK1200 correlator demodulator.
+ *
+ * This is an alternative receiver for the AFSK1200 modem: mark and space
+ * tones are detected by quadrature correlation over one bit time, and the
+ * result is sliced by several bit slicers in parallel, each with its own
+ * mark/space balance and clock recovery. Every slicer deframes and checks
+ * the CRC on its own; good frames are deduplicated and handed to the
+ * Afsk receive FIFO, so the AX.25 layer reads them as usual.
+ *
+ * $WIZ$ module_name = "afsk_corr"
+ * $WIZ$ module_configuration = "bertos/cfg/cfg_afsk.h"
+ * $WIZ$ module_depends = "afsk", "crc-ccitt"
+ */
+
+#ifndef NET_AFSK_CORR_H
+#define NET_AFSK_CORR_H
+
+#include "afsk.h"
+
+#include "cfg/cfg_afsk.h"
+
+#include <cfg/compiler.h>
+
+/*
+ * Fallbacks for projects with an older cfg_afsk.h.
+ */
+#ifndef CONFIG_AFSK_CORR_SLICERS
+	#define CONFIG_AFSK_CORR_SLICERS 3
+#endif
+#ifndef CONFIG_AFSK_CORR_FRAME_LEN
+	#define CONFIG_AFSK_CORR_FRAME_LEN 330
+#endif
+
+/**
+ * Bit slicer context.
+ * Each slicer has its own clock recovery and HDLC deframer.
+ */
+typedef struct AfskSlicer
+{
+	uint8_t space_gain;   ///< Space energy gain, 16 is unity.
+	uint8_t sampled_bits; ///< Bits sliced at sample rate.
+	int8_t curr_phase;    ///< Bit clock phase.
+	uint8_t found_bits;   ///< Bits found at bitrate, before NRZI decoding.
+	uint8_t demod_bits;   ///< NRZI decoded bitstream.
+	uint8_t bit_idx;      ///< Current received bit.
+	uint8_t currchar;     ///< Current received character.
+	bool rxstart;         ///< True after an HDLC_FLAG.
+	uint16_t crc;         ///< CRC of the frame received so far.
+	uint16_t len;         ///< Length of the frame received so far.
+	uint8_t frame[CONFIG_AFSK_CORR_FRAME_LEN]; ///< Frame being received.
+} AfskSlicer;
+
+/**
+ * Correlator demodulator context.
+ */
+typedef struct AfskCorr
+{
+	/** Modem receiving the decoded frames */
+	Afsk *af;
+
+	/** Last SAMPLEPERBIT samples, the correlation window */
+	int8_t win[SAMPLEPERBIT];
+
+	/** Index of the oldest sample in win */
+	uint8_t win_idx;
+
+	/** Phase of the reference tones */
+	uint8_t ref_idx;
+
+	/** Correlation sums of the window against mark and space tones */
+	int32_t mark_i, mark_q, space_i, space_q;
+
+	/** FCS and length of the last frame delivered, to drop duplicates */
+	uint16_t last_fcs;
+	uint16_t last_len;
+
+	/** Samples elapsed since the last frame was delivered */
+	uint16_t last_age;
+
+	/** Frames delivered to the Afsk FIFO */
+	uint32_t frames;
+
+	/** Frames dropped because already received by another slicer */
+	uint32_t dups;
+
+	AfskSlicer slicer[CONFIG_AFSK_CORR_SLICERS];
+} AfskCorr;
+
+void afsk_corrBlock(AfskCorr *corr, const int8_t *samples, size_t len);
+void afsk_corrInit(AfskCorr *corr, Afsk *af);
+
+int afsk_corr_testSetup(void);
+int afsk_corr_testRun(void);
+int afsk_corr_testTearDown(void);
+
+#endif /* NET_AFSK_CORR_H */
@@ -0,0 +1,185 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief AFSK correlator demodulator test.
+ *
+ * Decode count and CPU time against the delay demodulator.
+ *
+ * $test$: cp bertos/cfg/cfg_afsk.h $cfgdir/
+ * $test$: echo "#undef CONFIG_AFSK_RX_BUFLEN" >> $cfgdir/cfg_afsk.h
+ * $test$: echo "#define CONFIG_AFSK_RX_BUFLEN 1024" >> $cfgdir/cfg_afsk.h
+ */
+
+#include "afsk_corr.h"
+
+#include <drv/timer.h>
+#include <net/ax25.h>
+
+#include <cfg/test.h>
+#include <cfg/debug.h>
+
+#include <cpu/byteorder.h>
+
+#include <os/hptime.h>
+
+#include <stdio.h>
+#include <string.h>
+
+/* DMA buffer size used to feed the demodulators */
+#define BLOCK 64
+
+static int8_t clean[200000];
+static int8_t impaired[sizeof(clean)];
+static size_t samples;
+
+static Afsk afsk;
+static AfskCorr corr;
+static AX25Ctx ax25;
+static int msg_cnt;
+
+static void message_hook(UNUSED_ARG(struct AX25Msg *, msg))
+{
+	msg_cnt++;
+}
+
+/* Load the 8 bit linear PCM samples of an AU file */
+static size_t afsk_corr_load(const char *name, int8_t *buf, size_t size)
+{
+	FILE *fp = fopen(name, "rb");
+	uint32_t hdr[6];
+	size_t len;
+
+	ASSERT(fp);
+	ASSERT(fread(hdr, 1, sizeof(hdr), fp) == sizeof(hdr));
+	ASSERT(memcmp(hdr, ".snd", 4) == 0);
+	ASSERT(be32_to_cpu(hdr[3]) == 2);
+	ASSERT(be32_to_cpu(hdr[4]) == SAMPLERATE);
+	ASSERT(fseek(fp, be32_to_cpu(hdr[1]), SEEK_SET) == 0);
+	len = fread(buf, 1, size, fp);
+	ASSERT(len == be32_to_cpu(hdr[2]));
+	ASSERT(fclose(fp) == 0);
+	return len;
+}
+
+/*
+ * Decode the whole buffer with the delay demodulator or with the
+ * correlator, returning the frames received and the demodulator time.
+ */
+static int afsk_corr_decode(const int8_t *buf, bool use_corr, hptime_t *time)
+{
+	hptime_t start;
+
+	afsk_init(&afsk, 0, 0);
+	afsk_corrInit(&corr, &afsk);
+	ax25_init(&ax25, &afsk.fd, message_hook);
+	msg_cnt = 0;
+	*time = 0;
+
+	for (size_t i = 0; i + BLOCK <= samples; i += BLOCK)
+	{
+		start = hptime_get();
+		if (use_corr)
+			afsk_corrBlock(&corr, buf + i, BLOCK);
+		else
+			afsk_adc_block(&afsk, buf + i, BLOCK);
+		*time += hptime_get() - start;
+
+		ax25_poll(&ax25);
+	}
+	ASSERT(!(afsk.status & AFSK_RXFIFO_OVERRUN));
+	return msg_cnt;
+}
+
+static void afsk_corr_compare(const char *name, const int8_t *buf, int *delay_cnt, int *corr_cnt)
+{
+	hptime_t delay_time, corr_time;
+	size_t n = samples / BLOCK * BLOCK;
+
+	*delay_cnt = afsk_corr_decode(buf, false, &delay_time);
+	*corr_cnt = afsk_corr_decode(buf, true, &corr_time);
+
+	kprintf("%-10s delay: %2d frames %4lu ns/sample, correlator: %2d frames (%lu dups) %4lu ns/sample\n",
+		name, *delay_cnt, (unsigned long)(delay_time * 1000 / n),
+		*corr_cnt, (unsigned long)corr.dups, (unsigned long)(corr_time * 1000 / n));
+}
+
+static int8_t clip(int32_t val)
+{
+	return MINMAX(-128, val, 127);
+}
+
+int afsk_corr_testSetup(void)
+{
+	kdbg_init();
+	timer_init();
+	samples = afsk_corr_load("test/afsk_test.au", clean, sizeof(clean));
+	return 0;
+}
+
+int afsk_corr_testRun(void)
+{
+	int delay_cnt, corr_cnt;
+	int32_t y = 0;
+	uint32_t rnd = 1;
+	size_t i;
+
+	afsk_corr_compare("clean", clean, &delay_cnt, &corr_cnt);
+	ASSERT(delay_cnt >= 15);
+	ASSERT(corr_cnt >= delay_cnt);
+
+	/* Twist: first order lowpass, space tone is ~4 dB below mark */
+	for (i = 0; i < samples; i++)
+	{
+		y = (y * 3 + clean[i]) / 4;
+		impaired[i] = clip(y * 3);
+	}
+	afsk_corr_compare("twisted", impaired, &delay_cnt, &corr_cnt);
+	ASSERT(corr_cnt >= delay_cnt);
+
+	/* Uniform white noise */
+	for (i = 0; i < samples; i++)
+	{
+		rnd = rnd * 1103515245 + 12345;
+		impaired[i] = clip(clean[i] + (int8_t)(rnd >> 24) / 2);
+	}
+	afsk_corr_compare("noisy", impaired, &delay_cnt, &corr_cnt);
+	ASSERT(corr_cnt >= delay_cnt);
+
+	return 0;
+}
+
+int afsk_corr_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(afsk_corr);
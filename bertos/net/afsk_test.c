@@ -54,6 +54,8 @@
 
 #include <cpu/byteorder.h>
 
+#include <os/hptime.h>
+
 #include <stdio.h>
 #include <string.h>
 
@@ -152,6 +154,185 @@ int afsk_testSetup(void)
 }
 
 
+/* Whole input file, to feed the demodulator by blocks */
+static int8_t adc_samples[200000];
+static Afsk afsk_ref;
+static Afsk afsk_blk;
+
+/* Pop all the received chars from both modems and check they are the same */
+static size_t afsk_compareRx(void)
+{
+	size_t cnt = 0;
+
+	while (!fifo_isempty(&afsk_ref.rx_fifo))
+	{
+		ASSERT(!fifo_isempty(&afsk_blk.rx_fifo));
+		ASSERT(fifo_pop(&afsk_ref.rx_fifo) == fifo_pop(&afsk_blk.rx_fifo));
+		cnt++;
+	}
+	ASSERT(fifo_isempty(&afsk_blk.rx_fifo));
+	ASSERT(afsk_ref.status == afsk_blk.status);
+	return cnt;
+}
+
+/*
+ * Block demodulator must be bit exact with the per sample ISR, whatever
+ * the block boundaries are.
+ */
+static void afsk_blockTest(void)
+{
+	FILE *fp = afsk_fileOpen("test/afsk_test.au");
+	size_t len = fread(adc_samples, 1, sizeof(adc_samples), fp);
+	size_t i, blk, rx = 0;
+	hptime_t start, isr_time, blk_time;
+
+	ASSERT(len == data_size);
+	ASSERT(fclose(fp) == 0);
+
+	afsk_init(&afsk_ref, 0, 0);
+	afsk_init(&afsk_blk, 0, 0);
+	for (i = 0, blk = 1; i < len; i += blk, blk = blk % 97 + 1)
+	{
+		size_t n = MIN(blk, len - i);
+
+		for (size_t j = 0; j < n; j++)
+			afsk_adc_isr(&afsk_ref, adc_samples[i + j]);
+		afsk_adc_block(&afsk_blk, adc_samples + i, n);
+		rx += afsk_compareRx();
+		ASSERT(memcmp(&afsk_ref.hdlc, &afsk_blk.hdlc, sizeof(Hdlc)) == 0);
+		ASSERT(afsk_ref.curr_phase == afsk_blk.curr_phase);
+	}
+	kprintf("Block demodulator: %lu chars received, bit exact\n", (unsigned long)rx);
+
+	/* Same input, timed with a 64 samples DMA buffer (150 interrupts/s at 9600 Hz) */
+	#define AFSK_TEST_BLOCK 64
+	afsk_init(&afsk_ref, 0, 0);
+	start = hptime_get();
+	for (i = 0; i + AFSK_TEST_BLOCK <= len; i += AFSK_TEST_BLOCK)
+	{
+		for (size_t j = 0; j < AFSK_TEST_BLOCK; j++)
+			afsk_adc_isr(&afsk_ref, adc_samples[i + j]);
+		fifo_flush(&afsk_ref.rx_fifo);
+	}
+	isr_time = hptime_get() - start;
+
+	afsk_init(&afsk_blk, 0, 0);
+	start = hptime_get();
+	for (i = 0; i + AFSK_TEST_BLOCK <= len; i += AFSK_TEST_BLOCK)
+	{
+		afsk_adc_block(&afsk_blk, adc_samples + i, AFSK_TEST_BLOCK);
+		fifo_flush(&afsk_blk.rx_fifo);
+	}
+	blk_time = hptime_get() - start;
+
+	kprintf("Demodulator time per sample: isr %lu ns, block(%d) %lu ns\n",
+		(unsigned long)(isr_time * 1000 / i), AFSK_TEST_BLOCK,
+		(unsigned long)(blk_time * 1000 / i));
+}
+
+static int frame_cnt;
+static void frame_hook(UNUSED_ARG(struct AX25Msg *, msg))
+{
+	frame_cnt++;
+}
+
+static AfskFrame frame_pool[4];
+static uint8_t tx_stream[32768];
+static uint8_t tx_frames[32768];
+
+/* Modulate until the modem stops, return the number of samples */
+static size_t afsk_modulate(Afsk *af, uint8_t *out, size_t size)
+{
+	size_t n = 0;
+
+	do
+	{
+		ASSERT(n < size);
+		out[n++] = afsk_dac_isr(af);
+	}
+	while (af->sending);
+	return n;
+}
+
+/*
+ * Frame interface against the byte stream: same frames received,
+ * same samples sent, and CPU time per frame of demodulator plus AX25.
+ */
+static void afsk_frameTest(void)
+{
+	AX25Ctx ax25_frm;
+	AfskFrame *frame;
+	hptime_t start, stream_time, frame_time;
+	size_t i, tx_len;
+	int stream_cnt;
+	char buf[256];
+
+	afsk_init(&afsk_ref, 0, 0);
+	ax25_init(&ax25_frm, &afsk_ref.fd, frame_hook);
+	frame_cnt = 0;
+	start = hptime_get();
+	for (i = 0; i + AFSK_TEST_BLOCK <= data_size; i += AFSK_TEST_BLOCK)
+	{
+		afsk_adc_block(&afsk_ref, adc_samples + i, AFSK_TEST_BLOCK);
+		ax25_poll(&ax25_frm);
+	}
+	stream_time = hptime_get() - start;
+	stream_cnt = frame_cnt;
+
+	afsk_init(&afsk_blk, 0, 0);
+	afsk_framesInit(&afsk_blk, frame_pool, countof(frame_pool));
+	frame_cnt = 0;
+	start = hptime_get();
+	for (i = 0; i + AFSK_TEST_BLOCK <= data_size; i += AFSK_TEST_BLOCK)
+	{
+		afsk_adc_block(&afsk_blk, adc_samples + i, AFSK_TEST_BLOCK);
+		while ((frame = afsk_recvFrame(&afsk_blk)))
+		{
+			ax25_decodeFrame(&ax25_frm, frame->buf, frame->len);
+			afsk_freeFrame(&afsk_blk, frame);
+		}
+	}
+	frame_time = hptime_get() - start;
+	ASSERT(frame_cnt == stream_cnt);
+	ASSERT(!(afsk_blk.status & AFSK_RXFIFO_OVERRUN));
+
+	kprintf("RX per frame: stream %lu us, frames %lu us (%d frames)\n",
+		(unsigned long)(stream_time / stream_cnt),
+		(unsigned long)(frame_time / frame_cnt), frame_cnt);
+
+	/* The modulator must send the very same samples */
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = i;
+
+	afsk_init(&afsk_ref, 0, 0);
+	ax25_init(&ax25_frm, &afsk_ref.fd, NULL);
+	start = hptime_get();
+	ax25_send(&ax25_frm, AX25_CALL("abcdef", 0), AX25_CALL("123456", 1), buf, sizeof(buf));
+	tx_len = afsk_modulate(&afsk_ref, tx_stream, sizeof(tx_stream));
+	stream_time = hptime_get() - start;
+
+	afsk_init(&afsk_blk, 0, 0);
+	afsk_framesInit(&afsk_blk, frame_pool, countof(frame_pool));
+	AX25Call path[] = AX25_PATH(AX25_CALL("abcdef", 0), AX25_CALL("123456", 1));
+	start = hptime_get();
+	frame = afsk_allocFrame(&afsk_blk);
+	ASSERT(frame);
+	frame->len = ax25_buildFrame(frame->buf, sizeof(frame->buf), path, countof(path), buf, sizeof(buf));
+	ASSERT(frame->len);
+	afsk_sendFrame(&afsk_blk, frame);
+	ASSERT(afsk_modulate(&afsk_blk, tx_frames, sizeof(tx_frames)) == tx_len);
+	frame_time = hptime_get() - start;
+	ASSERT(memcmp(tx_stream, tx_frames, tx_len) == 0);
+
+	/* The sent frame is back in the pool */
+	for (i = 0; i < countof(frame_pool); i++)
+		ASSERT(afsk_allocFrame(&afsk_blk));
+	ASSERT(!afsk_allocFrame(&afsk_blk));
+
+	kprintf("TX per frame: stream %lu us, frames %lu us (%lu samples)\n",
+		(unsigned long)stream_time, (unsigned long)frame_time, (unsigned long)tx_len);
+}
+
 static void messageout_hook(struct AX25Msg *msg)
 {
 	ASSERT(strncmp(msg->dst.call, "ABCDEF", 6) == 0);
@@ -168,6 +349,9 @@ static void messageout_hook(struct AX25Msg *msg)
 int afsk_testRun(void)
 {
 	int c;
+
+	afsk_blockTest();
+	afsk_frameTest();
 	while ((c = fgetc(fp_adc)) != EOF)
 	{
 		afsk_adc_isr(&afsk_fd, (int8_t)c);
@@ -68,10 +68,10 @@
 		(addr)[i] = (c == ' ') ? '\x0' : c; \
 	}
 
-static void ax25_decode(AX25Ctx *ctx)
+static void ax25_decode(AX25Ctx *ctx, const uint8_t *frame, size_t frm_len)
 {
 	AX25Msg msg;
-	uint8_t *buf = ctx->buf;
+	const uint8_t *buf = frame;
 
 	DECODE_CALL(buf, msg.dst.call);
 	msg.dst.ssid = (*buf++ >> 1) & 0x0F;
@@ -119,7 +119,7 @@ static void ax25_decode(AX25Ctx *ctx)
 		return;
 	}
 
-	msg.len = ctx->frm_len - 2 - (buf - ctx->buf);
+	msg.len = frm_len - 2 - (buf - frame);
 	msg.info = buf;
 	LOG_INFO("DATA: %.*s\n", msg.len, msg.info);
 
@@ -151,7 +151,7 @@ void ax25_poll(AX25Ctx *ctx)
 				if (ctx->crc_in == AX25_CRC_CORRECT)
 				{
 					LOG_INFO("Frame found!\n");
-					ax25_decode(ctx);
+					ax25_decode(ctx, ctx->buf, ctx->frm_len);
 				}
 				else
 				{
@@ -200,6 +200,25 @@ void ax25_poll(AX25Ctx *ctx)
 	}
 }
 
+/**
+ * Decode a whole AX25 frame received by a frame oriented modem.
+ * The frame has no HDLC flags nor escapes and its FCS has already been
+ * checked by the receiver; if it is a message the callback of \a ctx is
+ * executed, just like with ax25_poll().
+ *
+ * \param ctx AX25 context to operate on.
+ * \param frame frame buffer, FCS included.
+ * \param len frame length.
+ */
+void ax25_decodeFrame(AX25Ctx *ctx, const uint8_t *frame, size_t len)
+{
+	if (len < AX25_MIN_FRAME_LEN)
+		return;
+
+	LOG_INFO("Frame found!\n");
+	ax25_decode(ctx, frame, len);
+}
+
 static void ax25_putchar(AX25Ctx *ctx, uint8_t c)
 {
 	if (c == HDLC_FLAG || c == HDLC_RESET
@@ -209,7 +228,10 @@ static void ax25_putchar(AX25Ctx *ctx, uint8_t c)
 	kfile_putc(c, ctx->ch);
 }
 
-static void ax25_sendCall(AX25Ctx *ctx, const AX25Call *addr, bool last)
+/*
+ * Encode a callsign in the 7 bytes of an AX25 address field.
+ */
+static void ax25_encodeCall(uint8_t *out, const AX25Call *addr, bool last)
 {
 	unsigned len = MIN(sizeof(addr->call), strlen(addr->call));
 
@@ -218,19 +240,29 @@ static void ax25_sendCall(AX25Ctx *ctx, const AX25Call *addr, bool last)
 		uint8_t c = addr->call[i];
 		ASSERT(isalnum(c) || c == ' ');
 		c = toupper(c);
-		ax25_putchar(ctx, c << 1);
+		*out++ = c << 1;
 	}
 
 	/* Fill with spaces the rest of the CALL if it's shorter */
 	if (len < sizeof(addr->call))
 		for (unsigned i = 0; i < sizeof(addr->call) - len; i++)
-			ax25_putchar(ctx, ' ' << 1);
+			*out++ = ' ' << 1;
 
 	/* The bit7 "has-been-repeated" flag is not implemented here */
 	/* Bits6:5 should be set to 1 for all SSIDs (0x60) */
 	/* The bit0 of last call SSID should be set to 1 */
-	uint8_t ssid = 0x60 | (addr->ssid << 1) | (last ? 0x01 : 0);
-	ax25_putchar(ctx, ssid);
+	*out = 0x60 | (addr->ssid << 1) | (last ? 0x01 : 0);
+}
+
+#define AX25_CALL_LEN 7
+
+static void ax25_sendCall(AX25Ctx *ctx, const AX25Call *addr, bool last)
+{
+	uint8_t field[AX25_CALL_LEN];
+
+	ax25_encodeCall(field, addr, last);
+	for (unsigned i = 0; i < sizeof(field); i++)
+		ax25_putchar(ctx, field[i]);
 }
 
 /**
@@ -276,6 +308,51 @@ void ax25_sendVia(AX25Ctx *ctx, const AX25Call *path, size_t path_len, const voi
 	kfile_putc(HDLC_FLAG, ctx->ch);
 }
 
+/**
+ * Build an AX25 frame in a buffer, without HDLC flags and escapes.
+ * This is the frame oriented counterpart of ax25_sendVia(): the result,
+ * FCS included, can be handed as is to a modem accepting whole frames.
+ *
+ * \param frame buffer for the frame.
+ * \param size size of \a frame.
+ * \param path An array of callsigns used as path, \see AX25_PATH.
+ * \param path_len callsigns path lenght.
+ * \param _buf payload buffer.
+ * \param len length of the payload.
+ *
+ * \return the frame length, or 0 if it does not fit in \a size bytes.
+ */
+size_t ax25_buildFrame(uint8_t *frame, size_t size, const AX25Call *path, size_t path_len, const void *_buf, size_t len)
+{
+	size_t frm_len = path_len * AX25_CALL_LEN + 2 + len + 2;
+	uint8_t *p = frame;
+	uint16_t crc;
+
+	ASSERT(path);
+	ASSERT(path_len >= 2);
+
+	if (frm_len > size)
+		return 0;
+
+	for (size_t i = 0; i < path_len; i++, p += AX25_CALL_LEN)
+		ax25_encodeCall(p, &path[i], (i == path_len - 1));
+
+	*p++ = AX25_CTRL_UI;
+	*p++ = AX25_PID_NOLAYER3;
+	memcpy(p, _buf, len);
+	p += len;
+
+	crc = CRC_CCITT_INIT_VAL;
+	for (const uint8_t *c = frame; c < p; c++)
+		crc = updcrc_ccitt(*c, crc);
+
+	/* CRC is sent in reverse order, see ax25_sendVia() */
+	*p++ = (crc & 0xff) ^ 0xff;
+	*p++ = (crc >> 8) ^ 0xff;
+
+	return frm_len;
+}
+
 static void print_call(KFile *ch, const AX25Call *call)
 {
 	kfile_printf(ch, "%.6s", call->call);
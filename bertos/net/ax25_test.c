@@ -43,6 +43,8 @@
 #include <cfg/kfile_debug.h>
 #include <cfg/test.h>
 
+#include <os/hptime.h>
+
 #include <string.h> //strncmp
 
 static AX25Ctx ax25;
@@ -85,6 +87,63 @@ static void msg_callback(AX25Msg *msg)
 	ASSERT(strncmp((const char *)msg->info, "=4603.63N/01431.26E-Op. Andrej", 30) == 0);
 }
 
+static int msg_cnt;
+
+static void count_callback(UNUSED_ARG(AX25Msg *, msg))
+{
+	msg_cnt++;
+}
+
+/*
+ * Per frame CPU time of the byte stream interface against
+ * the frame interface, on the same frame.
+ */
+#define BENCH_FRAMES 1000
+
+static void ax25_frameBench(const uint8_t *frame, size_t len)
+{
+	static uint8_t out[256];
+	AX25Call path[] = AX25_PATH(AX25_CALL("aprs", 0x70), AX25_CALL("s57ln", 0x30));
+	hptime_t start, rx_stream, rx_frame, tx_stream, tx_frame;
+
+	msg_cnt = 0;
+	start = hptime_get();
+	for (int i = 0; i < BENCH_FRAMES; i++)
+	{
+		kfilemem_init(&mem, aprs_packet, sizeof(aprs_packet));
+		ax25_init(&ax25, &mem.fd, count_callback);
+		ax25_poll(&ax25);
+	}
+	rx_stream = hptime_get() - start;
+	ASSERT(msg_cnt == BENCH_FRAMES);
+
+	start = hptime_get();
+	for (int i = 0; i < BENCH_FRAMES; i++)
+		ax25_decodeFrame(&ax25, frame, len);
+	rx_frame = hptime_get() - start;
+	ASSERT(msg_cnt == 2 * BENCH_FRAMES);
+
+	start = hptime_get();
+	for (int i = 0; i < BENCH_FRAMES; i++)
+	{
+		kfilemem_init(&mem1, out, sizeof(out));
+		ax25_init(&ax25, &mem1.fd, NULL);
+		ax25_sendVia(&ax25, path, countof(path), buf, sizeof(buf));
+	}
+	tx_stream = hptime_get() - start;
+
+	start = hptime_get();
+	for (int i = 0; i < BENCH_FRAMES; i++)
+		ASSERT(ax25_buildFrame(out, sizeof(out), path, countof(path), buf, sizeof(buf)) == len);
+	tx_frame = hptime_get() - start;
+
+	kprintf("Per frame [ns]: rx stream %lu, frame %lu; tx stream %lu, frame %lu\n",
+		(unsigned long)(rx_stream * 1000 / BENCH_FRAMES),
+		(unsigned long)(rx_frame * 1000 / BENCH_FRAMES),
+		(unsigned long)(tx_stream * 1000 / BENCH_FRAMES),
+		(unsigned long)(tx_frame * 1000 / BENCH_FRAMES));
+}
+
 int ax25_testSetup(void)
 {
 	kdbg_init();
@@ -106,6 +165,19 @@ int ax25_testRun(void)
 	ax25_init(&ax25, &mem1.fd, NULL);
 	ax25_send(&ax25, AX25_CALL("aprs", 0x70), AX25_CALL("s57ln", 0x30), buf, sizeof(buf));
 	ASSERT(memcmp(aprs_packet, aprs_packet_check, sizeof(aprs_packet)) == 0);
+
+	/* Frame interface: same frame, without flags */
+	uint8_t frame[64];
+	AX25Call path[] = AX25_PATH(AX25_CALL("aprs", 0x70), AX25_CALL("s57ln", 0x30));
+	size_t len = ax25_buildFrame(frame, sizeof(frame), path, countof(path), buf, sizeof(buf));
+	ASSERT(len == sizeof(aprs_packet) - 2);
+	ASSERT(memcmp(frame, aprs_packet + 1, len) == 0);
+	ASSERT(ax25_buildFrame(frame, len - 1, path, countof(path), buf, sizeof(buf)) == 0);
+
+	ax25_init(&ax25, &mem.fd, msg_callback);
+	ax25_decodeFrame(&ax25, frame, len);
+
+	ax25_frameBench(frame, len);
 	return  0;
 }
 
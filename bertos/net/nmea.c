@@ -55,6 +55,7 @@
 #include "cfg/cfg_nmea.h"
 
 #include <cfg/debug.h>
+#include <cfg/macros.h>
 
 #define LOG_LEVEL  NMEA_LOG_LEVEL
 #define LOG_FORMAT NMEA_LOG_FORMAT
@@ -63,6 +64,7 @@
 #include <net/nmeap/inc/nmeap.h>
 
 #include <ctype.h>
+#include <stddef.h>
 #include <time.h>
 #include <string.h>
 #include <stdlib.h>
@@ -189,60 +191,56 @@ static int32_t nmea_altitude(const char *palt, const char *punits)
 	return alt;
 }
 
+/* Days before the start of each month, in a non leap year */
+static const uint16_t month_days[] =
+{
+	0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334
+};
+
 /*
- * Convert time and date stamp string to unix time.
+ * Convert a UTC time of day and a date stamp to unix time.
+ *
+ * \param hms  time as hhmmss.
+ * \param dmy  date as ddmmyy, 0 for 1/1/1970.
  */
-static time_t timestampToSec(uint32_t time_stamp, uint32_t date_stamp)
+static time_t nmea_unixTime(uint32_t hms, uint32_t dmy)
 {
-	struct tm t;
-	uint16_t msec;
-	uint16_t tmr[3];
-	uint16_t date[3];
+	uint32_t h = hms / 10000;
+	uint32_t m = hms / 100 - h * 100;
+	uint32_t t = (h * 60 + m) * 60 + (hms - (h * 100 + m) * 100);
 
-	memset(&t, 0, sizeof(t));
-	memset(&tmr, 0, sizeof(tmr));
-	memset(&date, 0, sizeof(date));
-
-	LOG_INFO("time_s[%lu],date[%lu]\n", (long)time_stamp, (long)date_stamp);
-	uint32_t res = time_stamp / 1000;
-	uint32_t all = time_stamp;
-	msec = all - res * 1000;
-
-	for (int i = 0; i < 3; i++)
+	if (dmy)
 	{
-		all = res;
-		res = all / 100;
-		tmr[i]  = all - res * 100;
-		LOG_INFO("t[%d]%d\n", tmr[i],i);
+		uint32_t day = dmy / 10000;
+		uint32_t mon = dmy / 100 - day * 100;
+		/* The year field has only two digits */
+		uint32_t year = 2000 + dmy - (day * 100 + mon) * 100;
+		uint32_t days;
+
+		if (mon < 1 || mon > 12)
+			return t;
+
+		/* Valid up to 2099 */
+		days = (year - 1970) * 365 + (year - 1969) / 4
+			+ month_days[mon - 1] + day - 1;
+		if (mon > 2 && year % 4 == 0)
+			days++;
+		t += days * 86400L;
 	}
+	return t;
+}
 
-	t.tm_sec = tmr[0] + (ROUND_UP(msec, 1000) / 1000);
-	t.tm_min = tmr[1];
-	t.tm_hour = tmr[2];
-	//If we do not have refence data, we set 1/1/1970 as default
-	t.tm_mday = 1;
-	t.tm_mon = 0;
-	t.tm_year = 70;
+/*
+ * Convert time and date stamp string to unix time.
+ */
+static time_t timestampToSec(uint32_t time_stamp, uint32_t date_stamp)
+{
+	uint32_t hms = time_stamp / 1000;
 
-	if (date_stamp)
-	{
-		res = all = date_stamp;
-		for (int i = 0; i < 3; i++)
-		{
-			all = res;
-			res = all / 100;
-			date[i]  = all - res * 100;
-			LOG_INFO("d[%d]%d\n", date[i],i);
-		}
-		t.tm_mday = date[2];
-		t.tm_mon = date[1] - 1; // time struct count month from 0 to 11;
-		// we should specify the number of years from 1900, but the year field
-		// is only two digits, so we add 100 (2000 - 1900)..
-		t.tm_year = date[0] + 100;
-	}
-	LOG_INFO("times=%d,%d,%d,%d,%d,%d\n",t.tm_sec, t.tm_min, t.tm_hour, t.tm_year, t.tm_mon, t.tm_mday);
+	LOG_INFO("time_s[%lu],date[%lu]\n", (long)time_stamp, (long)date_stamp);
 
-	return  mktime(&t);
+	/* Any fraction of second rounds up */
+	return nmea_unixTime(hms, date_stamp) + (time_stamp != hms * 1000);
 }
 
 /**
@@ -472,3 +470,515 @@ void nmea_poll(nmeap_context_t *context, KFile *channel)
 	}
 }
 
+/*
+ * Streaming parser.
+ *
+ * Each sentence is described by a table of fields, indexed by the field
+ * number; every field is accumulated as integer and fractional part while
+ * it is received and converted to its destination when the next separator
+ * arrives.
+ */
+
+enum
+{
+	NMEA_F_SKIP,    ///< Ignored field
+	NMEA_F_INT,     ///< Integer, as atoi()
+	NMEA_F_FIX1,    ///< Fixed point, one decimal
+	NMEA_F_CHAR,    ///< First character
+	NMEA_F_TIME,    ///< hhmmss.sss time of day to time_t
+	NMEA_F_DATE,    ///< ddmmyy, added to the time_t of the previous time field
+	NMEA_F_DEGREE,  ///< dddmm.mmmm to micro degrees
+	NMEA_F_HEMI,    ///< N/S, E/W: sign of the previous degree field
+	NMEA_F_UNIT,    ///< M/F: unit of the previous altitude field
+};
+
+/* Fractional digits kept by each field type */
+static const uint8_t field_prec[] =
+{
+	[NMEA_F_SKIP]   = 0,
+	[NMEA_F_INT]    = 0,
+	[NMEA_F_FIX1]   = 1,
+	[NMEA_F_CHAR]   = 0,
+	[NMEA_F_TIME]   = 3,
+	[NMEA_F_DATE]   = 0,
+	[NMEA_F_DEGREE] = 4,
+	[NMEA_F_HEMI]   = 0,
+	[NMEA_F_UNIT]   = 0,
+};
+
+static const uint16_t nmea_pow10[] = { 1, 10, 100, 1000, 10000 };
+
+typedef struct NmeaField
+{
+	uint8_t type;
+	uint8_t offset;    ///< Destination in NmeaParser::data
+	uint8_t size;
+} NmeaField;
+
+#define FIELD(type, st, member) \
+	{ NMEA_F_##type, offsetof(st, member), sizeof(((st *)0)->member) }
+#define SKIP { NMEA_F_SKIP, 0, 0 }
+
+typedef struct NmeaSentence
+{
+	char name[3];      ///< Formatter, without the talker
+	uint8_t id;
+	uint8_t num_fields;
+	const NmeaField *fields;
+} NmeaSentence;
+
+static const NmeaField gga_fields[] =
+{
+	FIELD(TIME, NmeaGga, time),
+	FIELD(DEGREE, NmeaGga, latitude),
+	FIELD(HEMI, NmeaGga, latitude),
+	FIELD(DEGREE, NmeaGga, longitude),
+	FIELD(HEMI, NmeaGga, longitude),
+	FIELD(INT, NmeaGga, quality),
+	FIELD(INT, NmeaGga, satellites),
+	FIELD(FIX1, NmeaGga, hdop),
+	FIELD(INT, NmeaGga, altitude),
+	FIELD(UNIT, NmeaGga, altitude),
+	FIELD(INT, NmeaGga, geoid),
+	FIELD(UNIT, NmeaGga, geoid),
+};
+
+static const NmeaField rmc_fields[] =
+{
+	FIELD(TIME, NmeaRmc, time),
+	FIELD(CHAR, NmeaRmc, warn),
+	FIELD(DEGREE, NmeaRmc, latitude),
+	FIELD(HEMI, NmeaRmc, latitude),
+	FIELD(DEGREE, NmeaRmc, longitude),
+	FIELD(HEMI, NmeaRmc, longitude),
+	FIELD(INT, NmeaRmc, speed),
+	FIELD(INT, NmeaRmc, course),
+	FIELD(DATE, NmeaRmc, time),
+	FIELD(INT, NmeaRmc, mag_var),
+};
+
+static const NmeaField vtg_fields[] =
+{
+	FIELD(INT, NmeaVtg, track_good),
+	SKIP,
+	SKIP,
+	SKIP,
+	FIELD(INT, NmeaVtg, knot_speed),
+	SKIP,
+	FIELD(INT, NmeaVtg, km_speed),
+};
+
+#define GSV_SV(n) \
+	FIELD(INT, NmeaGsv, info[n].sv_prn), \
+	FIELD(INT, NmeaGsv, info[n].elevation), \
+	FIELD(INT, NmeaGsv, info[n].azimut), \
+	FIELD(INT, NmeaGsv, info[n].snr)
+
+static const NmeaField gsv_fields[] =
+{
+	FIELD(INT, NmeaGsv, tot_message),
+	FIELD(INT, NmeaGsv, message_num),
+	FIELD(INT, NmeaGsv, tot_svv),
+	GSV_SV(0),
+	GSV_SV(1),
+	GSV_SV(2),
+	GSV_SV(3),
+};
+
+#define SENTENCE(name, id, fields) \
+	{ name, id, countof(fields), fields }
+
+static const NmeaSentence gga_sentence = SENTENCE("GGA", NMEA_GPGGA, gga_fields);
+static const NmeaSentence rmc_sentence = SENTENCE("RMC", NMEA_GPRMC, rmc_fields);
+static const NmeaSentence vtg_sentence = SENTENCE("VTG", NMEA_GPVTG, vtg_fields);
+static const NmeaSentence gsv_sentence = SENTENCE("GSV", NMEA_GPGSV, gsv_fields);
+
+/*
+ * Perfect hash of the supported formatters.
+ */
+#define NMEA_HASH(a, b, c) (((a) ^ (b) ^ (c)) & 7)
+#define NMEA_SLOT(a, b, c) BV(NMEA_HASH(a, b, c))
+
+/*
+ * Every sentence must sit at its own slot, or it would shadow another
+ * one: the bits of distinct slots add up to their OR, a collision
+ * does not.  Keep in sync with sentence_table.
+ */
+STATIC_ASSERT(NMEA_SLOT('G', 'G', 'A') + NMEA_SLOT('R', 'M', 'C')
+	+ NMEA_SLOT('V', 'T', 'G') + NMEA_SLOT('G', 'S', 'V')
+	== (NMEA_SLOT('G', 'G', 'A') | NMEA_SLOT('R', 'M', 'C')
+	| NMEA_SLOT('V', 'T', 'G') | NMEA_SLOT('G', 'S', 'V')));
+
+static const NmeaSentence * const sentence_table[8] =
+{
+	[NMEA_HASH('G', 'G', 'A')] = &gga_sentence,
+	[NMEA_HASH('R', 'M', 'C')] = &rmc_sentence,
+	[NMEA_HASH('V', 'T', 'G')] = &vtg_sentence,
+	[NMEA_HASH('G', 'S', 'V')] = &gsv_sentence,
+};
+
+enum
+{
+	NMEA_ST_IDLE,   ///< Waiting for '$'
+	NMEA_ST_ID,     ///< Sentence header
+	NMEA_ST_FIELD,  ///< Sentence fields
+	NMEA_ST_CK1,    ///< First checksum digit
+	NMEA_ST_CK2,    ///< Second checksum digit
+	NMEA_ST_CR,
+	NMEA_ST_LF,
+};
+
+/* Field accumulator flags */
+#define NMEA_NEG   BV(0)  ///< Negative number
+#define NMEA_DOT   BV(1)  ///< Decimal point found
+#define NMEA_STOP  BV(2)  ///< End of the number
+
+static void nmea_fieldStart(NmeaParser *p)
+{
+	const NmeaSentence *s = p->sentence;
+	uint8_t type = NMEA_F_SKIP;
+
+	if (p->idx >= 1 && p->idx <= s->num_fields)
+		type = s->fields[p->idx - 1].type;
+
+	p->prec = field_prec[type];
+	p->num = 0;
+	p->frac = 0;
+	p->nfrac = 0;
+	p->flags = 0;
+	p->first = 0;
+}
+
+/*
+ * Accumulate the characters of the current field up to the next
+ * delimiter, return the number of characters consumed.
+ */
+static size_t nmea_fieldRun(NmeaParser *p, const char *buf, size_t len)
+{
+	uint32_t num = p->num;
+	uint16_t frac = p->frac;
+	uint8_t nfrac = p->nfrac;
+	uint8_t flags = p->flags;
+	uint8_t sum = p->sum;
+	size_t i = 0;
+
+	if (!p->first)
+	{
+		p->first = buf[0];
+		/* Only a leading sign */
+		if (buf[0] == '-')
+		{
+			flags |= NMEA_NEG;
+			sum ^= '-';
+			i++;
+		}
+	}
+
+	for (; i < len; i++)
+	{
+		char c = buf[i];
+
+		if (c == ',' || c == '*' || c == '\r' || c == '$')
+			break;
+
+		sum ^= c;
+		if (flags & NMEA_STOP)
+			continue;
+
+		if (c >= '0' && c <= '9')
+		{
+			if (!(flags & NMEA_DOT))
+				num = num * 10 + (c - '0');
+			else if (nfrac < p->prec)
+			{
+				frac = frac * 10 + (c - '0');
+				nfrac++;
+			}
+			else
+				flags |= NMEA_STOP;
+		}
+		else if (c == '.' && !(flags & NMEA_DOT))
+			flags |= NMEA_DOT;
+		else
+			flags |= NMEA_STOP;
+	}
+
+	p->num = num;
+	p->frac = frac;
+	p->nfrac = nfrac;
+	p->flags = flags;
+	p->sum = sum;
+	return i;
+}
+
+static void nmea_store(void *dst, uint8_t size, int32_t val)
+{
+	if (size == sizeof(int32_t))
+		*(int32_t *)dst = val;
+	else if (size == sizeof(int16_t))
+		*(int16_t *)dst = val;
+	else
+		*(int8_t *)dst = val;
+}
+
+static int32_t nmea_load(const void *src, uint8_t size)
+{
+	if (size == sizeof(int32_t))
+		return *(const int32_t *)src;
+	else if (size == sizeof(int16_t))
+		return *(const int16_t *)src;
+	else
+		return *(const int8_t *)src;
+}
+
+static void nmea_fieldEnd(NmeaParser *p)
+{
+	const NmeaSentence *s = p->sentence;
+	const NmeaField *f;
+	uint8_t *dst;
+	int32_t val;
+
+	if (p->idx < 1 || p->idx > s->num_fields)
+		return;
+
+	f = &s->fields[p->idx - 1];
+	dst = (uint8_t *)&p->data + f->offset;
+
+	switch (f->type)
+	{
+	case NMEA_F_INT:
+		val = p->num;
+		nmea_store(dst, f->size, (p->flags & NMEA_NEG) ? -val : val);
+		break;
+
+	case NMEA_F_FIX1:
+		nmea_store(dst, f->size, p->num * 10 + p->frac * nmea_pow10[1 - p->nfrac]);
+		break;
+
+	case NMEA_F_CHAR:
+		*(char *)dst = p->first;
+		break;
+
+	case NMEA_F_TIME:
+		/* Any fraction of second rounds up */
+		*(time_t *)dst = nmea_unixTime(p->num, 0) + (p->frac != 0);
+		break;
+
+	case NMEA_F_DATE:
+		if (p->num)
+			*(time_t *)dst = nmea_unixTime(0, p->num) + *(time_t *)dst;
+		break;
+
+	case NMEA_F_DEGREE:
+	{
+		uint32_t deg = p->num / 100;
+		uint32_t min = (p->num - deg * 100) * 10000 + p->frac * nmea_pow10[4 - p->nfrac];
+
+		*(udegree_t *)dst = deg * 1000000 + (min * 5 + 1) / 3;
+		break;
+	}
+
+	case NMEA_F_HEMI:
+		/* North and east are positive, no hemisphere means no fix */
+		if (!p->first)
+			*(udegree_t *)dst = 0;
+		else if (p->first != 'N' && p->first != 'E')
+			*(udegree_t *)dst = -*(udegree_t *)dst;
+		break;
+
+	case NMEA_F_UNIT:
+		if (p->first == 'F')
+		{
+			/* alt = alt * 3.2808399 */
+			val = nmea_load(dst, f->size);
+			val = val * 3 + (val >> 2) + (val >> 6) + (val >> 7) + (val >> 8);
+			nmea_store(dst, f->size, val);
+		}
+		break;
+	}
+}
+
+/*
+ * Look up the sentence from its header, NULL if not supported.
+ */
+static const NmeaSentence *nmea_lookup(const char *id)
+{
+	const NmeaSentence *s = sentence_table[NMEA_HASH(id[2], id[3], id[4])];
+
+	if (s && memcmp(s->name, id + 2, sizeof(s->name)) == 0)
+		return s;
+	return NULL;
+}
+
+static void nmea_deliver(NmeaParser *p)
+{
+	if (p->sum != p->cks)
+	{
+		p->errors++;
+		return;
+	}
+
+	p->sentences++;
+	p->talker[0] = p->id[0];
+	p->talker[1] = p->id[1];
+	if (p->callout)
+		p->callout(p, p->sentence->id, &p->data);
+}
+
+INLINE int nmea_hex(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+/**
+ * Feed a block of characters to the streaming parser.
+ *
+ * The callout is called for every sentence with a valid checksum;
+ * unsupported sentences are skipped without being checked.
+ */
+void nmea_parse(NmeaParser *p, const void *_buf, size_t len)
+{
+	const char *buf = (const char *)_buf;
+	int h;
+
+	while (len--)
+	{
+		char c = *buf++;
+
+		/* A new sentence always starts over */
+		if (c == '$')
+		{
+			if (p->state != NMEA_ST_IDLE)
+				p->errors++;
+			p->state = NMEA_ST_ID;
+			p->sum = 0;
+			p->idx = 0;
+			continue;
+		}
+
+		switch (p->state)
+		{
+		case NMEA_ST_IDLE:
+			break;
+
+		case NMEA_ST_ID:
+			if (!isalnum((unsigned char)c))
+			{
+				p->errors++;
+				p->state = NMEA_ST_IDLE;
+				break;
+			}
+			p->sum ^= c;
+			p->id[p->idx++] = c;
+			if (p->idx == sizeof(p->id))
+			{
+				p->sentence = nmea_lookup(p->id);
+				if (!p->sentence)
+				{
+					p->state = NMEA_ST_IDLE;
+					break;
+				}
+				memset(&p->data, 0, sizeof(p->data));
+				p->idx = 0;
+				nmea_fieldStart(p);
+				p->state = NMEA_ST_FIELD;
+			}
+			break;
+
+		case NMEA_ST_FIELD:
+			if (c == ',')
+			{
+				p->sum ^= c;
+				nmea_fieldEnd(p);
+				p->idx++;
+				nmea_fieldStart(p);
+			}
+			else if (c == '*')
+			{
+				nmea_fieldEnd(p);
+				p->state = NMEA_ST_CK1;
+			}
+			else if (c == '\r')
+			{
+				/* No checksum */
+				nmea_fieldEnd(p);
+				p->cks = p->sum;
+				p->state = NMEA_ST_LF;
+			}
+			else
+			{
+				size_t n = nmea_fieldRun(p, buf - 1, len + 1);
+
+				buf += n - 1;
+				len -= n - 1;
+			}
+			break;
+
+		case NMEA_ST_CK1:
+		case NMEA_ST_CK2:
+			h = nmea_hex(c);
+			if (h < 0)
+			{
+				p->errors++;
+				p->state = NMEA_ST_IDLE;
+				break;
+			}
+			p->cks = (p->state == NMEA_ST_CK1) ? h << 4 : p->cks | h;
+			p->state++;
+			break;
+
+		case NMEA_ST_CR:
+		case NMEA_ST_LF:
+			if (c != ((p->state == NMEA_ST_CR) ? '\r' : '\n'))
+			{
+				p->errors++;
+				p->state = NMEA_ST_IDLE;
+				break;
+			}
+			if (p->state++ == NMEA_ST_LF)
+			{
+				nmea_deliver(p);
+				p->state = NMEA_ST_IDLE;
+			}
+			break;
+		}
+	}
+}
+
+/**
+ * Parse all the available NMEA sentences from a channel with the streaming
+ * parser.
+ */
+void nmea_parserPoll(NmeaParser *parser, KFile *channel)
+{
+	uint8_t buf[32];
+	size_t len;
+	int e;
+
+	do
+	{
+		len = kfile_read(channel, buf, sizeof(buf));
+		nmea_parse(parser, buf, len);
+	}
+	while (len == sizeof(buf));
+
+	if ((e = kfile_error(channel)))
+	{
+		LOG_ERR("ch error [%0X]\n", e);
+		kfile_clearerr(channel);
+	}
+}
+
+/**
+ * Init the streaming parser; \a callout is called for every decoded sentence.
+ */
+void nmea_parserInit(NmeaParser *parser, nmea_callout_t callout, void *user_data)
+{
+	memset(parser, 0, sizeof(*parser));
+	parser->callout = callout;
+	parser->user_data = user_data;
+}
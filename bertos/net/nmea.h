@@ -131,6 +131,67 @@ typedef struct NmeaGsv
 	struct SvInfo info[4];    /* Stanrd gsv nmea report up to 4 sv info */
 } NmeaGsv;
 
+/**
+ * \name Streaming NMEA parser.
+ *
+ * Unlike the nmeap based parser, fields are converted to fixed point
+ * while the characters stream in, the checksum is computed on the fly and
+ * the sentence formatter is dispatched with a perfect hash, so a sentence
+ * is never buffered nor scanned twice.
+ * Any talker is accepted (GP, GN, GL, GA...); the talker of the last
+ * sentence is available in NmeaParser::talker.
+ * \{
+ */
+
+struct NmeaParser;
+
+/**
+ * Callout for a decoded sentence.
+ * \param id   sentence id, NMEA_GPGGA, NMEA_GPRMC, NMEA_GPVTG or NMEA_GPGSV.
+ * \param data decoded NmeaGga, NmeaRmc, NmeaVtg or NmeaGsv; it is only
+ *             valid until the callout returns.
+ */
+typedef void (*nmea_callout_t)(struct NmeaParser *parser, int id, const void *data);
+
+typedef struct NmeaParser
+{
+	const struct NmeaSentence *sentence; ///< Sentence being decoded
+	nmea_callout_t callout;
+	void *user_data;
+
+	uint8_t state;
+	uint8_t sum;         ///< Running checksum
+	uint8_t cks;         ///< Received checksum
+	uint8_t idx;         ///< Position in the header or field number
+	char id[5];          ///< Sentence header
+	char talker[2];      ///< Talker of the last decoded sentence
+
+	/* Current field */
+	uint32_t num;        ///< Integer part
+	uint16_t frac;       ///< Fractional part
+	uint8_t nfrac;       ///< Digits in frac
+	uint8_t prec;        ///< Wanted fractional digits
+	uint8_t flags;
+	char first;          ///< First character of the field, 0 if empty
+
+	union
+	{
+		NmeaGga gga;
+		NmeaRmc rmc;
+		NmeaVtg vtg;
+		NmeaGsv gsv;
+	} data;
+
+	uint32_t sentences;  ///< Decoded sentences
+	uint32_t errors;     ///< Sentences dropped for a bad checksum or framing
+} NmeaParser;
+
+void nmea_parserInit(NmeaParser *parser, nmea_callout_t callout, void *user_data);
+void nmea_parse(NmeaParser *parser, const void *buf, size_t len);
+void nmea_parserPoll(NmeaParser *parser, KFile *channel);
+
+/** \} */
+
 void nmea_poll(nmeap_context_t *context, KFile *channel);
 
 int nmea_gpgsv(nmeap_context_t *context, nmeap_sentence_t *sentence);
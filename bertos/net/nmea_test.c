@@ -32,6 +32,10 @@
  *
  * \brief NMEA parser test.
  *
+ * The capture is decoded with both the nmeap based and the streaming
+ * parser, which must give the same results; both are then benchmarked on
+ * the capture and on the output of a 10 Hz multi-constellation receiver.
+ *
  * \author Daniele Basile <asterix@develer.com>
  *
  * notest:avr
@@ -48,6 +52,9 @@
 
 #include <cfg/test.h>
 
+#include <os/hptime.h>
+
+#include <stdio.h>  //sprintf
 #include <string.h> //strncmp
 
 static nmeap_context_t nmea;	   /* parser context */
@@ -804,7 +811,7 @@ static NmeaGga gga_test1 =
 	.latitude = 43851403,
 	.longitude = 11147808,
 	.altitude = 57,
-	.time = 57928,
+	.time = 61528,
 	.satellites = 5,
 	.quality = 1,
 	.hdop = 26,
@@ -816,7 +823,7 @@ static NmeaGga gga_test2 =
 	.latitude = 43851403,
 	.longitude = 11147808,
 	.altitude = -57,
-	.time = 57928,
+	.time = 61528,
 	.satellites = 5,
 	.quality = 1,
 	.hdop = 26,
@@ -828,7 +835,7 @@ static NmeaGga gga_test3 =
 	.latitude = -43851403,
 	.longitude = -11147808,
 	.altitude = -57,
-	.time = 57928,
+	.time = 61528,
 	.satellites = 5,
 	.quality = 1,
 	.hdop = 26,
@@ -837,7 +844,7 @@ static NmeaGga gga_test3 =
 
 static NmeaRmc rmc_test =
 {
-	.time = 1254758726,
+	.time = 1254762326,
 	.warn = 'A',
 	.latitude = 43851405,
 	.longitude = 11147812,
@@ -897,9 +904,44 @@ static void *find_test(int n)
 
 #define TOT_GOOD_SENTENCE_NUM    665
 #define TOT_SENTENCE_NUM         731
+/*
+ * Sentences cut short by the next '$': nmeap drops the following one
+ * too, the streaming parser restarts on it.
+ */
+#define TOT_RECOVERED_SENTENCE_NUM 3
 
 static int tot_sentence_parsed = 0;
 
+/* Sentences decoded by the nmeap parser, to check the streaming one */
+typedef struct NmeaLog
+{
+	int id;
+	union
+	{
+		NmeaGga gga;
+		NmeaRmc rmc;
+		NmeaVtg vtg;
+		NmeaGsv gsv;
+	} data;
+} NmeaLog;
+
+static NmeaLog nmea_log[TOT_GOOD_SENTENCE_NUM];
+static int tot_sentence_checked;
+static int tot_sentence_recovered;
+
+static NmeaParser parser;
+
+static void log_sentence(int id, void *data, size_t size)
+{
+	NmeaLog *l = &nmea_log[tot_sentence_parsed - 1];
+
+	ASSERT(tot_sentence_parsed <= TOT_GOOD_SENTENCE_NUM);
+	l->id = id;
+	memcpy(&l->data, data, size);
+	/* The streaming parser does not keep stale fields */
+	memset(data, 0, size);
+}
+
 /**
  * do something with the GGA data
  */
@@ -923,6 +965,8 @@ static void gpgga_callout_test(nmeap_context_t *context, void *data, void *user_
             gga->quality,
             gga->hdop,
             gga->geoid);
+
+	log_sentence(NMEA_GPGGA, gga, sizeof(*gga));
 }
 
 /**
@@ -947,6 +991,8 @@ static void gprmc_callout_test(nmeap_context_t *context, void *data, void *user_
             rmc->speed,
             rmc->course,
             rmc->mag_var);
+
+	log_sentence(NMEA_GPRMC, rmc, sizeof(*rmc));
 }
 
 /**
@@ -970,6 +1016,8 @@ static void gpgsv_callout_test(nmeap_context_t *context, void *data, void *user_
 
 	for (int i = 0; i < 4; i++)
 	    LOG_INFO("\t[%d]%d %d %d %d\n", i, gsv->info[i].sv_prn, gsv->info[i].elevation, gsv->info[i].azimut, gsv->info[i].snr);
+
+	log_sentence(NMEA_GPGSV, gsv, sizeof(*gsv));
 }
 
 /**
@@ -990,6 +1038,128 @@ static void gpvtg_callout_test(nmeap_context_t *context, void *data, void *user_
 			vtg->track_good,
 			vtg->knot_speed,
 			vtg->km_speed);
+
+	log_sentence(NMEA_GPVTG, vtg, sizeof(*vtg));
+}
+
+static void parser_callout(NmeaParser *p, int id, const void *data)
+{
+	NmeaLog *l = &nmea_log[tot_sentence_checked];
+
+	ASSERT(p == &parser);
+	if (tot_sentence_checked < TOT_GOOD_SENTENCE_NUM && l->id == id
+		&& memcmp(&l->data, data, sizeof(l->data)) == 0)
+		tot_sentence_checked++;
+	else
+		tot_sentence_recovered++;
+}
+
+/*
+ * One second of output of a 10 Hz GPS + GLONASS + Galileo receiver:
+ * position every epoch, satellites in view and DOP once per second.
+ */
+#define RATE_HZ  10
+
+static const char * const epoch_sentences[] =
+{
+	"GNRMC,170525.900,A,4351.0843,N,01108.8687,E,0.00,237.67,051009,,,A",
+	"GNVTG,237.67,T,,,0.00,N,0.00,K,A",
+	"GNGGA,170525.900,4351.0842,N,01108.8685,E,1,14,0.9,57.4,M,45.2,M,,",
+	"GNGLL,4351.0842,N,01108.8685,E,170525.900,A,A",
+};
+
+static const char * const second_sentences[] =
+{
+	"GNGSA,A,3,03,06,07,14,16,19,21,22,,,,,1.6,0.9,1.3",
+	"GNGSA,A,3,65,66,72,81,,,,,,,,,1.6,0.9,1.3",
+	"GPGSV,3,1,09,03,78,302,37,06,87,031,40,07,05,292,37,14,05,135,30",
+	"GPGSV,3,2,09,16,45,210,41,19,33,067,38,21,12,180,29,22,60,001,44",
+	"GPGSV,3,3,09,26,08,320,",
+	"GLGSV,2,1,06,65,40,100,35,66,70,200,41,72,15,300,28,81,22,045,33",
+	"GLGSV,2,2,06,82,55,120,39,88,10,250,",
+	"GAGSV,1,1,04,02,50,090,40,11,30,180,36,12,20,270,31,24,65,010,43",
+};
+
+static char burst[4096];
+static size_t burst_len;
+/* Sentences in the burst decoded by the streaming parser */
+#define BURST_DECODED  (RATE_HZ * 3 + 6)
+
+static void burst_add(const char *s)
+{
+	uint8_t sum = 0;
+
+	for (const char *c = s; *c; c++)
+		sum ^= *c;
+	burst_len += sprintf(burst + burst_len, "$%s*%02X\r\n", s, sum);
+	ASSERT(burst_len < sizeof(burst));
+}
+
+static int bench_count;
+
+static void bench_callout(nmeap_context_t *context, void *data, void *user_data)
+{
+	(void)context;
+	(void)data;
+	(void)user_data;
+	bench_count++;
+}
+
+static void bench_parser_callout(NmeaParser *p, int id, const void *data)
+{
+	(void)p;
+	(void)id;
+	(void)data;
+	bench_count++;
+}
+
+#define BENCH_LOOPS 50
+
+/*
+ * Parse \a buf BENCH_LOOPS times with both parsers, return the time of the
+ * streaming one relative to nmeap, in percent.
+ */
+static void bench(const char *name, const char *buf, size_t len, const char * const *names, int expected)
+{
+	static nmeap_context_t ctx;
+	static NmeaGga bgga;
+	static NmeaRmc brmc;
+	static NmeaVtg bvtg;
+	static NmeaGsv bgsv;
+	hptime_t start, t_nmeap, t_parser;
+	int n_nmeap, n_parser;
+
+	nmeap_init(&ctx, NULL);
+	nmeap_addParser(&ctx, names[0], nmea_gpgga, bench_callout, &bgga);
+	nmeap_addParser(&ctx, names[1], nmea_gprmc, bench_callout, &brmc);
+	nmeap_addParser(&ctx, names[2], nmea_gpvtg, bench_callout, &bvtg);
+	for (int i = 3; names[i]; i++)
+		nmeap_addParser(&ctx, names[i], nmea_gpgsv, bench_callout, &bgsv);
+
+	bench_count = 0;
+	start = hptime_get();
+	for (int i = 0; i < BENCH_LOOPS; i++)
+		for (size_t j = 0; j < len; j++)
+			nmeap_parse(&ctx, buf[j]);
+	t_nmeap = hptime_get() - start;
+	n_nmeap = bench_count;
+
+	nmea_parserInit(&parser, bench_parser_callout, NULL);
+	bench_count = 0;
+	start = hptime_get();
+	for (int i = 0; i < BENCH_LOOPS; i++)
+		nmea_parse(&parser, buf, len);
+	t_parser = hptime_get() - start;
+	n_parser = bench_count;
+
+	kprintf("%s, %d bytes: nmeap %ld ns/byte (%d sentences), streaming %ld ns/byte (%d sentences)\n",
+		name, (int)len,
+		(long)(t_nmeap * 1000 / (BENCH_LOOPS * len)), n_nmeap / BENCH_LOOPS,
+		(long)(t_parser * 1000 / (BENCH_LOOPS * len)), n_parser / BENCH_LOOPS);
+
+	/* The streaming parser recovers sentences cut by a '$' */
+	ASSERT(n_parser >= n_nmeap);
+	ASSERT(n_parser == BENCH_LOOPS * expected);
 }
 
 int nmea_testSetup(void)
@@ -1005,6 +1175,14 @@ int nmea_testSetup(void)
 	nmeap_addParser(&nmea, "GPGSV", nmea_gpgsv, gpgsv_callout_test, &gsv);
 	nmeap_addParser(&nmea, "GPVTG", nmea_gpvtg, gpvtg_callout_test, &vtg);
 
+	nmea_parserInit(&parser, parser_callout, NULL);
+
+	for (int i = 0; i < RATE_HZ; i++)
+		for (unsigned j = 0; j < countof(epoch_sentences); j++)
+			burst_add(epoch_sentences[j]);
+	for (unsigned j = 0; j < countof(second_sentences); j++)
+		burst_add(second_sentences[j]);
+
 	return 0;
 }
 
@@ -1026,6 +1204,33 @@ int nmea_testRun(void)
 		return -1;
 	}
 
+	/* The streaming parser must decode the same data */
+	nmea_parse(&parser, nmea_test, sizeof(nmea_test));
+	kprintf("streaming parser: %ld sentences, %ld errors\n",
+		(long)parser.sentences, (long)parser.errors);
+	if (tot_sentence_checked != TOT_GOOD_SENTENCE_NUM
+		|| tot_sentence_recovered != TOT_RECOVERED_SENTENCE_NUM)
+	{
+		LOG_ERR("Incorrect number of sentences from the streaming parser.\n");
+		return -1;
+	}
+
+	/* Multi constellation talkers */
+	tot_sentence_checked = 0;
+	nmea_parserInit(&parser, NULL, NULL);
+	nmea_parse(&parser, burst, burst_len);
+	ASSERT(parser.sentences == BURST_DECODED);
+	ASSERT(parser.errors == 0);
+	ASSERT(parser.talker[0] == 'G' && parser.talker[1] == 'A');
+
+	static const char * const gp_names[] = { "GPGGA", "GPRMC", "GPVTG", "GPGSV", NULL };
+	static const char * const gn_names[] = { "GNGGA", "GNRMC", "GNVTG", "GPGSV", "GLGSV", "GAGSV", NULL };
+
+	/* Timings are only reported: they depend on the host load */
+	bench("capture", (const char *)nmea_test, sizeof(nmea_test), gp_names,
+		TOT_GOOD_SENTENCE_NUM + TOT_RECOVERED_SENTENCE_NUM);
+	bench("10 Hz multi-constellation", burst, burst_len, gn_names, BURST_DECODED);
+
 
 	return  0;
 }
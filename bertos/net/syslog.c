@@ -49,6 +49,8 @@
 #include <lwip/tcpip.h>
 
 #include <stdarg.h>
+#include <cfg/macros.h> /* MIN */
+
 #include <stdio.h>
 
 static char syslog_message[CONFIG_SYSLOG_BUFSIZE];
@@ -91,6 +93,8 @@ int syslog_printf(const char *fmt, ...)
 	int len = vsnprintf(syslog_message, sizeof(syslog_message), fmt, ap);
 	va_end(ap);
 	syslog_message[sizeof(syslog_message) - 1] = 0;
+	/* Send only what fits in the buffer */
+	len = MIN(len, (int)sizeof(syslog_message) - 1);
 
 	#if CONFIG_SYSLOG_SERIAL
 		kputs(syslog_message);
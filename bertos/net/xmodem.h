@@ -36,7 +36,7 @@
  * \author Francesco Sacchi <batt@develer.com>
  *
  * $WIZ$ module_name = "xmodem"
- * $WIZ$ module_depends = "kfile", "crc16"
+ * $WIZ$ module_depends = "kfile", "crc16", "crc32"
  * $WIZ$ module_configuration = "bertos/cfg/cfg_xmodem.h"
  */
 
@@ -60,4 +60,11 @@
 bool xmodem_recv(KFile *ch, KFile *fd);
 bool xmodem_send(KFile *ch, KFile *fd);
 
+bool xmodem_streamRecv(KFile *ch, KFile *fd);
+bool xmodem_streamSend(KFile *ch, KFile *fd);
+
+int xmodem_stream_testSetup(void);
+int xmodem_stream_testRun(void);
+int xmodem_stream_testTearDown(void);
+
 #endif /* NET_XMODEM_H */
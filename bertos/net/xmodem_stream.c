@@ -0,0 +1,396 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Streaming, windowed transfer protocol over a KFile channel.
+ *
+ * Companion of the X-Modem implementation for links where the stop and
+ * wait turnaround dominates the transfer time. The sender streams blocks
+ * without waiting, up to CONFIG_XMODEM_STREAM_WINDOW blocks ahead of the
+ * last acknowledge; the receiver acknowledges cumulatively every half
+ * window and asks to go back to the first missing offset on errors.
+ *
+ * Every frame, in both directions, is:
+ * \verbatim
+ *  SYNC | type | offset (4, LE) | len (2, LE) | data (len) | CRC-32 (4, LE)
+ * \endverbatim
+ * where the CRC-32 covers type, offset, len and data.
+ *
+ * The receiver starts the transfer telling the offset it wants data from:
+ * the current position of its destination file. This allows to resume an
+ * interrupted transfer just by calling xmodem_streamRecv() again.
+ */
+
+#include "xmodem.h"
+
+#include "cfg/cfg_xmodem.h"
+
+#include <cfg/debug.h>
+// Define log settings for cfg/log.h
+#define LOG_LEVEL    CONFIG_XMODEM_LOG_LEVEL
+#define LOG_FORMAT   CONFIG_XMODEM_LOG_FORMAT
+#include <cfg/log.h>
+
+#include <algo/crc32.h>
+#include <cpu/byteorder.h>
+
+#include <string.h> /* memcpy() */
+
+/*
+ * Fallbacks for projects with an older cfg_xmodem.h.
+ */
+#ifndef CONFIG_XMODEM_STREAM
+	#define CONFIG_XMODEM_STREAM 0
+#endif
+#ifndef CONFIG_XMODEM_STREAM_BLOCK
+	#define CONFIG_XMODEM_STREAM_BLOCK 1024
+#endif
+#ifndef CONFIG_XMODEM_STREAM_WINDOW
+	#define CONFIG_XMODEM_STREAM_WINDOW 8
+#endif
+
+#if CONFIG_XMODEM_STREAM
+
+/**
+ * \name Frame types
+ * \{
+ */
+#define XS_SYNC   0xA5  /**< Start of frame */
+#define XS_DATA   'D'   /**< Data block at offset */
+#define XS_EOF    'E'   /**< End of file, offset is the file size */
+#define XS_START  'S'   /**< Start sending from offset */
+#define XS_ACK    'A'   /**< All data before offset received */
+#define XS_NAK    'N'   /**< Data at offset missing, go back */
+#define XS_CAN    'C'   /**< Transfer aborted */
+/*\}*/
+
+/* Type, offset and len */
+#define XS_HDR_LEN 7
+
+/* The receiver acknowledges every half window */
+#define XS_ACK_EVERY ((CONFIG_XMODEM_STREAM_WINDOW + 1) / 2)
+
+STATIC_ASSERT(CONFIG_XMODEM_STREAM_BLOCK <= 0xFFFF);
+STATIC_ASSERT(CONFIG_XMODEM_STREAM_WINDOW >= 1);
+
+typedef enum XsResult
+{
+	XS_OK,       ///< Good frame received.
+	XS_TIMEOUT,  ///< Nothing received before the channel timeout.
+	XS_BAD,      ///< Corrupted or truncated frame.
+} XsResult;
+
+static void xs_sendFrame(KFile *ch, uint8_t type, uint32_t offset, const void *buf, size_t len)
+{
+	uint8_t hdr[1 + XS_HDR_LEN];
+	uint32_t crc;
+
+	hdr[0] = XS_SYNC;
+	hdr[1] = type;
+	offset = cpu_to_le32(offset);
+	memcpy(&hdr[2], &offset, sizeof(offset));
+	hdr[6] = len & 0xFF;
+	hdr[7] = len >> 8;
+
+	crc = crc32(CRC32_INIT_VAL, &hdr[1], XS_HDR_LEN);
+	crc = cpu_to_le32(crc32(crc, buf, len));
+
+	kfile_write(ch, hdr, sizeof(hdr));
+	if (len)
+		kfile_write(ch, buf, len);
+	kfile_write(ch, &crc, sizeof(crc));
+}
+
+/*
+ * Wait for a frame; garbage before the sync byte is skipped.
+ * The data part is stored in \a buf, at most \a size bytes.
+ */
+static XsResult xs_recvFrame(KFile *ch, uint8_t *buf, size_t size,
+	uint8_t *type, uint32_t *offset, size_t *len)
+{
+	uint8_t hdr[XS_HDR_LEN];
+	uint32_t crc;
+	int c;
+
+	while ((c = kfile_getc(ch)) != XS_SYNC)
+		if (c == EOF)
+			return XS_TIMEOUT;
+
+	if (kfile_read(ch, hdr, sizeof(hdr)) != sizeof(hdr))
+		return XS_BAD;
+
+	*type = hdr[0];
+	memcpy(offset, &hdr[1], sizeof(*offset));
+	*offset = le32_to_cpu(*offset);
+	*len = hdr[5] | (hdr[6] << 8);
+
+	if (*len > size)
+		return XS_BAD;
+	if (kfile_read(ch, buf, *len) != *len)
+		return XS_BAD;
+	if (kfile_read(ch, &crc, sizeof(crc)) != sizeof(crc))
+		return XS_BAD;
+
+	if (le32_to_cpu(crc) != crc32(crc32(CRC32_INIT_VAL, hdr, sizeof(hdr)), buf, *len))
+		return XS_BAD;
+
+	return XS_OK;
+}
+
+
+#if CONFIG_XMODEM_RECV
+/**
+ * \brief Receive a file using the streaming protocol.
+ *
+ * Data is written in \a fd starting from its current position, which is
+ * also the offset asked to the sender: to resume a transfer, seek \a fd
+ * to the amount of data already received.
+ *
+ * \param ch Channel to use for transfer; its read timeout is the
+ *           protocol timeout.
+ * \param fd Destination file
+ *
+ * \return true if the whole file has been received.
+ *
+ * \note This function allocates CONFIG_XMODEM_STREAM_BLOCK bytes of stack.
+ */
+bool xmodem_streamRecv(KFile *ch, KFile *fd)
+{
+	uint8_t block_buffer[CONFIG_XMODEM_STREAM_BLOCK];
+	uint32_t expected = fd->seek_pos, offset;
+	int retries = 0, blocks = 0;
+	bool started = false, nak_sent = false;
+	uint8_t type;
+	size_t len;
+
+	LOG_INFO("Starting Transfer from %ld...\n", (long)expected);
+	kfile_clearerr(ch);
+	xs_sendFrame(ch, XS_START, expected, NULL, 0);
+
+	for(;;)
+	{
+		if (XMODEM_CHECK_ABORT)
+			goto abort;
+
+		switch (xs_recvFrame(ch, block_buffer, sizeof(block_buffer), &type, &offset, &len))
+		{
+		case XS_TIMEOUT:
+			kfile_clearerr(ch);
+			if (++retries >= CONFIG_XMODEM_MAXRETRIES)
+				goto abort;
+
+			LOG_INFO("Timeout, retries %d\n", retries);
+			xs_sendFrame(ch, started ? XS_NAK : XS_START, expected, NULL, 0);
+			continue;
+
+		case XS_BAD:
+			LOG_WARN("Bad frame\n");
+			kfile_clearerr(ch);
+			if (!nak_sent)
+			{
+				xs_sendFrame(ch, XS_NAK, expected, NULL, 0);
+				nak_sent = true;
+			}
+			continue;
+
+		case XS_OK:
+			break;
+		}
+
+		if (type == XS_CAN)
+		{
+			LOG_INFO("Transfer aborted\n");
+			return false;
+		}
+		started = true;
+
+		/* Frames after a missing one are discarded until the sender goes back */
+		if (offset != expected)
+		{
+			LOG_INFO("Out of sequence %ld/%ld\n", (long)offset, (long)expected);
+			if (!nak_sent)
+			{
+				xs_sendFrame(ch, XS_NAK, expected, NULL, 0);
+				nak_sent = true;
+			}
+			continue;
+		}
+
+		if (type == XS_EOF)
+		{
+			xs_sendFrame(ch, XS_ACK, expected, NULL, 0);
+			LOG_INFO("Transfer completed\n");
+			return true;
+		}
+
+		if (type != XS_DATA)
+			continue;
+
+		if (kfile_write(fd, block_buffer, len) != len)
+		{
+			/* User callback failed: abort transfer immediately */
+			goto abort;
+		}
+
+		expected += len;
+		retries = 0;
+		nak_sent = false;
+		if (++blocks % XS_ACK_EVERY == 0)
+			xs_sendFrame(ch, XS_ACK, expected, NULL, 0);
+	}
+
+abort:
+	xs_sendFrame(ch, XS_CAN, expected, NULL, 0);
+	LOG_INFO("Transfer aborted\n");
+	return false;
+}
+#endif
+
+
+#if CONFIG_XMODEM_SEND
+/**
+ * \brief Transmit a file using the streaming protocol.
+ *
+ * \a fd is read from the offset asked by the receiver up to its end, in
+ * blocks of CONFIG_XMODEM_STREAM_BLOCK bytes. \a fd must be seekable.
+ *
+ * \param ch Channel to use for transfer; its read timeout is the
+ *           protocol timeout.
+ * \param fd Source file
+ *
+ * \return true if the receiver acknowledged the whole file.
+ *
+ * \note This function allocates CONFIG_XMODEM_STREAM_BLOCK bytes of stack.
+ */
+bool xmodem_streamSend(KFile *ch, KFile *fd)
+{
+	uint8_t block_buffer[CONFIG_XMODEM_STREAM_BLOCK];
+	uint32_t sent = 0, acked = 0, offset;
+	int retries = 0;
+	bool started = false, eof_sent = false;
+	uint8_t type;
+	size_t len;
+
+	kfile_clearerr(ch);
+	LOG_INFO("Wait remote host\n");
+
+	for(;;)
+	{
+		if (XMODEM_CHECK_ABORT)
+		{
+			xs_sendFrame(ch, XS_CAN, sent, NULL, 0);
+			return false;
+		}
+
+		/* Stream while the window allows */
+		if (started && !eof_sent
+			&& sent - acked < CONFIG_XMODEM_STREAM_WINDOW * CONFIG_XMODEM_STREAM_BLOCK)
+		{
+			len = kfile_read(fd, block_buffer, sizeof(block_buffer));
+			if (len)
+			{
+				xs_sendFrame(ch, XS_DATA, sent, block_buffer, len);
+				sent += len;
+			}
+			else
+			{
+				xs_sendFrame(ch, XS_EOF, sent, NULL, 0);
+				eof_sent = true;
+			}
+			continue;
+		}
+
+		/* Window full or whole file sent: wait for the receiver */
+		if (xs_recvFrame(ch, NULL, 0, &type, &offset, &len) != XS_OK)
+		{
+			kfile_clearerr(ch);
+			if (++retries > CONFIG_XMODEM_MAXRETRIES)
+			{
+				LOG_INFO("Transfer aborted\n");
+				return false;
+			}
+
+			/* Acknowledges lost: send again what is pending */
+			LOG_INFO("Retries %d\n", retries);
+			type = XS_NAK;
+			offset = acked;
+			if (!started)
+				continue;
+		}
+
+		switch (type)
+		{
+		case XS_ACK:
+			if (offset > acked && offset <= sent)
+			{
+				acked = offset;
+				retries = 0;
+			}
+			if (eof_sent && acked == sent)
+			{
+				LOG_INFO("Transfer completed\n");
+				return true;
+			}
+			break;
+
+		case XS_START:
+			LOG_INFO("Tx start from %ld\n", (long)offset);
+			started = true;
+			acked = sent = offset;
+			/* fallthrough */
+		case XS_NAK:
+			/* Go back to the first offset missing at the receiver */
+			if (offset < acked || offset > sent)
+				break;
+
+			if (kfile_seek(fd, offset, KSM_SEEK_SET) != (kfile_off_t)offset)
+			{
+				xs_sendFrame(ch, XS_CAN, offset, NULL, 0);
+				LOG_ERR("Seek to %ld failed\n", (long)offset);
+				return false;
+			}
+			LOG_INFO("Resend from %ld\n", (long)offset);
+			acked = sent = offset;
+			eof_sent = false;
+			break;
+
+		case XS_CAN:
+			LOG_INFO("Transfer aborted\n");
+			return false;
+
+		default:
+			break;
+		}
+	}
+}
+#endif
+
+#endif /* CONFIG_XMODEM_STREAM */
@@ -0,0 +1,264 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief Streaming transfer test, against X-Modem.
+ *
+ * Both protocols transfer an image between two processes over an
+ * emulated serial link with a given bandwidth, latency and byte error
+ * rate; the throughput of each run is reported.
+ *
+ * $test$: cp bertos/cfg/cfg_proc.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_KERN" >> $cfgdir/cfg_proc.h
+ * $test$: echo "#define CONFIG_KERN 1" >> $cfgdir/cfg_proc.h
+ */
+
+#include "xmodem.h"
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+
+#include <cpu/power.h>
+
+#include <drv/timer.h>
+
+#include <kern/proc.h>
+
+#include <os/hptime.h>
+
+#include <struct/kfile_mem.h>
+
+#include <string.h>
+
+/* Emulated link: 100 kB/s, timeout of the reads as seen by the protocols */
+#define LINK_BYTE_US    10
+#define LINK_TIMEOUT_MS 100
+#define LINK_BUFLEN     16384
+
+#define IMAGE_SIZE 32768
+
+/* One direction of the link */
+typedef struct LinkDir
+{
+	uint8_t buf[LINK_BUFLEN];
+	hptime_t due[LINK_BUFLEN]; ///< Arrival time of each byte
+	size_t head, tail;
+	hptime_t busy;             ///< Time the line becomes free
+} LinkDir;
+
+/* Link endpoint */
+typedef struct LinkPort
+{
+	KFile fd;
+	LinkDir *rx;
+	LinkDir *tx;
+	int err;
+} LinkPort;
+
+static LinkDir link_ab, link_ba;
+static LinkPort port_a, port_b;
+static hptime_t link_latency;
+static uint32_t link_errors;  ///< One byte in link_errors is corrupted, 0 for none
+static uint32_t link_rand;
+static unsigned long link_corrupted;
+
+static uint8_t image[IMAGE_SIZE];
+static uint8_t received[IMAGE_SIZE];
+static KFileMem src, dst;
+
+static PROC_DEFINE_STACK(sender_stack, KERN_MINSTACKSIZE * 2);
+static bool (*sender_fn)(KFile *ch, KFile *fd);
+static volatile bool sender_done;
+static bool sender_ok;
+
+static size_t link_read(KFile *fd, void *_buf, size_t size)
+{
+	LinkPort *port = (LinkPort *)fd;
+	LinkDir *dir = port->rx;
+	uint8_t *buf = (uint8_t *)_buf;
+	size_t i;
+
+	for (i = 0; i < size; i++)
+	{
+		hptime_t start = hptime_get();
+
+		while (dir->head == dir->tail || dir->due[dir->head] > hptime_get())
+		{
+			if (hptime_get() - start > LINK_TIMEOUT_MS * 1000)
+			{
+				port->err = 1;
+				return i;
+			}
+			cpu_relax();
+		}
+		buf[i] = dir->buf[dir->head];
+		dir->head = (dir->head + 1) % LINK_BUFLEN;
+	}
+	return i;
+}
+
+static size_t link_write(KFile *fd, const void *_buf, size_t size)
+{
+	LinkPort *port = (LinkPort *)fd;
+	LinkDir *dir = port->tx;
+	const uint8_t *buf = (const uint8_t *)_buf;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		hptime_t now;
+		uint8_t c = buf[i];
+
+		while ((dir->tail + 1) % LINK_BUFLEN == dir->head)
+			cpu_relax();
+
+		if (link_errors)
+		{
+			link_rand = link_rand * 1103515245 + 12345;
+			if ((link_rand >> 8) % link_errors == 0)
+			{
+				c ^= 0x10;
+				link_corrupted++;
+			}
+		}
+
+		/* Bytes leave one after the other, and arrive after the latency */
+		now = hptime_get();
+		dir->busy = MAX(dir->busy, now) + LINK_BYTE_US;
+		dir->due[dir->tail] = dir->busy + link_latency;
+		dir->buf[dir->tail] = c;
+		dir->tail = (dir->tail + 1) % LINK_BUFLEN;
+	}
+	return size;
+}
+
+static int link_error(KFile *fd)
+{
+	return ((LinkPort *)fd)->err;
+}
+
+static void link_clearerr(KFile *fd)
+{
+	((LinkPort *)fd)->err = 0;
+}
+
+static void link_portInit(LinkPort *port, LinkDir *rx, LinkDir *tx)
+{
+	memset(port, 0, sizeof(*port));
+	port->rx = rx;
+	port->tx = tx;
+	port->fd.read = link_read;
+	port->fd.write = link_write;
+	port->fd.error = link_error;
+	port->fd.clearerr = link_clearerr;
+}
+
+static void sender(void)
+{
+	sender_ok = sender_fn(&port_a.fd, &src.fd);
+	sender_done = true;
+}
+
+/*
+ * Transfer the image from port a to port b, the receiver resumes at
+ * \a resume; return the throughput in bytes/s.
+ */
+static unsigned long run(const char *name, bool (*send)(KFile *, KFile *),
+	bool (*recv)(KFile *, KFile *), mtime_t latency, uint32_t errors, size_t resume)
+{
+	hptime_t start, elapsed;
+	unsigned long rate;
+	bool ok;
+
+	memset(&link_ab, 0, sizeof(link_ab));
+	memset(&link_ba, 0, sizeof(link_ba));
+	link_portInit(&port_a, &link_ba, &link_ab);
+	link_portInit(&port_b, &link_ab, &link_ba);
+	link_latency = latency * 1000;
+	link_errors = errors;
+	link_rand = 1;
+	link_corrupted = 0;
+
+	kfilemem_init(&src, image, sizeof(image));
+	memset(received, 0, sizeof(received));
+	memcpy(received, image, resume);
+	kfilemem_init(&dst, received, sizeof(received));
+	kfile_seek(&dst.fd, resume, KSM_SEEK_SET);
+
+	sender_fn = send;
+	sender_done = false;
+	start = hptime_get();
+	proc_new(sender, NULL, sizeof(sender_stack), sender_stack);
+	ok = recv(&port_b.fd, &dst.fd);
+	while (!sender_done)
+		cpu_relax();
+	elapsed = hptime_get() - start;
+
+	ASSERT(ok);
+	ASSERT(memcmp(image, received, sizeof(image)) == 0);
+
+	rate = (unsigned long)((uint64_t)(sizeof(image) - resume) * 1000000 / elapsed);
+	kprintf("%-28s latency %3ld ms, %3lu bytes corrupted: %6lu bytes/s\n",
+		name, (long)latency, link_corrupted, rate);
+	return rate;
+}
+
+int xmodem_stream_testSetup(void)
+{
+	kdbg_init();
+	timer_init();
+	proc_init();
+
+	for (size_t i = 0; i < sizeof(image); i++)
+		image[i] = i * 7 + (i >> 8);
+	return 0;
+}
+
+int xmodem_stream_testRun(void)
+{
+	unsigned long xm, xs;
+
+	xm = run("xmodem", xmodem_send, xmodem_recv, 20, 0, 0);
+	xs = run("stream", xmodem_streamSend, xmodem_streamRecv, 20, 0, 0);
+	ASSERT(xs > xm * 2);
+
+	run("xmodem, errors", xmodem_send, xmodem_recv, 20, 5000, 0);
+	run("stream, errors", xmodem_streamSend, xmodem_streamRecv, 20, 5000, 0);
+	run("stream, no latency", xmodem_streamSend, xmodem_streamRecv, 0, 0, 0);
+	run("stream, resume at 10000", xmodem_streamSend, xmodem_streamRecv, 20, 0, 10000);
+	return 0;
+}
+
+int xmodem_stream_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(xmodem_stream);
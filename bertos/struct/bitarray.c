@@ -37,7 +37,14 @@
 
 #include "bitarray.h"
 
-#include <string.h>
+/*
+ * Range operations work a 32 bit word at a time: bit n of the array is
+ * bit n % 32 of word n / 32, words are stored little endian.
+ * The last word may be shorter than 4 bytes: only the bytes inside the
+ * array are ever accessed.
+ */
+#define WORD_BITS  32
+#define WORD_ONES  0xFFFFFFFFUL
 
 // De Bruijn constant coefficents.
 static const uint8_t DeBruijn_coefficents[32] =
@@ -46,6 +53,170 @@ static const uint8_t DeBruijn_coefficents[32] =
   31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
 };
 
+/* Position of the first bit set in a non zero word */
+INLINE int word_firstSet(uint32_t data)
+{
+	return DeBruijn_coefficents[((uint32_t)((data & -data) * 0x077CB531U)) >> 27];
+}
+
+INLINE int word_count(uint32_t data)
+{
+	data = data - ((data >> 1) & 0x55555555UL);
+	data = (data & 0x33333333UL) + ((data >> 2) & 0x33333333UL);
+	data = (data + (data >> 4)) & 0x0F0F0F0FUL;
+	return (uint32_t)(data * 0x01010101UL) >> 24;
+}
+
+static uint32_t word_load(const BitArray *bitx, size_t w)
+{
+	const uint8_t *b = bitx->array + w * 4;
+	size_t len = bitx->size - w * 4;
+	uint32_t data = 0;
+
+	/* The compiler turns this into a single load where it can */
+	if (len >= 4)
+		return b[0] | (b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+
+	while (len--)
+		data = (data << 8) | b[len];
+	return data;
+}
+
+static void word_store(BitArray *bitx, size_t w, uint32_t data)
+{
+	uint8_t *b = bitx->array + w * 4;
+	size_t len = MIN(bitx->size - w * 4, (size_t)4);
+
+	for (size_t i = 0; i < len; i++, data >>= 8)
+		b[i] = data;
+}
+
+/* Mask of the bits of word \a w inside [start, end) */
+INLINE uint32_t word_mask(size_t w, size_t start, size_t end)
+{
+	size_t first = w * WORD_BITS;
+	uint32_t mask = WORD_ONES;
+
+	if (start > first)
+		mask <<= start - first;
+	if (end < first + WORD_BITS)
+		mask &= WORD_ONES >> (first + WORD_BITS - end);
+	return mask;
+}
+
+/*
+ * Return the first bit in [start, end) equal to \a value, \a end if none.
+ */
+static size_t bitarray_scan(const BitArray *bitx, size_t start, size_t end, bool value)
+{
+	uint32_t invert = value ? 0 : WORD_ONES;
+
+	for (size_t w = start / WORD_BITS; w * WORD_BITS < end; w++)
+	{
+		uint32_t data = (word_load(bitx, w) ^ invert) & word_mask(w, start, end);
+
+		if (data)
+			return w * WORD_BITS + word_firstSet(data);
+	}
+	return end;
+}
+
+static void bitarray_fill(BitArray *bitx, size_t start, size_t end, bool value)
+{
+	for (size_t w = start / WORD_BITS; w * WORD_BITS < end; w++)
+	{
+		uint32_t mask = word_mask(w, start, end);
+		uint32_t data = 0;
+
+		/* Whole words are just overwritten */
+		if (mask != WORD_ONES)
+			data = word_load(bitx, w) & ~mask;
+		word_store(bitx, w, value ? data | mask : data);
+	}
+}
+
+#define RANGE_ASSERT(bitx, idx, offset) \
+	ASSERT((idx) >= 0 && (offset) >= 0 && (size_t)((idx) + (offset)) <= (bitx)->size * 8)
+
+/**
+ * Set a range of bits.
+ *
+ * The range starts from \a idx (inclusive) and spans \a offset bits.
+ *
+ * \param bitx BitArray context
+ * \param idx Starting bit
+ * \param offset Number of bit to set
+ */
+void bitarray_setRange(BitArray *bitx, int idx, int offset)
+{
+	RANGE_ASSERT(bitx, idx, offset);
+	bitarray_fill(bitx, idx, idx + offset, true);
+}
+
+/**
+ * Clear a range of bits.
+ *
+ * The range starts from \a idx (inclusive) and spans \a offset bits.
+ *
+ * \param bitx BitArray context
+ * \param idx Starting bit
+ * \param offset Number of bits to clear
+ */
+void bitarray_clearRange(BitArray *bitx, int idx, int offset)
+{
+	RANGE_ASSERT(bitx, idx, offset);
+	bitarray_fill(bitx, idx, idx + offset, false);
+}
+
+/**
+ * Test if a range of bit is full.
+ *
+ * \param bitx BitArray context
+ * \param idx Starting bit
+ * \param offset Number of bits to test
+ * \return True if range is full, false otherwise
+ */
+bool bitarray_isRangeFull(BitArray *bitx, int idx, int offset)
+{
+	RANGE_ASSERT(bitx, idx, offset);
+	return bitarray_scan(bitx, idx, idx + offset, false) == (size_t)(idx + offset);
+}
+
+/**
+ * Test if a range of bit is empty.
+ *
+ * \param bitx BitArray context
+ * \param idx Starting bit
+ * \param offset Number of bits to test
+ * \return True if range is empty, false otherwise
+ */
+bool bitarray_isRangeEmpty(BitArray *bitx, int idx, int offset)
+{
+	RANGE_ASSERT(bitx, idx, offset);
+	return bitarray_scan(bitx, idx, idx + offset, true) == (size_t)(idx + offset);
+}
+
+/**
+ * Count the bits set in a range.
+ *
+ * \param bitx BitArray context
+ * \param idx Starting bit
+ * \param offset Number of bits to test
+ * \return Number of bits set
+ */
+int bitarray_countRange(BitArray *bitx, int idx, int offset)
+{
+	size_t start = idx, end = idx + offset;
+	int count = 0;
+
+	RANGE_ASSERT(bitx, idx, offset);
+
+	for (size_t w = start / WORD_BITS; w * WORD_BITS < end; w++)
+		count += word_count(word_load(bitx, w) & word_mask(w, start, end));
+
+	return count;
+}
+
 /**
  * Return the position of the first bit non zero in bitarray
  *
@@ -56,22 +227,92 @@ int bitarray_firstSetBit(BitArray *bitx)
 {
 	ASSERT(bitx);
 
-	uint8_t *b = bitx->array;
-	size_t bytes = bitx->size;
-	int curr = 0;
+	size_t pos = bitarray_scan(bitx, 0, bitx->size * 8, true);
+
+	return (pos < bitx->size * 8) ? (int)pos : -1;
+}
+
+/**
+ * Return the position of the first bit clear in bitarray
+ *
+ * Only \a bitarray_len bits are searched.
+ *
+ * \param bitx BitArray context
+ * \return Position of the first bit clear, -1 if the bitarray is full
+ */
+int bitarray_firstClearBit(BitArray *bitx)
+{
+	ASSERT(bitx);
+
+	size_t pos = bitarray_scan(bitx, 0, bitx->bitarray_len, false);
+
+	return (pos < bitx->bitarray_len) ? (int)pos : -1;
+}
+
+/**
+ * Find the first run of \a len clear bits.
+ *
+ * This is the allocation primitive when the bitarray is used as a free
+ * block map: the returned range can be marked as used with
+ * bitarray_setRange().
+ * Only \a bitarray_len bits are searched.
+ *
+ * \param bitx BitArray context
+ * \param len Number of consecutive clear bits requested
+ * \return Position of the first bit of the run, -1 if there is none
+ */
+int bitarray_findClearRange(BitArray *bitx, int len)
+{
+	size_t end = bitx->bitarray_len;
+	size_t run = 0, run_start = 0;
+
+	ASSERT(len > 0);
 
-	while (bytes)
+	for (size_t w = 0; w * WORD_BITS < end; w++)
 	{
-		uint32_t data = 0;
-		size_t len = MIN(bytes, (size_t)4);
-		memcpy(&data, b, len);
+		/* Bits past the end count as used */
+		uint32_t free = ~word_load(bitx, w) & word_mask(w, 0, end);
+		uint32_t used = ~free;
 
-		if (data)
-			return (DeBruijn_coefficents[((uint32_t)((data & -data) * 0x077CB531U)) >> 27] + curr);
+		if (!run)
+			run_start = w * WORD_BITS;
+
+		if (free == WORD_ONES)
+		{
+			run += WORD_BITS;
+			if (run >= (size_t)len)
+				return run_start;
+			continue;
+		}
+
+		/* Run coming from the previous words */
+		if (run + word_firstSet(used) >= (size_t)len)
+			return run_start;
+
+		/* Runs inside the word: bit i is left set if bits i..i+len-1 are free */
+		if (len < WORD_BITS)
+		{
+			uint32_t data = free;
+
+			for (int l = 1; l < len; )
+			{
+				int shift = MIN(l, len - l);
+
+				data &= data >> shift;
+				l += shift;
+			}
+			if (data)
+				return w * WORD_BITS + word_firstSet(data);
+		}
 
-		bytes -= 4;
-		curr += 32;
-		b += len;
+		/* Free bits at the top of the word start a new run */
+		used |= used >> 1;
+		used |= used >> 2;
+		used |= used >> 4;
+		used |= used >> 8;
+		used |= used >> 16;
+		run = WORD_BITS - word_count(used);
+		run_start = (w + 1) * WORD_BITS - run;
 	}
 
 	return -1;
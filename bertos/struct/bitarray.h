@@ -90,39 +90,8 @@ INLINE void bitarray_clear(BitArray *bitx, int idx)
 	bitx->array[page] &= ~BV(bit);
 }
 
-/**
- * Set a range of bits.
- *
- * The range starts from \a idx (inclusive) and spans \a offset bits.
- *
- * \param bitx BitArray context
- * \param idx Starting bit
- * \param offset Number of bit to set
- */
-INLINE void bitarray_setRange(BitArray *bitx, int idx, int offset)
-{
-	ASSERT((size_t)idx <= bitx->bitarray_len);
-
-	for (int i = idx; i < offset + idx; i++)
-		bitarray_set(bitx, i);
-}
-
-/**
- * Clear a range of bits.
- *
- * The range starts from \a idx (inclusive) and spans \a offset bits.
- *
- * \param bitx BitArray context
- * \param idx Starting bit
- * \param offset Number of bits to clear
- */
-INLINE void bitarray_clearRange(BitArray *bitx, int idx, int offset)
-{
-	ASSERT((size_t)idx <= bitx->bitarray_len);
-
-	for (int i = idx; i < offset + idx; i++)
-		bitarray_clear(bitx, i);
-}
+void bitarray_setRange(BitArray *bitx, int idx, int offset);
+void bitarray_clearRange(BitArray *bitx, int idx, int offset);
 
 /**
  * Test a bit.
@@ -140,6 +109,10 @@ INLINE bool bitarray_test(BitArray *bitx, int idx)
 	return (bitx->array[page] & BV(bit));
 }
 
+bool bitarray_isRangeFull(BitArray *bitx, int idx, int offset);
+bool bitarray_isRangeEmpty(BitArray *bitx, int idx, int offset);
+int bitarray_countRange(BitArray *bitx, int idx, int offset);
+
 /**
  * Check if the bitarray is full
  *
@@ -150,62 +123,20 @@ INLINE bool bitarray_test(BitArray *bitx, int idx)
  */
 INLINE bool bitarray_isFull(BitArray *bitx)
 {
-	// test full bytes except the last one
-	for (size_t page = 0; page <= bitx->size - 2; page++)
-	{
-		if (!(bitx->array[page] == 0xff))
-			return 0;
-	}
-	// test the last byte using the correct bitmask
-	uint8_t mask = BV(bitx->bitarray_len >> 3) - 1;
-	if (!(bitx->array[bitx->size - 1] & mask))
-		return 0;
-
-	return 1;
+	return bitarray_isRangeFull(bitx, 0, bitx->bitarray_len);
 }
 
-/*
- * Ugly!.. reformat it.
- */
 /**
- * Test if a range of bit is full.
+ * Count the bits set in the bitarray.
  *
- * \param bitx BitArray context
- * \param idx Starting bit
- * \param offset Number of bits to test
- * \return True if range is full, false otherwise
- */
-INLINE bool bitarray_isRangeFull(BitArray *bitx, int idx, int offset)
-{
-	ASSERT((size_t)(idx + offset) <= bitx->bitarray_len);
-
-	for (int i = idx; i <= idx + offset; i++)
-		if (!bitarray_test(bitx, i))
-			return 0;
-
-	return 1;
-}
-
-/*
- * Ugly!.. reformat it.
- */
-/**
- * Test if a range of bit is empty.
+ * Only \a bitarray_len bits are counted.
  *
  * \param bitx BitArray context
- * \param idx Starting bit
- * \param offset Number of bits to test
- * \return True if range is empty, false otherwise
+ * \return Number of bits set
  */
-INLINE bool bitarray_isRangeEmpty(BitArray *bitx, int idx, int offset)
+INLINE int bitarray_count(BitArray *bitx)
 {
-	ASSERT((size_t)(idx + offset) <= bitx->bitarray_len);
-
-	for (int i = idx; i <= idx + offset; i++)
-		if (bitarray_test(bitx, i))
-			return 0;
-
-	return 1;
+	return bitarray_countRange(bitx, 0, bitx->bitarray_len);
 }
 
 /**
@@ -239,6 +170,8 @@ INLINE void bitarray_dump(BitArray *bitx)
 }
 
 int bitarray_firstSetBit(BitArray *bitx);
+int bitarray_firstClearBit(BitArray *bitx);
+int bitarray_findClearRange(BitArray *bitx, int len);
 
 /**
  * Init a BitArray.
@@ -32,6 +32,10 @@
  *
  * \brief Bitarray test
  *
+ * The word at a time range operations are checked on random ranges
+ * against their bit by bit equivalent, and both are benchmarked on a large
+ * free block map.
+ *
  * \author Daniele Basile <asterix@develer.com>
  */
 
@@ -41,6 +45,8 @@
 #include <cfg/test.h>
 #include <cfg/debug.h>
 
+#include <os/hptime.h>
+
 #include <string.h>
 
 #define TEST1_LEN   31
@@ -61,6 +67,161 @@ BitArray bitx3;
 BitArray bitx4;
 BitArray bitx5;
 
+/* Odd sizes, so that the last word is not complete */
+#define RAND_LEN    1001
+#define BENCH_LEN   65536
+
+BITARRAY_ALLOC(rand_mem, RAND_LEN);
+BITARRAY_ALLOC(ref_mem, RAND_LEN);
+BITARRAY_ALLOC(bench_mem, BENCH_LEN);
+
+static BitArray rand_bitx;
+static BitArray ref_bitx;
+static BitArray bench_bitx;
+
+static uint32_t seed = 1;
+
+static int rand_int(int max)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 8) % max;
+}
+
+/* Bit by bit reference implementations */
+static void ref_fill(BitArray *bitx, int idx, int offset, bool value)
+{
+	for (int i = idx; i < idx + offset; i++)
+	{
+		if (value)
+			bitarray_set(bitx, i);
+		else
+			bitarray_clear(bitx, i);
+	}
+}
+
+static int ref_count(BitArray *bitx, int idx, int offset)
+{
+	int count = 0;
+
+	for (int i = idx; i < idx + offset; i++)
+		count += bitarray_test(bitx, i);
+	return count;
+}
+
+static int ref_first(BitArray *bitx, int end, bool value)
+{
+	for (int i = 0; i < end; i++)
+		if (bitarray_test(bitx, i) == value)
+			return i;
+	return -1;
+}
+
+static int ref_findClearRange(BitArray *bitx, int len)
+{
+	int run = 0;
+
+	for (int i = 0; i < (int)bitx->bitarray_len; i++)
+	{
+		run = bitarray_test(bitx, i) ? 0 : run + 1;
+		if (run == len)
+			return i - len + 1;
+	}
+	return -1;
+}
+
+static int randomTest(void)
+{
+	for (int n = 0; n < 20000; n++)
+	{
+		int idx = rand_int(RAND_LEN);
+		int offset = rand_int(RAND_LEN - idx + 1);
+		int len = rand_int(64) + 1;
+
+		switch (rand_int(4))
+		{
+		case 0:
+			bitarray_setRange(&rand_bitx, idx, offset);
+			ref_fill(&ref_bitx, idx, offset, true);
+			break;
+		case 1:
+			bitarray_clearRange(&rand_bitx, idx, offset);
+			ref_fill(&ref_bitx, idx, offset, false);
+			break;
+		default:
+			/* Short ranges, to get fragmented maps */
+			offset = MIN(offset, len);
+			if (rand_int(2))
+			{
+				bitarray_setRange(&rand_bitx, idx, offset);
+				ref_fill(&ref_bitx, idx, offset, true);
+			}
+			else
+			{
+				bitarray_clearRange(&rand_bitx, idx, offset);
+				ref_fill(&ref_bitx, idx, offset, false);
+			}
+			break;
+		}
+
+		if (memcmp(rand_mem, ref_mem, sizeof(rand_mem)) != 0)
+			return -1;
+
+		idx = rand_int(RAND_LEN);
+		offset = rand_int(RAND_LEN - idx + 1);
+		if (bitarray_countRange(&rand_bitx, idx, offset) != ref_count(&ref_bitx, idx, offset)
+			|| bitarray_isRangeFull(&rand_bitx, idx, offset) != (ref_count(&ref_bitx, idx, offset) == offset)
+			|| bitarray_isRangeEmpty(&rand_bitx, idx, offset) != (ref_count(&ref_bitx, idx, offset) == 0)
+			|| bitarray_firstSetBit(&rand_bitx) != ref_first(&ref_bitx, RAND_LEN, true)
+			|| bitarray_firstClearBit(&rand_bitx) != ref_first(&ref_bitx, RAND_LEN, false)
+			|| bitarray_findClearRange(&rand_bitx, len) != ref_findClearRange(&ref_bitx, len)
+			|| bitarray_isFull(&rand_bitx) != (ref_count(&ref_bitx, 0, RAND_LEN) == RAND_LEN)
+			|| bitarray_count(&rand_bitx) != ref_count(&ref_bitx, 0, RAND_LEN))
+		{
+			kprintf("Mismatch at range %d+%d, run %d\n", idx, offset, len);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+#define BENCH(name, ref, word) \
+	do { \
+		hptime_t start = hptime_get(); \
+		ref; \
+		hptime_t t_ref = hptime_get() - start; \
+		start = hptime_get(); \
+		word; \
+		kprintf("%-24s bit by bit %6ld us, word %5ld us\n", name, \
+			(long)t_ref, (long)(hptime_get() - start)); \
+	} while (0)
+
+/*
+ * Free block map of BENCH_LEN blocks, allocating runs of 8 blocks in a
+ * map with a free block every 4.
+ */
+static void bench(void)
+{
+	int r1 = 0, r2 = 0;
+
+	BENCH("setRange", ref_fill(&bench_bitx, 0, BENCH_LEN, true),
+		bitarray_setRange(&bench_bitx, 0, BENCH_LEN));
+	BENCH("clearRange", ref_fill(&bench_bitx, 1, BENCH_LEN - 2, false),
+		bitarray_clearRange(&bench_bitx, 1, BENCH_LEN - 2));
+	BENCH("isRangeEmpty", r1 = (ref_count(&bench_bitx, 1, BENCH_LEN - 2) == 0),
+		r2 = bitarray_isRangeEmpty(&bench_bitx, 1, BENCH_LEN - 2));
+	ASSERT(r1 && r2);
+	BENCH("countRange", r1 = ref_count(&bench_bitx, 0, BENCH_LEN),
+		r2 = bitarray_countRange(&bench_bitx, 0, BENCH_LEN));
+	ASSERT(r1 == 2 && r2 == 2);
+
+	for (int i = 0; i < BENCH_LEN; i += 4)
+		bitarray_setRange(&bench_bitx, i, 3);
+	bitarray_clearRange(&bench_bitx, BENCH_LEN - 8, 8);
+	BENCH("findClearRange", r1 = ref_findClearRange(&bench_bitx, 8),
+		r2 = bitarray_findClearRange(&bench_bitx, 8));
+	ASSERT(r1 == BENCH_LEN - 9 && r2 == r1);
+}
+
 int bitarray_testSetup(void)
 {
 	kdbg_init();
@@ -69,6 +230,9 @@ int bitarray_testSetup(void)
 	bitarray_init(&bitx3, TEST3_LEN, test3, sizeof(test3));
 	bitarray_init(&bitx4, TEST4_LEN, test4, sizeof(test4));
 	bitarray_init(&bitx5, TEST5_LEN, test5, sizeof(test5));
+	bitarray_init(&rand_bitx, RAND_LEN, rand_mem, sizeof(rand_mem));
+	bitarray_init(&ref_bitx, RAND_LEN, ref_mem, sizeof(ref_mem));
+	bitarray_init(&bench_bitx, BENCH_LEN, bench_mem, sizeof(bench_mem));
 	return 0;
 }
 
@@ -163,6 +327,11 @@ int bitarray_testRun(void)
 	if (pos != 5)
 		goto error;
 
+	kprintf("Test 7\n");
+	if (randomTest() < 0)
+		goto error;
+
+	bench();
 	return 0;
 
 error:
@@ -48,14 +48,23 @@
  * \li The hash table is created as power of two to remove the divisions from the code.
  * Of course, hash functions work at their best when the table size is a prime number.
  * When calculating the modulus to convert the hash value to an index, the actual operation
- * becomes a bitwise AND: this is fast, but truncates the value losing bits. Thus, the higher
- * bits are first "merged" with the lower bits through some XOR operations (see the last line of
- * \c calc_hash()).
+ * becomes a bitwise AND: this is fast, but truncates the value losing bits. Thus, the
+ * hash function must mix every input bit into the lower bits: we use Bob Jenkins'
+ * one-at-a-time hash, which needs only shifts and additions (see \c calc_hash()).
  *
  * \li To minimize the memory occupation, there is no flag to set for the empty node. An
  * empty node is recognized by its data pointer set to NULL. It is then invalid to store
  * NULL as data pointer in the table.
  *
+ * \li Removed nodes are marked with a special pointer (\c HT_DELETED) instead of being
+ * emptied: the lookups must keep probing past them, since the removed element could
+ * have been in the middle of the probe sequence of other keys. Insertions reuse the
+ * first deleted node found along the probe sequence.
+ *
+ * \li The top byte of the hash of each node is stored in a separate array: a node is
+ * compared with the key (which requires the hook and a memcmp()) only when its
+ * fingerprint matches, that is for 1 in 256 of the colliding nodes.
+ *
  * \li The visiting interface through iterators is implemented with pass-by-value semantic.
  * While this is overkill for medium-to-stupid compilers, it is the best designed from an
  * user point of view. Moreover, being totally inlined (defined completely in the header),
@@ -88,12 +97,22 @@
 #include <cfg/compiler.h>
 #include <cfg/macros.h> //ROTL(), ROTR();
 
+#if CONFIG_HT_GROW
+	#include <struct/heap.h>
+#endif
+
 #include <string.h>
 
 
 typedef const void** HashNodePtr;
 #define NODE_EMPTY(node)               (!*(node))
+#define NODE_DELETED(node)             (*(node) == HT_DELETED)
 #define HT_HAS_INTERNAL_KEY(ht)        (CONFIG_HT_OPTIONAL_INTERNAL_KEY && ht->flags.key_internal)
+#define HT_SIZE(ht)                    ((size_t)1 << (ht)->max_elts_log2)
+/// Fingerprint of a hash: its top bits, the ones least used by the index
+#define HASH_FP(hash)                  ((uint8_t)((hash) >> 24))
+
+const char ht_deleted_node = 0;
 
 /** For hash tables with internal keys, compute the pointer to the internal key for a given \a node. */
 INLINE uint8_t *key_internal_get_ptr(struct HashTable *ht, HashNodePtr node)
@@ -103,7 +122,7 @@ INLINE uint8_t *key_internal_get_ptr(struct HashTable *ht, HashNodePtr node)
 
 	// Compute the index of the node and use it to move within the whole key buffer
 	index = node - &ht->mem[0];
-	ASSERT(index < (size_t)(1 << ht->max_elts_log2));
+	ASSERT(index < HT_SIZE(ht));
 	key_buf += index * (INTERNAL_KEY_MAX_LENGTH + 1);
 
 	return key_buf;
@@ -136,89 +155,116 @@ INLINE bool node_key_match(struct HashTable* ht, HashNodePtr node, const void* k
 }
 
 
-static uint16_t calc_hash(const void* _key, uint8_t key_length)
+static uint32_t calc_hash(const void* _key, uint8_t key_length)
 {
-	const char* key = (const char*)_key;
-	uint16_t hash = key_length;
+	const uint8_t* key = (const uint8_t*)_key;
+	uint32_t hash = key_length;
 	int i;
 	int len = (int)key_length;
 
 	for (i = 0; i < len; ++i)
-		hash = ROTL(hash, 4) ^ key[i];
+	{
+		hash += key[i];
+		hash += hash << 10;
+		hash ^= hash >> 6;
+	}
 
-	return hash ^ (hash >> 6) ^ (hash >> 13);
+	hash += hash << 3;
+	hash ^= hash >> 11;
+	hash += hash << 15;
+	return hash;
 }
 
 
+/*
+ * Look for \a key, whose hash is \a hash, in the table.
+ *
+ * Return the node holding the key or NULL if not found; in the latter
+ * case, if \a free_node is not NULL, the node where the key should be inserted
+ * is stored there (NULL if the table is full).
+ */
 static HashNodePtr perform_lookup(struct HashTable* ht,
-                                  const void* key, uint8_t key_length)
+                                  const void* key, uint8_t key_length,
+                                  uint32_t hash, HashNodePtr* free_node)
 {
-	uint16_t hash = calc_hash(key, key_length);
-	uint16_t mask = ((1 << ht->max_elts_log2) - 1);
-	uint16_t index = hash & mask;
-	uint16_t first_index = index;
-	uint16_t step;
+	uint32_t mask = HT_SIZE(ht) - 1;
+	uint32_t index = hash & mask;
+	uint32_t first_index = index;
+	uint32_t step = 0;
+	uint8_t fp = HASH_FP(hash);
+	HashNodePtr deleted = NULL;
 	HashNodePtr node;
 
-	// Fast-path optimization: we check immediately if the current node
-	//  is the one we were looking for, so we save the computation of the
-	//  increment step in the common case.
-	node = &ht->mem[index];
-	if (NODE_EMPTY(node)
-		|| node_key_match(ht, node, key, key_length))
-		return node;
-
-	// Increment while going through the hash table in case of collision.
-	//  This implements the double-hash technique: we use the higher part
-	//  of the hash as a step increment instead of just going to the next
-	//  element, to minimize the collisions.
-	// Notice that the number must be odd to be sure that the whole table
-	//  is traversed. Actually MCD(table_size, step) must be 1, but
-	//  table_size is always a power of 2, so we just ensure that step is
-	//  never a multiple of 2.
-	step = (ROTR(hash, ht->max_elts_log2) & mask) | 1;
-
 	do
 	{
-		index += step;
-		index &= mask;
-
 		node = &ht->mem[index];
-		if (NODE_EMPTY(node)
-			|| node_key_match(ht, node, key, key_length))
+
+		if (NODE_EMPTY(node))
+		{
+			if (free_node)
+				*free_node = deleted ? deleted : node;
+			return NULL;
+		}
+
+		if (NODE_DELETED(node))
+		{
+			if (!deleted)
+				deleted = node;
+		}
+		else if (ht->fp[index] == fp
+			&& node_key_match(ht, node, key, key_length))
 			return node;
 
-		// The check is done after the key compare. This actually causes
-		//  one more compare in the case the table is full (since the first
-		//  element was compared at the very start, and then at the end),
-		//  but it makes faster the common path where we enter this loop
-		//  for the first time, and index will not match first_index for
-		//  sure.
+		// Increment while going through the hash table in case of collision.
+		//  This implements the double-hash technique: we use the higher part
+		//  of the hash as a step increment instead of just going to the next
+		//  element, to minimize the collisions.
+		// Notice that the number must be odd to be sure that the whole table
+		//  is traversed. Actually MCD(table_size, step) must be 1, but
+		//  table_size is always a power of 2, so we just ensure that step is
+		//  never a multiple of 2.
+		// The step is computed only on the first collision, to keep the
+		//  common path (first node hit) fast.
+		if (!step)
+			step = (ROTR(hash, ht->max_elts_log2) & mask) | 1;
+
+		index += step;
+		index &= mask;
 	} while (index != first_index);
 
+	if (free_node)
+		*free_node = deleted;
 	return NULL;
 }
 
 
 void ht_init(struct HashTable* ht)
 {
-	memset(ht->mem, 0, sizeof(ht->mem[0]) * (1 << ht->max_elts_log2));
+	memset(ht->mem, 0, sizeof(ht->mem[0]) * HT_SIZE(ht));
+	ht->elts = 0;
+	ht->deleted = 0;
 }
 
 
-static bool insert(struct HashTable* ht, const void* key, uint8_t key_length, const void* data)
+static bool insert(struct HashTable* ht, const void* key, uint8_t key_length, const void* data, uint32_t hash)
 {
-	HashNodePtr node;
+	HashNodePtr node, free_node;
 
 	if (!data)
 		return false;
 
-	if (HT_HAS_INTERNAL_KEY(ht))
-		key_length = MIN(key_length, (uint8_t)INTERNAL_KEY_MAX_LENGTH);
-
-	node = perform_lookup(ht, key, key_length);
+	node = perform_lookup(ht, key, key_length, hash, &free_node);
 	if (!node)
-		return false;
+	{
+		if (!free_node)
+			return false;
+
+		node = free_node;
+		if (NODE_DELETED(node))
+			ht->deleted--;
+		ht->elts++;
+		ht->fp[node - ht->mem] = HASH_FP(hash);
+	}
 
 	if (HT_HAS_INTERNAL_KEY(ht))
 	{
@@ -232,6 +278,24 @@ static bool insert(struct HashTable* ht, const void* key, uint8_t key_length, co
 }
 
 
+static const void* perform_remove(struct HashTable* ht, const void* key, uint8_t key_length, uint32_t hash)
+{
+	HashNodePtr node;
+	const void* data;
+
+	node = perform_lookup(ht, key, key_length, hash, NULL);
+	if (!node)
+		return NULL;
+
+	data = *node;
+	*node = HT_DELETED;
+	ht->elts--;
+	ht->deleted++;
+
+	return data;
+}
+
+
 bool ht_insert_with_key(struct HashTable* ht, const void* key, uint8_t key_length, const void* data)
 {
 #ifdef _DEBUG
@@ -247,7 +311,10 @@ bool ht_insert_with_key(struct HashTable* ht, const void* key, uint8_t key_lengt
 	}
 #endif
 
-	return insert(ht, key, key_length, data);
+	if (HT_HAS_INTERNAL_KEY(ht))
+		key_length = MIN(key_length, (uint8_t)INTERNAL_KEY_MAX_LENGTH);
+
+	return insert(ht, key, key_length, data, calc_hash(key, key_length));
 }
 
 
@@ -267,7 +334,7 @@ bool ht_insert(struct HashTable* ht, const void* data)
 
 	key = ht->key_data.hook(data, &key_length);
 
-	return insert(ht, key, key_length, data);
+	return insert(ht, key, key_length, data, calc_hash(key, key_length));
 }
 
 
@@ -278,10 +345,172 @@ const void* ht_find(struct HashTable* ht, const void* key, uint8_t key_length)
 	if (HT_HAS_INTERNAL_KEY(ht))
 		key_length = MIN(key_length, (uint8_t)INTERNAL_KEY_MAX_LENGTH);
 
-	node = perform_lookup(ht, key, key_length);
+	node = perform_lookup(ht, key, key_length, calc_hash(key, key_length), NULL);
 
-	if (!node || NODE_EMPTY(node))
-		return NULL;
+	return node ? *node : NULL;
+}
+
+
+const void* ht_remove(struct HashTable* ht, const void* key, uint8_t key_length)
+{
+	if (HT_HAS_INTERNAL_KEY(ht))
+		key_length = MIN(key_length, (uint8_t)INTERNAL_KEY_MAX_LENGTH);
 
-	return *node;
+	return perform_remove(ht, key, key_length, calc_hash(key, key_length));
 }
+
+
+#if CONFIG_HT_GROW
+
+/// Nodes of the old table moved on every insertion or removal
+#define GROW_STEP  4
+
+INLINE size_t grow_mem_size(uint16_t log2)
+{
+	// Node pointers followed by the fingerprints
+	return (sizeof(const void*) + 1) << log2;
+}
+
+static bool grow_alloc(struct HashTableGrow* ht, struct HashTable* t, uint16_t log2, hook_get_key hook)
+{
+	uint8_t* mem = (uint8_t*)heap_allocmem(ht->heap, grow_mem_size(log2));
+
+	if (!mem)
+		return false;
+
+	t->mem = (const void**)mem;
+	t->fp = mem + (sizeof(const void*) << log2);
+	t->max_elts_log2 = log2;
+	t->flags.key_internal = false;
+	t->key_data.hook = hook;
+	ht_init(t);
+	return true;
+}
+
+static void grow_free(struct HashTableGrow* ht, struct HashTable* t)
+{
+	heap_freemem(ht->heap, t->mem, grow_mem_size(t->max_elts_log2));
+	t->mem = NULL;
+}
+
+/* Move some nodes of the old table to the current one */
+static void grow_step(struct HashTableGrow* ht, size_t count)
+{
+	struct HashTable* old = &ht->old;
+	size_t end;
+
+	if (!old->mem)
+		return;
+
+	end = MIN(ht->old_pos + count, HT_SIZE(old));
+	for (; ht->old_pos < end; ht->old_pos++)
+	{
+		HashNodePtr node = &old->mem[ht->old_pos];
+		const void* key;
+		uint8_t key_length;
+
+		if (!HT_NODE_USED(node))
+			continue;
+
+		// The current table is large enough for all the elements
+		key = old->key_data.hook(*node, &key_length);
+		insert(&ht->cur, key, key_length, *node, calc_hash(key, key_length));
+		*node = HT_DELETED;
+		old->elts--;
+	}
+
+	if (ht->old_pos == HT_SIZE(old))
+		grow_free(ht, old);
+}
+
+/*
+ * Start moving the elements to a new table, twice as large unless the
+ * table is loaded mostly with deleted nodes.
+ */
+static void grow_start(struct HashTableGrow* ht)
+{
+	struct HashTable next;
+	uint16_t log2 = ht->cur.max_elts_log2;
+
+	// Never more than one table to empty
+	grow_step(ht, HT_SIZE(&ht->old));
+
+	if (ht->cur.elts >= HT_SIZE(&ht->cur) / 4)
+		log2++;
+
+	// Without memory, go on with the current table while there is room
+	if (!grow_alloc(ht, &next, log2, ht->cur.key_data.hook))
+		return;
+
+	ht->old = ht->cur;
+	ht->cur = next;
+	ht->old_pos = 0;
+}
+
+bool ht_grow_init(struct HashTableGrow* ht, struct Heap* heap, size_t size, hook_get_key hook)
+{
+	memset(ht, 0, sizeof(*ht));
+	ht->heap = heap;
+	return grow_alloc(ht, &ht->cur, UINT32_LOG2(size), hook);
+}
+
+void ht_grow_destroy(struct HashTableGrow* ht)
+{
+	if (ht->cur.mem)
+		grow_free(ht, &ht->cur);
+	if (ht->old.mem)
+		grow_free(ht, &ht->old);
+}
+
+bool ht_grow_insert(struct HashTableGrow* ht, const void* data)
+{
+	const void* key;
+	uint8_t key_length;
+	uint32_t hash;
+
+	if (!data)
+		return false;
+
+	key = ht->cur.key_data.hook(data, &key_length);
+	hash = calc_hash(key, key_length);
+
+	grow_step(ht, GROW_STEP);
+
+	// Grow over 3/4 of load, deleted nodes included
+	if ((ht->cur.elts + ht->cur.deleted + 1) * 4 > HT_SIZE(&ht->cur) * 3)
+		grow_start(ht);
+
+	// An older copy may still be in the old table
+	if (ht->old.mem)
+		perform_remove(&ht->old, key, key_length, hash);
+
+	return insert(&ht->cur, key, key_length, data, hash);
+}
+
+const void* ht_grow_find(struct HashTableGrow* ht, const void* key, uint8_t key_length)
+{
+	uint32_t hash = calc_hash(key, key_length);
+	HashNodePtr node;
+
+	node = perform_lookup(&ht->cur, key, key_length, hash, NULL);
+	if (!node && ht->old.mem)
+		node = perform_lookup(&ht->old, key, key_length, hash, NULL);
+
+	return node ? *node : NULL;
+}
+
+const void* ht_grow_remove(struct HashTableGrow* ht, const void* key, uint8_t key_length)
+{
+	uint32_t hash = calc_hash(key, key_length);
+	const void* data;
+
+	grow_step(ht, GROW_STEP);
+
+	data = perform_remove(&ht->cur, key, key_length, hash);
+	if (!data && ht->old.mem)
+		data = perform_remove(&ht->old, key, key_length, hash);
+
+	return data;
+}
+
+#endif /* CONFIG_HT_GROW */
@@ -45,8 +45,14 @@
  * \li The key is stored within the data and a hook is used to extract it. Optionally, it
  * is possible to store a copy of the key within the hash table.
  *
- * Since the hashing is open, there is no way to remove elements from the table. Instead, a
- * function is provided to clear the table completely.
+ * \li Removal of elements: a removed node is marked as deleted, so that the lookups
+ * of the other keys go on probing past it; its place is reused by the next insertion.
+ * \li A fingerprint of the hash of each node is stored beside it: most of the nodes
+ * with a different key are skipped without extracting and comparing the key.
+ * \li Optionally (CONFIG_HT_GROW), a growable table allocated on a heap, which
+ * is moved to a larger one a few nodes per operation when it gets too loaded.
+ *
+ * A function is also provided to clear the table completely.
  *
  * The data stored within the table must be a pointer. The NULL pointer is used as
  * a marker for a free node, so it is invalid to store a NULL pointer in the table
@@ -98,8 +104,18 @@ struct HashTable
 		hook_get_key hook;       ///< Hook to get the key
 		uint8_t *mem;            ///< Pointer to the key memory
 	} key_data;
+	uint8_t *fp;                 ///< Hash fingerprint of each node
+	size_t elts;                 ///< Nodes in use
+	size_t deleted;              ///< Nodes marked as deleted
 };
 
+/// Marker of a deleted node
+extern const char ht_deleted_node;
+#define HT_DELETED                   ((const void *)&ht_deleted_node)
+
+/// True if \a node holds an element
+#define HT_NODE_USED(node)           (*(node) && *(node) != HT_DELETED)
+
 
 /// Iterator to walk the hash table
 typedef struct
@@ -122,12 +138,14 @@ typedef struct
  */
 #define DECLARE_HASHTABLE(name, size, hook_gk) \
 	static const void* name##_nodes[1 << UINT32_LOG2(size)]; \
+	static uint8_t name##_fp[1 << UINT32_LOG2(size)]; \
 	struct HashTable name = \
 		{ \
 			.mem = name##_nodes, \
 			.max_elts_log2 = UINT32_LOG2(size), \
 			.flags = { .key_internal = false }, \
-			.key_data.hook = hook_gk \
+			.key_data.hook = hook_gk, \
+			.fp = name##_fp \
 		}
 
 
@@ -135,12 +153,14 @@ typedef struct
 #define DECLARE_HASHTABLE_STATIC(name, size, hook_gk) \
 	enum { name##_SIZE = (1 << UINT32_LOG2(size)), }; \
 	static const void* name##_nodes[name##_SIZE]; \
+	static uint8_t name##_fp[name##_SIZE]; \
 	static struct HashTable name = \
 		{ \
 			.mem = name##_nodes, \
 			.max_elts_log2 = UINT32_LOG2(size), \
 			.flags = { .key_internal = false }, \
-			.key_data.hook = hook_gk \
+			.key_data.hook = hook_gk, \
+			.fp = name##_fp \
 		}
 
 #if CONFIG_HT_OPTIONAL_INTERNAL_KEY
@@ -152,7 +172,15 @@ typedef struct
 	#define DECLARE_HASHTABLE_INTERNALKEY(name, size) \
 		static uint8_t name##_keys[(1 << UINT32_LOG2(size)) * (INTERNAL_KEY_MAX_LENGTH + 1)]; \
 		static const void* name##_nodes[1 << UINT32_LOG2(size)]; \
-		struct HashTable name = { name##_nodes, UINT32_LOG2(size), { true }, name##_keys }
+		static uint8_t name##_fp[1 << UINT32_LOG2(size)]; \
+		struct HashTable name = \
+			{ \
+				.mem = name##_nodes, \
+				.max_elts_log2 = UINT32_LOG2(size), \
+				.flags = { .key_internal = true }, \
+				.key_data.mem = name##_keys, \
+				.fp = name##_fp \
+			}
 
 	/** Exactly like \c DECLARE_HASHTABLE_INTERNALKEY, but the variable will be declared as static. */
 	#define DECLARE_HASHTABLE_INTERNALKEY_STATIC(name, size) \
@@ -160,12 +188,14 @@ typedef struct
 			name##_SIZE = (1 << UINT32_LOG2(size)), }; \
 		static uint8_t name##_keys[name##_KEYS]; \
 		static const void* name##_nodes[name##_SIZE]; \
+		static uint8_t name##_fp[name##_SIZE]; \
 		static struct HashTable name = \
 			{ \
 				.mem = name##_nodes, \
 				.max_elts_log2 = UINT32_LOG2(size), \
 				.flags = { .key_internal = true }, \
-				.key_data.mem = name##_keys \
+				.key_data.mem = name##_keys, \
+				.fp = name##_fp \
 			}
 #endif
 
@@ -230,12 +260,25 @@ bool ht_insert_with_key(struct HashTable* ht, const void* key, uint8_t key_lengt
  */
 const void* ht_find(struct HashTable* ht, const void* key, uint8_t key_length);
 
+/**
+ * Remove an element from the hash table
+ *
+ * \param ht Handle of the hash table
+ * \param key Key of the element
+ * \param key_length Length of the key in characters
+ * \return Data of the removed element, or NULL if no element was found for the given key.
+ */
+const void* ht_remove(struct HashTable* ht, const void* key, uint8_t key_length);
+
 /** Similar to \c ht_insert_with_key() but \a key is an ASCIIZ string */
 #define ht_insert_str(ht, key, data)         ht_insert_with_key(ht, key, strlen(key), data)
 
 /** Similar to \c ht_find() but \a key is an ASCIIZ string */
 #define ht_find_str(ht, key)                 ht_find(ht, key, strlen(key))
 
+/** Similar to \c ht_remove() but \a key is an ASCIIZ string */
+#define ht_remove_str(ht, key)               ht_remove(ht, key, strlen(key))
+
 /// Get an iterator to the begin of the hash table \a ht
 INLINE HashIterator ht_iter_begin(struct HashTable* ht)
 {
@@ -244,7 +287,7 @@ INLINE HashIterator ht_iter_begin(struct HashTable* ht)
 	h.pos = &ht->mem[0];
 	h.end = &ht->mem[1 << ht->max_elts_log2];
 
-	while (h.pos != h.end && !*h.pos)
+	while (h.pos != h.end && !HT_NODE_USED(h.pos))
 		++h.pos;
 
 	return h;
@@ -286,12 +329,70 @@ INLINE const void* ht_iter_get(HashIterator iter)
 INLINE HashIterator ht_iter_next(HashIterator h)
 {
 	++h.pos;
-	while (h.pos != h.end && !(*h.pos))
+	while (h.pos != h.end && !HT_NODE_USED(h.pos))
 		++h.pos;
 
 	return h;
 }
 
+#if CONFIG_HT_GROW
+
+struct Heap;
+
+/**
+ * Growable hash table, with external keys.
+ *
+ * The nodes are allocated on a heap. When the table gets loaded over 3/4,
+ * a new table of twice the size is allocated and the elements are moved
+ * to it a few at a time on every insertion or removal, so that there is
+ * never a long pause; lookups meanwhile search both tables.
+ *
+ * \note This structure MUST NOT be accessed directly.
+ */
+struct HashTableGrow
+{
+	struct HashTable cur;        ///< Table where elements are inserted
+	struct HashTable old;        ///< Table being emptied, mem is NULL if none
+	size_t old_pos;              ///< Next node of old to move
+	struct Heap *heap;
+};
+
+/**
+ * Initialize a growable hash table.
+ *
+ * \param ht Growable hash table
+ * \param heap Heap where the nodes are allocated
+ * \param size Initial number of elements, rounded down to a power of two
+ * \param hook Hook to be used to extract the key from the node
+ * \return true if the table was allocated, false otherwise
+ */
+bool ht_grow_init(struct HashTableGrow *ht, struct Heap *heap, size_t size, hook_get_key hook);
+
+/// Release the memory of a growable hash table
+void ht_grow_destroy(struct HashTableGrow *ht);
+
+/**
+ * Insert an element into a growable hash table, see \c ht_insert().
+ *
+ * \return true if insertion was successful, false if the table is full and
+ *         there is not enough memory on the heap to grow it.
+ */
+bool ht_grow_insert(struct HashTableGrow *ht, const void *data);
+
+/// Find an element in a growable hash table, see \c ht_find()
+const void *ht_grow_find(struct HashTableGrow *ht, const void *key, uint8_t key_length);
+
+/// Remove an element from a growable hash table, see \c ht_remove()
+const void *ht_grow_remove(struct HashTableGrow *ht, const void *key, uint8_t key_length);
+
+/// Number of elements in a growable hash table
+INLINE size_t ht_grow_count(struct HashTableGrow *ht)
+{
+	return ht->cur.elts + (ht->old.mem ? ht->old.elts : 0);
+}
+
+#endif /* CONFIG_HT_GROW */
+
 int hashtable_testSetup(void);
 int hashtable_testRun(void);
 int hashtable_testTearDown(void);
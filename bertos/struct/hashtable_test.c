@@ -31,15 +31,21 @@
  *
  * \brief Test hashtable module.
  *
- * Test the hashtable module (insertion and find).
+ * Test the hashtable module (insertion, find and removal), the growable
+ * tables and benchmark the lookups at increasing load factors.
  *
  * \author Andrea Righi <arighi@develer.com>
  *
  * $test$: cp bertos/cfg/cfg_hashtable.h $cfgdir/
+ * $test$: echo  "#undef CONFIG_HT_GROW" >> $cfgdir/cfg_hashtable.h
+ * $test$: echo "#define CONFIG_HT_GROW 1" >> $cfgdir/cfg_hashtable.h
  */
 
 #include <cfg/debug.h>
 #include <cfg/test.h>
+#include <os/hptime.h>
+#include <struct/heap.h>
+#include <stdio.h> /* sprintf() */
 #include <string.h> /* strlen() */
 #include "struct/hashtable.h"
 
@@ -94,13 +100,176 @@ static bool single_test(void)
 	return true;
 }
 
+#define BENCH_SIZE     1024
+#define BENCH_LOOKUPS  4096
+#define GROW_ELEMENTS  5000
+
+static char keys[GROW_ELEMENTS][8];
+static int key_compares;
+
+static const void *bench_get_key(const void *ptr, uint8_t *length)
+{
+	key_compares++;
+	return test_get_key(ptr, length);
+}
+
+DECLARE_HASHTABLE_STATIC(bench, BENCH_SIZE, bench_get_key);
+
+static HEAP_DEFINE_BUF(heap_buf, 256 * 1024);
+static Heap heap;
+
+static bool remove_test(void)
+{
+	HashIterator cur, end;
+	int i, count = 0;
+
+	ht_init(&hash1);
+	ht_init(&hash2);
+	for (i = 0; i < NUM_ELEMENTS; i++)
+	{
+		ASSERT(ht_insert(&hash1, keys[i]));
+		ASSERT(ht_insert_str(&hash2, keys[i], keys[i]));
+	}
+
+	// Remove every other element, the others must still be found
+	for (i = 0; i < NUM_ELEMENTS; i += 2)
+	{
+		if (ht_remove_str(&hash1, keys[i]) != keys[i])
+			return false;
+		if (ht_remove_str(&hash2, keys[i]) != keys[i])
+			return false;
+	}
+	for (i = 0; i < NUM_ELEMENTS; i++)
+	{
+		const void *expected = (i % 2) ? keys[i] : NULL;
+
+		if (ht_find_str(&hash1, keys[i]) != expected
+			|| ht_find_str(&hash2, keys[i]) != expected)
+			return false;
+	}
+	if (ht_remove_str(&hash1, keys[0]))
+		return false;
+
+	end = ht_iter_end(&hash1);
+	for (cur = ht_iter_begin(&hash1); !ht_iter_cmp(cur, end); cur = ht_iter_next(cur))
+		count++;
+	if (count != NUM_ELEMENTS / 2)
+		return false;
+
+	// Deleted nodes are reused, even in a full table
+	for (i = 0; i < NUM_ELEMENTS; i += 2)
+		if (!ht_insert(&hash1, keys[i]))
+			return false;
+	for (i = 0; i < NUM_ELEMENTS; i++)
+		if (ht_find_str(&hash1, keys[i]) != keys[i])
+			return false;
+
+	return true;
+}
+
+static bool grow_test(void)
+{
+	struct HashTableGrow ht;
+	size_t free_space = heap_freeSpace(&heap);
+	int i;
+
+	if (!ht_grow_init(&ht, &heap, 8, test_get_key))
+		return false;
+
+	for (i = 0; i < GROW_ELEMENTS; i++)
+	{
+		if (!ht_grow_insert(&ht, keys[i]))
+			return false;
+		// Elements must be found while they are being moved
+		if (ht_grow_find(&ht, keys[i / 2], strlen(keys[i / 2])) != keys[i / 2])
+			return false;
+	}
+	if (ht_grow_count(&ht) != GROW_ELEMENTS)
+		return false;
+
+	for (i = 0; i < GROW_ELEMENTS; i++)
+		if (ht_grow_find(&ht, keys[i], strlen(keys[i])) != keys[i])
+			return false;
+
+	// Churn: the deleted nodes must not fill the table
+	for (int n = 0; n < 4; n++)
+	{
+		for (i = 0; i < GROW_ELEMENTS; i += 3)
+			if (ht_grow_remove(&ht, keys[i], strlen(keys[i])) != keys[i])
+				return false;
+		for (i = 0; i < GROW_ELEMENTS; i += 3)
+			if (!ht_grow_insert(&ht, keys[i]))
+				return false;
+	}
+
+	for (i = 0; i < GROW_ELEMENTS; i++)
+		if (ht_grow_remove(&ht, keys[i], strlen(keys[i])) != keys[i])
+			return false;
+	if (ht_grow_count(&ht) != 0)
+		return false;
+
+	kprintf("grow: %d elements, table of %d nodes\n",
+		GROW_ELEMENTS, 1 << ht.cur.max_elts_log2);
+	ht_grow_destroy(&ht);
+
+	return heap_freeSpace(&heap) == free_space;
+}
+
+/*
+ * Lookups of present and missing keys at increasing load factors; the
+ * key compares are counted through the hook.
+ */
+static void bench_test(void)
+{
+	static const int load[] = { 25, 50, 75, 90, 100 };
+	int n = 0;
+
+	ht_init(&bench);
+	for (unsigned l = 0; l < countof(load); l++)
+	{
+		hptime_t start, t_hit, t_miss;
+		int hit_cmp, miss_cmp;
+
+		for (; n < BENCH_SIZE * load[l] / 100; n++)
+			ASSERT(ht_insert(&bench, keys[n]));
+
+		key_compares = 0;
+		start = hptime_get();
+		for (int i = 0; i < BENCH_LOOKUPS; i++)
+		{
+			const char *k = keys[i % n];
+			ASSERT(ht_find(&bench, k, strlen(k)) == k);
+		}
+		t_hit = hptime_get() - start;
+		hit_cmp = key_compares;
+
+		key_compares = 0;
+		start = hptime_get();
+		for (int i = 0; i < BENCH_LOOKUPS; i++)
+		{
+			const char *k = keys[BENCH_SIZE + i % BENCH_SIZE];
+			ASSERT(ht_find(&bench, k, strlen(k)) == NULL);
+		}
+		t_miss = hptime_get() - start;
+		miss_cmp = key_compares;
+
+		kprintf("load %3d%%: hit %4ld ns, %d.%02d compares; miss %5ld ns, %d.%02d compares\n",
+			load[l],
+			(long)(t_hit * 1000 / BENCH_LOOKUPS),
+			hit_cmp / BENCH_LOOKUPS, hit_cmp * 100 / BENCH_LOOKUPS % 100,
+			(long)(t_miss * 1000 / BENCH_LOOKUPS),
+			miss_cmp / BENCH_LOOKUPS, miss_cmp * 100 / BENCH_LOOKUPS % 100);
+	}
+}
+
 int hashtable_testRun(void)
 {
-	if (!single_test())
+	if (!single_test() || !remove_test() || !grow_test())
 	{
 		kprintf("hashtable_test failed\n");
 		return -1;
 	}
+	bench_test();
 	kprintf("hashtable_test successful\n");
 	return 0;
 }
@@ -108,6 +277,9 @@ int hashtable_testRun(void)
 int hashtable_testSetup(void)
 {
 	kdbg_init();
+	heap_init(&heap, heap_buf, sizeof(heap_buf));
+	for (int i = 0; i < GROW_ELEMENTS; i++)
+		sprintf(keys[i], "k%d", i);
 	return 0;
 }
 
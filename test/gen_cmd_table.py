@@ -0,0 +1,204 @@
+#!/usr/bin/python
+# This file is part of BeRTOS.
+#
+# Bertos is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#
+# As a special exception, you may use this file as part of a free software
+# library without restriction.  Specifically, if other files instantiate
+# templates or use macros or inline functions from this file, or you compile
+# this file and link it with other files to produce an executable, this
+# file does not by itself cause the resulting executable to be covered by
+# the GNU General Public License.  This exception does not however
+# invalidate any other reasons why the executable file might be covered by
+# the GNU General Public License.
+#
+# Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+#
+# Generate a static command table for the parser (mware/parser.h).
+#
+# The command list is a text file with one command per line:
+#
+#   <name> <arg_fmt> <result_fmt> [<function> [<flags>]]
+#
+# where an empty format string is written as "-", <function> defaults
+# to cmd_<name> and <flags> to 0.  Blank lines and lines starting with
+# '#' are ignored.
+#
+# The output is a C source file defining a struct ParserTable with a
+# minimal perfect hash over the command names and the pre-decoded
+# argument descriptors in program memory; install it at runtime with
+# parser_register_table().
+#
+# Usage: gen_cmd_table.py [-n <table name>] [-m <max args>] [-o <out.c>] <commands>
+#
+
+from __future__ import print_function
+import getopt
+import sys
+
+MASK32 = 0xFFFFFFFF
+# Upper limit of the uint16_t displacement values.
+MAX_DISP = 0x10000
+
+def cmd_hash(name):
+	"""32 bit FNV-1a, the same as parser_hash() in parser.c."""
+	h = 0x811C9DC5
+	for c in bytearray(name.encode('ascii')):
+		h ^= c
+		h = (h * 0x01000193) & MASK32
+	return h
+
+def slot(h, disp, size):
+	"""Final slot for a key hash, the same as table_slot() in parser.c."""
+	h ^= (disp * 0x9E3779B1) & MASK32
+	h ^= h >> 16
+	h = (h * 0x85EBCA6B) & MASK32
+	h ^= h >> 13
+	return h % size
+
+def perfect_hash(hashes, n_buckets):
+	"""
+	Hash and displace: keys are split into buckets by the first level
+	hash, then each bucket (biggest first) looks for the displacement
+	that sends all of its keys to free slots.
+	Return the displacement table, or None if a bucket cannot be placed.
+	"""
+	size = len(hashes)
+	buckets = [[] for i in range(n_buckets)]
+	for i, h in enumerate(hashes):
+		buckets[h % n_buckets].append(i)
+
+	disp = [0] * n_buckets
+	taken = [None] * size
+	order = sorted(range(n_buckets), key=lambda b: -len(buckets[b]))
+	for b in order:
+		if not buckets[b]:
+			continue
+		for d in range(MAX_DISP):
+			slots = [slot(hashes[i], d, size) for i in buckets[b]]
+			if len(set(slots)) == len(slots) and \
+					all(taken[s] is None for s in slots):
+				break
+		else:
+			return None, None
+		disp[b] = d
+		for i, s in zip(buckets[b], slots):
+			taken[s] = i
+	return disp, taken
+
+def decode_fmt(fmt, where):
+	"""Return (count, string mask) for a format string."""
+	mask = 0
+	for i, c in enumerate(fmt):
+		if c == 's':
+			mask |= 1 << i
+		elif c != 'd':
+			sys.exit("%s: invalid format character '%s'" % (where, c))
+	return len(fmt), mask
+
+def parse(path):
+	cmds = []
+	with open(path) as f:
+		for lineno, line in enumerate(f, 1):
+			line = line.strip()
+			if not line or line.startswith('#'):
+				continue
+			where = "%s:%d" % (path, lineno)
+			tok = line.split()
+			if len(tok) < 3 or len(tok) > 5:
+				sys.exit("%s: expected <name> <args> <results> [<func> [<flags>]]" % where)
+			name = tok[0]
+			args = '' if tok[1] == '-' else tok[1]
+			res = '' if tok[2] == '-' else tok[2]
+			func = tok[3] if len(tok) > 3 else 'cmd_' + name
+			flags = tok[4] if len(tok) > 4 else '0'
+			if len(name) > 255:
+				sys.exit("%s: command name too long" % where)
+			if any(c['name'] == name for c in cmds):
+				sys.exit("%s: duplicate command '%s'" % (where, name))
+			cmds.append(dict(name=name, args=args, res=res,
+				func=func, flags=flags, where=where))
+	return cmds
+
+def main():
+	opts, args = getopt.getopt(sys.argv[1:], "n:m:o:")
+	opts = dict(opts)
+	if len(args) != 1:
+		sys.exit("Usage: %s [-n <table name>] [-m <max args>] [-o <out.c>] <commands>" % sys.argv[0])
+
+	table = opts.get('-n', 'cmd_table')
+	max_args = int(opts.get('-m', 4))
+	cmds = parse(args[0])
+	if not cmds:
+		sys.exit("%s: no commands" % args[0])
+	if len(cmds) > 255:
+		sys.exit("%s: too many commands" % args[0])
+
+	for c in cmds:
+		c['nargs'], c['args_str'] = decode_fmt(c['args'], c['where'])
+		c['nres'], c['res_str'] = decode_fmt(c['res'], c['where'])
+		# args[0] is the command name, results follow the arguments.
+		if 1 + c['nargs'] + c['nres'] > max_args:
+			sys.exit("%s: '%s' needs more than %d arguments" % (c['where'], c['name'], max_args))
+
+	hashes = [cmd_hash(c['name']) for c in cmds]
+	if len(set(hashes)) != len(hashes):
+		sys.exit("%s: hash collision between command names" % args[0])
+
+	n_buckets = (len(cmds) + 1) // 2
+	while True:
+		disp, order = perfect_hash(hashes, n_buckets)
+		if disp:
+			break
+		n_buckets += 1
+
+	out = open(opts['-o'], 'w') if '-o' in opts else sys.stdout
+	w = lambda s = '': print(s, file=out)
+
+	w("/* Generated by gen_cmd_table.py from %s: do not edit. */" % args[0])
+	w()
+	w("#include <mware/parser.h>")
+	w("#include <cpu/pgm.h>")
+	w()
+	for f in sorted(set(c['func'] for c in cmds)):
+		w("ResultCode %s(parms *args);" % f)
+	w()
+	w("static const struct CmdTemplate %s_cmds[] =" % table)
+	w("{")
+	for i in order:
+		c = cmds[i]
+		w('\t{ "%s", "%s", "%s", %s, %s },' % (c['name'], c['args'], c['res'], c['func'], c['flags']))
+	w("};")
+	w()
+	w("static const struct ParserCmdDesc %s_desc[] PROGMEM =" % table)
+	w("{")
+	for i in order:
+		c = cmds[i]
+		w("\t{ %d, %d, %d, 0x%02x, 0x%02x }," % (len(c['name']), c['nargs'], c['nres'], c['args_str'], c['res_str']))
+	w("};")
+	w()
+	w("static const uint16_t %s_disp[] PROGMEM =" % table)
+	w("{")
+	for i in range(0, len(disp), 8):
+		w("\t" + " ".join("%d," % d for d in disp[i:i + 8]))
+	w("};")
+	w()
+	w("const struct ParserTable %s =" % table)
+	w("{")
+	w("\t%s_cmds, %s_desc, %s_disp, %d, %d" % (table, table, table, len(cmds), len(disp)))
+	w("};")
+
+if __name__ == "__main__":
+	main()
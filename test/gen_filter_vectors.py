@@ -0,0 +1,221 @@
+#!/usr/bin/python
+# This file is part of BeRTOS.
+#
+# Bertos is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#
+# As a special exception, you may use this file as part of a free software
+# library without restriction.  Specifically, if other files instantiate
+# templates or use macros or inline functions from this file, or you compile
+# this file and link it with other files to produce an executable, this
+# file does not by itself cause the resulting executable to be covered by
+# the GNU General Public License.  This exception does not however
+# invalidate any other reasons why the executable file might be covered by
+# the GNU General Public License.
+#
+# Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+#
+# Generate the test vectors of algo/filter_test.c.
+#
+# Filters are designed in floating point and quantized. For each one
+# the expected output is emitted twice: bit exact, computed with the
+# integer arithmetic documented in algo/filter.h, and ideal, computed in
+# floating point on the same quantized coefficients and input, to check
+# the precision of the fixed point arithmetic.
+#
+# Usage: gen_filter_vectors.py [-o <out.h>]
+#
+
+from __future__ import print_function
+import getopt
+import math
+import sys
+
+N = 600
+FIR_TAPS = 31
+FIR_DECIM = 4
+BIQUAD_SECTIONS = 2
+BIQUAD_SHIFT = 1
+CIC_STAGES = 3
+CIC_DECIM = 8
+
+def sat(x, bits):
+	return max(-(1 << (bits - 1)), min((1 << (bits - 1)) - 1, x))
+
+def quant(x, bits):
+	return sat(int(round(x * (1 << (bits - 1)))), bits)
+
+def signal():
+	"""Two tones plus pseudo random noise, at about half full scale."""
+	seed = 12345
+	out = []
+	for n in range(N):
+		seed = (seed * 1103515245 + 12345) & 0x7FFFFFFF
+		noise = ((seed >> 8) & 0xFFFF) / 65536.0 - 0.5
+		out.append(0.4 * math.sin(2 * math.pi * 0.01 * n)
+			+ 0.3 * math.sin(2 * math.pi * 0.31 * n) + 0.1 * noise)
+	return out
+
+def lowpass_fir(ntaps, fc):
+	"""Hamming windowed sinc, unity gain at DC."""
+	m = (ntaps - 1) / 2.0
+	h = []
+	for k in range(ntaps):
+		x = k - m
+		s = 2 * fc if x == 0 else math.sin(2 * math.pi * fc * x) / (math.pi * x)
+		h.append(s * (0.54 - 0.46 * math.cos(2 * math.pi * k / (ntaps - 1))))
+	g = sum(h)
+	return [v / g for v in h]
+
+def lowpass_biquad(fc, q):
+	"""RBJ cookbook low pass, as (b0, b1, b2, -a1, -a2)."""
+	w = 2 * math.pi * fc
+	alpha = math.sin(w) / (2 * q)
+	a0 = 1 + alpha
+	b0 = (1 - math.cos(w)) / 2 / a0
+	return [b0, 2 * b0, b0, 2 * math.cos(w) / a0, -(1 - alpha) / a0]
+
+def fir_exact(c, x, decim, bits):
+	"""Bit exact output of fir_q15() and fir_q31()."""
+	hist = [0] * (len(c) - 1) + x
+	y = []
+	for i in range(decim - 1, len(x), decim):
+		w = hist[i:i + len(c)]
+		if bits == 16:
+			acc = sum(a * b for a, b in zip(c, w))
+			y.append(sat((acc + (1 << 14)) >> 15, 16))
+		else:
+			acc = sum((a * b) >> 32 for a, b in zip(c, w))
+			y.append(sat(acc << 1, 32))
+	return y
+
+def fir_ideal(c, x, decim, bits):
+	scale = float(1 << (bits - 1))
+	hist = [0] * (len(c) - 1) + x
+	return [sat(int(round(sum(a * b for a, b in zip(c, hist[i:i + len(c)])) / scale)), bits)
+		for i in range(decim - 1, len(x), decim)]
+
+def biquad_exact(coeffs, x, shift, bits):
+	"""Bit exact output of biquad_q15() and biquad_q31()."""
+	for b0, b1, b2, a1, a2 in coeffs:
+		x1 = x2 = y1 = y2 = 0
+		y = []
+		for v in x:
+			if bits == 16:
+				acc = b0 * v + b1 * x1 + b2 * x2 + a1 * y1 + a2 * y2
+				out = sat((acc + (1 << (14 - shift))) >> (15 - shift), 16)
+			else:
+				acc = sum((a * b) >> 32 for a, b in
+					((b0, v), (b1, x1), (b2, x2), (a1, y1), (a2, y2)))
+				out = sat(acc << (1 + shift), 32)
+			x2, x1 = x1, v
+			y2, y1 = y1, out
+			y.append(out)
+		x = y
+	return x
+
+def biquad_ideal(coeffs, x, shift, bits):
+	scale = float(1 << (bits - 1 - shift))
+	for c in coeffs:
+		b0, b1, b2, a1, a2 = [v / scale for v in c]
+		x1 = x2 = y1 = y2 = 0.0
+		y = []
+		for v in x:
+			out = b0 * v + b1 * x1 + b2 * x2 + a1 * y1 + a2 * y2
+			x2, x1 = x1, v
+			y2, y1 = y1, out
+			y.append(out)
+		x = y
+	return [sat(int(round(v)), bits) for v in x]
+
+def cic_exact(x, stages, decim):
+	"""Bit exact output of cic_decimate(), with 32 bit wrapping registers."""
+	mask = 0xFFFFFFFF
+	shift = stages * int(math.log(decim, 2))
+	integ = [0] * stages
+	comb = [0] * stages
+	y = []
+	for i, v in enumerate(x):
+		acc = v & mask
+		for s in range(stages):
+			integ[s] = (integ[s] + acc) & mask
+			acc = integ[s]
+		if i % decim == decim - 1:
+			for s in range(stages):
+				acc, comb[s] = (acc - comb[s]) & mask, acc
+			if acc & 0x80000000:
+				acc -= 1 << 32
+			y.append(sat(acc >> shift, 16))
+	return y
+
+def main():
+	opts, args = getopt.getopt(sys.argv[1:], "o:")
+	opts = dict(opts)
+	if args:
+		sys.exit("Usage: %s [-o <out.h>]" % sys.argv[0])
+
+	sig = signal()
+	x15 = [quant(v, 16) for v in sig]
+	x31 = [quant(v, 32) for v in sig]
+
+	h = lowpass_fir(FIR_TAPS, 0.05)
+	# -32768 is not allowed, see fir_q15_init()
+	fir15 = [max(quant(v, 16), -32767) for v in h]
+	fir31 = [quant(v, 32) for v in h]
+
+	bq = [lowpass_biquad(0.05, 0.54), lowpass_biquad(0.05, 1.31)]
+	bq15 = [[quant(v / (1 << BIQUAD_SHIFT), 16) for v in c] for c in bq]
+	bq31 = [[quant(v / (1 << BIQUAD_SHIFT), 32) for v in c] for c in bq]
+
+	out = open(opts['-o'], 'w') if '-o' in opts else sys.stdout
+	w = lambda s = '': print(s, file=out)
+
+	def array(typ, name, values, per_line=8, suffix=''):
+		w("static const %s %s[] =" % (typ, name))
+		w("{")
+		for i in range(0, len(values), per_line):
+			w("\t" + " ".join("%d%s," % (v, suffix) for v in values[i:i + per_line]))
+		w("};")
+		w()
+
+	w("/* Generated by gen_filter_vectors.py: do not edit. */")
+	w()
+	w("#define VEC_LEN %d" % N)
+	w("#define FIR_TAPS %d" % FIR_TAPS)
+	w("#define FIR_DECIM %d" % FIR_DECIM)
+	w("#define BIQUAD_SECTIONS %d" % BIQUAD_SECTIONS)
+	w("#define BIQUAD_SHIFT %d" % BIQUAD_SHIFT)
+	w("#define CIC_STAGES %d" % CIC_STAGES)
+	w("#define CIC_DECIM %d" % CIC_DECIM)
+	w()
+	array("q15_t", "in_q15", x15)
+	array("q31_t", "in_q31", x31, 4, 'L')
+	array("q15_t", "fir_q15_coeffs", fir15)
+	array("q31_t", "fir_q31_coeffs", fir31, 4, 'L')
+	array("q15_t", "biquad_q15_coeffs", sum(bq15, []), 5)
+	array("q31_t", "biquad_q31_coeffs", sum(bq31, []), 5, 'L')
+
+	array("q15_t", "fir_q15_exact", fir_exact(fir15, x15, 1, 16))
+	array("q15_t", "fir_q15_ideal", fir_ideal(fir15, x15, 1, 16))
+	array("q15_t", "fir_q15_decim_exact", fir_exact(fir15, x15, FIR_DECIM, 16))
+	array("q31_t", "fir_q31_exact", fir_exact(fir31, x31, 1, 32), 4, 'L')
+	array("q31_t", "fir_q31_ideal", fir_ideal(fir31, x31, 1, 32), 4, 'L')
+	array("q15_t", "biquad_q15_exact", biquad_exact(bq15, x15, BIQUAD_SHIFT, 16))
+	array("q15_t", "biquad_q15_ideal", biquad_ideal(bq15, x15, BIQUAD_SHIFT, 16))
+	array("q31_t", "biquad_q31_exact", biquad_exact(bq31, x31, BIQUAD_SHIFT, 32), 4, 'L')
+	array("q31_t", "biquad_q31_ideal", biquad_ideal(bq31, x31, BIQUAD_SHIFT, 32), 4, 'L')
+	array("q15_t", "cic_exact", cic_exact(x15, CIC_STAGES, CIC_DECIM))
+
+if __name__ == "__main__":
+	main()
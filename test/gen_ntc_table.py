@@ -0,0 +1,194 @@
+#!/usr/bin/python
+# This file is part of BeRTOS.
+#
+# Bertos is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#
+# As a special exception, you may use this file as part of a free software
+# library without restriction.  Specifically, if other files instantiate
+# templates or use macros or inline functions from this file, or you compile
+# this file and link it with other files to produce an executable, this
+# file does not by itself cause the resulting executable to be covered by
+# the GNU General Public License.  This exception does not however
+# invalidate any other reasons why the executable file might be covered by
+# the GNU General Public License.
+#
+# Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+#
+# Generate the conversion tables of an NTC for drv/ntc.h.
+#
+# The resistance table comes from the Beta model of the NTC, or from a
+# datasheet table (one "<celsius> <ohm>" couple per line), resampled at
+# the requested temperature step.  Along with it the reciprocal of every
+# table interval is emitted, so that ntc_read() interpolates with one
+# multiply and one shift instead of a division.
+#
+# With -a, a TableEven (algo/table.h) from the ADC counts to temperature is
+# also emitted, for the circuit described in hw/hw_ntc.h: evenly spaced on
+# the ADC counts, it converts a sample without any search or division.
+#
+# Usage: gen_ntc_table.py [options]
+#
+#  -n <name>      name of the NtcHwInfo (default: ntc_info)
+#  -b <beta>      Beta of the NTC, with -r
+#  -r <ohm>       resistance at 25 C, with -b
+#  -c <file>      datasheet table, instead of -b and -r
+#  -t <min:max:step>  temperature range and step, celsius (default: -40:125:5)
+#  -a <bits:rser:rpar:amp:shift>  also emit the ADC table, with a point
+#                 every 2^shift counts
+#  -o <out.c>     output file (default: stdout)
+#
+
+from __future__ import print_function
+import getopt
+import math
+import sys
+
+KELVIN = 273.15
+
+def beta_model(beta, r25):
+	return lambda t: r25 * math.exp(beta * (1.0 / (t + KELVIN) - 1.0 / (25 + KELVIN)))
+
+def csv_model(path):
+	"""Interpolate ln(R) linearly in 1/T between the datasheet points."""
+	points = []
+	with open(path) as f:
+		for line in f:
+			line = line.split('#')[0].split()
+			if line:
+				points.append((1.0 / (float(line[0]) + KELVIN), math.log(float(line[1]))))
+	points.sort()
+	def model(t):
+		x = 1.0 / (t + KELVIN)
+		for (x0, y0), (x1, y1) in zip(points, points[1:]):
+			if x <= x1:
+				break
+		return math.exp(y0 + (y1 - y0) * (x - x0) / (x1 - x0))
+	return model
+
+def recip_shift(deg_step, max_den):
+	"""
+	Biggest shift that keeps the products of ntc_convert() within 32 bits:
+	with reciprocals rounded up, they are less than
+	((10 * step) << shift) + interval.
+	"""
+	shift = 0
+	while ((10 * deg_step) << (shift + 1)) + max_den < 1 << 32 and shift < 30:
+		shift += 1
+	return shift
+
+def main():
+	opts, args = getopt.getopt(sys.argv[1:], "n:b:r:c:t:a:o:")
+	opts = dict(opts)
+	if args or not ('-c' in opts or ('-b' in opts and '-r' in opts)):
+		sys.exit("Usage: %s [-n <name>] (-b <beta> -r <ohm> | -c <file>) [-t <min:max:step>] "
+			"[-a <bits:rser:rpar:amp:shift>] [-o <out.c>]" % sys.argv[0])
+
+	name = opts.get('-n', 'ntc_info')
+	if '-c' in opts:
+		model = csv_model(opts['-c'])
+	else:
+		model = beta_model(float(opts['-b']), float(opts['-r']))
+	tmin, tmax, tstep = [int(v) for v in opts.get('-t', '-40:125:5').split(':')]
+
+	# NtcHwInfo degrees are celsius, res_t is ohm * 100
+	deg_min, deg_step = tmin, tstep
+	temps = range(tmin, tmax + 1, tstep)
+	res = [int(round(model(t) * 100)) for t in temps]
+	if any(a <= b for a, b in zip(res, res[1:])):
+		sys.exit("resistances must decrease with the temperature")
+	if res[0] >= 1 << 32:
+		sys.exit("resistance too big for res_t")
+
+	# Rounded up, so that the table points convert exactly
+	dens = [a - b for a, b in zip(res, res[1:])]
+	shift = recip_shift(deg_step, max(dens))
+	recip = [0] + [-(-((10 * deg_step) << shift) // d) for d in dens]
+
+	out = open(opts['-o'], 'w') if '-o' in opts else sys.stdout
+	w = lambda s = '': print(s, file=out)
+
+	w("/* Generated by gen_ntc_table.py: do not edit. */")
+	w()
+	w("#include <drv/ntc.h>")
+	if '-a' in opts:
+		w("#include <algo/table.h>")
+	w()
+	w("static const res_t %s_res[] =" % name)
+	w("{")
+	for t, r in zip(temps, res):
+		w("\t%dUL, /* %d C */" % (r, t))
+	w("};")
+	w()
+	w("static const uint32_t %s_recip[] =" % name)
+	w("{")
+	for i in range(0, len(recip), 6):
+		w("\t" + " ".join("%dUL," % v for v in recip[i:i + 6]))
+	w("};")
+	w()
+	w("const NtcHwInfo %s =" % name)
+	w("{")
+	w("\t%s_res, countof(%s_res), %d, %d, %s_recip, %d" % (name, name, deg_min, deg_step, name, shift))
+	w("};")
+
+	if '-a' not in opts:
+		return
+
+	bits, rser, rpar, amp, adc_shift = opts['-a'].split(':')
+	bits, adc_shift = int(bits), int(adc_shift)
+	rser, rpar, amp = float(rser), float(rpar), float(amp)
+
+	# Invert the hw/hw_ntc.h formula: ADC counts of the NTC at temperature t
+	def counts(t):
+		r = model(t)
+		rp = rpar * r / (rpar + r)
+		return (1 << bits) * amp * rp / (rser + rp)
+
+	def celsius(adc):
+		"""Temperature for the ADC counts, by bisection of counts()."""
+		lo, hi = tmin - 50.0, tmax + 50.0
+		for i in range(60):
+			mid = (lo + hi) / 2
+			if counts(mid) > adc:
+				lo = mid
+			else:
+				hi = mid
+		return (lo + hi) / 2
+
+	# Counts decrease with temperature: keep the curve where it is defined
+	first = int(counts(tmax)) >> adc_shift << adc_shift
+	last = min(int(math.ceil(counts(tmin))), (1 << bits) - 1)
+	y = []
+	x = first
+	while True:
+		# deg_t is celsius * 10
+		y.append(int(round(celsius(x) * 10)))
+		if x >= last:
+			break
+		x += 1 << adc_shift
+
+	w()
+	w("static const int %s_adc_y[] =" % name)
+	w("{")
+	for i in range(0, len(y), 10):
+		w("\t" + " ".join("%d," % v for v in y[i:i + 10]))
+	w("};")
+	w()
+	w("const TableEven %s_adc =" % name)
+	w("{")
+	w("\t%s_adc_y, countof(%s_adc_y), %d, %d" % (name, name, first, adc_shift))
+	w("};")
+
+if __name__ == "__main__":
+	main()
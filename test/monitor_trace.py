@@ -0,0 +1,141 @@
+#!/usr/bin/python
+# This file is part of BeRTOS.
+#
+# Bertos is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#
+# As a special exception, you may use this file as part of a free software
+# library without restriction.  Specifically, if other files instantiate
+# templates or use macros or inline functions from this file, or you compile
+# this file and link it with other files to produce an executable, this
+# file does not by itself cause the resulting executable to be covered by
+# the GNU General Public License.  This exception does not however
+# invalidate any other reasons why the executable file might be covered by
+# the GNU General Public License.
+#
+# Copyright 2016 Develer S.r.l. (http://www.develer.com/)
+#
+# Decoder for the scheduler trace written by monitor_traceDump().
+#
+# Usage: monitor_trace.py [-s] <dump file>
+#
+#  -s  print only the per-process summary, not the event timeline
+#
+
+from __future__ import print_function
+import struct
+import sys
+
+MAGIC = 0x43525442
+VERSION = 1
+
+EV_READY, EV_IN, EV_OUT, EV_EXIT, EV_USER = range(5)
+EV_NAMES = ("READY", "IN", "OUT", "EXIT", "USER")
+OUT_REASONS = ("blocked", "yield", "preempted")
+
+def parse(data):
+	magic, version, nproc, hz = struct.unpack_from("<IBBI", data, 0)
+	if magic != MAGIC:
+		raise ValueError("bad magic %#x" % magic)
+	if version != VERSION:
+		raise ValueError("unsupported version %d" % version)
+	pos = 10
+	names = {}
+	for i in range(nproc):
+		pid, length = struct.unpack_from("<BB", data, pos)
+		pos += 2
+		names[pid] = data[pos:pos + length].decode("ascii", "replace")
+		pos += length
+	count, = struct.unpack_from("<I", data, pos)
+	pos += 4
+	events = []
+	for i in range(count):
+		stamp, arg, ev, pid = struct.unpack_from("<IIBB", data, pos)
+		pos += 10
+		# Entries overwritten while dumping
+		if ev == 0xff:
+			continue
+		events.append((stamp, arg, ev, pid))
+	return hz, names, events
+
+def unwrap(events):
+	"""Turn the 32 bit wrapping stamps into monotonic times, relative to the first event."""
+	out = []
+	base = 0
+	prev = None
+	for stamp, arg, ev, pid in events:
+		if prev is not None and stamp < prev:
+			base += 1 << 32
+		prev = stamp
+		out.append((base + stamp, arg, ev, pid))
+	if out:
+		first = out[0][0]
+		out = [(t - first, arg, ev, pid) for t, arg, ev, pid in out]
+	return out
+
+def main():
+	args = sys.argv[1:]
+	summary_only = "-s" in args
+	args = [a for a in args if a != "-s"]
+	if len(args) != 1:
+		print("Usage: monitor_trace.py [-s] <dump file>", file=sys.stderr)
+		sys.exit(1)
+
+	with open(args[0], "rb") as f:
+		hz, names, events = parse(f.read())
+	events = unwrap(events)
+
+	def us(ticks):
+		return ticks * 1000000.0 / hz
+
+	def name(pid):
+		return names.get(pid, "#%d" % pid)
+
+	stats = {}
+	running = {}
+	for t, arg, ev, pid in events:
+		st = stats.setdefault(pid, {"run": 0, "sw": 0, "pre": 0, "lat": 0, "user": 0})
+		if ev == EV_IN:
+			running[pid] = t
+			st["lat"] = max(st["lat"], arg)
+			detail = "latency %.1f us" % us(arg)
+		elif ev == EV_OUT:
+			if pid in running:
+				st["run"] += t - running.pop(pid)
+			st["sw"] += 1
+			if arg == 2:
+				st["pre"] += 1
+			detail = OUT_REASONS[arg] if arg < len(OUT_REASONS) else str(arg)
+		elif ev == EV_USER:
+			st["user"] += 1
+			detail = "arg %u" % arg
+		else:
+			detail = ""
+		if not summary_only:
+			evname = EV_NAMES[ev] if ev < len(EV_NAMES) else str(ev)
+			print("%12.1f  %-16s %-6s %s" % (us(t), name(pid), evname, detail))
+
+	span = events[-1][0] if events else 0
+	if not summary_only:
+		print()
+	print("%d events over %.1f ms, %d Hz time stamps" % (len(events), us(span) / 1000, hz))
+	print("%-16s %10s %6s %12s %12s %6s" % ("Name", "Run[us]", "CPU%", "Sw(pre/tot)", "MaxLat[us]", "User"))
+	for pid in sorted(stats):
+		st = stats[pid]
+		print("%-16s %10.0f %6.1f %5d/%-6d %12.1f %6d" % (name(pid), us(st["run"]),
+			100.0 * st["run"] / span if span else 0.0,
+			st["pre"], st["sw"], us(st["lat"]), st["user"]))
+
+if __name__ == "__main__":
+	main()
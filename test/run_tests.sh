@@ -30,30 +30,42 @@ TESTS=${TESTS:-`find . \
 
 TESTOUT="testout"
 SRC_LIST="
+	bertos/algo/filter.c
 	bertos/algo/ramp.c
+	bertos/algo/table.c
 	bertos/algo/crc_ccitt.c
 	bertos/algo/crc.c
+	bertos/algo/crc32.c
 	bertos/algo/fletcher32.c
+	bertos/algo/hamming.c
 	bertos/drv/kdebug.c
 	bertos/drv/timer.c
+	bertos/drv/nand.c
+	bertos/drv/nand_ftl.c
 	bertos/kern/monitor.c
 	bertos/kern/proc.c
 	bertos/kern/signal.c
 	bertos/kern/sem.c
 	bertos/kern/preempt.c
 	bertos/kern/rtask.c
+	bertos/benchmark/bench.c
+	bertos/benchmark/kernel_bench.c
 	bertos/mware/event.c
 	bertos/mware/formatwr.c
 	bertos/mware/hex.c
 	bertos/mware/sprintf.c
 	bertos/mware/readline.c
+	bertos/mware/parser.c
 	bertos/os/hptime.c
 	bertos/struct/kfile_fifo.c
 	bertos/struct/heap.c
 	bertos/struct/hashtable.c
 	bertos/struct/bitarray.c
 	bertos/fs/fatfs/ff.c
-	bertos/emul/diskio_emul.c
+	bertos/fs/fatfs/diskio.c
+	bertos/emul/nand_emul.c
+	bertos/emul/dsp_stream_emul.c
+	bertos/io/dsp_stream.c
 	bertos/fs/fat.c
 	bertos/fs/battfs.c
 	bertos/emul/switch_ctx_emul.S
@@ -62,6 +74,9 @@ SRC_LIST="
 	bertos/struct/kfile_mem.c
 	bertos/net/ax25.c
 	bertos/net/afsk.c
+	bertos/net/afsk_corr.c
+	bertos/net/xmodem.c
+	bertos/net/xmodem_stream.c
 	bertos/net/nmeap/src/nmeap01.c
 	bertos/net/nmea.c
 	bertos/net/http.c
@@ -69,7 +84,9 @@ SRC_LIST="
 	bertos/io/kblock.c
 	bertos/io/kblock_ram.c
 	bertos/io/kblock_posix.c
+	bertos/io/reblock.c
 	bertos/io/kfile.c
+	bertos/io/kfile_buffered.c
 	bertos/sec/cipher.c
 	bertos/sec/cipher/blowfish.c
 	bertos/sec/cipher/aes.c